@@ -0,0 +1,455 @@
+/**
+ * @file adxl345.c
+ *
+ * Driver of the ADXL345 over SPI.
+ */
+
+#include "adxl345.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "motion_detector.h"
+#include "utils.h"
+
+/**
+ * @brief Threshold of activity (0.5g).
+ *
+ * 62.5mg/LSB.
+ */
+#define ADXL345_THRESH_ACT  8u
+
+/**
+ * @brief ACT_INACT_CTL: AC-coupled activity on every axis.
+ *
+ * AC coupling compares acceleration with the one when activity detection
+ * started, so gravity does not count.
+ */
+#define ADXL345_ACT_INACT_CTL  0xF0u
+
+/**
+ * @brief Threshold of taps (3g).
+ *
+ * 62.5mg/LSB.
+ */
+#define ADXL345_THRESH_TAP  48u
+
+/**
+ * @brief Maximum duration of a tap (10ms).
+ *
+ * 625us/LSB.
+ */
+#define ADXL345_TAP_DURATION  16u
+
+/** @brief TAP_AXES: taps on every axis. */
+#define ADXL345_TAP_AXES  0x07u
+
+/**
+ * @brief Threshold of free fall (0.4g).
+ *
+ * 62.5mg/LSB. Free fall is when every axis is below this.
+ */
+#define ADXL345_THRESH_FF  6u
+
+/**
+ * @brief Minimum duration of free fall (100ms).
+ *
+ * 5ms/LSB.
+ */
+#define ADXL345_TIME_FF  20u
+
+/** @brief ADXL345 delay to update (200ms). */
+#define ADXL345_UPDATE_DELAY_MS  200u
+
+/** @brief Dummy buffer transmitted while samples are read. */
+static const uint8_t ADXL345_DUMMY_TX[3u * sizeof(int16_t)] = { 0 };
+
+/** @brief Transactions to read the FIFO. */
+static hal_spi_transaction adxl345_fifo_transactions[ADXL345_MAX_FIFO_ENTRIES];
+
+hal_err_t adxl345_read (
+		hal_spi_device spi,
+		uint8_t address,
+		uint8_t* value)
+{
+	hal_err_t ret;
+	hal_spi_transaction trans = {
+		.flags = HAL_SPI_USE_RXDATA | HAL_SPI_USE_TXDATA,
+		.cmd = address | ADXL345_REG_READ_FLAG,
+		.length = 8 // in bits
+	};
+	ret = hal_spi_transmit(spi, &trans);
+	if (ret != HAL_OK) {
+		return ret;
+	}
+	*value = trans.rx_data[0];
+	return HAL_OK;
+}
+
+hal_err_t adxl345_write (
+		hal_spi_device spi,
+		uint8_t address,
+		uint8_t value)
+{
+	hal_spi_transaction trans = {
+		.flags = HAL_SPI_USE_RXDATA,
+		.cmd = address,
+		.tx_buffer = &value,
+		.length = 8 // in bits
+	};
+	return hal_spi_transmit(spi, &trans);
+}
+
+hal_err_t adxl345_read_acceleration (hal_spi_device spi, int16_t* accs) {
+	uint8_t tx_buffer[3u * sizeof(uint16_t)]; // a dummy buffer
+	hal_spi_transaction trans = {
+		.cmd = ADXL345_REG_READ_FLAG |
+			ADXL345_REG_MB_FLAG |
+			ADXL345_REG_DATAX0,
+		.length = sizeof(tx_buffer) * 8, // in bits
+		.tx_buffer = tx_buffer,
+		.rx_buffer = accs
+	};
+	// sample of each axis is represented in twos complement.
+	// and as ESP32 is little endian, `accs` does not need swapping.
+	// https://docs.espressif.com/projects/esp-idf/en/latest/api-reference/peripherals/spi_master.html#transactions-with-integers-other-than-uint8-t
+	return hal_spi_transmit(spi, &trans);
+}
+
+/**
+ * @brief Reads a register, and aborts if the transaction fails.
+ *
+ * Steps that return no error abort with `HAL_ERROR_CHECK` like
+ * `::adxl345_read_fifo`; unlike `assert`, it is not compiled out by
+ * `NDEBUG`.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in] address
+ *
+ *   Address of the register.
+ *
+ * @return
+ *
+ *   Value of the register.
+ */
+static uint8_t adxl345_read_checked (hal_spi_device spi, uint8_t address) {
+	uint8_t value = 0u;
+	HAL_ERROR_CHECK(adxl345_read(spi, address, &value));
+	return value;
+}
+
+/**
+ * @brief Writes a register, and aborts if the transaction fails.
+ *
+ * See `::adxl345_read_checked`.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in] address
+ *
+ *   Address of the register.
+ *
+ * @param[in] value
+ *
+ *   Value to write.
+ */
+static void adxl345_write_checked (
+		hal_spi_device spi,
+		uint8_t address,
+		uint8_t value)
+{
+	HAL_ERROR_CHECK(adxl345_write(spi, address, value));
+}
+
+void adxl345_init (hal_spi_device spi) {
+	uint8_t out;
+	out = adxl345_read_checked(spi, ADXL345_REG_DEVID);
+	printf("DEVID: 0x%X\n", out);
+	out = adxl345_read_checked(spi, ADXL345_REG_BW_RATE);
+	printf("BW_RATE: 0x%X\n", out);
+}
+
+uint32_t adxl345_odr_millihz (const adxl345_config* config) {
+	return 3200000u >> (ADXL345_RATE_3200HZ - config->rate);
+}
+
+uint32_t adxl345_bus_bits_per_second (
+		const adxl345_config* config,
+		uint32_t watermark)
+{
+	uint64_t bits = ADXL345_BITS_PER_SAMPLE * 1000u;
+	if (watermark > 0u) {
+		bits += (2u * ADXL345_BITS_PER_REGISTER * 1000u) / watermark;
+	}
+	return (uint32_t)((bits * adxl345_odr_millihz(config)) / 1000000u);
+}
+
+int adxl345_spi_clock_hz (
+		const adxl345_config* config,
+		uint32_t watermark)
+{
+	static const int CLOCKS[] = { 1000000, 2000000, ADXL345_MAX_SPI_CLOCK_HZ };
+	const uint64_t bits = adxl345_bus_bits_per_second(config, watermark);
+	size_t i;
+	for (i = 0; i < sizeof(CLOCKS) / sizeof(CLOCKS[0]); ++i) {
+		if ((config->rate >= ADXL345_RATE_1600HZ) &&
+			(CLOCKS[i] < ADXL345_MIN_FAST_SPI_CLOCK_HZ))
+		{
+			continue;
+		}
+		if (bits * 100u <= (uint64_t)CLOCKS[i] * ADXL345_MAX_BUS_UTILIZATION) {
+			break;
+		}
+	}
+	return CLOCKS[MIN(i, sizeof(CLOCKS) / sizeof(CLOCKS[0]) - 1u)];
+}
+
+hal_err_t adxl345_configure (
+		hal_spi_device spi,
+		const adxl345_config* config)
+{
+	const uint8_t bw_rate = (uint8_t)config->rate |
+		(config->low_power ? ADXL345_BW_RATE_LOW_POWER : 0u);
+	const uint8_t data_format = (uint8_t)config->range |
+		(config->full_resolution ? ADXL345_DATA_FORMAT_FULL_RES : 0u);
+	hal_err_t ret;
+	uint8_t actual_bw_rate;
+	uint8_t actual_data_format;
+	assert(!config->low_power ||
+		((config->rate >= ADXL345_RATE_12_5HZ) &&
+		 (config->rate <= ADXL345_RATE_400HZ)));
+	ret = adxl345_write(spi, ADXL345_REG_BW_RATE, bw_rate);
+	if (ret != HAL_OK) {
+		return ret;
+	}
+	ret = adxl345_write(spi, ADXL345_REG_DATA_FORMAT, data_format);
+	if (ret != HAL_OK) {
+		return ret;
+	}
+	ret = adxl345_read(spi, ADXL345_REG_BW_RATE, &actual_bw_rate);
+	if (ret != HAL_OK) {
+		return ret;
+	}
+	ret = adxl345_read(spi, ADXL345_REG_DATA_FORMAT, &actual_data_format);
+	if (ret != HAL_OK) {
+		return ret;
+	}
+	if ((actual_bw_rate != bw_rate) || (actual_data_format != data_format)) {
+		return HAL_ERR_INVALID_RESPONSE;
+	}
+	return HAL_OK;
+}
+
+void adxl345_print_config (
+		const adxl345_config* config,
+		uint32_t watermark,
+		int spi_clock_hz)
+{
+	const uint32_t odr = adxl345_odr_millihz(config);
+	const uint32_t bits = adxl345_bus_bits_per_second(config, watermark);
+	const uint32_t utilization =
+		(uint32_t)(((uint64_t)bits * 1000u) / (uint32_t)spi_clock_hz);
+	printf(
+		"ODR: %u.%03uHz, range: +-%dg, full resolution: %d, low power: %d\n",
+		(unsigned)(odr / 1000u),
+		(unsigned)(odr % 1000u),
+		2 << config->range,
+		config->full_resolution,
+		config->low_power);
+	printf(
+		"SPI: %dHz, %u bits/s, bus utilization: %u.%u%%\n",
+		spi_clock_hz,
+		(unsigned)bits,
+		(unsigned)(utilization / 10u),
+		(unsigned)(utilization % 10u));
+}
+
+void adxl345_start (hal_spi_device spi) {
+	adxl345_write_checked(spi, ADXL345_REG_POWER_CTL, ADXL345_POWER_CTL_MEASURE);
+	hal_delay_ms(ADXL345_UPDATE_DELAY_MS);
+}
+
+void adxl345_configure_fifo (hal_spi_device spi, uint32_t watermark) {
+	assert((watermark > 0u) && (watermark < 32u));
+	adxl345_write_checked(
+		spi,
+		ADXL345_REG_FIFO_CTL,
+		ADXL345_FIFO_CTL_STREAM | (uint8_t)watermark);
+	// 0 maps an interrupt to INT1
+	adxl345_write_checked(spi, ADXL345_REG_INT_MAP, 0x00u);
+	adxl345_write_checked(spi, ADXL345_REG_INT_ENABLE, ADXL345_INT_WATERMARK);
+}
+
+void adxl345_read_fifo (
+		hal_spi_device spi,
+		sample_record* samples,
+		size_t num_samples)
+{
+	hal_err_t ret;
+	hal_spi_transaction* trans;
+	size_t i;
+	assert(num_samples <= ADXL345_MAX_FIFO_ENTRIES);
+	for (i = 0; i < num_samples; ++i) {
+		trans = &adxl345_fifo_transactions[i];
+		memset(trans, 0, sizeof(hal_spi_transaction));
+		trans->cmd = ADXL345_REG_READ_FLAG |
+			ADXL345_REG_MB_FLAG |
+			ADXL345_REG_DATAX0;
+		trans->length = sizeof(ADXL345_DUMMY_TX) * 8; // in bits
+		trans->tx_buffer = ADXL345_DUMMY_TX;
+		trans->rx_buffer = samples[i].accs;
+		ret = hal_spi_queue(spi, trans);
+		HAL_ERROR_CHECK(ret);
+	}
+	for (i = 0; i < num_samples; ++i) {
+		ret = hal_spi_get_result(spi, &trans);
+		HAL_ERROR_CHECK(ret);
+	}
+}
+
+/**
+ * @brief Reads a given number of samples in the FIFO, and stamps them.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in,out] clock
+ *
+ *   Clock of samples.
+ *
+ * @param[out] samples
+ *
+ *   Buffer to receive samples.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples to read; FIFO_STATUS read by the caller.
+ */
+static void adxl345_read_stamped_entries (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		sample_record* samples,
+		size_t num_samples)
+{
+	size_t i;
+	adxl345_read_fifo(spi, samples, num_samples);
+	clock->drain_end_timestamp = hal_get_time_us();
+	for (i = 0; i < num_samples; ++i, ++clock->next_index) {
+		samples[i].timestamp = clock->anchor_timestamp +
+			((int64_t)(clock->next_index - clock->anchor_index) * 1000000000) /
+			(int64_t)clock->odr_millihz;
+	}
+}
+
+size_t adxl345_read_stamped_fifo (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		sample_record* samples)
+{
+	const size_t num_samples =
+		adxl345_read_checked(spi, ADXL345_REG_FIFO_STATUS) &
+		ADXL345_FIFO_STATUS_ENTRIES_MASK;
+	adxl345_read_stamped_entries(spi, clock, samples, num_samples);
+	return num_samples;
+}
+
+void adxl345_discard_fifo (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		uint32_t odr_millihz)
+{
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	// samples taken while the FIFO is read would be stamped after
+	// the anchor below; reads them again until none is left
+	while (adxl345_read_stamped_fifo(spi, clock, samples) > 0u);
+	adxl345_read_checked(spi, ADXL345_REG_INT_SOURCE);
+	clock->odr_millihz = odr_millihz;
+	clock->anchor_index = clock->next_index;
+	clock->anchor_timestamp = clock->drain_end_timestamp;
+}
+
+size_t adxl345_drain_fifo (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		uint32_t watermark,
+		adxl345_edge_timestamp_fn get_edge_timestamp,
+		sample_record* samples,
+		uint8_t* int_source)
+{
+	size_t num_samples;
+	int64_t edge_timestamp;
+	*int_source = adxl345_read_checked(spi, ADXL345_REG_INT_SOURCE);
+	num_samples = adxl345_read_checked(spi, ADXL345_REG_FIFO_STATUS) &
+		ADXL345_FIFO_STATUS_ENTRIES_MASK;
+	edge_timestamp = get_edge_timestamp();
+	// the sample at the watermark was taken at the edge,
+	// unless the previous drain popped samples after the edge
+	if ((num_samples >= watermark) &&
+		(edge_timestamp > clock->drain_end_timestamp))
+	{
+		clock->anchor_index = clock->next_index + watermark - 1u;
+		clock->anchor_timestamp = edge_timestamp;
+	}
+	// samples taken since FIFO_STATUS are left for the next drain
+	adxl345_read_stamped_entries(spi, clock, samples, num_samples);
+	return num_samples;
+}
+
+void adxl345_configure_events (hal_spi_device spi) {
+	adxl345_write_checked(spi, ADXL345_REG_THRESH_ACT, ADXL345_THRESH_ACT);
+	adxl345_write_checked(spi, ADXL345_REG_ACT_INACT_CTL, ADXL345_ACT_INACT_CTL);
+	adxl345_write_checked(spi, ADXL345_REG_THRESH_TAP, ADXL345_THRESH_TAP);
+	adxl345_write_checked(spi, ADXL345_REG_DUR, ADXL345_TAP_DURATION);
+	adxl345_write_checked(spi, ADXL345_REG_LATENT, 0x00u); // disables double taps
+	adxl345_write_checked(spi, ADXL345_REG_TAP_AXES, ADXL345_TAP_AXES);
+	adxl345_write_checked(spi, ADXL345_REG_THRESH_FF, ADXL345_THRESH_FF);
+	adxl345_write_checked(spi, ADXL345_REG_TIME_FF, ADXL345_TIME_FF);
+}
+
+void adxl345_arm_events (
+		hal_spi_device spi,
+		const adxl345_config* idle_config,
+		adxl345_fifo_clock* clock)
+{
+	hal_err_t ret;
+	adxl345_write_checked(spi, ADXL345_REG_INT_ENABLE, 0x00u);
+	ret = adxl345_configure(spi, idle_config);
+	HAL_ERROR_CHECK(ret);
+	adxl345_discard_fifo(spi, clock, adxl345_odr_millihz(idle_config));
+	// 0 maps an interrupt to INT1
+	adxl345_write_checked(spi, ADXL345_REG_INT_MAP, 0x00u);
+	adxl345_write_checked(spi, ADXL345_REG_INT_ENABLE, MOTION_EVENT_MASK);
+}
+
+size_t adxl345_start_capture (
+		hal_spi_device spi,
+		const adxl345_config* config,
+		adxl345_fifo_clock* clock,
+		adxl345_edge_timestamp_fn get_edge_timestamp,
+		sample_record* samples)
+{
+	size_t num_samples;
+	// the newest sample in the FIFO caused the edge
+	num_samples = adxl345_read_checked(spi, ADXL345_REG_FIFO_STATUS) &
+		ADXL345_FIFO_STATUS_ENTRIES_MASK;
+	clock->anchor_index = clock->next_index + MAX(num_samples, 1u) - 1u;
+	clock->anchor_timestamp = get_edge_timestamp();
+	num_samples = adxl345_read_stamped_fifo(spi, clock, samples);
+	adxl345_write_checked(spi, ADXL345_REG_BW_RATE, (uint8_t)config->rate);
+	clock->odr_millihz = adxl345_odr_millihz(config);
+	clock->anchor_index = clock->next_index;
+	clock->anchor_timestamp = hal_get_time_us();
+	adxl345_write_checked(spi, ADXL345_REG_INT_MAP, MOTION_EVENT_MASK);
+	adxl345_write_checked(
+		spi,
+		ADXL345_REG_INT_ENABLE,
+		ADXL345_INT_WATERMARK | MOTION_EVENT_MASK);
+	return num_samples;
+}
@@ -0,0 +1,693 @@
+#ifndef _ADXL345_H
+#define _ADXL345_H
+
+/**
+ * @file adxl345.h
+ *
+ * Driver of the ADXL345 over SPI.
+ *
+ * The driver talks to the ADXL345 only through `hal.h`,
+ * so it also runs against a simulated ADXL345 on the Linux HAL.
+ * Tasks, interrupts and buffering of samples are left to the application.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief ADXL345 register read flag. */
+#define ADXL345_REG_READ_FLAG  0x80u
+/** @brief ADXL345 register multibyte flag. */
+#define ADXL345_REG_MB_FLAG  0x40u
+/** @brief ADXL345 register: DEVID. */
+#define ADXL345_REG_DEVID  0x00u
+/** @brief ADXL345 register: THRESH_TAP. */
+#define ADXL345_REG_THRESH_TAP  0x1Du
+/** @brief ADXL345 register: DUR. */
+#define ADXL345_REG_DUR  0x21u
+/** @brief ADXL345 register: LATENT. */
+#define ADXL345_REG_LATENT  0x22u
+/** @brief ADXL345 register: THRESH_ACT. */
+#define ADXL345_REG_THRESH_ACT  0x24u
+/** @brief ADXL345 register: ACT_INACT_CTL. */
+#define ADXL345_REG_ACT_INACT_CTL  0x27u
+/** @brief ADXL345 register: THRESH_FF. */
+#define ADXL345_REG_THRESH_FF  0x28u
+/** @brief ADXL345 register: TIME_FF. */
+#define ADXL345_REG_TIME_FF  0x29u
+/** @brief ADXL345 register: TAP_AXES. */
+#define ADXL345_REG_TAP_AXES  0x2Au
+/** @brief ADXL345 register: BW_RATE. */
+#define ADXL345_REG_BW_RATE  0x2Cu
+/** @brief ADXL345 register: POWER_CTL. */
+#define ADXL345_REG_POWER_CTL  0x2Du
+/** @brief ADXL345 register: INT_ENABLE. */
+#define ADXL345_REG_INT_ENABLE  0x2Eu
+/** @brief ADXL345 register: INT_MAP. */
+#define ADXL345_REG_INT_MAP  0x2Fu
+/** @brief ADXL345 register: INT_SOURCE. */
+#define ADXL345_REG_INT_SOURCE  0x30u
+/** @brief ADXL345 register: DATA_FORMAT. */
+#define ADXL345_REG_DATA_FORMAT  0x31u
+/** @brief ADXL345 register: DATAX0. */
+#define ADXL345_REG_DATAX0  0x32u
+/** @brief ADXL345 register: FIFO_CTL. */
+#define ADXL345_REG_FIFO_CTL  0x38u
+/** @brief ADXL345 register: FIFO_STATUS. */
+#define ADXL345_REG_FIFO_STATUS  0x39u
+
+/** @brief ADXL345 POWER_CTL flag: Measure. */
+#define ADXL345_POWER_CTL_MEASURE  0x08u
+
+/** @brief ADXL345 BW_RATE flag: Low power. */
+#define ADXL345_BW_RATE_LOW_POWER  0x10u
+/** @brief ADXL345 BW_RATE: mask for the rate code. */
+#define ADXL345_BW_RATE_RATE_MASK  0x0Fu
+
+/** @brief ADXL345 DATA_FORMAT flag: Full resolution. */
+#define ADXL345_DATA_FORMAT_FULL_RES  0x08u
+/** @brief ADXL345 DATA_FORMAT: mask for the range. */
+#define ADXL345_DATA_FORMAT_RANGE_MASK  0x03u
+
+/** @brief Maximum SPI clock of the ADXL345 (5MHz). */
+#define ADXL345_MAX_SPI_CLOCK_HZ  5000000
+
+/**
+ * @brief Minimum SPI clock for 1600Hz or faster output data rates (2MHz).
+ *
+ * Recommended by the datasheet.
+ */
+#define ADXL345_MIN_FAST_SPI_CLOCK_HZ  2000000
+
+/** @brief Number of bits to read a sample; command and 6 bytes. */
+#define ADXL345_BITS_PER_SAMPLE  (8u + 48u)
+
+/** @brief Number of bits to read a register; command and 1 byte. */
+#define ADXL345_BITS_PER_REGISTER  (8u + 8u)
+
+/**
+ * @brief Maximum bus utilization when an SPI clock is chosen (in percent).
+ *
+ * Leaves room for gaps between transactions that the SPI driver makes.
+ */
+#define ADXL345_MAX_BUS_UTILIZATION  25u
+
+/** @brief ADXL345 interrupt: Watermark. */
+#define ADXL345_INT_WATERMARK  0x02u
+/** @brief ADXL345 interrupt: Overrun. */
+#define ADXL345_INT_OVERRUN  0x01u
+
+/** @brief ADXL345 FIFO_CTL: Stream mode. */
+#define ADXL345_FIFO_CTL_STREAM  0x80u
+/** @brief ADXL345 FIFO_STATUS: mask for the number of entries. */
+#define ADXL345_FIFO_STATUS_ENTRIES_MASK  0x3Fu
+
+/**
+ * @brief Maximum number of samples the ADXL345 holds.
+ *
+ * 32 in the FIFO and 1 in the output registers.
+ */
+#define ADXL345_MAX_FIFO_ENTRIES  33u
+
+/**
+ * @brief Output data rate of the ADXL345.
+ *
+ * Values are codes in BW_RATE.
+ */
+typedef enum adxl345_rate_t {
+	ADXL345_RATE_0_10HZ = 0x00,
+	ADXL345_RATE_0_20HZ = 0x01,
+	ADXL345_RATE_0_39HZ = 0x02,
+	ADXL345_RATE_0_78HZ = 0x03,
+	ADXL345_RATE_1_56HZ = 0x04,
+	ADXL345_RATE_3_13HZ = 0x05,
+	ADXL345_RATE_6_25HZ = 0x06,
+	ADXL345_RATE_12_5HZ = 0x07,
+	ADXL345_RATE_25HZ = 0x08,
+	ADXL345_RATE_50HZ = 0x09,
+	ADXL345_RATE_100HZ = 0x0A, // default
+	ADXL345_RATE_200HZ = 0x0B,
+	ADXL345_RATE_400HZ = 0x0C,
+	ADXL345_RATE_800HZ = 0x0D,
+	ADXL345_RATE_1600HZ = 0x0E,
+	ADXL345_RATE_3200HZ = 0x0F
+} adxl345_rate;
+
+/**
+ * @brief Measurement range of the ADXL345.
+ *
+ * Values are codes in DATA_FORMAT.
+ */
+typedef enum adxl345_range_t {
+	ADXL345_RANGE_2G = 0x00, // default
+	ADXL345_RANGE_4G = 0x01,
+	ADXL345_RANGE_8G = 0x02,
+	ADXL345_RANGE_16G = 0x03
+} adxl345_range;
+
+/**
+ * @brief Configuration of the ADXL345.
+ */
+typedef struct adxl345_config_t {
+	/** @brief Output data rate. */
+	adxl345_rate rate;
+	/** @brief Measurement range. */
+	adxl345_range range;
+	/**
+	 * @brief Whether the full resolution mode is enabled.
+	 *
+	 * The resolution is 4mg/LSB in any range if non-zero,
+	 * otherwise 10 bits spread over the range.
+	 */
+	int full_resolution;
+	/**
+	 * @brief Whether the low power mode is enabled.
+	 *
+	 * Valid only from 12.5Hz to 400Hz, and slightly noisier.
+	 */
+	int low_power;
+} adxl345_config;
+
+/**
+ * @brief Initializer of an `::adxl345_config`.
+ *
+ * @param[in] _rate
+ *
+ *   (`adxl345_rate`) Output data rate.
+ *
+ * @param[in] _range
+ *
+ *   (`adxl345_range`) Measurement range.
+ *
+ * @param[in] _full_resolution
+ *
+ *   (`int`) Whether the full resolution mode is enabled.
+ *
+ * @param[in] _low_power
+ *
+ *   (`int`) Whether the low power mode is enabled.
+ *
+ * @return
+ *
+ *   Initializer of an `::adxl345_config`.
+ */
+#define adxl345_config_initializer(_rate, _range, _full_resolution, _low_power) \
+{ \
+	.rate = (_rate), \
+	.range = (_range), \
+	.full_resolution = (_full_resolution), \
+	.low_power = (_low_power) \
+}
+
+/**
+ * @brief Clock of samples drained from the FIFO.
+ *
+ * Sample `n` was taken at
+ * `anchor_timestamp + (n - anchor_index) / odr`.
+ */
+typedef struct adxl345_fifo_clock_t {
+	/** @brief Current output data rate in mHz. */
+	uint32_t odr_millihz;
+	/** @brief Index of the next sample. */
+	uint64_t next_index;
+	/** @brief Index of the sample taken at `anchor_timestamp`. */
+	uint64_t anchor_index;
+	/** @brief Time when sample `anchor_index` was taken. */
+	int64_t anchor_timestamp;
+	/** @brief Time when the FIFO was drained last time. */
+	int64_t drain_end_timestamp;
+} adxl345_fifo_clock;
+
+/**
+ * @brief Obtains the time of the last rising edge of INT1.
+ *
+ * Provided by the application, which owns the interrupt.
+ *
+ * @return
+ *
+ *   Time of the last rising edge of INT1 in microseconds.
+ */
+typedef int64_t (*adxl345_edge_timestamp_fn)(void);
+
+/**
+ * @brief Reads a given register from an ADXL345.
+ *
+ * In a 4-wire SPI transaction, transmission and receiving happen in parallel
+ * as shown below.
+ *
+ * ```
+ * Transmit: command --> t.tx_data[0]
+ * Receive:  N/A     --> t.rx_data[0]
+ *
+ * where
+ * command = address | ADXL345_READ_FLAG
+ * and t is hal_spi_transaction
+ *   t.tx_data[1] = do not care
+ *   t.rx_data[0] = register value
+ * ```
+ *
+ * This function blocks until the transmission and receiving end.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345 from which the register is to be read.
+ *
+ * @param[in] address
+ *
+ *   Address of the register to be read.
+ *
+ * @param[out] value
+ *
+ *   Receives the value of the register associated with `address`.
+ *   Untouched if the transaction fails.
+ *
+ * @return
+ *
+ *   `HAL_OK` if succeeded, or the error of `::hal_spi_transmit`.
+ */
+hal_err_t adxl345_read (
+		hal_spi_device spi,
+		uint8_t address,
+		uint8_t* value);
+
+/**
+ * @brief Writes a given value in a specified register of an ADXL345.
+ *
+ * In a 4-wire SPI transaction, transmission and receiving happen in parallel
+ * as shown below.
+ *
+ * ```
+ * Transmit: address --> t.tx_data[0]
+ * Receive:  N/A     --> t.rx_data[0]
+ *
+ * where t is hal_spi_transaction and
+ * t.tx_data[0] = value
+ * t.rx_data[0] = do not care
+ * ```
+ *
+ * This function blocks until the transmission and receiving end.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345 where the register value is to be set.
+ *
+ * @param[in] address
+ *
+ *   Address of the register to be written.
+ *
+ * @param[in] value
+ *
+ *   Value to be written to the register associated with `address`.
+ *
+ * @return
+ *
+ *   `HAL_OK` if succeeded, or the error of `::hal_spi_transmit`.
+ */
+hal_err_t adxl345_write (
+		hal_spi_device spi,
+		uint8_t address,
+		uint8_t value);
+
+/**
+ * @brief Reads the latest acceleration from the ADXL345.
+ *
+ * Undefined if `accs` does not point to a block smaller than
+ * `sizeof(int16_t) * 3`
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345 from which the latest acceleration is to be read.
+ *
+ * @param[out] accs
+ *
+ *   Buffer to receive acceleration.
+ *   - `[0]`: x-acceleration
+ *   - `[1]`: y-acceleration
+ *   - `[2]`: z-acceleration
+ *
+ * @return
+ *
+ *   `HAL_OK` if succeeded, or the error of `::hal_spi_transmit`.
+ */
+hal_err_t adxl345_read_acceleration (hal_spi_device spi, int16_t* accs);
+
+/**
+ * @brief Initializes the ADXL345.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345 to be initialized.
+ */
+void adxl345_init (hal_spi_device spi);
+
+/**
+ * @brief Output data rate of a given configuration.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ *
+ * @return
+ *
+ *   Output data rate in mHz; `3200Hz / 2^(15 - code)`.
+ */
+uint32_t adxl345_odr_millihz (const adxl345_config* config);
+
+/**
+ * @brief Number of bits transferred per second with a given configuration.
+ *
+ * Counts only bits on the bus; gaps between transactions are not included.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ *
+ * @param[in] watermark
+ *
+ *   Watermark of the FIFO. Two registers are read to drain the FIFO
+ *   every `watermark` samples.
+ *   `0` if the FIFO is not used.
+ *
+ * @return
+ *
+ *   Number of bits per second.
+ */
+uint32_t adxl345_bus_bits_per_second (
+		const adxl345_config* config,
+		uint32_t watermark);
+
+/**
+ * @brief Chooses an SPI clock for a given configuration.
+ *
+ * Chooses the slowest of 1MHz, 2MHz and 5MHz that keeps the bus
+ * utilization within `ADXL345_MAX_BUS_UTILIZATION`,
+ * and is at least 2MHz for 1600Hz or faster output data rates.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ *
+ * @param[in] watermark
+ *
+ *   Watermark of the FIFO. `0` if the FIFO is not used.
+ *
+ * @return
+ *
+ *   SPI clock in Hz.
+ */
+int adxl345_spi_clock_hz (
+		const adxl345_config* config,
+		uint32_t watermark);
+
+/**
+ * @brief Configures the output data rate, range and resolution.
+ *
+ * Call this function before `::adxl345_start`.
+ * Registers are read back to verify that the ADXL345 accepted them.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in] config
+ *
+ *   Configuration to apply.
+ *   `low_power` has to be `0` unless `rate` is from 12.5Hz to 400Hz.
+ *
+ * @return
+ *
+ *   - `HAL_OK`: succeeded.
+ *   - `HAL_ERR_INVALID_RESPONSE`: a register did not hold a written value.
+ *   - the error of `::hal_spi_transmit` if a transaction failed.
+ */
+hal_err_t adxl345_configure (
+		hal_spi_device spi,
+		const adxl345_config* config);
+
+/**
+ * @brief Prints a given configuration and the bus utilization.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ *
+ * @param[in] watermark
+ *
+ *   Watermark of the FIFO. `0` if the FIFO is not used.
+ *
+ * @param[in] spi_clock_hz
+ *
+ *   SPI clock in Hz.
+ */
+void adxl345_print_config (
+		const adxl345_config* config,
+		uint32_t watermark,
+		int spi_clock_hz);
+
+/**
+ * @brief Starts sampling of the ADXL345.
+ *
+ * This function blocks for 200ms after sending a start command.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345 to start.
+ */
+void adxl345_start (hal_spi_device spi);
+
+/**
+ * @brief Configures the FIFO of the ADXL345 in the stream mode.
+ *
+ * The watermark interrupt is mapped to INT1 (active high).
+ * Call this function before `::adxl345_start`.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in] watermark
+ *
+ *   Number of samples in the FIFO that raises INT1. From `1` to `31`.
+ */
+void adxl345_configure_fifo (hal_spi_device spi, uint32_t watermark);
+
+/**
+ * @brief Reads samples from the FIFO of the ADXL345.
+ *
+ * Each sample is read in a multibyte transaction from DATAX0 to DATAZ1,
+ * which pops the sample from the FIFO.
+ * All of the transactions are queued back-to-back,
+ * and this function blocks until they end.
+ *
+ * The datasheet requires at least 5us between the end of reading a sample
+ * and the next read. The gap between queued transactions of the SPI driver
+ * is longer than that.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[out] samples
+ *
+ *   Buffer to receive samples.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples to read.
+ *   Must not exceed `ADXL345_MAX_FIFO_ENTRIES`.
+ */
+void adxl345_read_fifo (
+		hal_spi_device spi,
+		sample_record* samples,
+		size_t num_samples);
+
+/**
+ * @brief Reads samples in the FIFO, and stamps them with a given clock.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in,out] clock
+ *
+ *   Clock of samples.
+ *
+ * @param[out] samples
+ *
+ *   Buffer to receive samples.
+ *   Has to be as large as `ADXL345_MAX_FIFO_ENTRIES` samples.
+ *
+ * @return
+ *
+ *   Number of samples read.
+ */
+size_t adxl345_read_stamped_fifo (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		sample_record* samples);
+
+/**
+ * @brief Discards samples in the FIFO.
+ *
+ * Keeps reading until the FIFO is empty, because samples are taken while
+ * it is read.
+ * Also clears the overrun and events in INT_SOURCE.
+ * The clock restarts at the output data rate `odr_millihz` from now.
+ * As the next sample may come up to a period later, samples are stamped
+ * early by as much until the next edge of INT1 anchors the clock.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[out] clock
+ *
+ *   Clock of samples.
+ *
+ * @param[in] odr_millihz
+ *
+ *   Output data rate in mHz.
+ */
+void adxl345_discard_fifo (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		uint32_t odr_millihz);
+
+/**
+ * @brief Drains the FIFO once.
+ *
+ * Reads INT_SOURCE, which tells overruns, then reads every sample in
+ * the FIFO.
+ *
+ * Samples are stamped by counting them at the output data rate from the
+ * latest rising edge of INT1, when the sample at the watermark was taken.
+ * So timestamps do not depend on when the FIFO is drained, and do not
+ * drift as they are re-anchored at every edge.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in,out] clock
+ *
+ *   Clock of samples.
+ *
+ * @param[in] watermark
+ *
+ *   Watermark given to `::adxl345_configure_fifo`.
+ *
+ * @param[in] get_edge_timestamp
+ *
+ *   Obtains the time of the last rising edge of INT1.
+ *   Called after the number of samples in the FIFO is read.
+ *
+ * @param[out] samples
+ *
+ *   Buffer to receive samples.
+ *   Has to be as large as `ADXL345_MAX_FIFO_ENTRIES` samples.
+ *
+ * @param[out] int_source
+ *
+ *   Receives INT_SOURCE, which is cleared by reading it.
+ *   `ADXL345_INT_OVERRUN` is set if the FIFO overran.
+ *
+ * @return
+ *
+ *   Number of samples drained.
+ */
+size_t adxl345_drain_fifo (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		uint32_t watermark,
+		adxl345_edge_timestamp_fn get_edge_timestamp,
+		sample_record* samples,
+		uint8_t* int_source);
+
+/**
+ * @brief Configures detection of events.
+ *
+ * Thresholds of activity, taps and free fall are written.
+ * Call this function before `::adxl345_start`.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ */
+void adxl345_configure_events (hal_spi_device spi);
+
+/**
+ * @brief Goes idle and waits for an event.
+ *
+ * Lowers the output data rate to a given idle configuration,
+ * discards samples in the FIFO, and maps events to INT1.
+ * Aborts if the ADXL345 does not accept the configuration.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in] idle_config
+ *
+ *   Configuration while waiting for events.
+ *
+ * @param[out] clock
+ *
+ *   Clock of samples.
+ */
+void adxl345_arm_events (
+		hal_spi_device spi,
+		const adxl345_config* idle_config,
+		adxl345_fifo_clock* clock);
+
+/**
+ * @brief Starts a capture.
+ *
+ * Reads samples in the FIFO as the pre-trigger window,
+ * then raises the output data rate to that of a given configuration,
+ * and maps the watermark to INT1 while events are moved to INT2,
+ * which is not connected but still shows events in INT_SOURCE.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the ADXL345.
+ *
+ * @param[in] config
+ *
+ *   Configuration of a capture. Only the output data rate is applied.
+ *
+ * @param[in,out] clock
+ *
+ *   Clock of samples.
+ *
+ * @param[in] get_edge_timestamp
+ *
+ *   Obtains the time of the last rising edge of INT1, which reported
+ *   the event.
+ *
+ * @param[out] samples
+ *
+ *   Buffer to receive the pre-trigger window.
+ *   Has to be as large as `ADXL345_MAX_FIFO_ENTRIES` samples.
+ *
+ * @return
+ *
+ *   Number of samples in the pre-trigger window.
+ */
+size_t adxl345_start_capture (
+		hal_spi_device spi,
+		const adxl345_config* config,
+		adxl345_fifo_clock* clock,
+		adxl345_edge_timestamp_fn get_edge_timestamp,
+		sample_record* samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
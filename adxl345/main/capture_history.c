@@ -0,0 +1,114 @@
+/**
+ * @file capture_history.c
+ *
+ * Implementation of the history of samples with captures.
+ */
+
+#include "capture_history.h"
+
+#include <assert.h>
+
+/**
+ * @brief Whether a given sample reaches a threshold.
+ *
+ * @param[in] sample
+ *
+ *   Sample.
+ *
+ * @param[in] threshold
+ *
+ *   Magnitude of acceleration.
+ *
+ * @return
+ *
+ *   Whether the magnitude of `sample` is not less than `threshold`.
+ */
+static int reaches_threshold (const sample_record* sample, uint32_t threshold) {
+	uint64_t squared = 0u;
+	int i;
+	for (i = 0; i < 3; ++i) {
+		squared += (uint64_t)((int32_t)sample->accs[i] * sample->accs[i]);
+	}
+	return squared >= (uint64_t)threshold * threshold;
+}
+
+/**
+ * @brief Starts collecting post-trigger samples from the next sample.
+ *
+ * @param[in,out] history
+ *
+ *   Armed history.
+ */
+static void start_capture (capture_history* history) {
+	const uint32_t num_samples = history->next - history->oldest;
+	assert(history->state == CAPTURE_ARMED);
+	history->capture.trigger = history->next;
+	history->capture.start = history->next -
+		((num_samples < history->pre_trigger_samples) ?
+			num_samples :
+			history->pre_trigger_samples);
+	history->capture.end = history->next + history->post_trigger_samples;
+	history->state = CAPTURE_TRIGGERED;
+}
+
+int capture_history_add (capture_history* history, const sample_record* sample) {
+	const uint32_t capacity = capture_history_capacity(history);
+	assert(history->post_trigger_samples > 0u);
+	assert(history->pre_trigger_samples + history->post_trigger_samples <=
+		capacity);
+	if ((history->state == CAPTURE_FROZEN) &&
+		(history->next - history->capture.start >= capacity))
+	{
+		++history->num_dropped;
+		return 0;
+	}
+	if ((history->state == CAPTURE_ARMED) &&
+		(history->threshold > 0u) &&
+		reaches_threshold(sample, history->threshold))
+	{
+		start_capture(history);
+	}
+	history->records[history->next & history->mask] = *sample;
+	++history->next;
+	if (history->next - history->oldest > capacity) {
+		++history->oldest;
+	}
+	if ((history->state == CAPTURE_TRIGGERED) &&
+		(history->next == history->capture.end))
+	{
+		history->state = CAPTURE_FROZEN;
+		return 1;
+	}
+	return 0;
+}
+
+int capture_history_trigger (capture_history* history) {
+	if (history->state != CAPTURE_ARMED) {
+		return 0;
+	}
+	start_capture(history);
+	return 1;
+}
+
+size_t capture_history_peek (
+		const capture_history* history,
+		uint32_t begin,
+		uint32_t end,
+		const sample_record** samples)
+{
+	const uint32_t offset = begin & history->mask;
+	const uint32_t contiguous = capture_history_capacity(history) - offset;
+	const uint32_t num_samples = end - begin;
+	assert(begin - history->oldest < history->next - history->oldest);
+	*samples = &history->records[offset];
+	return (num_samples < contiguous) ? num_samples : contiguous;
+}
+
+void capture_history_release (capture_history* history) {
+	history->state = CAPTURE_ARMED;
+}
+
+size_t capture_history_footprint (const capture_history* history) {
+	return sizeof(capture_history) +
+		capture_history_capacity(history) * sizeof(sample_record);
+}
@@ -0,0 +1,244 @@
+#ifndef _CAPTURE_HISTORY_H
+#define _CAPTURE_HISTORY_H
+
+/**
+ * @file capture_history.h
+ *
+ * History of samples that freezes captures around triggers.
+ *
+ * A history keeps the latest samples in a circular buffer.
+ * When a trigger comes, the history keeps collecting post-trigger samples,
+ * then freezes the pre- and post-trigger samples where they are;
+ * samples are never copied into a capture.
+ * A frozen capture is read through `::capture_history_peek`, and has to be
+ * released with `::capture_history_release` before the next trigger.
+ * Until then, new samples fill only the rest of the buffer.
+ *
+ * A history is not thread-safe; add samples and read captures in
+ * a single task.
+ */
+
+#include "sample_ring.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief State of a `::capture_history`.
+ */
+typedef enum capture_state_t {
+	/** @brief Waiting for a trigger. */
+	CAPTURE_ARMED = 0,
+	/** @brief Collecting post-trigger samples. */
+	CAPTURE_TRIGGERED,
+	/** @brief A capture is complete and waiting for release. */
+	CAPTURE_FROZEN
+} capture_state;
+
+/**
+ * @brief Range of a capture in a `::capture_history`.
+ *
+ * Indices run freely and wrap around at `2^32`, like `::sample_ring`.
+ */
+typedef struct capture_record_t {
+	/** @brief Index of the first pre-trigger sample. */
+	uint32_t start;
+	/** @brief Index of the trigger sample; i.e., the first post-trigger one. */
+	uint32_t trigger;
+	/** @brief Index next to the last post-trigger sample. */
+	uint32_t end;
+} capture_record;
+
+/**
+ * @brief Circular history of samples with captures.
+ */
+typedef struct capture_history_t {
+	/** @brief Memory block of samples. */
+	sample_record* records;
+	/** @brief `capacity - 1`. */
+	uint32_t mask;
+	/** @brief Maximum number of samples before a trigger in a capture. */
+	uint32_t pre_trigger_samples;
+	/** @brief Number of samples from a trigger in a capture. */
+	uint32_t post_trigger_samples;
+	/**
+	 * @brief Magnitude of acceleration that triggers a capture.
+	 *
+	 * `0` disables triggers by magnitude.
+	 */
+	uint32_t threshold;
+	/** @brief Index of the oldest sample in the history. */
+	uint32_t oldest;
+	/** @brief Index of the next sample. */
+	uint32_t next;
+	/** @brief Current state. */
+	capture_state state;
+	/** @brief Current capture. Valid unless `CAPTURE_ARMED`. */
+	capture_record capture;
+	/** @brief Number of samples dropped while a capture was frozen. */
+	uint32_t num_dropped;
+} capture_history;
+
+/**
+ * @brief Initializer of a `::capture_history`.
+ *
+ * It will cause undefined behavior if `_capacity` is not a power of two.
+ *
+ * @param[in] _records
+ *
+ *   (`sample_record*`) Memory block of samples.
+ *   You have to allocate `_capacity` samples.
+ *
+ * @param[in] _capacity
+ *
+ *   (`uint32_t`) Depth of the history in samples.
+ *   Not less than `_pre_trigger_samples + _post_trigger_samples`.
+ *
+ * @param[in] _pre_trigger_samples
+ *
+ *   (`uint32_t`) Maximum number of samples before a trigger in a capture.
+ *
+ * @param[in] _post_trigger_samples
+ *
+ *   (`uint32_t`) Number of samples from a trigger in a capture.
+ *   At least 1.
+ *
+ * @param[in] _threshold
+ *
+ *   (`uint32_t`) Magnitude of acceleration that triggers a capture.
+ *   `0` disables triggers by magnitude.
+ *
+ * @return
+ *
+ *   Initializer of an armed `::capture_history`.
+ */
+#define capture_history_initializer(_records, _capacity, _pre_trigger_samples, _post_trigger_samples, _threshold) \
+{ \
+	.records = (_records), \
+	.mask = (_capacity) - 1u, \
+	.pre_trigger_samples = (_pre_trigger_samples), \
+	.post_trigger_samples = (_post_trigger_samples), \
+	.threshold = (_threshold), \
+	.oldest = 0u, \
+	.next = 0u, \
+	.state = CAPTURE_ARMED, \
+	.capture = { .start = 0u, .trigger = 0u, .end = 0u }, \
+	.num_dropped = 0u \
+}
+
+/**
+ * @brief Depth of a given `::capture_history`.
+ *
+ * @param[in] history
+ *
+ *   (`const capture_history*`) History.
+ *
+ * @return
+ *
+ *   Maximum number of samples in `history`.
+ */
+#define capture_history_capacity(history)  ((history)->mask + 1u)
+
+/**
+ * @brief Adds a sample.
+ *
+ * The sample triggers a capture if the history is armed, and the magnitude
+ * of the sample reaches the threshold.
+ * The sample is dropped if it would overwrite a frozen capture.
+ *
+ * @param[in,out] history
+ *
+ *   History where the sample is to be added.
+ *
+ * @param[in] sample
+ *
+ *   Sample to add.
+ *
+ * @return
+ *
+ *   - `1`: the sample completed a capture, which is frozen now.
+ *   - `0`: otherwise.
+ */
+int capture_history_add (capture_history* history, const sample_record* sample);
+
+/**
+ * @brief Triggers a capture.
+ *
+ * The next sample becomes the trigger sample.
+ * Does nothing unless the history is armed.
+ *
+ * @param[in,out] history
+ *
+ *   History to trigger.
+ *
+ * @return
+ *
+ *   - `1`: triggered.
+ *   - `0`: not armed.
+ */
+int capture_history_trigger (capture_history* history);
+
+/**
+ * @brief Peeks contiguous samples in a history.
+ *
+ * Samples from `begin` to `end` may wrap around the buffer,
+ * so call this function again from `begin` plus the returned number
+ * until it reaches `end`.
+ *
+ * @param[in] history
+ *
+ *   History.
+ *
+ * @param[in] begin
+ *
+ *   Index of the first sample. Has to be in the history.
+ *
+ * @param[in] end
+ *
+ *   Index next to the last sample.
+ *
+ * @param[out] samples
+ *
+ *   Receives the pointer to the sample at `begin` in the buffer.
+ *
+ * @return
+ *
+ *   Number of contiguous samples from `*samples` up to `end`.
+ */
+size_t capture_history_peek (
+		const capture_history* history,
+		uint32_t begin,
+		uint32_t end,
+		const sample_record** samples);
+
+/**
+ * @brief Releases a frozen capture, and arms the history again.
+ *
+ * @param[in,out] history
+ *
+ *   History to release.
+ */
+void capture_history_release (capture_history* history);
+
+/**
+ * @brief Memory footprint of a given history.
+ *
+ * @param[in] history
+ *
+ *   History.
+ *
+ * @return
+ *
+ *   Number of bytes of the history and its buffer.
+ */
+size_t capture_history_footprint (const capture_history* history);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+/**
+ * @file dsp.c
+ *
+ * Implementation of fixed-point signal processing.
+ */
+
+#include "dsp.h"
+
+#include <assert.h>
+
+/**
+ * @brief Saturates a given value into `int16_t`.
+ *
+ * @param[in] x
+ *
+ *   Value to saturate.
+ *
+ * @return
+ *
+ *   `x` clamped from `INT16_MIN` to `INT16_MAX`.
+ */
+static inline int16_t saturate_int16 (int64_t x) {
+	if (x > INT16_MAX) {
+		return INT16_MAX;
+	}
+	if (x < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t)x;
+}
+
+/**
+ * @brief Integer square root.
+ *
+ * @param[in] x
+ *
+ *   Value.
+ *
+ * @return
+ *
+ *   Floor of the square root of `x`.
+ */
+static uint32_t isqrt64 (uint64_t x) {
+	uint64_t root = 0u;
+	uint64_t bit = (uint64_t)1u << 62;
+	while (bit > x) {
+		bit >>= 2;
+	}
+	while (bit != 0u) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t)root;
+}
+
+int16_t dsp_biquad_process (dsp_biquad* biquad, int16_t x) {
+	const dsp_biquad_coefficients* c = biquad->coefficients;
+	int64_t acc;
+	int16_t y;
+	acc = (int64_t)((int32_t)c->b0 * x) +
+		(int32_t)c->b1 * biquad->x1 +
+		(int32_t)c->b2 * biquad->x2 -
+		(int32_t)c->a1 * biquad->y1 -
+		(int32_t)c->a2 * biquad->y2;
+	// rounds to the nearest
+	acc += (int64_t)1 << (DSP_BIQUAD_SHIFT - 1);
+	y = saturate_int16(acc >> DSP_BIQUAD_SHIFT);
+	biquad->x2 = biquad->x1;
+	biquad->x1 = x;
+	biquad->y2 = biquad->y1;
+	biquad->y1 = y;
+	return y;
+}
+
+int16_t dsp_biquad_cascade_process (
+		dsp_biquad* stages,
+		size_t num_stages,
+		int16_t x)
+{
+	size_t i;
+	for (i = 0; i < num_stages; ++i) {
+		x = dsp_biquad_process(&stages[i], x);
+	}
+	return x;
+}
+
+int dsp_cic_process (dsp_cic* cic, int16_t x, int16_t* y) {
+	uint32_t value;
+	uint32_t previous;
+	size_t i;
+	assert((cic->order >= 1u) && (cic->order <= DSP_CIC_MAX_ORDER));
+	assert(cic->log2_factor <= 15u);
+	assert(cic->order * cic->log2_factor <= 16u);
+	// integrators run at the input rate
+	value = (uint32_t)(int32_t)x;
+	for (i = 0; i < cic->order; ++i) {
+		cic->integrators[i] += value;
+		value = cic->integrators[i];
+	}
+	if (++cic->phase < ((uint32_t)1u << cic->log2_factor)) {
+		return 0;
+	}
+	cic->phase = 0u;
+	// combs run at the output rate
+	for (i = 0; i < cic->order; ++i) {
+		previous = cic->combs[i];
+		cic->combs[i] = value;
+		value -= previous;
+	}
+	// the wrapped-around result is exact in 16 + order * log2_factor bits
+	*y = (int16_t)((int32_t)value >> (cic->order * cic->log2_factor));
+	return 1;
+}
+
+int dsp_window_add (dsp_window* window, int16_t x, dsp_features* features) {
+	const int32_t value = x;
+	const uint16_t magnitude = (uint16_t)((value < 0) ? -value : value);
+	assert(window->length > 0u);
+	window->sum += value;
+	window->sum_squares += (uint64_t)(value * value);
+	if (magnitude > window->peak) {
+		window->peak = magnitude;
+	}
+	if (++window->count < window->length) {
+		return 0;
+	}
+	features->mean = (int16_t)(window->sum / (int32_t)window->length);
+	features->rms = (uint16_t)isqrt64(window->sum_squares / window->length);
+	features->peak = window->peak;
+	window->count = 0u;
+	window->sum = 0;
+	window->sum_squares = 0u;
+	window->peak = 0u;
+	return 1;
+}
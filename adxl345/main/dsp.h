@@ -0,0 +1,345 @@
+#ifndef _DSP_H
+#define _DSP_H
+
+/**
+ * @file dsp.h
+ *
+ * Fixed-point signal processing of acceleration streams.
+ *
+ * Every stage processes a single channel one value at a time,
+ * on `int16_t` values with `int32_t` or wider accumulators;
+ * no floating point is involved.
+ * - `::dsp_cic`: CIC decimator.
+ * - `::dsp_biquad`: biquad (second order IIR) filter,
+ *   cascaded with `::dsp_biquad_cascade_process`.
+ * - `::dsp_window`: mean, RMS and peak over fixed-length windows.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Number of fractional bits of biquad coefficients.
+ *
+ * Coefficients are in Q2.14; i.e., from -2.0 to 2.0 (exclusive).
+ */
+#define DSP_BIQUAD_SHIFT  14
+
+/**
+ * @brief Converts a real number into a biquad coefficient.
+ *
+ * Only for constant expressions; e.g., initializers.
+ *
+ * @param[in] x
+ *
+ *   Real number. Must be in [-2.0, 2.0).
+ *
+ * @return
+ *
+ *   `x` in Q2.14 rounded to the nearest.
+ */
+#define DSP_BIQUAD_Q14(x) \
+	((int16_t)((x) * (1 << DSP_BIQUAD_SHIFT) + (((x) < 0) ? -0.5 : 0.5)))
+
+/** @brief Maximum order of a `::dsp_cic`. */
+#define DSP_CIC_MAX_ORDER  4u
+
+/**
+ * @brief Coefficients of a biquad filter.
+ *
+ * ```
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ * ```
+ *
+ * Coefficients are normalized by a0, and in Q2.14.
+ */
+typedef struct dsp_biquad_coefficients_t {
+	/** @brief b0. */
+	int16_t b0;
+	/** @brief b1. */
+	int16_t b1;
+	/** @brief b2. */
+	int16_t b2;
+	/** @brief a1. */
+	int16_t a1;
+	/** @brief a2. */
+	int16_t a2;
+} dsp_biquad_coefficients;
+
+/**
+ * @brief Initializer of a `::dsp_biquad_coefficients`.
+ *
+ * Coefficients are real numbers converted with `DSP_BIQUAD_Q14`.
+ *
+ * @param[in] _b0
+ *
+ *   b0 normalized by a0.
+ *
+ * @param[in] _b1
+ *
+ *   b1 normalized by a0.
+ *
+ * @param[in] _b2
+ *
+ *   b2 normalized by a0.
+ *
+ * @param[in] _a1
+ *
+ *   a1 normalized by a0.
+ *
+ * @param[in] _a2
+ *
+ *   a2 normalized by a0.
+ *
+ * @return
+ *
+ *   Initializer of a `::dsp_biquad_coefficients`.
+ */
+#define dsp_biquad_coefficients_initializer(_b0, _b1, _b2, _a1, _a2) \
+{ \
+	.b0 = DSP_BIQUAD_Q14(_b0), \
+	.b1 = DSP_BIQUAD_Q14(_b1), \
+	.b2 = DSP_BIQUAD_Q14(_b2), \
+	.a1 = DSP_BIQUAD_Q14(_a1), \
+	.a2 = DSP_BIQUAD_Q14(_a2) \
+}
+
+/**
+ * @brief Biquad filter in the direct form I.
+ *
+ * The direct form I keeps the state in `int16_t`, and cannot overflow
+ * inside; only the output saturates.
+ */
+typedef struct dsp_biquad_t {
+	/** @brief Coefficients. May be shared among filters. */
+	const dsp_biquad_coefficients* coefficients;
+	/** @brief x[n-1]. */
+	int16_t x1;
+	/** @brief x[n-2]. */
+	int16_t x2;
+	/** @brief y[n-1]. */
+	int16_t y1;
+	/** @brief y[n-2]. */
+	int16_t y2;
+} dsp_biquad;
+
+/**
+ * @brief Initializer of a `::dsp_biquad`.
+ *
+ * @param[in] _coefficients
+ *
+ *   (`const dsp_biquad_coefficients*`) Coefficients.
+ *
+ * @return
+ *
+ *   Initializer of a `::dsp_biquad` at rest.
+ */
+#define dsp_biquad_initializer(_coefficients) \
+{ \
+	.coefficients = (_coefficients), \
+	.x1 = 0, \
+	.x2 = 0, \
+	.y1 = 0, \
+	.y2 = 0 \
+}
+
+/**
+ * @brief CIC (cascaded integrator-comb) decimator.
+ *
+ * Decimates by a power of two with `order` integrators and combs
+ * (differential delay 1), and divides the output by the gain
+ * `factor^order`.
+ * Integrators wrap around in `uint32_t`, which the combs cancel,
+ * so `order * log2_factor` may be up to 16 bits of growth.
+ */
+typedef struct dsp_cic_t {
+	/** @brief Number of integrators and combs. */
+	uint8_t order;
+	/** @brief log2 of the decimation factor. */
+	uint8_t log2_factor;
+	/** @brief Number of inputs since the last output. */
+	uint16_t phase;
+	/** @brief Integrators. */
+	uint32_t integrators[DSP_CIC_MAX_ORDER];
+	/** @brief Previous inputs of combs. */
+	uint32_t combs[DSP_CIC_MAX_ORDER];
+} dsp_cic;
+
+/**
+ * @brief Initializer of a `::dsp_cic`.
+ *
+ * @param[in] _order
+ *
+ *   (`uint8_t`) Number of integrators and combs.
+ *   From 1 to `DSP_CIC_MAX_ORDER`.
+ *
+ * @param[in] _log2_factor
+ *
+ *   (`uint8_t`) log2 of the decimation factor. At most 15.
+ *   `_order * _log2_factor` must not exceed 16.
+ *
+ * @return
+ *
+ *   Initializer of a `::dsp_cic` at rest.
+ */
+#define dsp_cic_initializer(_order, _log2_factor) \
+{ \
+	.order = (_order), \
+	.log2_factor = (_log2_factor), \
+	.phase = 0u, \
+	.integrators = { 0u }, \
+	.combs = { 0u } \
+}
+
+/**
+ * @brief Features of a window.
+ */
+typedef struct dsp_features_t {
+	/** @brief Mean truncated toward zero. */
+	int16_t mean;
+	/** @brief Root mean square truncated toward zero. */
+	uint16_t rms;
+	/** @brief Maximum absolute value. */
+	uint16_t peak;
+} dsp_features;
+
+/**
+ * @brief Accumulator of features over fixed-length windows.
+ *
+ * Windows do not overlap.
+ */
+typedef struct dsp_window_t {
+	/** @brief Number of values in a window. */
+	uint32_t length;
+	/** @brief Number of values added to the current window. */
+	uint32_t count;
+	/** @brief Sum of values. */
+	int32_t sum;
+	/** @brief Sum of squared values. */
+	uint64_t sum_squares;
+	/** @brief Maximum absolute value. */
+	uint16_t peak;
+} dsp_window;
+
+/**
+ * @brief Initializer of a `::dsp_window`.
+ *
+ * @param[in] _length
+ *
+ *   (`uint32_t`) Number of values in a window.
+ *   From 1 to 65536, so that the sum fits in `int32_t`.
+ *
+ * @return
+ *
+ *   Initializer of an empty `::dsp_window`.
+ */
+#define dsp_window_initializer(_length) \
+{ \
+	.length = (_length), \
+	.count = 0u, \
+	.sum = 0, \
+	.sum_squares = 0u, \
+	.peak = 0u \
+}
+
+/**
+ * @brief Filters a value with a `::dsp_biquad`.
+ *
+ * The accumulator is 64 bits wide, and the output is rounded to the nearest
+ * and saturated.
+ *
+ * @param[in,out] biquad
+ *
+ *   Biquad filter.
+ *
+ * @param[in] x
+ *
+ *   Input value.
+ *
+ * @return
+ *
+ *   Output value.
+ */
+int16_t dsp_biquad_process (dsp_biquad* biquad, int16_t x);
+
+/**
+ * @brief Filters a value with cascaded `::dsp_biquad`s.
+ *
+ * @param[in,out] stages
+ *
+ *   Biquad filters applied in order.
+ *
+ * @param[in] num_stages
+ *
+ *   Number of filters in `stages`.
+ *
+ * @param[in] x
+ *
+ *   Input value.
+ *
+ * @return
+ *
+ *   Output value of the last filter. `x` if `num_stages` is `0`.
+ */
+int16_t dsp_biquad_cascade_process (
+		dsp_biquad* stages,
+		size_t num_stages,
+		int16_t x);
+
+/**
+ * @brief Puts a value in a `::dsp_cic`.
+ *
+ * @param[in,out] cic
+ *
+ *   CIC decimator.
+ *
+ * @param[in] x
+ *
+ *   Input value.
+ *
+ * @param[out] y
+ *
+ *   Receives an output value if this function returns `1`.
+ *   Not modified otherwise.
+ *
+ * @return
+ *
+ *   - `1`: an output value is available; i.e., every `2^log2_factor` inputs.
+ *   - `0`: no output value.
+ */
+int dsp_cic_process (dsp_cic* cic, int16_t x, int16_t* y);
+
+/**
+ * @brief Adds a value to a `::dsp_window`.
+ *
+ * Starts a new window when the current one is complete.
+ *
+ * @param[in,out] window
+ *
+ *   Window.
+ *
+ * @param[in] x
+ *
+ *   Value to add.
+ *
+ * @param[out] features
+ *
+ *   Receives features of the window if this function returns `1`.
+ *   Not modified otherwise.
+ *
+ * @return
+ *
+ *   - `1`: `x` completed the window.
+ *   - `0`: the window is not complete yet.
+ */
+int dsp_window_add (dsp_window* window, int16_t x, dsp_features* features);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file interval_stats.c
+ *
+ * Implementation of statistics of intervals.
+ */
+
+#include "interval_stats.h"
+
+#include <math.h>
+
+void interval_stats_reset (interval_stats* stats) {
+	stats->count = 0u;
+	stats->min = 0;
+	stats->max = 0;
+	stats->reference = 0;
+	stats->sum = 0;
+	stats->sum_squares = 0;
+}
+
+void interval_stats_add (interval_stats* stats, int64_t interval) {
+	int64_t difference;
+	if (stats->count == 0u) {
+		stats->min = interval;
+		stats->max = interval;
+		stats->reference = interval;
+	} else if (interval < stats->min) {
+		stats->min = interval;
+	} else if (interval > stats->max) {
+		stats->max = interval;
+	}
+	difference = interval - stats->reference;
+	stats->sum += difference;
+	stats->sum_squares += difference * difference;
+	++stats->count;
+}
+
+double interval_stats_mean (const interval_stats* stats) {
+	if (stats->count == 0u) {
+		return 0.0;
+	}
+	return (double)stats->reference + (double)stats->sum / stats->count;
+}
+
+double interval_stats_stddev (const interval_stats* stats) {
+	double mean_difference;
+	double variance;
+	if (stats->count == 0u) {
+		return 0.0;
+	}
+	mean_difference = (double)stats->sum / stats->count;
+	variance = (double)stats->sum_squares / stats->count -
+		mean_difference * mean_difference;
+	return (variance > 0.0) ? sqrt(variance) : 0.0;
+}
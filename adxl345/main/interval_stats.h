@@ -0,0 +1,106 @@
+#ifndef _INTERVAL_STATS_H
+#define _INTERVAL_STATS_H
+
+/**
+ * @file interval_stats.h
+ *
+ * Statistics of intervals between samples; i.e., jitter.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Statistics of intervals.
+ *
+ * Sums are taken of differences from the first interval,
+ * so that they stay small and exact in integers.
+ */
+typedef struct interval_stats_t {
+	/** @brief Number of intervals. */
+	uint32_t count;
+	/** @brief Shortest interval. */
+	int64_t min;
+	/** @brief Longest interval. */
+	int64_t max;
+	/** @brief First interval, from which differences are taken. */
+	int64_t reference;
+	/** @brief Sum of differences. */
+	int64_t sum;
+	/** @brief Sum of squared differences. */
+	int64_t sum_squares;
+} interval_stats;
+
+/**
+ * @brief Initializer of an `::interval_stats`.
+ *
+ * @return
+ *
+ *   Initializer of an empty `::interval_stats`.
+ */
+#define interval_stats_initializer() \
+{ \
+	.count = 0u, \
+	.min = 0, \
+	.max = 0, \
+	.reference = 0, \
+	.sum = 0, \
+	.sum_squares = 0 \
+}
+
+/**
+ * @brief Empties an `::interval_stats`.
+ *
+ * @param[out] stats
+ *
+ *   `::interval_stats` to be emptied.
+ */
+void interval_stats_reset (interval_stats* stats);
+
+/**
+ * @brief Adds an interval.
+ *
+ * @param[in,out] stats
+ *
+ *   `::interval_stats` where the interval is to be added.
+ *
+ * @param[in] interval
+ *
+ *   Interval to add.
+ */
+void interval_stats_add (interval_stats* stats, int64_t interval);
+
+/**
+ * @brief Mean of intervals.
+ *
+ * @param[in] stats
+ *
+ *   `::interval_stats`.
+ *
+ * @return
+ *
+ *   Mean of intervals. `0` if `stats` is empty.
+ */
+double interval_stats_mean (const interval_stats* stats);
+
+/**
+ * @brief Standard deviation of intervals.
+ *
+ * @param[in] stats
+ *
+ *   `::interval_stats`.
+ *
+ * @return
+ *
+ *   Population standard deviation of intervals. `0` if `stats` is empty.
+ */
+double interval_stats_stddev (const interval_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
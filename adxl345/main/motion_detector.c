@@ -0,0 +1,48 @@
+/**
+ * @file motion_detector.c
+ *
+ * Implementation of the state machine of event-driven capture.
+ */
+
+#include "motion_detector.h"
+
+motion_action motion_detector_handle_interrupt (
+		motion_detector* detector,
+		uint8_t int_source)
+{
+	const uint8_t events = int_source & MOTION_EVENT_MASK;
+	if (events == 0u) {
+		return MOTION_ACTION_NONE;
+	}
+	detector->remaining_samples = detector->post_trigger_samples;
+	if (detector->state == MOTION_CAPTURING) {
+		return MOTION_ACTION_NONE;
+	}
+	detector->state = MOTION_CAPTURING;
+	detector->captured_samples = 0u;
+	detector->trigger_events = events;
+	++detector->num_captures;
+	return MOTION_ACTION_START_CAPTURE;
+}
+
+motion_action motion_detector_handle_samples (
+		motion_detector* detector,
+		uint32_t num_samples)
+{
+	if (detector->state != MOTION_CAPTURING) {
+		return MOTION_ACTION_NONE;
+	}
+	detector->captured_samples += num_samples;
+	if (num_samples < detector->remaining_samples) {
+		detector->remaining_samples -= num_samples;
+	} else {
+		detector->remaining_samples = 0u;
+	}
+	if ((detector->remaining_samples > 0u) &&
+		(detector->captured_samples < detector->max_capture_samples))
+	{
+		return MOTION_ACTION_NONE;
+	}
+	detector->state = MOTION_IDLE;
+	return MOTION_ACTION_STOP_CAPTURE;
+}
@@ -0,0 +1,164 @@
+#ifndef _MOTION_DETECTOR_H
+#define _MOTION_DETECTOR_H
+
+/**
+ * @file motion_detector.h
+ *
+ * State machine of event-driven capture.
+ *
+ * The ADXL345 detects motion by itself, and the host sleeps until it raises
+ * an interrupt. Then the host captures samples at a high rate until
+ * no event comes for a post-trigger window.
+ *
+ * This module only decides what to do from values of INT_SOURCE and
+ * numbers of captured samples; it never touches the ADXL345.
+ * So any source of interrupts can drive it; e.g., a simulated one.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief INT_SOURCE of the ADXL345: Single tap. */
+#define MOTION_EVENT_SINGLE_TAP  0x40u
+/** @brief INT_SOURCE of the ADXL345: Double tap. */
+#define MOTION_EVENT_DOUBLE_TAP  0x20u
+/** @brief INT_SOURCE of the ADXL345: Activity. */
+#define MOTION_EVENT_ACTIVITY  0x10u
+/** @brief INT_SOURCE of the ADXL345: Free fall. */
+#define MOTION_EVENT_FREE_FALL  0x04u
+
+/** @brief Interrupts of the ADXL345 that trigger a capture. */
+#define MOTION_EVENT_MASK \
+	(MOTION_EVENT_SINGLE_TAP | \
+	 MOTION_EVENT_DOUBLE_TAP | \
+	 MOTION_EVENT_ACTIVITY | \
+	 MOTION_EVENT_FREE_FALL)
+
+/**
+ * @brief State of a `::motion_detector`.
+ */
+typedef enum motion_state_t {
+	/** @brief Waiting for an event at a low rate. */
+	MOTION_IDLE = 0,
+	/** @brief Capturing samples at a high rate. */
+	MOTION_CAPTURING
+} motion_state;
+
+/**
+ * @brief Action that a `::motion_detector` requests.
+ */
+typedef enum motion_action_t {
+	/** @brief Nothing to do. */
+	MOTION_ACTION_NONE = 0,
+	/**
+	 * @brief Starts a capture.
+	 *
+	 * Samples in the FIFO are the pre-trigger window.
+	 */
+	MOTION_ACTION_START_CAPTURE,
+	/** @brief Stops the capture, and goes back to idle. */
+	MOTION_ACTION_STOP_CAPTURE
+} motion_action;
+
+/**
+ * @brief Event-driven capture.
+ */
+typedef struct motion_detector_t {
+	/** @brief Current state. */
+	motion_state state;
+	/**
+	 * @brief Number of samples to capture after the last event.
+	 *
+	 * An event during a capture extends it.
+	 */
+	uint32_t post_trigger_samples;
+	/** @brief Maximum number of samples in a capture. */
+	uint32_t max_capture_samples;
+	/** @brief Number of samples left in the current capture. */
+	uint32_t remaining_samples;
+	/** @brief Number of samples in the current capture. */
+	uint32_t captured_samples;
+	/** @brief Events that started the current or last capture. */
+	uint8_t trigger_events;
+	/** @brief Number of captures started. */
+	uint32_t num_captures;
+} motion_detector;
+
+/**
+ * @brief Initializer of a `::motion_detector`.
+ *
+ * @param[in] _post_trigger_samples
+ *
+ *   (`uint32_t`) Number of samples to capture after the last event.
+ *
+ * @param[in] _max_capture_samples
+ *
+ *   (`uint32_t`) Maximum number of samples in a capture.
+ *   Not less than `_post_trigger_samples`.
+ *
+ * @return
+ *
+ *   Initializer of an idle `::motion_detector`.
+ */
+#define motion_detector_initializer(_post_trigger_samples, _max_capture_samples) \
+{ \
+	.state = MOTION_IDLE, \
+	.post_trigger_samples = (_post_trigger_samples), \
+	.max_capture_samples = (_max_capture_samples), \
+	.remaining_samples = 0u, \
+	.captured_samples = 0u, \
+	.trigger_events = 0u, \
+	.num_captures = 0u \
+}
+
+/**
+ * @brief Handles a value of INT_SOURCE.
+ *
+ * Bits other than `MOTION_EVENT_MASK` are ignored.
+ *
+ * @param[in,out] detector
+ *
+ *   `::motion_detector`.
+ *
+ * @param[in] int_source
+ *
+ *   Value of INT_SOURCE of the ADXL345.
+ *
+ * @return
+ *
+ *   - `MOTION_ACTION_START_CAPTURE`: an event came while idle.
+ *   - `MOTION_ACTION_NONE`: otherwise. An event extends the current capture.
+ */
+motion_action motion_detector_handle_interrupt (
+		motion_detector* detector,
+		uint8_t int_source);
+
+/**
+ * @brief Handles samples captured.
+ *
+ * @param[in,out] detector
+ *
+ *   `::motion_detector`.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples captured since the last call.
+ *
+ * @return
+ *
+ *   - `MOTION_ACTION_STOP_CAPTURE`: the post-trigger window or
+ *     the maximum length of a capture has been reached.
+ *   - `MOTION_ACTION_NONE`: otherwise, or idle.
+ */
+motion_action motion_detector_handle_samples (
+		motion_detector* detector,
+		uint32_t num_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file sample_log.c
+ *
+ * Implementation of the binary framing of sample batches.
+ */
+
+#include "sample_log.h"
+
+#include <assert.h>
+
+/**
+ * @brief Writes a little-endian integer.
+ *
+ * @param[out] out
+ *
+ *   Block to receive the integer.
+ *
+ * @param[in] value
+ *
+ *   Integer to write.
+ *
+ * @param[in] size
+ *
+ *   Number of bytes to write.
+ *
+ * @return
+ *
+ *   `out + size`.
+ */
+static uint8_t* sample_log_put_le (uint8_t* out, uint64_t value, size_t size) {
+	size_t i;
+	for (i = 0; i < size; ++i) {
+		*out++ = (uint8_t)(value >> (8u * i));
+	}
+	return out;
+}
+
+/**
+ * @brief Writes the difference of an axis as a zigzag varint.
+ *
+ * @param[out] out
+ *
+ *   Block to receive the varint.
+ *
+ * @param[in] current
+ *
+ *   Value of the current sample.
+ *
+ * @param[in] previous
+ *
+ *   Value of the previous sample.
+ *
+ * @return
+ *
+ *   Next byte of `out`.
+ */
+static uint8_t* sample_log_put_delta (
+		uint8_t* out,
+		int16_t current,
+		int16_t previous)
+{
+	// difference modulo 2^16
+	const uint16_t delta = (uint16_t)(current - previous);
+	uint16_t zigzag = (uint16_t)(
+		(delta << 1) ^ ((delta & 0x8000u) != 0u ? 0xFFFFu : 0x0000u));
+	while (zigzag >= 0x80u) {
+		*out++ = (uint8_t)(zigzag | 0x80u);
+		zigzag >>= 7;
+	}
+	*out++ = (uint8_t)zigzag;
+	return out;
+}
+
+/**
+ * @brief Calculates CRC-16/CCITT-FALSE.
+ *
+ * Polynomial `0x1021`, initial value `0xFFFF`, not reflected.
+ *
+ * @param[in] data
+ *
+ *   Data.
+ *
+ * @param[in] size
+ *
+ *   Size of `data` in bytes.
+ *
+ * @return
+ *
+ *   CRC of `data`.
+ */
+static uint16_t sample_log_crc16 (const uint8_t* data, size_t size) {
+	uint16_t crc = 0xFFFFu;
+	int i;
+	while (size-- > 0u) {
+		crc ^= (uint16_t)(*data++ << 8);
+		for (i = 0; i < 8; ++i) {
+			crc = (crc & 0x8000u) ? (uint16_t)((crc << 1) ^ 0x1021u)
+			                      : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+size_t sample_log_encode (
+		sample_log_encoder* encoder,
+		const sample_record* samples,
+		size_t num_samples,
+		uint8_t* frame)
+{
+	uint8_t* out = frame + SAMPLE_LOG_HEADER_SIZE;
+	size_t payload_size;
+	size_t i;
+	int axis;
+	assert(num_samples > 0u && num_samples <= SAMPLE_LOG_MAX_SAMPLES);
+	for (axis = 0; axis < 3; ++axis) {
+		out = sample_log_put_le(out, (uint16_t)samples[0].accs[axis], 2);
+	}
+	for (i = 1; i < num_samples; ++i) {
+		for (axis = 0; axis < 3; ++axis) {
+			out = sample_log_put_delta(
+				out,
+				samples[i].accs[axis],
+				samples[i - 1].accs[axis]);
+		}
+	}
+	payload_size = (size_t)(out - frame) - SAMPLE_LOG_HEADER_SIZE;
+	out = frame;
+	*out++ = SAMPLE_LOG_SYNC_0;
+	*out++ = SAMPLE_LOG_SYNC_1;
+	*out++ = SAMPLE_LOG_VERSION;
+	*out++ = 0u;
+	out = sample_log_put_le(out, num_samples, 2);
+	out = sample_log_put_le(out, payload_size, 2);
+	out = sample_log_put_le(out, encoder->sequence, 4);
+	out = sample_log_put_le(out, (uint64_t)samples[0].timestamp, 8);
+	out = sample_log_put_le(
+		out,
+		(uint32_t)(samples[num_samples - 1].timestamp - samples[0].timestamp),
+		4);
+	out = sample_log_put_le(out, encoder->num_dropped, 4);
+	out = sample_log_put_le(out, encoder->num_overruns, 4);
+	out = frame + SAMPLE_LOG_HEADER_SIZE + payload_size;
+	sample_log_put_le(
+		out,
+		sample_log_crc16(frame + 2, SAMPLE_LOG_HEADER_SIZE - 2 + payload_size),
+		SAMPLE_LOG_CRC_SIZE);
+	++encoder->sequence;
+	return SAMPLE_LOG_HEADER_SIZE + payload_size + SAMPLE_LOG_CRC_SIZE;
+}
@@ -0,0 +1,141 @@
+#ifndef _SAMPLE_LOG_H
+#define _SAMPLE_LOG_H
+
+/**
+ * @file sample_log.h
+ *
+ * Binary framing of sample batches.
+ *
+ * A frame carries a batch of `::sample_record`s.
+ * All integers are little-endian.
+ *
+ * | Offset | Size | Field |
+ * |--------|------|-------|
+ * | 0      | 2    | sync bytes `0xA5`, `0x5A` |
+ * | 2      | 1    | version (`SAMPLE_LOG_VERSION`) |
+ * | 3      | 1    | reserved (`0`) |
+ * | 4      | 2    | number of samples (`uint16_t`) |
+ * | 6      | 2    | payload size in bytes (`uint16_t`) |
+ * | 8      | 4    | sequence number of the frame (`uint32_t`) |
+ * | 12     | 8    | timestamp of the first sample in microseconds (`int64_t`) |
+ * | 20     | 4    | timestamp of the last sample minus the first (`uint32_t`) |
+ * | 24     | 4    | total number of dropped samples (`uint32_t`) |
+ * | 28     | 4    | total number of FIFO overruns (`uint32_t`) |
+ * | 32     | n    | payload |
+ * | 32 + n | 2    | CRC-16/CCITT-FALSE of bytes from offset 2 to 32 + n |
+ *
+ * The payload starts with the first sample as three `int16_t`s,
+ * followed by the difference of each axis from the previous sample.
+ * A difference is taken modulo `2^16`, zigzag-encoded,
+ * then written as a LEB128 varint of 1 to 3 bytes; i.e., 1 byte if it is
+ * within `[-64, 63]`.
+ *
+ * Samples in a frame are assumed evenly spaced; only timestamps of the
+ * first and the last samples are kept.
+ *
+ * `py/decode_samples.py` decodes frames.
+ */
+
+#include "sample_ring.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Version of the frame format. */
+#define SAMPLE_LOG_VERSION  1u
+
+/** @brief First sync byte. */
+#define SAMPLE_LOG_SYNC_0  0xA5u
+
+/** @brief Second sync byte. */
+#define SAMPLE_LOG_SYNC_1  0x5Au
+
+/** @brief Size of a frame header in bytes. */
+#define SAMPLE_LOG_HEADER_SIZE  32u
+
+/** @brief Size of a CRC in bytes. */
+#define SAMPLE_LOG_CRC_SIZE  2u
+
+/** @brief Maximum number of samples in a frame. */
+#define SAMPLE_LOG_MAX_SAMPLES  256u
+
+/**
+ * @brief Maximum size of a frame in bytes.
+ *
+ * Every difference takes 3 bytes in the worst case.
+ */
+#define SAMPLE_LOG_MAX_FRAME_SIZE \
+	(SAMPLE_LOG_HEADER_SIZE + \
+	 6u + (SAMPLE_LOG_MAX_SAMPLES - 1u) * 9u + \
+	 SAMPLE_LOG_CRC_SIZE)
+
+/**
+ * @brief Encoder of frames.
+ */
+typedef struct sample_log_encoder_t {
+	/** @brief Sequence number of the next frame. */
+	uint32_t sequence;
+	/** @brief Total number of dropped samples written in the next frame. */
+	uint32_t num_dropped;
+	/** @brief Total number of FIFO overruns written in the next frame. */
+	uint32_t num_overruns;
+} sample_log_encoder;
+
+/**
+ * @brief Initializer of a `::sample_log_encoder`.
+ *
+ * The first frame has the sequence number `0`.
+ *
+ * @return
+ *
+ *   Initializer of a `::sample_log_encoder`.
+ */
+#define sample_log_encoder_initializer() \
+{ \
+	.sequence = 0u, \
+	.num_dropped = 0u, \
+	.num_overruns = 0u \
+}
+
+/**
+ * @brief Encodes samples into a frame.
+ *
+ * Increments the sequence number of `encoder`.
+ *
+ * @param[in,out] encoder
+ *
+ *   Encoder.
+ *
+ * @param[in] samples
+ *
+ *   Samples to encode.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples to encode.
+ *   Must be `1` to `SAMPLE_LOG_MAX_SAMPLES`.
+ *
+ * @param[out] frame
+ *
+ *   Block to receive the frame.
+ *   Has to be as large as `SAMPLE_LOG_MAX_FRAME_SIZE` bytes.
+ *
+ * @return
+ *
+ *   Size of the frame in bytes.
+ */
+size_t sample_log_encode (
+		sample_log_encoder* encoder,
+		const sample_record* samples,
+		size_t num_samples,
+		uint8_t* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
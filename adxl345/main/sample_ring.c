@@ -0,0 +1,96 @@
+/**
+ * @file sample_ring.c
+ *
+ * Implementation of the lock-free ring buffer.
+ *
+ * Each index is written by only one side, so no read-modify-write atomics
+ * are necessary. Acquire loads of the other side's index and release
+ * stores of the own index order the copies of records with respect to
+ * the indices, also across the two cores of an ESP32.
+ */
+
+#include "sample_ring.h"
+#include "utils.h"
+
+#include <string.h>
+
+/**
+ * @brief Number of records from a given index to the end of the ring.
+ *
+ * A range starting at `index` wraps around if it is longer than this.
+ *
+ * @param[in] ring
+ *
+ *   `::sample_ring`.
+ *
+ * @param[in] index
+ *
+ *   Free-running index.
+ *
+ * @return
+ *
+ *   Number of records from `index` to the end of `ring->records`.
+ */
+static inline size_t sample_ring_contiguous (
+		const sample_ring* ring,
+		uint32_t index)
+{
+	return sample_ring_capacity(ring) - (index & ring->mask);
+}
+
+size_t sample_ring_push (
+		sample_ring* ring,
+		const sample_record* records,
+		size_t num_records)
+{
+	const uint32_t head = ring->head;
+	const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	size_t first;
+	num_records = MIN(
+		num_records,
+		sample_ring_capacity(ring) - (size_t)(head - tail));
+	first = MIN(num_records, sample_ring_contiguous(ring, head));
+	memcpy(
+		ring->records + (head & ring->mask),
+		records,
+		first * sizeof(sample_record));
+	memcpy(
+		ring->records,
+		records + first,
+		(num_records - first) * sizeof(sample_record));
+	__atomic_store_n(
+		&ring->head,
+		head + (uint32_t)num_records,
+		__ATOMIC_RELEASE);
+	return num_records;
+}
+
+size_t sample_ring_pop (
+		sample_ring* ring,
+		sample_record* records,
+		size_t max_records)
+{
+	const uint32_t tail = ring->tail;
+	const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	const size_t num_records = MIN(max_records, (size_t)(head - tail));
+	const size_t first = MIN(num_records, sample_ring_contiguous(ring, tail));
+	memcpy(
+		records,
+		ring->records + (tail & ring->mask),
+		first * sizeof(sample_record));
+	memcpy(
+		records + first,
+		ring->records,
+		(num_records - first) * sizeof(sample_record));
+	__atomic_store_n(
+		&ring->tail,
+		tail + (uint32_t)num_records,
+		__ATOMIC_RELEASE);
+	return num_records;
+}
+
+size_t sample_ring_count (const sample_ring* ring) {
+	const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	return (size_t)(head - tail);
+}
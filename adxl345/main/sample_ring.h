@@ -0,0 +1,171 @@
+#ifndef _SAMPLE_RING_H
+#define _SAMPLE_RING_H
+
+/**
+ * @file sample_ring.h
+ *
+ * Lock-free ring buffer of acceleration samples.
+ *
+ * A ring buffer is safe between a single producer and a single consumer
+ * without locks; e.g., a high-priority reader task (or an ISR) and a
+ * lower-priority consumer task, even on different cores.
+ * Neither side ever blocks the other, so the producer is not delayed
+ * by a slow consumer. It loses samples instead if the buffer is full.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sample of acceleration.
+ */
+typedef struct sample_record_t {
+	/** @brief Time when the sample was taken in microseconds. */
+	int64_t timestamp;
+	/**
+	 * @brief Acceleration.
+	 *
+	 * - `[0]`: x-acceleration
+	 * - `[1]`: y-acceleration
+	 * - `[2]`: z-acceleration
+	 */
+	int16_t accs[3];
+} sample_record;
+
+/**
+ * @brief Single-producer/single-consumer ring buffer of `::sample_record`s.
+ *
+ * `head` and `tail` run freely and wrap around at `2^32`,
+ * so `head - tail` is always the number of records in the buffer.
+ */
+typedef struct sample_ring_t {
+	/** @brief Memory block of records. */
+	sample_record* records;
+	/** @brief `capacity - 1`. */
+	uint32_t mask;
+	/** @brief Number of records ever pushed. Written only by the producer. */
+	uint32_t head;
+	/** @brief Number of records ever popped. Written only by the consumer. */
+	uint32_t tail;
+} sample_ring;
+
+/**
+ * @brief Initializer of a `::sample_ring`.
+ *
+ * It will cause undefined behavior if `_capacity` is not a power of two.
+ *
+ * @param[in] _records
+ *
+ *   (`sample_record*`) Memory block of records.
+ *   You have to allocate `_capacity` records.
+ *
+ * @param[in] _capacity
+ *
+ *   (`uint32_t`) Maximum number of records in the ring buffer.
+ *
+ * @return
+ *
+ *   Initializer of a `::sample_ring`.
+ */
+#define sample_ring_initializer(_records, _capacity) \
+{ \
+	.records = (_records), \
+	.mask = (_capacity) - 1u, \
+	.head = 0u, \
+	.tail = 0u \
+}
+
+/**
+ * @brief Capacity of a `::sample_ring`.
+ *
+ * @param[in] ring
+ *
+ *   (`const sample_ring*`) `::sample_ring` whose capacity is to be
+ *   obtained.
+ *
+ * @return
+ *
+ *   (`size_t`) Maximum number of records in `ring`.
+ */
+#define sample_ring_capacity(ring)  ((size_t)(ring)->mask + 1u)
+
+/**
+ * @brief Pushes given records.
+ *
+ * Must be called only by the producer.
+ * Records that do not fit are not pushed.
+ *
+ * @param[in,out] ring
+ *
+ *   `::sample_ring` where records are to be pushed.
+ *
+ * @param[in] records
+ *
+ *   Records to push.
+ *
+ * @param[in] num_records
+ *
+ *   Number of records to push.
+ *
+ * @return
+ *
+ *   Number of records actually pushed.
+ */
+size_t sample_ring_push (
+		sample_ring* ring,
+		const sample_record* records,
+		size_t num_records);
+
+/**
+ * @brief Pops records.
+ *
+ * Must be called only by the consumer.
+ *
+ * @param[in,out] ring
+ *
+ *   `::sample_ring` from which records are to be popped.
+ *
+ * @param[out] records
+ *
+ *   Buffer to receive records.
+ *
+ * @param[in] max_records
+ *
+ *   Maximum number of records to pop.
+ *
+ * @return
+ *
+ *   Number of records actually popped.
+ *   `0` if `ring` is empty.
+ */
+size_t sample_ring_pop (
+		sample_ring* ring,
+		sample_record* records,
+		size_t max_records);
+
+/**
+ * @brief Number of records in a `::sample_ring`.
+ *
+ * The result may be outdated as soon as it is returned,
+ * but never overestimates for the consumer nor underestimates for
+ * the producer.
+ *
+ * @param[in] ring
+ *
+ *   `::sample_ring` to be inspected.
+ *
+ * @return
+ *
+ *   Number of records in `ring`.
+ */
+size_t sample_ring_count (const sample_ring* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * @file spectrum.c
+ *
+ * Implementation of vibration spectra.
+ */
+
+#include "spectrum.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+/** @brief Pi in single precision. */
+#define SPECTRUM_PI  3.14159265358979323846f
+
+/** @brief Pi in double precision. */
+#define SPECTRUM_PI_DOUBLE  3.14159265358979323846
+
+/**
+ * @brief Computes the spectra of axes from the history.
+ *
+ * @param[in,out] spectrum
+ *
+ *   `::spectrum` with a full history.
+ */
+static void spectrum_update (spectrum* spectrum) {
+	const uint32_t size = spectrum->size;
+	const uint32_t num_bins = SPECTRUM_NUM_BINS(size);
+	// the sum of the periodic Hann window is size / 2
+	const float scale = 2.0f / (float)size;
+	float* work = spectrum->work;
+	float* magnitudes;
+	float re;
+	float im;
+	float mean;
+	int32_t sum;
+	uint32_t i;
+	int axis;
+	for (axis = 0; axis < 3; ++axis) {
+		// removes the mean (e.g., gravity), which would leak into low bins
+		sum = 0;
+		for (i = 0; i < size; ++i) {
+			sum += spectrum->history[i * 3u + axis];
+		}
+		mean = (float)sum / (float)size;
+		for (i = 0; i < size; ++i) {
+			work[2u * i] = spectrum->window[i] *
+				((float)spectrum->history[i * 3u + axis] - mean);
+			work[2u * i + 1u] = 0.0f;
+		}
+		spectrum_fft(work, size, spectrum->twiddles);
+		magnitudes = spectrum->magnitudes + axis * num_bins;
+		for (i = 0; i < num_bins; ++i) {
+			re = work[2u * i];
+			im = work[2u * i + 1u];
+			magnitudes[i] = sqrtf(re * re + im * im) * scale;
+		}
+		// a sine wave splits into positive and negative frequencies
+		for (i = 1; i < num_bins - 1u; ++i) {
+			magnitudes[i] *= 2.0f;
+		}
+	}
+}
+
+void spectrum_init (spectrum* spectrum) {
+	const uint32_t size = spectrum->size;
+	double angle;
+	uint32_t i;
+	assert((size >= SPECTRUM_MIN_SIZE) && (size <= SPECTRUM_MAX_SIZE));
+	assert((size & (size - 1u)) == 0u);
+	for (i = 0; i < size; ++i) {
+		// periodic, whose 50% overlaps sum to a constant
+		spectrum->window[i] =
+			0.5f - 0.5f * cosf(2.0f * SPECTRUM_PI * (float)i / (float)size);
+	}
+	// rounded once from double precision; angles in single precision
+	// would double the error of large FFTs
+	for (i = 0; i < size / 2u; ++i) {
+		angle = -2.0 * SPECTRUM_PI_DOUBLE * (double)i / (double)size;
+		spectrum->twiddles[2u * i] = (float)cos(angle);
+		spectrum->twiddles[2u * i + 1u] = (float)sin(angle);
+	}
+	spectrum->num_samples = 0u;
+}
+
+void spectrum_fft (float* data, uint32_t size, const float* twiddles) {
+	uint32_t i;
+	uint32_t j;
+	uint32_t bit;
+	uint32_t length;
+	uint32_t half;
+	uint32_t stride;
+	uint32_t start;
+	uint32_t k;
+	float tmp;
+	float wr;
+	float wi;
+	float xr;
+	float xi;
+	float* a;
+	float* b;
+	assert((size > 0u) && ((size & (size - 1u)) == 0u));
+	// bit-reversal permutation
+	for (i = 1, j = 0; i < size; ++i) {
+		for (bit = size >> 1; (j & bit) != 0u; bit >>= 1) {
+			j ^= bit;
+		}
+		j |= bit;
+		if (i < j) {
+			tmp = data[2u * i];
+			data[2u * i] = data[2u * j];
+			data[2u * j] = tmp;
+			tmp = data[2u * i + 1u];
+			data[2u * i + 1u] = data[2u * j + 1u];
+			data[2u * j + 1u] = tmp;
+		}
+	}
+	// decimation-in-time butterflies
+	for (length = 2u; length <= size; length <<= 1) {
+		half = length >> 1;
+		stride = size / length;
+		for (start = 0; start < size; start += length) {
+			for (k = 0; k < half; ++k) {
+				wr = twiddles[2u * k * stride];
+				wi = twiddles[2u * k * stride + 1u];
+				a = data + 2u * (start + k);
+				b = data + 2u * (start + k + half);
+				xr = b[0] * wr - b[1] * wi;
+				xi = b[0] * wi + b[1] * wr;
+				b[0] = a[0] - xr;
+				b[1] = a[1] - xi;
+				a[0] += xr;
+				a[1] += xi;
+			}
+		}
+	}
+}
+
+int spectrum_add (spectrum* spectrum, const sample_record* sample) {
+	const uint32_t size = spectrum->size;
+	memcpy(
+		spectrum->history + spectrum->num_samples * 3u,
+		sample->accs,
+		sizeof(sample->accs));
+	if (++spectrum->num_samples < size) {
+		return 0;
+	}
+	spectrum_update(spectrum);
+	// keeps the latest half for the next spectra
+	memmove(
+		spectrum->history,
+		spectrum->history + (size / 2u) * 3u,
+		(size / 2u) * sizeof(sample->accs));
+	spectrum->num_samples = size / 2u;
+	return 1;
+}
+
+size_t spectrum_find_peaks (
+		const spectrum* spectrum,
+		int axis,
+		spectrum_peak* peaks,
+		size_t max_peaks)
+{
+	const uint32_t num_bins = SPECTRUM_NUM_BINS(spectrum->size);
+	const float* magnitudes = spectrum->magnitudes + axis * num_bins;
+	const float bin_width =
+		(float)spectrum->sample_rate_millihz / 1000.0f / (float)spectrum->size;
+	size_t num_peaks = 0u;
+	size_t j;
+	uint32_t k;
+	float left;
+	float center;
+	float right;
+	float denominator;
+	float offset;
+	assert((axis >= 0) && (axis < 3));
+	if (max_peaks == 0u) {
+		return 0u;
+	}
+	for (k = 1; k < num_bins - 1u; ++k) {
+		left = magnitudes[k - 1u];
+		center = magnitudes[k];
+		right = magnitudes[k + 1u];
+		if ((center <= left) || (center <= right)) {
+			continue;
+		}
+		if ((num_peaks == max_peaks) &&
+			(center <= peaks[num_peaks - 1u].magnitude))
+		{
+			continue;
+		}
+		// inserts in descending order, dropping the lowest if full
+		j = (num_peaks < max_peaks) ? num_peaks++ : num_peaks - 1u;
+		for (; (j > 0u) && (peaks[j - 1u].magnitude < center); --j) {
+			peaks[j] = peaks[j - 1u];
+		}
+		denominator = left - 2.0f * center + right;
+		offset = (denominator != 0.0f) ?
+			0.5f * (left - right) / denominator :
+			0.0f;
+		peaks[j].frequency = ((float)k + offset) * bin_width;
+		peaks[j].magnitude = center;
+	}
+	return num_peaks;
+}
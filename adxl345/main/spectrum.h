@@ -0,0 +1,308 @@
+#ifndef _SPECTRUM_H
+#define _SPECTRUM_H
+
+/**
+ * @file spectrum.h
+ *
+ * Vibration spectra of acceleration streams.
+ *
+ * Samples of three axes are accumulated in a history, and every time
+ * half of the history is replaced (50% overlap), each axis loses its mean,
+ * is windowed with a Hann window, and is transformed with a radix-2 FFT
+ * in single precision, which the FPU of the ESP32 handles. FFT sizes are
+ * powers of two only.
+ *
+ * Every buffer is allocated by the caller; e.g., as static arrays sized with
+ * the `SPECTRUM_*_SIZE` macros.
+ */
+
+#include "sample_ring.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Minimum FFT size. */
+#define SPECTRUM_MIN_SIZE  4u
+
+/** @brief Maximum FFT size. */
+#define SPECTRUM_MAX_SIZE  4096u
+
+/**
+ * @brief Number of `int16_t` elements in a history buffer.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Number of elements of three axes.
+ */
+#define SPECTRUM_HISTORY_SIZE(size)  (3u * (size))
+
+/**
+ * @brief Number of `float` elements in a window buffer.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Number of elements in a Hann window.
+ */
+#define SPECTRUM_WINDOW_SIZE(size)  (size)
+
+/**
+ * @brief Number of `float` elements in a twiddle factor buffer.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Number of elements of `size / 2` complex numbers.
+ */
+#define SPECTRUM_TWIDDLES_SIZE(size)  (size)
+
+/**
+ * @brief Number of `float` elements in a work buffer.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Number of elements of `size` complex numbers.
+ */
+#define SPECTRUM_WORK_SIZE(size)  (2u * (size))
+
+/**
+ * @brief Number of bins in the spectrum of an axis.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Number of bins from DC to the Nyquist frequency.
+ */
+#define SPECTRUM_NUM_BINS(size)  ((size) / 2u + 1u)
+
+/**
+ * @brief Number of `float` elements in a magnitude buffer.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Number of elements of bins of three axes.
+ */
+#define SPECTRUM_MAGNITUDES_SIZE(size)  (3u * SPECTRUM_NUM_BINS(size))
+
+/**
+ * @brief Peak of a spectrum.
+ */
+typedef struct spectrum_peak_t {
+	/** @brief Frequency in Hz interpolated between bins. */
+	float frequency;
+	/** @brief Amplitude at the peak bin in the unit of samples. */
+	float magnitude;
+} spectrum_peak;
+
+/**
+ * @brief Spectra of three axes.
+ */
+typedef struct spectrum_t {
+	/** @brief FFT size. A power of two. */
+	uint32_t size;
+	/** @brief Sampling rate in mHz. */
+	uint32_t sample_rate_millihz;
+	/** @brief Number of samples in `history`. */
+	uint32_t num_samples;
+	/**
+	 * @brief Latest samples of axes; `[i * 3 + axis]`.
+	 *
+	 * Has `SPECTRUM_HISTORY_SIZE(size)` elements.
+	 */
+	int16_t* history;
+	/**
+	 * @brief Hann window.
+	 *
+	 * Has `SPECTRUM_WINDOW_SIZE(size)` elements.
+	 */
+	float* window;
+	/**
+	 * @brief Twiddle factors; `exp(-2 pi i k / size)` as (re, im) pairs.
+	 *
+	 * Has `SPECTRUM_TWIDDLES_SIZE(size)` elements.
+	 */
+	float* twiddles;
+	/**
+	 * @brief Complex numbers transformed in place.
+	 *
+	 * Has `SPECTRUM_WORK_SIZE(size)` elements.
+	 */
+	float* work;
+	/**
+	 * @brief Amplitude spectra of axes; `[axis * SPECTRUM_NUM_BINS(size) + k]`.
+	 *
+	 * Has `SPECTRUM_MAGNITUDES_SIZE(size)` elements.
+	 * A sine wave of amplitude A at bin `k` gives A at `k`.
+	 * DC is almost `0` because the mean is removed.
+	 */
+	float* magnitudes;
+} spectrum;
+
+/**
+ * @brief Initializer of a `::spectrum`.
+ *
+ * `::spectrum_init` has to be called before use.
+ * Buffers need not be initialized.
+ *
+ * @param[in] _size
+ *
+ *   (`uint32_t`) FFT size. A power of two from `SPECTRUM_MIN_SIZE` to
+ *   `SPECTRUM_MAX_SIZE`.
+ *
+ * @param[in] _sample_rate_millihz
+ *
+ *   (`uint32_t`) Sampling rate in mHz.
+ *
+ * @param[in] _history
+ *
+ *   (`int16_t*`) `SPECTRUM_HISTORY_SIZE(_size)` elements.
+ *
+ * @param[in] _window
+ *
+ *   (`float*`) `SPECTRUM_WINDOW_SIZE(_size)` elements.
+ *
+ * @param[in] _twiddles
+ *
+ *   (`float*`) `SPECTRUM_TWIDDLES_SIZE(_size)` elements.
+ *
+ * @param[in] _work
+ *
+ *   (`float*`) `SPECTRUM_WORK_SIZE(_size)` elements.
+ *
+ * @param[in] _magnitudes
+ *
+ *   (`float*`) `SPECTRUM_MAGNITUDES_SIZE(_size)` elements.
+ *
+ * @return
+ *
+ *   Initializer of a `::spectrum`.
+ */
+#define spectrum_initializer(_size, _sample_rate_millihz, _history, _window, _twiddles, _work, _magnitudes) \
+{ \
+	.size = (_size), \
+	.sample_rate_millihz = (_sample_rate_millihz), \
+	.num_samples = 0u, \
+	.history = (_history), \
+	.window = (_window), \
+	.twiddles = (_twiddles), \
+	.work = (_work), \
+	.magnitudes = (_magnitudes) \
+}
+
+/**
+ * @brief Computes the window and twiddle factors, and empties the history.
+ *
+ * @param[in,out] spectrum
+ *
+ *   `::spectrum` to initialize.
+ */
+void spectrum_init (spectrum* spectrum);
+
+/**
+ * @brief Transforms complex numbers with a radix-2 FFT in place.
+ *
+ * Radix-2 only; there is no mixed-radix or Bluestein fallback, so sizes
+ * other than powers of two are not supported, and fail an assertion.
+ * The relative RMS error against an exact DFT is about `1e-7` up to
+ * `SPECTRUM_MAX_SIZE` with the twiddle factors of `::spectrum_init`.
+ *
+ * @param[in,out] data
+ *
+ *   `size` complex numbers as (re, im) pairs.
+ *   Receives the transform in the natural order.
+ *
+ * @param[in] size
+ *
+ *   Number of complex numbers. A power of two; see above.
+ *
+ * @param[in] twiddles
+ *
+ *   `exp(-2 pi i k / size)` for `k` from `0` to `size / 2 - 1`
+ *   as (re, im) pairs.
+ */
+void spectrum_fft (float* data, uint32_t size, const float* twiddles);
+
+/**
+ * @brief Adds a sample, and updates the spectra when half of the history
+ * is replaced.
+ *
+ * The first spectra need a full history of `size` samples.
+ *
+ * @param[in,out] spectrum
+ *
+ *   `::spectrum` where the sample is to be added.
+ *
+ * @param[in] sample
+ *
+ *   Sample to add.
+ *
+ * @return
+ *
+ *   - `1`: `magnitudes` has been updated.
+ *   - `0`: `magnitudes` has not been updated.
+ */
+int spectrum_add (spectrum* spectrum, const sample_record* sample);
+
+/**
+ * @brief Finds the highest peaks in the spectrum of an axis.
+ *
+ * A peak is a bin higher than both neighbors, so DC and the Nyquist
+ * frequency are never peaks. The frequency is interpolated with a parabola
+ * through the peak and its neighbors.
+ *
+ * @param[in] spectrum
+ *
+ *   `::spectrum`.
+ *
+ * @param[in] axis
+ *
+ *   Axis; `0` for x, `1` for y and `2` for z.
+ *
+ * @param[out] peaks
+ *
+ *   Receives peaks in descending order of magnitude.
+ *
+ * @param[in] max_peaks
+ *
+ *   Maximum number of peaks to find.
+ *
+ * @return
+ *
+ *   Number of peaks found.
+ */
+size_t spectrum_find_peaks (
+		const spectrum* spectrum,
+		int axis,
+		spectrum_peak* peaks,
+		size_t max_peaks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,9 +14,24 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_err.h"
 #include "esp_system.h"
 #include "driver/spi_master.h"
-#include "driver/gpio.h"
+#include "driver/uart.h"
+
+#include "hal.h"
+#include "spi_bus_manager.h"
+#include "utils.h"
+
+#include "adxl345.h"
+#include "dsp.h"
+#include "capture_history.h"
+#include "interval_stats.h"
+#include "motion_detector.h"
+#include "sample_log.h"
+#include "sample_ring.h"
+#include "spectrum.h"
 
 /** @brief Uses SPI3 (VSPI). */
 #define ADXL_HOST  VSPI_HOST
@@ -33,9 +48,9 @@
 /**
  * @brief GPIO# for CS.
  *
- * Also used as a strapping pin.
+ * Not GPIO 5, which is the CS of the E-Paper display on the same bus.
  */
-#define PIN_NUM_CS  5
+#define PIN_NUM_CS  21
 #elif ADXL_HOST == HSPI_HOST
 /**
  * @brief GPIO# for MISO.
@@ -53,224 +68,1202 @@
 #error "unsupported SPI host"
 #endif
 
-/** @brief ADXL345 register read flag. */
-#define ADXL345_REG_READ_FLAG  0x80u
-/** @brief ADXL345 register multibyte flag. */
-#define ADXL345_REG_MB_FLAG  0x40u
-/** @brief ADXL345 register: DEVID. */
-#define ADXL345_REG_DEVID  0x00u
-/** @brief ADXL345 register: BW_RATE. */
-#define ADXL345_REG_BW_RATE  0x2Cu
-/** @brief ADXL345 register: POWER_CTL. */
-#define ADXL345_REG_POWER_CTL  0x2Du
-/** @brief ADXL345 register: DATAX0. */
-#define ADXL345_REG_DATAX0  0x32u
+/**
+ * @brief GPIO# for INT1 of the ADXL345.
+ *
+ * Input only.
+ */
+#define PIN_NUM_INT1  33
 
-/** @brief ADXL345 POWER_CTL flag: Measure. */
-#define ADXL345_POWER_CTL_MEASURE  0x08u
+/**
+ * @brief Rank of the ADXL345 on the SPI bus.
+ *
+ * Higher than a display that shares the bus, so that the ADXL345 is
+ * registered first and FIFO drains go ahead of the chunks of a frame.
+ */
+#define ADXL345_BUS_RANK  1
 
-/** @brief ADXL345 delay to update (200ms). */
-#define ADXL345_UPDATE_DELAY  (200u / portTICK_PERIOD_MS)
+/**
+ * @brief SPI bus of the ADXL345.
+ *
+ * Transactions are at most as long as the FIFO.
+ */
+static spi_bus_manager adxl345_spi_bus = spi_bus_manager_initializer(
+	ADXL_HOST,
+	PIN_NUM_MOSI,
+	PIN_NUM_MISO,
+	PIN_NUM_CLK,
+	0, // default
+	DMA_CHAN);
 
 /**
- * @brief Reads a given register from an ADXL345.
+ * @brief Whether samples are streamed through the FIFO of the ADXL345.
  *
- * In a 4-wire SPI transaction, transmission and receiving happen in parallel
- * as shown below.
+ * If `0`, the latest acceleration is polled every 100ms instead.
+ */
+#ifndef ADXL345_USE_FIFO
+#define ADXL345_USE_FIFO  1
+#endif
+
+/**
+ * @brief Whether samples are logged in binary frames.
  *
- * ```
- * Transmit: command --> t.tx_data[0]
- * Receive:  N/A     --> t.rx_data[0]
+ * If `1`, samples are written to the console UART in frames of
+ * `sample_log.h` instead of the text report.
+ * Decode them with `py/decode_samples.py`.
+ */
+#ifndef ADXL345_LOG_BINARY
+#define ADXL345_LOG_BINARY  1
+#endif
+
+/**
+ * @brief Whether samples are captured only on events.
  *
- * where
- * command = address | ADXL345_READ_FLAG
- * and t is spi_transaction_t
- *   t.tx_data[1] = do not care
- *   t.rx_data[0] = register value
- * ```
+ * If `1`, the ADXL345 watches activity, taps and free fall at
+ * `ADXL345_IDLE_CONFIG` while the host sleeps, and samples are captured
+ * at `ADXL345_CONFIG` around each event.
+ * Requires the FIFO.
+ */
+#ifndef ADXL345_USE_EVENTS
+#define ADXL345_USE_EVENTS  0
+#endif
+
+#if ADXL345_USE_EVENTS && !ADXL345_USE_FIFO
+#error "ADXL345_USE_EVENTS requires ADXL345_USE_FIFO"
+#endif
+
+/**
+ * @brief Whether only samples around triggers are consumed.
  *
- * This function blocks until the transmission and receiving end.
+ * If `1`, the consumer keeps the latest `ADXL345_CAPTURE_HISTORY_SIZE`
+ * samples, and a sample whose magnitude reaches `ADXL345_CAPTURE_THRESHOLD`
+ * freezes `ADXL345_PRE_TRIGGER_SAMPLES` samples before it and
+ * `ADXL345_CAPTURE_POST_TRIGGER_SAMPLES` samples from it.
+ * Only frozen captures are logged in binary, and the text report shows
+ * a summary of each capture.
+ */
+#ifndef ADXL345_USE_CAPTURE
+#define ADXL345_USE_CAPTURE  0
+#endif
+
+/**
+ * @brief Whether samples are filtered and decimated before consumed.
  *
- * @param[in] spi
+ * If `1`, the consumer receives samples decimated by
+ * `2^ADXL345_DSP_LOG2_DECIMATION` and filtered by `ADXL345_DSP_BIQUADS`,
+ * instead of raw samples. The text report also shows features of
+ * every `ADXL345_DSP_WINDOW_SIZE` decimated samples.
+ * Requires the FIFO, for which filters are designed.
+ */
+#ifndef ADXL345_USE_DSP
+#define ADXL345_USE_DSP  0
+#endif
+
+#if ADXL345_USE_DSP && (!ADXL345_USE_FIFO || ADXL345_USE_EVENTS)
+#error "ADXL345_USE_DSP requires ADXL345_USE_FIFO without ADXL345_USE_EVENTS"
+#endif
+
+/**
+ * @brief Whether the text report shows peaks of vibration spectra.
  *
- *   Handle of the ADXL345 from which the register is to be read.
+ * If `1`, the consumer computes spectra of samples it receives with
+ * `ADXL345_SPECTRUM_SIZE` FFTs overlapping by 50%, and the text report
+ * shows the highest `ADXL345_SPECTRUM_NUM_PEAKS` peaks of each axis.
+ * Requires the text report; i.e., `ADXL345_LOG_BINARY` is `0`,
+ * and a constant rate; i.e., `ADXL345_USE_EVENTS` is `0`.
+ */
+#ifndef ADXL345_USE_SPECTRUM
+#define ADXL345_USE_SPECTRUM  0
+#endif
+
+#if ADXL345_USE_SPECTRUM && ADXL345_LOG_BINARY
+#error "ADXL345_USE_SPECTRUM requires ADXL345_LOG_BINARY to be 0"
+#endif
+
+#if ADXL345_USE_SPECTRUM && ADXL345_USE_EVENTS
+#error "ADXL345_USE_SPECTRUM requires ADXL345_USE_EVENTS to be 0"
+#endif
+
+/** @brief UART where binary frames are written; i.e., the console. */
+#define ADXL345_LOG_UART  UART_NUM_0
+
+/**
+ * @brief Baud rate of binary logging.
  *
- * @param[in] address
+ * 3200Hz takes about 10KB/s in typical and 30KB/s in the worst case,
+ * that the default 115200 baud cannot carry.
+ */
+#define ADXL345_LOG_BAUD_RATE  921600u
+
+/** @brief Size of the TX buffer of the UART driver in bytes. */
+#define ADXL345_LOG_TX_BUFFER_SIZE  8192
+
+/**
+ * @brief Maximum ticks to hold a partial frame (1s).
  *
- *   Address of the register to be read.
+ * A frame is written when it has `SAMPLE_LOG_MAX_SAMPLES` samples,
+ * or no sample comes within this time.
+ */
+#define ADXL345_LOG_FLUSH_TIMEOUT  (1000u / portTICK_PERIOD_MS)
+
+/**
+ * @brief Number of samples captured after the last event (1s at 3200Hz).
+ */
+#define ADXL345_POST_TRIGGER_SAMPLES  3200u
+
+/** @brief Maximum number of samples in a capture (10s at 3200Hz). */
+#define ADXL345_MAX_CAPTURE_SAMPLES  32000u
+
+/**
+ * @brief Period of polling in milliseconds.
  *
- * @return
+ * Same as the output data rate in `ADXL345_CONFIG` of the polling mode.
+ * Has to be a multiple of the tick period.
+ */
+#define ADXL345_POLLING_PERIOD_MS  10u
+
+/**
+ * @brief Number of samples in the FIFO that raises INT1.
  *
- *   Value of the register associated with `address`.
+ * 16 samples take 5ms at 3200Hz, and leave another 5ms before the FIFO
+ * overruns.
  */
-static uint8_t adxl345_read (spi_device_handle_t spi, uint8_t address) {
-    esp_err_t ret;
-    spi_transaction_t trans = {
-		.flags = SPI_TRANS_USE_RXDATA | SPI_TRANS_USE_TXDATA,
-		.cmd = address | ADXL345_REG_READ_FLAG,
-		.length = 8 // in bits
-	};
-    ret = spi_device_polling_transmit(spi, &trans);
-    assert(ret == ESP_OK);
-	return trans.rx_data[0];
-}
+#define ADXL345_FIFO_WATERMARK  16u
 
 /**
- * @brief Writes a given value in a specified register of an ADXL345.
+ * @brief Capacity of the sample ring buffer (in samples).
  *
- * In a 4-wire SPI transaction, transmission and receiving happen in parallel
- * as shown below.
+ * Must be a power of two.
+ */
+#define ADXL345_SAMPLE_RING_SIZE  1024u
+
+/** @brief Maximum number of samples popped from the ring buffer at once. */
+#define ADXL345_CONSUMER_BATCH_SIZE  64u
+
+/**
+ * @brief Maximum ticks to wait for INT1.
  *
- * ```
- * Transmit: address --> t.tx_data[0]
- * Receive:  N/A     --> t.rx_data[0]
+ * The FIFO is checked anyway after this time in case an edge is missed.
+ */
+#define ADXL345_FIFO_TIMEOUT  (100u / portTICK_PERIOD_MS)
+
+/** @brief Interval of the stream statistics report (1s). */
+#define ADXL345_REPORT_INTERVAL  (1000u / portTICK_PERIOD_MS)
+
+/** @brief Order of the CIC decimator. */
+#define ADXL345_DSP_CIC_ORDER  3u
+
+/**
+ * @brief log2 of the decimation factor.
  *
- * where t is spi_transaction_t and
- * t.tx_data[0] = value
- * t.rx_data[0] = do not care
- * ```
+ * 16 decimates 3200Hz into 200Hz.
+ */
+#define ADXL345_DSP_LOG2_DECIMATION  4u
+
+/** @brief Number of decimated samples in a feature window (1s at 200Hz). */
+#define ADXL345_DSP_WINDOW_SIZE  200u
+
+/** @brief Number of biquad filters after decimation. */
+#define ADXL345_DSP_NUM_BIQUADS  2u
+
+/**
+ * @brief Depth of the capture history in samples.
  *
- * This function blocks until the transmission and receiving end.
+ * Must be a power of two. Takes 64KB.
+ */
+#define ADXL345_CAPTURE_HISTORY_SIZE  4096u
+
+/** @brief Number of samples before a trigger in a capture (640ms). */
+#define ADXL345_PRE_TRIGGER_SAMPLES  2048u
+
+/** @brief Number of samples from a trigger in a capture (320ms). */
+#define ADXL345_CAPTURE_POST_TRIGGER_SAMPLES  1024u
+
+/**
+ * @brief Magnitude of acceleration that triggers a capture (3g).
  *
- * @param[in] spi
+ * 4mg/LSB in the full resolution mode.
+ */
+#define ADXL345_CAPTURE_THRESHOLD  750u
+
+/**
+ * @brief FFT size of vibration spectra.
  *
- *   Handle of the ADXL345 where the register value is to be set.
+ * 1024 gives 3.125Hz resolution at 3200Hz, and spectra every 160ms.
+ * A power of two from `SPECTRUM_MIN_SIZE` to `SPECTRUM_MAX_SIZE`, because
+ * `::spectrum_fft` is radix-2 only.
+ */
+#define ADXL345_SPECTRUM_SIZE  1024u
+
+#if (ADXL345_SPECTRUM_SIZE & (ADXL345_SPECTRUM_SIZE - 1u)) || \
+	(ADXL345_SPECTRUM_SIZE < SPECTRUM_MIN_SIZE) || \
+	(ADXL345_SPECTRUM_SIZE > SPECTRUM_MAX_SIZE)
+#error "ADXL345_SPECTRUM_SIZE must be a power of two supported by spectrum.h"
+#endif
+
+/** @brief Number of peaks of each axis in the text report. */
+#define ADXL345_SPECTRUM_NUM_PEAKS  3u
+
+#if ADXL345_USE_FIFO
+/**
+ * @brief Configuration of the ADXL345.
  *
- * @param[in] address
+ * ±16g in the full resolution mode keeps 4mg/LSB of the default.
+ */
+static const adxl345_config ADXL345_CONFIG = adxl345_config_initializer(
+	ADXL345_RATE_3200HZ,
+	ADXL345_RANGE_16G,
+	1, // full resolution
+	0); // low power
+#else
+/**
+ * @brief Configuration of the ADXL345.
  *
- *   Address of the register to be written.
+ * The output data rate has to match `ADXL345_POLLING_PERIOD_MS`.
+ */
+static const adxl345_config ADXL345_CONFIG = adxl345_config_initializer(
+	ADXL345_RATE_100HZ,
+	ADXL345_RANGE_16G,
+	1, // full resolution
+	0); // low power
+#endif
+
+#if ADXL345_USE_EVENTS
+/**
+ * @brief Configuration of the ADXL345 while waiting for events.
  *
- * @param[in] value
+ * Taps need 100Hz or faster. The FIFO holds the last 330ms as
+ * the pre-trigger window.
+ */
+static const adxl345_config ADXL345_IDLE_CONFIG = adxl345_config_initializer(
+	ADXL345_RATE_100HZ,
+	ADXL345_RANGE_16G,
+	1, // full resolution
+	1); // low power
+#endif
+
+/** @brief Memory block of `::adxl345_sample_ring`. */
+static sample_record adxl345_sample_records[ADXL345_SAMPLE_RING_SIZE];
+
+/**
+ * @brief Ring buffer of samples.
+ *
+ * The reader task is the producer and `::adxl345_consume_samples_task`
+ * is the consumer.
+ */
+static sample_ring adxl345_sample_ring = sample_ring_initializer(
+	adxl345_sample_records,
+	ADXL345_SAMPLE_RING_SIZE);
+
+/** @brief Task consuming samples. */
+static TaskHandle_t adxl345_consumer_task_handle = NULL;
+
+/** @brief Number of times the FIFO overran. Always `0` without the FIFO. */
+static volatile uint32_t adxl345_num_overruns = 0u;
+
+/** @brief Number of captures on events. Always `0` without events. */
+static volatile uint32_t adxl345_num_captures = 0u;
+
+/** @brief Number of samples dropped because the ring buffer was full. */
+static volatile uint32_t adxl345_num_dropped_samples = 0u;
+
+/**
+ * @brief Pushes samples into `::adxl345_sample_ring`.
+ *
+ * Never blocks. Samples that do not fit are dropped and counted.
+ * Wakes up the consumer task.
  *
- *   Value to be written to the register associated with `address`.
+ * @param[in] samples
+ *
+ *   Samples to push.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples to push.
  */
-static void adxl345_write (
-		spi_device_handle_t spi,
-		uint8_t address,
-		uint8_t value)
+static void adxl345_push_samples (
+		const sample_record* samples,
+		size_t num_samples)
 {
-	esp_err_t ret;
-	spi_transaction_t trans = {
-		.flags = SPI_TRANS_USE_RXDATA,
-		.cmd = address,
-		.tx_buffer = &value,
-		.length = 8 // in bits
-	};
-	ret = spi_device_polling_transmit(spi, &trans);
-	assert(ret == ESP_OK);
+	size_t num_pushed;
+	if (num_samples == 0u) {
+		return;
+	}
+	num_pushed = sample_ring_push(&adxl345_sample_ring, samples, num_samples);
+	adxl345_num_dropped_samples += (uint32_t)(num_samples - num_pushed);
+	xTaskNotifyGive(adxl345_consumer_task_handle);
 }
 
+#if ADXL345_USE_DSP
+
 /**
- * @brief Reads the latest acceleration from the ADXL345.
+ * @brief Biquad filters applied after decimation at 200Hz.
  *
- * Undefined if `accs` does not point to a block smaller than
- * `sizeof(int16_t) * 3`
+ * Butterworth (Q=1/sqrt(2)) from the Audio EQ Cookbook.
+ * - 2Hz high-pass: removes gravity and drift.
+ * - 80Hz low-pass: cuts what the CIC decimator lets alias.
+ */
+static const dsp_biquad_coefficients ADXL345_DSP_BIQUADS[ADXL345_DSP_NUM_BIQUADS] = {
+	dsp_biquad_coefficients_initializer(
+		0.9565432255568768, -1.9130864511137535, 0.9565432255568768,
+		-1.9111970674260732, 0.9149758348014339),
+	dsp_biquad_coefficients_initializer(
+		0.6389455251590224, 1.2778910503180447, 0.6389455251590224,
+		1.1429805025399007, 0.41280159809618855)
+};
+
+/** @brief CIC decimators of axes. */
+static dsp_cic adxl345_dsp_cics[3] = {
+	dsp_cic_initializer(ADXL345_DSP_CIC_ORDER, ADXL345_DSP_LOG2_DECIMATION),
+	dsp_cic_initializer(ADXL345_DSP_CIC_ORDER, ADXL345_DSP_LOG2_DECIMATION),
+	dsp_cic_initializer(ADXL345_DSP_CIC_ORDER, ADXL345_DSP_LOG2_DECIMATION)
+};
+
+/** @brief Biquad filters of axes. */
+static dsp_biquad adxl345_dsp_biquads[3][ADXL345_DSP_NUM_BIQUADS] = {
+	{
+		dsp_biquad_initializer(&ADXL345_DSP_BIQUADS[0]),
+		dsp_biquad_initializer(&ADXL345_DSP_BIQUADS[1])
+	},
+	{
+		dsp_biquad_initializer(&ADXL345_DSP_BIQUADS[0]),
+		dsp_biquad_initializer(&ADXL345_DSP_BIQUADS[1])
+	},
+	{
+		dsp_biquad_initializer(&ADXL345_DSP_BIQUADS[0]),
+		dsp_biquad_initializer(&ADXL345_DSP_BIQUADS[1])
+	}
+};
+
+/** @brief Feature windows of axes. */
+static dsp_window adxl345_dsp_windows[3] = {
+	dsp_window_initializer(ADXL345_DSP_WINDOW_SIZE),
+	dsp_window_initializer(ADXL345_DSP_WINDOW_SIZE),
+	dsp_window_initializer(ADXL345_DSP_WINDOW_SIZE)
+};
+
+/** @brief Features of the last complete window of axes. */
+static dsp_features adxl345_dsp_features[3];
+
+#endif
+
+/**
+ * @brief Filters and decimates samples in place.
  *
- * @param[in] spi
+ * Does nothing unless `ADXL345_USE_DSP` is `1`.
+ * A decimated sample is stamped with the time of the last raw sample
+ * it covers; the delay of filters is not compensated.
+ * Only the consumer task may call this function.
+ *
+ * @param[in,out] samples
+ *
+ *   Raw samples to filter. Receives decimated samples.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of raw samples in `samples`.
+ *
+ * @return
+ *
+ *   Number of decimated samples in `samples`.
+ */
+static size_t adxl345_filter_samples (
+		sample_record* samples,
+		size_t num_samples)
+{
+#if ADXL345_USE_DSP
+	int16_t accs[3];
+	size_t num_filtered = 0u;
+	size_t i;
+	size_t axis;
+	int decimated = 0;
+	for (i = 0; i < num_samples; ++i) {
+		// the decimators of all axes are in phase
+		for (axis = 0; axis < 3; ++axis) {
+			decimated = dsp_cic_process(
+				&adxl345_dsp_cics[axis],
+				samples[i].accs[axis],
+				&accs[axis]);
+		}
+		if (!decimated) {
+			continue;
+		}
+		for (axis = 0; axis < 3; ++axis) {
+			accs[axis] = dsp_biquad_cascade_process(
+				adxl345_dsp_biquads[axis],
+				ADXL345_DSP_NUM_BIQUADS,
+				accs[axis]);
+			dsp_window_add(
+				&adxl345_dsp_windows[axis],
+				accs[axis],
+				&adxl345_dsp_features[axis]);
+		}
+		// never overtakes `i`
+		samples[num_filtered].timestamp = samples[i].timestamp;
+		memcpy(samples[num_filtered].accs, accs, sizeof(accs));
+		++num_filtered;
+	}
+	return num_filtered;
+#else
+	return num_samples;
+#endif
+}
+
+#if ADXL345_USE_CAPTURE
+
+/** @brief Memory block of `::adxl345_capture_history`. */
+static sample_record adxl345_capture_records[ADXL345_CAPTURE_HISTORY_SIZE];
+
+/**
+ * @brief History of samples that the consumer receives.
+ *
+ * Only the consumer task may access it.
+ */
+static capture_history adxl345_capture_history = capture_history_initializer(
+	adxl345_capture_records,
+	ADXL345_CAPTURE_HISTORY_SIZE,
+	ADXL345_PRE_TRIGGER_SAMPLES,
+	ADXL345_CAPTURE_POST_TRIGGER_SAMPLES,
+	ADXL345_CAPTURE_THRESHOLD);
+
+#endif
+
+#if ADXL345_USE_SPECTRUM
+/**
+ * @brief Rate of samples that the consumer receives.
+ *
+ * @return
+ *
+ *   Output data rate divided by the decimation of
+ *   `::adxl345_filter_samples` in mHz.
+ */
+static uint32_t adxl345_consumer_rate_millihz (void) {
+#if ADXL345_USE_DSP
+	return adxl345_odr_millihz(&ADXL345_CONFIG) >> ADXL345_DSP_LOG2_DECIMATION;
+#else
+	return adxl345_odr_millihz(&ADXL345_CONFIG);
+#endif
+}
+#endif
+
+#if ADXL345_USE_FIFO
+
+/** @brief Task draining the FIFO; i.e., the FIFO or event task. */
+static TaskHandle_t adxl345_fifo_task_handle = NULL;
+
+/** @brief Time of the last rising edge of INT1 in microseconds. */
+static int64_t adxl345_int1_timestamp = 0;
+
+/** @brief Guards `::adxl345_int1_timestamp`, which is not atomic. */
+static portMUX_TYPE adxl345_int1_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Handles a rising edge of INT1.
  *
- *   Handle of the ADXL345 from which the latest acceleration is to be read.
+ * Records the time of the edge and wakes up `::adxl345_fifo_task`
+ * (or `::adxl345_event_task`).
  *
- * @param[out] accs
+ * @param[in] arg
  *
- *   Buffer to receive acceleration.
- *   - `[0]`: x-acceleration
- *   - `[1]`: y-acceleration
- *   - `[2]`: z-acceleration
+ *   Not used.
+ */
+static void IRAM_ATTR adxl345_int1_isr_handler (void* arg) {
+	BaseType_t higher_priority_task_woken = pdFALSE;
+	const int64_t timestamp = hal_get_time_us();
+	portENTER_CRITICAL_ISR(&adxl345_int1_mux);
+	adxl345_int1_timestamp = timestamp;
+	portEXIT_CRITICAL_ISR(&adxl345_int1_mux);
+	vTaskNotifyGiveFromISR(
+		adxl345_fifo_task_handle,
+		&higher_priority_task_woken);
+	if (higher_priority_task_woken == pdTRUE) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+/**
+ * @brief Configures INT1 of the ESP32.
  */
-static void adxl345_read_acceleration (spi_device_handle_t spi, int16_t* accs) {
+static void adxl345_configure_int1 (void) {
 	esp_err_t ret;
-	uint8_t tx_buffer[3u * sizeof(uint16_t)]; // a dummy buffer
-	spi_transaction_t trans = {
-		.cmd = ADXL345_REG_READ_FLAG |
-			ADXL345_REG_MB_FLAG |
-			ADXL345_REG_DATAX0,
-		.length = sizeof(tx_buffer) * 8, // in bits
-		.tx_buffer = tx_buffer,
-		.rx_buffer = accs
-	};
-	ret = spi_device_polling_transmit(spi, &trans);
-	assert(ret == ESP_OK);
-	// sample of each axis is represented in twos complement.
-	// and as ESP32 is little endian, `accs` does not need swapping.
-	// https://docs.espressif.com/projects/esp-idf/en/latest/api-reference/peripherals/spi_master.html#transactions-with-integers-other-than-uint8-t
+	ret = hal_gpio_set_isr(
+		PIN_NUM_INT1,
+		HAL_GPIO_RISING_EDGE,
+		adxl345_int1_isr_handler,
+		NULL);
+	ESP_ERROR_CHECK(ret);
 }
 
 /**
- * @brief Initializes the ADXL345.
+ * @brief Time of the last rising edge of INT1.
  *
- * @param[in] spi
+ * @return
  *
- *   Handle of the ADXL345 to be initialized.
+ *   Time of the last rising edge of INT1 in microseconds.
  */
-static void adxl345_init (spi_device_handle_t spi) {
-	uint8_t out;
-    out = adxl345_read(spi, ADXL345_REG_DEVID);
-    printf("DEVID: 0x%X\n", out);
-	out = adxl345_read(spi, ADXL345_REG_BW_RATE);
-	printf("BW_RATE: 0x%X\n", out);
+static int64_t adxl345_get_int1_timestamp (void) {
+	int64_t timestamp;
+	portENTER_CRITICAL(&adxl345_int1_mux);
+	timestamp = adxl345_int1_timestamp;
+	portEXIT_CRITICAL(&adxl345_int1_mux);
+	return timestamp;
 }
 
 /**
- * @brief Starts sampling of the ADXL345.
+ * @brief Drains the FIFO once into `::adxl345_sample_ring`.
  *
- * This function blocks for 200ms after sending a start command.
+ * Samples are read with `::adxl345_drain_fifo`, and overruns are counted.
  *
  * @param[in] spi
  *
- *   Handle of the ADXL345 to start.
+ *   Handle of the ADXL345.
+ *
+ * @param[in,out] clock
+ *
+ *   Clock of samples.
+ *
+ * @param[out] int_source
+ *
+ *   Receives INT_SOURCE, which is cleared by reading it.
+ *
+ * @return
+ *
+ *   Number of samples drained.
+ */
+static size_t adxl345_drain_fifo_to_ring (
+		hal_spi_device spi,
+		adxl345_fifo_clock* clock,
+		uint8_t* int_source)
+{
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	size_t num_samples;
+	num_samples = adxl345_drain_fifo(
+		spi,
+		clock,
+		ADXL345_FIFO_WATERMARK,
+		adxl345_get_int1_timestamp,
+		samples,
+		int_source);
+	if ((*int_source & ADXL345_INT_OVERRUN) != 0u) {
+		++adxl345_num_overruns;
+	}
+	adxl345_push_samples(samples, num_samples);
+	return num_samples;
+}
+
+#if ADXL345_USE_EVENTS
+
+/**
+ * @brief Task that captures samples on events.
+ *
+ * Blocks until the ADXL345 detects activity, a tap or free fall at
+ * a low rate. Then pushes samples in the FIFO as the pre-trigger window,
+ * and drains the FIFO at the high rate until `::motion_detector` stops
+ * the capture.
+ *
+ * @param[in] pvParameters
+ *
+ *   (`hal_spi_device`) Handle to the ADXL345.
+ */
+static void adxl345_event_task (void* pvParameters) {
+	hal_spi_device spi = (hal_spi_device)pvParameters;
+	motion_detector detector = motion_detector_initializer(
+		ADXL345_POST_TRIGGER_SAMPLES,
+		ADXL345_MAX_CAPTURE_SAMPLES);
+	adxl345_fifo_clock clock = {
+		.odr_millihz = adxl345_odr_millihz(&ADXL345_IDLE_CONFIG),
+		.next_index = 0u,
+		.anchor_index = 0u,
+		.anchor_timestamp = 0,
+		.drain_end_timestamp = 0
+	};
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	size_t num_samples;
+	uint8_t int_source;
+	adxl345_arm_events(spi, &ADXL345_IDLE_CONFIG, &clock);
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		if (adxl345_read(spi, ADXL345_REG_INT_SOURCE, &int_source) != HAL_OK) {
+			continue;
+		}
+		if (motion_detector_handle_interrupt(&detector, int_source) !=
+			MOTION_ACTION_START_CAPTURE)
+		{
+			continue;
+		}
+		num_samples = adxl345_start_capture(
+			spi,
+			&ADXL345_CONFIG,
+			&clock,
+			adxl345_get_int1_timestamp,
+			samples);
+		adxl345_push_samples(samples, num_samples);
+		do {
+			num_samples = adxl345_drain_fifo_to_ring(spi, &clock, &int_source);
+			motion_detector_handle_interrupt(&detector, int_source);
+			motion_detector_handle_samples(&detector, (uint32_t)num_samples);
+			if ((num_samples < ADXL345_FIFO_WATERMARK) &&
+				(detector.state == MOTION_CAPTURING))
+			{
+				ulTaskNotifyTake(pdTRUE, ADXL345_FIFO_TIMEOUT);
+			}
+		} while (detector.state == MOTION_CAPTURING);
+		adxl345_num_captures = detector.num_captures;
+		adxl345_arm_events(spi, &ADXL345_IDLE_CONFIG, &clock);
+	}
+}
+
+#else
+
+/**
+ * @brief Task that drains the FIFO of the ADXL345.
+ *
+ * Waits for the watermark interrupt, then drains the FIFO with
+ * `::adxl345_drain_fifo_to_ring`.
+ * INT1 stays high while the FIFO holds the watermark or more samples,
+ * so this task keeps draining until the FIFO falls below the watermark;
+ * otherwise no rising edge would come again.
+ *
+ * @param[in] pvParameters
+ *
+ *   (`hal_spi_device`) Handle to the ADXL345.
  */
-static void adxl345_start (spi_device_handle_t spi) {
-	adxl345_write(spi, ADXL345_REG_POWER_CTL, ADXL345_POWER_CTL_MEASURE);
-	vTaskDelay(ADXL345_UPDATE_DELAY);
+static void adxl345_fifo_task (void* pvParameters) {
+	hal_spi_device spi = (hal_spi_device)pvParameters;
+	adxl345_fifo_clock clock = {
+		.odr_millihz = adxl345_odr_millihz(&ADXL345_CONFIG),
+		.next_index = 0u,
+		.anchor_index = 0u,
+		.anchor_timestamp = 0,
+		.drain_end_timestamp = 0
+	};
+	size_t num_samples;
+	uint8_t int_source;
+	// discards samples accumulated before this task started,
+	// which also clears the overrun
+	adxl345_discard_fifo(spi, &clock, adxl345_odr_millihz(&ADXL345_CONFIG));
+	while (1) {
+		do {
+			num_samples = adxl345_drain_fifo_to_ring(spi, &clock, &int_source);
+		} while (num_samples >= ADXL345_FIFO_WATERMARK);
+		ulTaskNotifyTake(pdTRUE, ADXL345_FIFO_TIMEOUT);
+	}
 }
 
+#endif
+
+#else
+
 /**
  * @brief Task that periodically reads accelerations.
  *
+ * Pushes samples into `::adxl345_sample_ring`.
+ *
+ * Wakes up every `ADXL345_POLLING_PERIOD_MS` from the previous wake time,
+ * so the period does not drift by the time to read a sample.
+ * `host/test/test_adxl345_timing.c` runs the same loop on a simulated
+ * clock.
+ *
  * @param[in] pvParameters
  *
- *   (`spi_device_handle_t`) Handle to the ADXL345 from which the latest
+ *   (`hal_spi_device`) Handle to the ADXL345 from which the latest
  *   accleration is to be read.
  */
 static void adxl345_read_acceleration_task (void* pvParameters) {
-	int16_t accs[3];
-	spi_device_handle_t spi = (spi_device_handle_t)pvParameters;
+	sample_record sample;
+	hal_spi_device spi = (hal_spi_device)pvParameters;
+	int64_t wake_time = hal_get_time_us();
 	while (1) {
-		adxl345_read_acceleration(spi, accs);
-		printf(
-			"ax, ay, az: %d, %d, %d\n",
-			(int)accs[0],
-			(int)accs[1],
-			(int)accs[2]);
-		vTaskDelay(100 / portTICK_PERIOD_MS);
+		sample.timestamp = hal_get_time_us();
+		// drops the sample if the transaction fails
+		if (adxl345_read_acceleration(spi, sample.accs) == HAL_OK) {
+			adxl345_push_samples(&sample, 1);
+		}
+		hal_delay_until(&wake_time, ADXL345_POLLING_PERIOD_MS);
 	}
 }
 
+#endif
+
+#if ADXL345_LOG_BINARY
+
+/** @brief Batch of samples to be encoded into a frame. */
+static sample_record adxl345_log_samples[SAMPLE_LOG_MAX_SAMPLES];
+
+/** @brief Frame to be written. */
+static uint8_t adxl345_log_frame[SAMPLE_LOG_MAX_FRAME_SIZE];
+
+/**
+ * @brief Switches the console UART to binary logging.
+ *
+ * Installs the UART driver so that frames are written in large chunks
+ * through the TX buffer, and raises the baud rate to
+ * `ADXL345_LOG_BAUD_RATE`.
+ * Do not print anything after calling this function.
+ */
+static void adxl345_configure_log_uart (void) {
+	esp_err_t ret;
+	printf("logging in binary at %u baud\n", (unsigned)ADXL345_LOG_BAUD_RATE);
+	ret = uart_wait_tx_done(ADXL345_LOG_UART, portMAX_DELAY);
+	ESP_ERROR_CHECK(ret);
+	ret = uart_driver_install(
+		ADXL345_LOG_UART,
+		256, // rx_buffer_size: has to be greater than the hardware FIFO.
+		ADXL345_LOG_TX_BUFFER_SIZE,
+		0, // queue_size
+		NULL, // uart_queue
+		0); // intr_alloc_flags
+	ESP_ERROR_CHECK(ret);
+	ret = uart_set_baudrate(ADXL345_LOG_UART, ADXL345_LOG_BAUD_RATE);
+	ESP_ERROR_CHECK(ret);
+}
+
+#if ADXL345_USE_CAPTURE
+
+/**
+ * @brief Writes the frozen capture of `::adxl345_capture_history`.
+ *
+ * Frames are encoded directly from the history, and the capture is
+ * released.
+ *
+ * @param[in,out] encoder
+ *
+ *   Encoder of frames.
+ */
+static void adxl345_log_capture (sample_log_encoder* encoder) {
+	const capture_record* capture = &adxl345_capture_history.capture;
+	const sample_record* samples;
+	uint32_t begin = capture->start;
+	size_t num_samples;
+	size_t frame_size;
+	while (begin != capture->end) {
+		num_samples = capture_history_peek(
+			&adxl345_capture_history,
+			begin,
+			capture->end,
+			&samples);
+		num_samples = MIN(num_samples, SAMPLE_LOG_MAX_SAMPLES);
+		encoder->num_dropped = adxl345_num_dropped_samples +
+			adxl345_capture_history.num_dropped;
+		encoder->num_overruns = adxl345_num_overruns;
+		frame_size = sample_log_encode(
+			encoder,
+			samples,
+			num_samples,
+			adxl345_log_frame);
+		uart_write_bytes(
+			ADXL345_LOG_UART,
+			(const char*)adxl345_log_frame,
+			frame_size);
+		begin += (uint32_t)num_samples;
+	}
+	capture_history_release(&adxl345_capture_history);
+}
+
+/**
+ * @brief Task that logs captures in binary frames.
+ *
+ * Pops samples from `::adxl345_sample_ring` into
+ * `::adxl345_capture_history`, and writes each capture when it is frozen.
+ * Samples are filtered with `::adxl345_filter_samples` as they are popped.
+ *
+ * @param[in] pvParameters
+ *
+ *   Not used.
+ */
+static void adxl345_log_captures_task (void* pvParameters) {
+	sample_log_encoder encoder = sample_log_encoder_initializer();
+	size_t num_popped;
+	size_t num_filtered;
+	size_t i;
+	while (1) {
+		num_popped = sample_ring_pop(
+			&adxl345_sample_ring,
+			adxl345_log_samples,
+			SAMPLE_LOG_MAX_SAMPLES);
+		if (num_popped == 0u) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+		num_filtered = adxl345_filter_samples(adxl345_log_samples, num_popped);
+		for (i = 0; i < num_filtered; ++i) {
+			if (capture_history_add(
+					&adxl345_capture_history,
+					&adxl345_log_samples[i]))
+			{
+				adxl345_log_capture(&encoder);
+			}
+		}
+	}
+}
+
+#else
+
+/**
+ * @brief Task that logs samples in binary frames.
+ *
+ * Pops samples from `::adxl345_sample_ring` until a frame is full,
+ * then writes the frame to `ADXL345_LOG_UART`.
+ * A partial frame is written if no sample comes within
+ * `ADXL345_LOG_FLUSH_TIMEOUT`.
+ * Samples are filtered with `::adxl345_filter_samples` as they are popped.
+ *
+ * @param[in] pvParameters
+ *
+ *   Not used.
+ */
+static void adxl345_log_samples_task (void* pvParameters) {
+	sample_log_encoder encoder = sample_log_encoder_initializer();
+	size_t num_samples = 0u;
+	size_t num_popped;
+	size_t frame_size;
+	while (1) {
+		num_popped = sample_ring_pop(
+			&adxl345_sample_ring,
+			adxl345_log_samples + num_samples,
+			SAMPLE_LOG_MAX_SAMPLES - num_samples);
+		num_samples += adxl345_filter_samples(
+			adxl345_log_samples + num_samples,
+			num_popped);
+		if (num_samples < SAMPLE_LOG_MAX_SAMPLES) {
+			if (num_popped > 0u) {
+				continue;
+			}
+			if ((ulTaskNotifyTake(pdTRUE, ADXL345_LOG_FLUSH_TIMEOUT) > 0u) ||
+				(num_samples == 0u))
+			{
+				continue;
+			}
+		}
+		encoder.num_dropped = adxl345_num_dropped_samples;
+		encoder.num_overruns = adxl345_num_overruns;
+		frame_size = sample_log_encode(
+			&encoder,
+			adxl345_log_samples,
+			num_samples,
+			adxl345_log_frame);
+		uart_write_bytes(
+			ADXL345_LOG_UART,
+			(const char*)adxl345_log_frame,
+			frame_size);
+		num_samples = 0u;
+	}
+}
+
+#endif
+
+#else
+
+#if ADXL345_USE_SPECTRUM
+
+/** @brief History of `::adxl345_consume_samples_task`'s spectra. */
+static int16_t adxl345_spectrum_history[SPECTRUM_HISTORY_SIZE(ADXL345_SPECTRUM_SIZE)];
+
+/** @brief Hann window of `::adxl345_consume_samples_task`'s spectra. */
+static float adxl345_spectrum_window[SPECTRUM_WINDOW_SIZE(ADXL345_SPECTRUM_SIZE)];
+
+/** @brief Twiddle factors of `::adxl345_consume_samples_task`'s spectra. */
+static float adxl345_spectrum_twiddles[SPECTRUM_TWIDDLES_SIZE(ADXL345_SPECTRUM_SIZE)];
+
+/** @brief Work buffer of `::adxl345_consume_samples_task`'s spectra. */
+static float adxl345_spectrum_work[SPECTRUM_WORK_SIZE(ADXL345_SPECTRUM_SIZE)];
+
+/** @brief Magnitudes of `::adxl345_consume_samples_task`'s spectra. */
+static float adxl345_spectrum_magnitudes[SPECTRUM_MAGNITUDES_SIZE(ADXL345_SPECTRUM_SIZE)];
+
+#endif
+
+#if ADXL345_USE_CAPTURE
+
+/**
+ * @brief Prints a summary of the frozen capture of
+ * `::adxl345_capture_history`, and releases it.
+ *
+ * The summary consists of the time of the trigger, numbers of samples
+ * before and from the trigger, and the peak squared magnitude.
+ */
+static void adxl345_report_capture (void) {
+	const capture_record* capture = &adxl345_capture_history.capture;
+	const sample_record* samples;
+	uint32_t begin = capture->start;
+	uint64_t peak = 0u;
+	uint64_t squared;
+	size_t num_samples;
+	size_t i;
+	int axis;
+	while (begin != capture->end) {
+		num_samples = capture_history_peek(
+			&adxl345_capture_history,
+			begin,
+			capture->end,
+			&samples);
+		for (i = 0; i < num_samples; ++i) {
+			squared = 0u;
+			for (axis = 0; axis < 3; ++axis) {
+				squared += (uint64_t)(
+					(int32_t)samples[i].accs[axis] * samples[i].accs[axis]);
+			}
+			peak = MAX(peak, squared);
+		}
+		begin += (uint32_t)num_samples;
+	}
+	capture_history_peek(
+		&adxl345_capture_history,
+		capture->trigger,
+		capture->end,
+		&samples);
+	printf(
+		"capture at %lld us: pre %u, post %u, peak^2 %llu\n",
+		(long long)samples[0].timestamp,
+		(unsigned)(capture->trigger - capture->start),
+		(unsigned)(capture->end - capture->trigger),
+		(unsigned long long)peak);
+	capture_history_release(&adxl345_capture_history);
+}
+
+#endif
+
+/**
+ * @brief Reports the statistics of the SPI bus.
+ *
+ * Latencies are times that transactions wait for the bus.
+ */
+static void adxl345_report_bus (void) {
+	const uint32_t utilization = spi_bus_manager_utilization(&adxl345_spi_bus);
+	spi_bus_device_stats stats;
+	spi_bus_manager_get_stats(&adxl345_spi_bus, NULL, &stats);
+	printf(
+		"bus: transactions %u, utilization %u.%u%%, latency (us): mean %.1f, max %lld\n",
+		(unsigned)stats.num_transactions,
+		(unsigned)(utilization / 10u),
+		(unsigned)(utilization % 10u),
+		(stats.num_transactions > 0u) ?
+			(double)stats.total_latency_us / stats.num_transactions :
+			0.0,
+		(long long)stats.max_latency_us);
+}
+
+/**
+ * @brief Task that consumes samples.
+ *
+ * Pops samples from `::adxl345_sample_ring` in batches, and reports
+ * the number of samples received, overruns, drops and statistics of
+ * intervals between timestamps (jitter) every second with the latest
+ * sample, instead of printing every sample.
+ * Samples are filtered with `::adxl345_filter_samples` as they are popped.
+ * Peaks of spectra are also reported if `ADXL345_USE_SPECTRUM` is `1`,
+ * and each capture if `ADXL345_USE_CAPTURE` is `1`.
+ * Sleeps while the ring buffer is empty.
+ *
+ * @param[in] pvParameters
+ *
+ *   Not used.
+ */
+static void adxl345_consume_samples_task (void* pvParameters) {
+	sample_record samples[ADXL345_CONSUMER_BATCH_SIZE];
+	sample_record last_sample = { .timestamp = 0, .accs = { 0, 0, 0 } };
+	interval_stats intervals = interval_stats_initializer();
+	int has_last_sample = 0;
+	uint32_t num_samples = 0u;
+	size_t num_popped;
+	size_t num_filtered;
+	size_t i;
+	TickType_t last_report = xTaskGetTickCount();
+#if ADXL345_USE_SPECTRUM
+	spectrum spectrum = spectrum_initializer(
+		ADXL345_SPECTRUM_SIZE,
+		adxl345_consumer_rate_millihz(),
+		adxl345_spectrum_history,
+		adxl345_spectrum_window,
+		adxl345_spectrum_twiddles,
+		adxl345_spectrum_work,
+		adxl345_spectrum_magnitudes);
+	spectrum_peak peaks[ADXL345_SPECTRUM_NUM_PEAKS];
+	size_t num_peaks;
+	size_t j;
+	int has_spectrum = 0;
+	spectrum_init(&spectrum);
+#endif
+	while (1) {
+		num_popped = sample_ring_pop(
+			&adxl345_sample_ring,
+			samples,
+			ADXL345_CONSUMER_BATCH_SIZE);
+		if (num_popped > 0u) {
+			num_filtered = adxl345_filter_samples(samples, num_popped);
+			for (i = 0; i < num_filtered; ++i) {
+				if (has_last_sample) {
+					interval_stats_add(
+						&intervals,
+						samples[i].timestamp - last_sample.timestamp);
+				}
+				last_sample = samples[i];
+				has_last_sample = 1;
+#if ADXL345_USE_SPECTRUM
+				has_spectrum |= spectrum_add(&spectrum, &samples[i]);
+#endif
+#if ADXL345_USE_CAPTURE
+				if (capture_history_add(&adxl345_capture_history, &samples[i])) {
+					adxl345_report_capture();
+				}
+#endif
+			}
+			num_samples += (uint32_t)num_filtered;
+		} else {
+			ulTaskNotifyTake(pdTRUE, ADXL345_REPORT_INTERVAL);
+		}
+		if ((xTaskGetTickCount() - last_report) >= ADXL345_REPORT_INTERVAL) {
+			printf(
+				"samples: %u, captures: %u, overruns: %u, dropped: %u, ax, ay, az: %d, %d, %d\n",
+				(unsigned)num_samples,
+				(unsigned)adxl345_num_captures,
+				(unsigned)adxl345_num_overruns,
+				(unsigned)adxl345_num_dropped_samples,
+				(int)last_sample.accs[0],
+				(int)last_sample.accs[1],
+				(int)last_sample.accs[2]);
+			printf(
+				"interval (us): min %lld, max %lld, mean %.1f, stddev %.1f\n",
+				(long long)intervals.min,
+				(long long)intervals.max,
+				interval_stats_mean(&intervals),
+				interval_stats_stddev(&intervals));
+			adxl345_report_bus();
+#if ADXL345_USE_DSP
+			for (i = 0; i < 3; ++i) {
+				printf(
+					"%c: mean %d, rms %u, peak %u\n",
+					"xyz"[i],
+					(int)adxl345_dsp_features[i].mean,
+					(unsigned)adxl345_dsp_features[i].rms,
+					(unsigned)adxl345_dsp_features[i].peak);
+			}
+#endif
+#if ADXL345_USE_SPECTRUM
+			for (i = 0; has_spectrum && (i < 3); ++i) {
+				num_peaks = spectrum_find_peaks(
+					&spectrum,
+					(int)i,
+					peaks,
+					ADXL345_SPECTRUM_NUM_PEAKS);
+				printf("%c peaks (Hz, LSB):", "xyz"[i]);
+				for (j = 0; j < num_peaks; ++j) {
+					printf(
+						" %.1f %.1f",
+						(double)peaks[j].frequency,
+						(double)peaks[j].magnitude);
+				}
+				printf("\n");
+			}
+#endif
+			interval_stats_reset(&intervals);
+			num_samples = 0u;
+			last_report += ADXL345_REPORT_INTERVAL;
+		}
+	}
+}
+
+#endif
+
 void app_main (void) {
     esp_err_t ret;
-    spi_device_handle_t spi;
-    spi_bus_config_t buscfg = {
-        .miso_io_num = PIN_NUM_MISO,
-        .mosi_io_num = PIN_NUM_MOSI,
-        .sclk_io_num = PIN_NUM_CLK,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1
-    };
-    spi_device_interface_config_t devcfg = {
-		.clock_speed_hz = 1000000, // 1Mbps. nearest clock will be chosen.
-        .mode = 3, // CPOL=1, CPHA=1
-        .spics_io_num = PIN_NUM_CS,
+    hal_spi_device spi;
+    hal_spi_device_config devcfg = {
+		.cs_pin = PIN_NUM_CS,
+		.clock_speed_hz = 0, // chosen for ADXL345_CONFIG below.
+		.mode = 3, // CPOL=1, CPHA=1
 		.command_bits = 8, // ADXL345 always takes 1+7 bit command (address).
+#if ADXL345_USE_FIFO
+		.queue_size = ADXL345_MAX_FIFO_ENTRIES // reads the entire FIFO at once.
+#else
         .queue_size = 1 // I do not know an appropriate size.
+#endif
     };
-    // initializes the SPI bus
-    ret = spi_bus_initialize(ADXL_HOST, &buscfg, DMA_CHAN);
-    ESP_ERROR_CHECK(ret);
-    // attaches the ADXL to the SPI bus
-    ret = spi_bus_add_device(ADXL_HOST, &devcfg, &spi);
-    ESP_ERROR_CHECK(ret);
+#if ADXL345_USE_FIFO
+	const uint32_t watermark = ADXL345_FIFO_WATERMARK;
+#else
+	const uint32_t watermark = 0u;
+#endif
+	// nearest clock will be chosen
+	devcfg.clock_speed_hz = adxl345_spi_clock_hz(&ADXL345_CONFIG, watermark);
+	// attaches the ADXL to the SPI bus
+	ret = spi_bus_manager_add_device(
+		&adxl345_spi_bus,
+		&devcfg,
+		ADXL345_BUS_RANK,
+		&spi);
+	ESP_ERROR_CHECK(ret);
+	// initializes the SPI bus
+	ret = spi_bus_manager_start(&adxl345_spi_bus);
+	ESP_ERROR_CHECK(ret);
     // initializes the ADXL
     adxl345_init(spi);
+	ret = adxl345_configure(spi, &ADXL345_CONFIG);
+	ESP_ERROR_CHECK(ret);
+	adxl345_print_config(&ADXL345_CONFIG, watermark, devcfg.clock_speed_hz);
+#if ADXL345_USE_CAPTURE
+	printf(
+		"capture history: %u samples, %u bytes\n",
+		(unsigned)capture_history_capacity(&adxl345_capture_history),
+		(unsigned)capture_history_footprint(&adxl345_capture_history));
+#endif
+	// consumes samples
+#if ADXL345_LOG_BINARY
+	adxl345_configure_log_uart();
+#if ADXL345_USE_CAPTURE
+	xTaskCreate(
+		adxl345_log_captures_task,
+		"adxl345_log_captures_task",
+		2048u, // usStackDepth
+		NULL, // pvParameters
+		5, // uxPriority: lower than the reader task.
+		&adxl345_consumer_task_handle); // pvCreatedTask
+#else
+	xTaskCreate(
+		adxl345_log_samples_task,
+		"adxl345_log_samples_task",
+		2048u, // usStackDepth
+		NULL, // pvParameters
+		5, // uxPriority: lower than the reader task.
+		&adxl345_consumer_task_handle); // pvCreatedTask
+#endif
+#else
+	xTaskCreate(
+		adxl345_consume_samples_task,
+		"adxl345_consume_samples_task",
+		4096u, // usStackDepth: holds a batch of samples.
+		NULL, // pvParameters
+		5, // uxPriority: lower than the reader task.
+		&adxl345_consumer_task_handle); // pvCreatedTask
+#endif
+#if ADXL345_USE_FIFO
+	adxl345_configure_fifo(spi, ADXL345_FIFO_WATERMARK);
+#if ADXL345_USE_EVENTS
+	adxl345_configure_events(spi);
+	// starts sampling
+	adxl345_start(spi);
+	// the event task has to be the only user of `spi` from now on
+	xTaskCreate(
+		adxl345_event_task,
+		"adxl345_event_task",
+		4096u, // usStackDepth: holds samples of the entire FIFO.
+		(void*)spi, // pvParameters
+		10, // uxPriority: higher than the consumer not to miss samples.
+		&adxl345_fifo_task_handle); // pvCreatedTask
+#else
+	// starts sampling
+	adxl345_start(spi);
+	// the FIFO task has to be the only user of `spi` from now on
+	xTaskCreate(
+		adxl345_fifo_task,
+		"adxl345_fifo_task",
+		4096u, // usStackDepth: holds samples of the entire FIFO.
+		(void*)spi, // pvParameters
+		10, // uxPriority: higher than the consumer not to miss samples.
+		&adxl345_fifo_task_handle); // pvCreatedTask
+#endif
+	adxl345_configure_int1();
+#else
 	// starts sampling
 	adxl345_start(spi);
 	// periodically reads acceleration
@@ -281,6 +1274,7 @@ void app_main (void) {
 		// DO NOT pass `&spi` because the task function would be executed
 		// after this function finishes; i.e., &spi would be corrupted.
 		(void*)spi, // pvParameters.
-		5, // uxPriority: I do not know an appropriate priority.
+		10, // uxPriority: higher than the consumer.
 		0); // pvCreatedTask
+#endif
 }
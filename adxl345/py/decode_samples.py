@@ -0,0 +1,242 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+
+import argparse
+import binascii
+import logging
+import struct
+import sys
+import numpy as np
+
+
+LOGGER = logging.getLogger(__name__)
+
+SYNC = b'\xA5\x5A'
+"""Sync bytes at the beginning of a frame."""
+
+VERSION = 1
+"""Same as ``SAMPLE_LOG_VERSION`` in ``main/sample_log.h``."""
+
+HEADER = struct.Struct('<2sBBHHIqIII')
+"""Layout of a frame header."""
+
+CRC_SIZE = 2
+"""Size of a CRC in bytes."""
+
+MAX_SAMPLES = 256
+"""Same as ``SAMPLE_LOG_MAX_SAMPLES`` in ``main/sample_log.h``."""
+
+MAX_PAYLOAD_SIZE = 6 + (MAX_SAMPLES - 1) * 9
+"""Maximum size of a payload in bytes."""
+
+SAMPLE_DTYPE = np.dtype([
+    ('timestamp', np.int64),
+    ('ax', np.int16),
+    ('ay', np.int16),
+    ('az', np.int16),
+])
+"""Type of a decoded sample."""
+
+
+def crc16(data):
+    """Calculates CRC-16/CCITT-FALSE of given bytes.
+
+    :param data: bytes.
+    :type data: bytes
+
+    :return: CRC of ``data``.
+    :rtype: int
+    """
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def decode_payload(payload, num_samples):
+    """Decodes the payload of a frame.
+
+    :param payload: payload of a frame.
+    :type payload: bytes
+
+    :param num_samples: number of samples in the payload.
+    :type num_samples: int
+
+    :return: ``(num_samples, 3)`` array of accelerations.
+    :rtype: numpy.ndarray
+
+    :raises ValueError: if the payload is inconsistent.
+    """
+    if len(payload) < 6:
+        raise ValueError('payload too short')
+    accs = np.empty((num_samples, 3), dtype=np.int16)
+    previous = list(struct.unpack_from('<3h', payload))
+    accs[0] = previous
+    pos = 6
+    for i in range(1, num_samples):
+        for axis in range(3):
+            zigzag = 0
+            shift = 0
+            while True:
+                if pos >= len(payload):
+                    raise ValueError('payload truncated')
+                byte = payload[pos]
+                pos += 1
+                zigzag |= (byte & 0x7F) << shift
+                shift += 7
+                if (byte & 0x80) == 0:
+                    break
+            delta = (zigzag >> 1) ^ -(zigzag & 1)
+            value = (previous[axis] + delta + 0x8000) % 0x10000 - 0x8000
+            previous[axis] = value
+            accs[i, axis] = value
+    if pos != len(payload):
+        raise ValueError('payload has extra bytes')
+    return accs
+
+
+def decode_frames(data):
+    """Decodes frames in a given stream.
+
+    Bytes that do not form a valid frame, e.g., boot messages, are skipped.
+
+    :param data: captured stream.
+    :type data: bytes
+
+    :return: list of ``(header, samples)`` where ``header`` is a dict and
+             ``samples`` is an array of ``SAMPLE_DTYPE``.
+    :rtype: list
+    """
+    frames = []
+    pos = 0
+    num_skipped = 0
+    while True:
+        start = data.find(SYNC, pos)
+        if start < 0:
+            num_skipped += len(data) - pos
+            break
+        num_skipped += start - pos
+        pos = start + 1  # skips the sync bytes if the frame is invalid
+        if start + HEADER.size > len(data):
+            num_skipped += len(data) - start
+            break
+        (_, version, _, num_samples, payload_size, sequence, timestamp,
+         span, num_dropped, num_overruns) = HEADER.unpack_from(data, start)
+        if (version != VERSION) or not (1 <= num_samples <= MAX_SAMPLES) or \
+                (payload_size > MAX_PAYLOAD_SIZE):
+            continue
+        end = start + HEADER.size + payload_size
+        if end + CRC_SIZE > len(data):
+            continue
+        crc, = struct.unpack_from('<H', data, end)
+        if crc != crc16(data[start + 2:end]):
+            LOGGER.debug('CRC mismatch at %d', start)
+            continue
+        try:
+            accs = decode_payload(
+                data[start + HEADER.size:end], num_samples)
+        except ValueError as e:
+            LOGGER.debug('invalid payload at %d: %s', start, e)
+            continue
+        samples = np.empty(num_samples, dtype=SAMPLE_DTYPE)
+        # samples are evenly spaced in a frame
+        samples['timestamp'] = timestamp + \
+            np.arange(num_samples) * span // max(num_samples - 1, 1)
+        samples['ax'] = accs[:, 0]
+        samples['ay'] = accs[:, 1]
+        samples['az'] = accs[:, 2]
+        frames.append(({
+            'sequence': sequence,
+            'num_dropped': num_dropped,
+            'num_overruns': num_overruns,
+        }, samples))
+        pos = end + CRC_SIZE
+    if num_skipped > 0:
+        LOGGER.info('skipped %d byte(s)', num_skipped)
+    return frames
+
+
+def check_frames(frames):
+    """Reports gaps in given frames.
+
+    A gap of sequence numbers means frames lost on the link,
+    and an increase of dropped samples or overruns means samples lost
+    on the device.
+
+    :param frames: frames returned by ``decode_frames``.
+    :type frames: list
+    """
+    for (previous, _), (current, _) in zip(frames, frames[1:]):
+        lost = (current['sequence'] - previous['sequence'] - 1) & 0xFFFFFFFF
+        if lost > 0:
+            LOGGER.warning(
+                'lost %d frame(s) before sequence %d',
+                lost, current['sequence'])
+        dropped = current['num_dropped'] - previous['num_dropped']
+        overruns = current['num_overruns'] - previous['num_overruns']
+        if (dropped > 0) or (overruns > 0):
+            LOGGER.warning(
+                'device dropped %d sample(s) and overran %d time(s)'
+                ' before sequence %d',
+                dropped, overruns, current['sequence'])
+
+
+def concatenate_samples(frames):
+    """Concatenates samples in given frames.
+
+    :param frames: frames returned by ``decode_frames``.
+    :type frames: list
+
+    :return: array of ``SAMPLE_DTYPE``.
+    :rtype: numpy.ndarray
+    """
+    if len(frames) == 0:
+        return np.empty(0, dtype=SAMPLE_DTYPE)
+    return np.concatenate([samples for _, samples in frames])
+
+
+def write_csv(out, samples):
+    """Writes given samples in CSV.
+
+    :param out: output text stream.
+    :type out: io.TextIOBase
+
+    :param samples: array of ``SAMPLE_DTYPE``.
+    :type samples: numpy.ndarray
+    """
+    out.write('timestamp_us,ax,ay,az\n')
+    for sample in samples:
+        out.write('%d,%d,%d,%d\n' % tuple(sample))
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO)
+    arg_parser = argparse.ArgumentParser(
+        description='Decode binary sample frames logged by the ADXL345'
+                    ' program')
+    arg_parser.add_argument(
+        'input_path', metavar='INPUT', type=str,
+        help='path to a captured stream, or - to read the standard input')
+    arg_parser.add_argument(
+        '--format', dest='format', choices=['csv', 'npy'], default='csv',
+        help='output format (default: csv)')
+    arg_parser.add_argument(
+        '-o', '--output', dest='output', type=str, default=None,
+        help='path to an output file (default: standard output for csv)')
+    args = arg_parser.parse_args()
+    if args.input_path == '-':
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.input_path, 'rb') as f:
+            data = f.read()
+    frames = decode_frames(data)
+    check_frames(frames)
+    samples = concatenate_samples(frames)
+    LOGGER.info('decoded %d frame(s), %d sample(s)', len(frames), len(samples))
+    if args.format == 'npy':
+        if args.output is None:
+            arg_parser.error('--output is necessary for npy')
+        np.save(args.output, samples)
+    elif args.output is not None:
+        with open(args.output, 'w') as out:
+            write_csv(out, samples)
+    else:
+        write_csv(sys.stdout, samples)
@@ -0,0 +1,202 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Reference of the fixed-point stages in ``main/dsp.c``.
+
+Every function reproduces the integer arithmetic of its counterpart bit by
+bit, so that streams processed on the device can be checked or replayed
+off the device. Only the standard library is needed.
+
+Values are Python ``int`` s; wrapping and truncation of C types are
+explicit.
+"""
+
+import math
+
+
+BIQUAD_SHIFT = 14
+"""Same as ``DSP_BIQUAD_SHIFT`` in ``main/dsp.h``."""
+
+CIC_MAX_ORDER = 4
+"""Same as ``DSP_CIC_MAX_ORDER`` in ``main/dsp.h``."""
+
+FIRMWARE_BIQUADS = [
+    (0.9565432255568768, -1.9130864511137535, 0.9565432255568768,
+     -1.9111970674260732, 0.9149758348014339),
+    (0.6389455251590224, 1.2778910503180447, 0.6389455251590224,
+     1.1429805025399007, 0.41280159809618855),
+]
+"""Same as ``ADXL345_DSP_BIQUADS`` in ``main/spi_adxl345_main.c``;
+2Hz high-pass and 80Hz low-pass at 200Hz as ``(b0, b1, b2, a1, a2)``."""
+
+
+def to_int16(x):
+    """Wraps an integer around as a cast to ``int16_t``.
+
+    :param x: integer.
+    :type x: int
+
+    :return: ``x`` modulo ``2^16`` in ``[-2^15, 2^15)``.
+    :rtype: int
+    """
+    return ((x + 0x8000) & 0xFFFF) - 0x8000
+
+
+def to_int32(x):
+    """Wraps an integer around as a cast to ``int32_t``.
+
+    :param x: integer.
+    :type x: int
+
+    :return: ``x`` modulo ``2^32`` in ``[-2^31, 2^31)``.
+    :rtype: int
+    """
+    return ((x + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+
+
+def saturate_int16(x):
+    """Clamps an integer into ``int16_t``.
+
+    :param x: integer.
+    :type x: int
+
+    :return: ``x`` clamped from ``-2^15`` to ``2^15 - 1``.
+    :rtype: int
+    """
+    return max(-0x8000, min(0x7FFF, x))
+
+
+def q14(x):
+    """Converts a real number into a biquad coefficient as
+    ``DSP_BIQUAD_Q14`` does.
+
+    :param x: real number in ``[-2.0, 2.0)``.
+    :type x: float
+
+    :return: ``x`` in Q2.14 rounded half away from zero.
+    :rtype: int
+    """
+    # the cast in C truncates toward zero, as int does
+    return to_int16(int(x * (1 << BIQUAD_SHIFT) + (-0.5 if x < 0 else 0.5)))
+
+
+def biquad(coefficients, xs):
+    """Filters values with a biquad filter as ``dsp_biquad_process`` does.
+
+    :param coefficients: ``(b0, b1, b2, a1, a2)`` in Q2.14.
+    :type coefficients: tuple
+
+    :param xs: ``int16_t`` input values.
+    :type xs: iterable
+
+    :return: ``int16_t`` output values, one per input.
+    :rtype: list
+    """
+    b0, b1, b2, a1, a2 = coefficients
+    x1 = x2 = y1 = y2 = 0
+    ys = []
+    for x in xs:
+        acc = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2
+        # >> floors as the arithmetic shift of int64_t does
+        y = saturate_int16((acc + (1 << (BIQUAD_SHIFT - 1))) >> BIQUAD_SHIFT)
+        x2, x1 = x1, x
+        y2, y1 = y1, y
+        ys.append(y)
+    return ys
+
+
+def biquad_cascade(stages, xs):
+    """Filters values with cascaded biquad filters as
+    ``dsp_biquad_cascade_process`` does.
+
+    :param stages: coefficients of filters in Q2.14 applied in order.
+    :type stages: list
+
+    :param xs: ``int16_t`` input values.
+    :type xs: iterable
+
+    :return: ``int16_t`` output values, one per input.
+    :rtype: list
+    """
+    ys = list(xs)
+    for coefficients in stages:
+        ys = biquad(coefficients, ys)
+    return ys
+
+
+def cic(order, log2_factor, xs):
+    """Decimates values with a CIC decimator as ``dsp_cic_process`` does.
+
+    :param order: number of integrators and combs, from ``1`` to
+                  ``CIC_MAX_ORDER``.
+    :type order: int
+
+    :param log2_factor: log2 of the decimation factor, at most ``15``.
+                        ``order * log2_factor`` must not exceed ``16``.
+    :type log2_factor: int
+
+    :param xs: ``int16_t`` input values.
+    :type xs: iterable
+
+    :return: ``int16_t`` output values, one every ``2^log2_factor`` inputs.
+    :rtype: list
+
+    :raises ValueError: if the parameters are out of range.
+    """
+    if not (1 <= order <= CIC_MAX_ORDER and 0 <= log2_factor <= 15 and
+            order * log2_factor <= 16):
+        raise ValueError('order %d and log2_factor %d out of range' % (
+            order, log2_factor))
+    integrators = [0] * order
+    combs = [0] * order
+    phase = 0
+    ys = []
+    for x in xs:
+        # uint32_t wraps around
+        value = x & 0xFFFFFFFF
+        for i in range(order):
+            integrators[i] = (integrators[i] + value) & 0xFFFFFFFF
+            value = integrators[i]
+        phase += 1
+        if phase < (1 << log2_factor):
+            continue
+        phase = 0
+        for i in range(order):
+            previous = combs[i]
+            combs[i] = value
+            value = (value - previous) & 0xFFFFFFFF
+        ys.append(to_int16(to_int32(value) >> (order * log2_factor)))
+    return ys
+
+
+def window(length, xs):
+    """Calculates features of windows as ``dsp_window_add`` does.
+
+    :param length: number of values in a window, from ``1`` to ``65536``.
+    :type length: int
+
+    :param xs: ``int16_t`` input values.
+    :type xs: iterable
+
+    :return: ``(mean, rms, peak)`` of every complete window. An incomplete
+             window at the end is dropped.
+    :rtype: list
+
+    :raises ValueError: if ``length`` is out of range.
+    """
+    if not 1 <= length <= 65536:
+        raise ValueError('length %d out of range' % length)
+    features = []
+    count = total = sum_squares = peak = 0
+    for x in xs:
+        total += x
+        sum_squares += x * x
+        peak = max(peak, abs(x))
+        count += 1
+        if count < length:
+            continue
+        # the division in C truncates toward zero
+        mean = abs(total) // length * (-1 if total < 0 else 1)
+        features.append((mean, math.isqrt(sum_squares // length), peak))
+        count = total = sum_squares = peak = 0
+    return features
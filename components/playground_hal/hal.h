@@ -0,0 +1,550 @@
+#ifndef _HAL_H
+#define _HAL_H
+
+/**
+ * @file hal.h
+ *
+ * Thin hardware abstraction layer shared by the projects.
+ *
+ * Drivers talk to SPI devices and GPIO pins, wait and read the time only
+ * through this interface, so that they also run on Linux.
+ * There are two backends.
+ * - `hal_esp_idf.c`: ESP-IDF. Every function forwards to the ESP-IDF API,
+ *   and types are those of ESP-IDF.
+ * - `hal_linux.c`: Linux. Transactions are recorded, time is simulated,
+ *   and inputs are driven by `hal_linux.h`.
+ *
+ * `::hal_spi_bus_init` and `::hal_spi_bus_add_device` set up an SPI bus and
+ * devices. On Linux, `::hal_linux_add_spi_device` also adds a device with
+ * a custom timing.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "driver/spi_master.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Error code.
+ *
+ * Same as `esp_err_t`; `0` is success.
+ */
+typedef int hal_err_t;
+
+/** @brief Success. Same as `ESP_OK`. */
+#define HAL_OK  0
+
+/** @brief Error: timed out. Same as `ESP_ERR_TIMEOUT`. */
+#define HAL_ERR_TIMEOUT  0x107
+
+/** @brief Error: a device responded unexpectedly. Same as `ESP_ERR_INVALID_RESPONSE`. */
+#define HAL_ERR_INVALID_RESPONSE  0x108
+
+/** @brief Timeout of `::hal_task_wait_notification` that never expires. */
+#define HAL_WAIT_FOREVER  UINT32_MAX
+
+#ifdef ESP_PLATFORM
+/** @brief Places a function called in an ISR in IRAM. */
+#define HAL_ISR_ATTR  IRAM_ATTR
+/** @brief Places a variable in DMA-capable memory. */
+#define HAL_DMA_ATTR  DMA_ATTR
+/**
+ * @brief Aborts if a given expression does not evaluate to `HAL_OK`.
+ *
+ * Same as `ESP_ERROR_CHECK`.
+ */
+#define HAL_ERROR_CHECK(x)  ESP_ERROR_CHECK(x)
+#else
+/** @brief Places a function called in an ISR in IRAM. */
+#define HAL_ISR_ATTR
+/** @brief Places a variable in DMA-capable memory. */
+#define HAL_DMA_ATTR
+/**
+ * @brief Aborts if a given expression does not evaluate to `HAL_OK`.
+ *
+ * Same as `ESP_ERROR_CHECK`.
+ */
+#define HAL_ERROR_CHECK(x) \
+	do { \
+		const hal_err_t hal_err_ = (x); \
+		if (hal_err_ != HAL_OK) { \
+			hal_error_check_failed(hal_err_, __FILE__, __LINE__, #x); \
+		} \
+	} while (0)
+#endif
+
+#ifdef ESP_PLATFORM
+
+/** @brief Handle of an SPI device. */
+typedef spi_device_handle_t hal_spi_device;
+
+/** @brief SPI transaction. */
+typedef spi_transaction_t hal_spi_transaction;
+
+/** @brief Transaction flag: transmits `tx_data` instead of `tx_buffer`. */
+#define HAL_SPI_USE_TXDATA  SPI_TRANS_USE_TXDATA
+/** @brief Transaction flag: receives in `rx_data` instead of `rx_buffer`. */
+#define HAL_SPI_USE_RXDATA  SPI_TRANS_USE_RXDATA
+
+/** @brief Handle of a task. */
+typedef TaskHandle_t hal_task;
+
+#else
+
+/** @brief Handle of an SPI device. */
+typedef struct hal_spi_device_t* hal_spi_device;
+
+/**
+ * @brief SPI transaction.
+ *
+ * Has the same fields as `spi_transaction_t` of ESP-IDF that the drivers
+ * use.
+ */
+typedef struct hal_spi_transaction_t {
+	/** @brief Flags; `HAL_SPI_USE_*`. */
+	uint32_t flags;
+	/** @brief Command in the bits specified for the device. */
+	uint16_t cmd;
+	/** @brief Length of data in bits. */
+	size_t length;
+	/** @brief Length of received data in bits. Not used. */
+	size_t rxlength;
+	/** @brief Free for the user. */
+	void* user;
+	union {
+		/** @brief Data to transmit. */
+		const void* tx_buffer;
+		/** @brief Data to transmit if `HAL_SPI_USE_TXDATA`. */
+		uint8_t tx_data[4];
+	};
+	union {
+		/** @brief Buffer to receive data. */
+		void* rx_buffer;
+		/** @brief Received data if `HAL_SPI_USE_RXDATA`. */
+		uint8_t rx_data[4];
+	};
+} hal_spi_transaction;
+
+/** @brief Transaction flag: transmits `tx_data` instead of `tx_buffer`. */
+#define HAL_SPI_USE_TXDATA  0x08u
+/** @brief Transaction flag: receives in `rx_data` instead of `rx_buffer`. */
+#define HAL_SPI_USE_RXDATA  0x04u
+
+/**
+ * @brief Handle of a task.
+ *
+ * There is only one task on Linux, which also runs the tasks scheduled by
+ * `::hal_linux_schedule`.
+ */
+typedef struct hal_task_t* hal_task;
+
+/**
+ * @brief Reports a failure of `HAL_ERROR_CHECK` and aborts.
+ *
+ * @param[in] err
+ *
+ *   Error.
+ *
+ * @param[in] file
+ *
+ *   Source file of the check.
+ *
+ * @param[in] line
+ *
+ *   Line of the check.
+ *
+ * @param[in] expression
+ *
+ *   Expression that failed.
+ */
+void hal_error_check_failed (
+		hal_err_t err,
+		const char* file,
+		int line,
+		const char* expression);
+
+#endif
+
+/**
+ * @brief Edge that triggers a GPIO interrupt.
+ */
+typedef enum hal_gpio_edge_t {
+	/** @brief Rising edge. */
+	HAL_GPIO_RISING_EDGE = 0,
+	/** @brief Falling edge. */
+	HAL_GPIO_FALLING_EDGE
+} hal_gpio_edge;
+
+/**
+ * @brief Handler of a GPIO interrupt.
+ *
+ * @param[in] arg
+ *
+ *   Argument given to `::hal_gpio_set_isr`.
+ */
+typedef void (*hal_gpio_isr)(void* arg);
+
+/**
+ * @brief Configuration of an SPI bus.
+ */
+typedef struct hal_spi_bus_config_t {
+	/** @brief SPI host; `spi_host_device_t` on ESP-IDF. */
+	int host;
+	/** @brief GPIO# for MOSI. */
+	int mosi_pin;
+	/** @brief GPIO# for MISO. */
+	int miso_pin;
+	/** @brief GPIO# for SCLK. */
+	int clk_pin;
+	/** @brief Maximum length of a transaction in bytes. `0` for the default. */
+	int max_transfer_size;
+	/** @brief DMA channel. `0` does not use DMA. */
+	int dma_channel;
+} hal_spi_bus_config;
+
+/**
+ * @brief Receives the timing of an SPI transaction.
+ *
+ * Called once for every transaction of a device.
+ * Runs in an ISR on ESP-IDF.
+ *
+ * @param[in] arg
+ *
+ *   `arg` of the `::hal_spi_device_config`.
+ *
+ * @param[in] queued_us
+ *
+ *   Time when the transaction was queued or transmitted in microseconds.
+ *
+ * @param[in] start_us
+ *
+ *   Time when the transaction started on the bus in microseconds.
+ *
+ * @param[in] end_us
+ *
+ *   Time when the transaction ended in microseconds.
+ */
+typedef void (*hal_spi_timing_callback)(
+		void* arg,
+		int64_t queued_us,
+		int64_t start_us,
+		int64_t end_us);
+
+/**
+ * @brief Configuration of an SPI device.
+ */
+typedef struct hal_spi_device_config_t {
+	/** @brief GPIO# for CS. */
+	int cs_pin;
+	/** @brief SPI clock in Hz. */
+	int clock_speed_hz;
+	/** @brief SPI mode (0-3). */
+	int mode;
+	/** @brief Number of bits of a command. */
+	int command_bits;
+	/** @brief Maximum number of transactions waiting in the queue. */
+	int queue_size;
+	/** @brief Receives the timing of transactions. May be `NULL`. */
+	hal_spi_timing_callback on_transaction;
+	/** @brief Passed to `on_transaction`. */
+	void* arg;
+} hal_spi_device_config;
+
+/**
+ * @brief Maximum number of devices that `::hal_spi_bus_add_device` adds.
+ *
+ * Same as the number of CS lines of an ESP32 SPI host.
+ */
+#define HAL_SPI_MAX_DEVICES  3
+
+/**
+ * @brief Initializes an SPI bus.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the bus.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_spi_bus_init (const hal_spi_bus_config* config);
+
+/**
+ * @brief Adds a device to an SPI bus.
+ *
+ * When transactions of more than one device are waiting, the device added
+ * earlier goes first. A transaction in progress is never interrupted.
+ *
+ * @param[in] bus
+ *
+ *   Configuration of the bus given to `::hal_spi_bus_init`.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the device.
+ *
+ * @param[out] device
+ *
+ *   Receives the handle of the device.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_spi_bus_add_device (
+		const hal_spi_bus_config* bus,
+		const hal_spi_device_config* config,
+		hal_spi_device* device);
+
+/**
+ * @brief Transmits an SPI transaction, and blocks until it ends.
+ *
+ * Like `spi_device_polling_transmit`.
+ *
+ * @param[in] spi
+ *
+ *   SPI device.
+ *
+ * @param[in,out] trans
+ *
+ *   Transaction.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_spi_transmit (hal_spi_device spi, hal_spi_transaction* trans);
+
+/**
+ * @brief Queues an SPI transaction.
+ *
+ * Like `spi_device_queue_trans` without timeout.
+ * `trans` must live until it is returned from `::hal_spi_get_result`.
+ *
+ * @param[in] spi
+ *
+ *   SPI device.
+ *
+ * @param[in,out] trans
+ *
+ *   Transaction.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_spi_queue (hal_spi_device spi, hal_spi_transaction* trans);
+
+/**
+ * @brief Waits for a queued SPI transaction to end.
+ *
+ * Like `spi_device_get_trans_result` without timeout.
+ * Transactions end in the order they are queued.
+ *
+ * @param[in] spi
+ *
+ *   SPI device.
+ *
+ * @param[out] trans
+ *
+ *   Receives the transaction that ended.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_spi_get_result (hal_spi_device spi, hal_spi_transaction** trans);
+
+/**
+ * @brief Makes a given GPIO pin an output.
+ *
+ * @param[in] pin
+ *
+ *   GPIO#.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_gpio_set_output (int pin);
+
+/**
+ * @brief Makes a given GPIO pin an input.
+ *
+ * @param[in] pin
+ *
+ *   GPIO#.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_gpio_set_input (int pin);
+
+/**
+ * @brief Sets the level of an output pin.
+ *
+ * @param[in] pin
+ *
+ *   GPIO#.
+ *
+ * @param[in] level
+ *
+ *   `0` for LOW, `1` for HIGH.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_gpio_set_level (int pin, uint32_t level);
+
+/**
+ * @brief Level of an input pin.
+ *
+ * @param[in] pin
+ *
+ *   GPIO#.
+ *
+ * @return
+ *
+ *   `0` for LOW, `1` for HIGH.
+ */
+int hal_gpio_get_level (int pin);
+
+/**
+ * @brief Makes a given GPIO pin an input, and registers its interrupt
+ * handler.
+ *
+ * @param[in] pin
+ *
+ *   GPIO#.
+ *
+ * @param[in] edge
+ *
+ *   Edge that triggers the interrupt.
+ *
+ * @param[in] handler
+ *
+ *   Interrupt handler. Runs in an ISR on ESP-IDF.
+ *
+ * @param[in] arg
+ *
+ *   Argument passed to `handler`.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t hal_gpio_set_isr (
+		int pin,
+		hal_gpio_edge edge,
+		hal_gpio_isr handler,
+		void* arg);
+
+/**
+ * @brief Blocks the calling task for a given time.
+ *
+ * Rounded up to the tick period on ESP-IDF, so that a nonzero time
+ * blocks at least a tick.
+ *
+ * @param[in] ms
+ *
+ *   Time to wait in milliseconds.
+ */
+void hal_delay_ms (uint32_t ms);
+
+/**
+ * @brief Blocks the calling task until the next period starts.
+ *
+ * Like `vTaskDelayUntil`. Advances `*wake_time_us` by `period_ms`, and
+ * waits until that time. Returns at once if the time has passed, so that
+ * a late task catches up. As the wake time is counted from the previous
+ * one, the period does not drift by the time the task runs.
+ * Rounded to the tick period on ESP-IDF, which does not accumulate either.
+ *
+ * On overrun, `*wake_time_us` is not reset to the current time. If the task
+ * is late by several periods, as many calls return at once, one per missed
+ * period, until it is back on the grid; e.g., a poll of the ADXL345 reads
+ * the samples it missed instead of skipping them. A caller that rather
+ * skips missed periods sets `*wake_time_us` to `::hal_get_time_us` itself.
+ *
+ * @param[in,out] wake_time_us
+ *
+ *   Time the task woke up last in microseconds.
+ *   Initialize with `::hal_get_time_us`.
+ *
+ * @param[in] period_ms
+ *
+ *   Period in milliseconds.
+ */
+void hal_delay_until (int64_t* wake_time_us, uint32_t period_ms);
+
+/**
+ * @brief Current time.
+ *
+ * Like `esp_timer_get_time`. Safe to call in an ISR.
+ *
+ * @return
+ *
+ *   Time since boot in microseconds.
+ */
+int64_t hal_get_time_us (void);
+
+/**
+ * @brief Handle of the calling task.
+ *
+ * @return
+ *
+ *   Handle of the calling task.
+ */
+hal_task hal_task_current (void);
+
+/**
+ * @brief Notifies a given task from an ISR.
+ *
+ * Like `vTaskNotifyGiveFromISR`, and yields if the task has a higher
+ * priority. The task receives it in `::hal_task_wait_notification`.
+ *
+ * @param[in] task
+ *
+ *   Task to be notified.
+ */
+void hal_task_notify_from_isr (hal_task task);
+
+/**
+ * @brief Waits for notifications to the calling task.
+ *
+ * Like `ulTaskNotifyTake(pdTRUE, timeout)`.
+ * Rounded up to the tick period on ESP-IDF, so that a nonzero timeout
+ * waits at least a tick; `0` does not block.
+ * On Linux, scheduled tasks run until one of them notifies or `timeout_ms`
+ * elapses on the simulated clock.
+ *
+ * @param[in] timeout_ms
+ *
+ *   Maximum time to wait in milliseconds.
+ *   `0` takes notifications without waiting.
+ *   `HAL_WAIT_FOREVER` never times out.
+ *
+ * @return
+ *
+ *   Number of notifications taken. `0` if timed out.
+ */
+uint32_t hal_task_wait_notification (uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
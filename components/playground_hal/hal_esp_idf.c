@@ -0,0 +1,350 @@
+/**
+ * @file hal_esp_idf.c
+ *
+ * ESP-IDF backend of the hardware abstraction layer.
+ */
+
+#include "hal.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+
+/**
+ * @brief Capacity of the queue times of a device.
+ *
+ * Must be a power of two larger than the queue size of any device
+ * plus one for a polling transaction.
+ */
+#define HAL_ESP_IDF_MAX_PENDING  64u
+
+/**
+ * @brief Device added by `::hal_spi_bus_add_device`.
+ *
+ * Transactions of a device start in the order they are queued,
+ * so the oldest queue time belongs to the next transaction that starts.
+ */
+typedef struct hal_esp_idf_device_t {
+	/** @brief Handle of the device. */
+	spi_device_handle_t handle;
+	/** @brief Receives the timing of transactions. */
+	hal_spi_timing_callback on_transaction;
+	/** @brief Passed to `on_transaction`. */
+	void* arg;
+	/** @brief Times when transactions were queued. */
+	int64_t queued_us[HAL_ESP_IDF_MAX_PENDING];
+	/** @brief Index of the next queue time to write. Task only. */
+	volatile uint32_t next_queued;
+	/** @brief Index of the queue time of the transaction in progress. */
+	volatile uint32_t next_started;
+	/** @brief Time when the transaction in progress started. */
+	int64_t start_us;
+} hal_esp_idf_device;
+
+/** @brief Devices added by `::hal_spi_bus_add_device`. */
+static hal_esp_idf_device hal_esp_idf_devices[HAL_SPI_MAX_DEVICES];
+
+/** @brief Number of devices added by `::hal_spi_bus_add_device`. */
+static size_t hal_esp_idf_num_devices = 0u;
+
+/**
+ * @brief Device of a given handle.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the device.
+ *
+ * @return
+ *
+ *   Device. `NULL` if `spi` was not added by `::hal_spi_bus_add_device`,
+ *   or does not take timing.
+ */
+static hal_esp_idf_device* hal_esp_idf_find_device (spi_device_handle_t spi) {
+	size_t i;
+	for (i = 0u; i < hal_esp_idf_num_devices; ++i) {
+		if (hal_esp_idf_devices[i].handle == spi) {
+			return (hal_esp_idf_devices[i].on_transaction != NULL) ?
+				&hal_esp_idf_devices[i] :
+				NULL;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Records the time when a transaction is queued.
+ *
+ * Called before the transaction is handed to ESP-IDF, because it may start
+ * at once.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the device.
+ */
+static void hal_esp_idf_record_queued (spi_device_handle_t spi) {
+	hal_esp_idf_device* device = hal_esp_idf_find_device(spi);
+	if (device != NULL) {
+		device->queued_us[device->next_queued & (HAL_ESP_IDF_MAX_PENDING - 1u)] =
+			esp_timer_get_time();
+		++device->next_queued;
+	}
+}
+
+/**
+ * @brief Forgets the time of a transaction that ESP-IDF rejected.
+ *
+ * @param[in] spi
+ *
+ *   Handle of the device.
+ */
+static void hal_esp_idf_cancel_queued (spi_device_handle_t spi) {
+	hal_esp_idf_device* device = hal_esp_idf_find_device(spi);
+	if (device != NULL) {
+		--device->next_queued;
+	}
+}
+
+/**
+ * @brief Records the start of a transaction of a given device.
+ *
+ * @param[in] index
+ *
+ *   Index of the device.
+ */
+static void IRAM_ATTR hal_esp_idf_on_start (size_t index) {
+	hal_esp_idf_devices[index].start_us = esp_timer_get_time();
+}
+
+/**
+ * @brief Reports the timing of a transaction of a given device.
+ *
+ * @param[in] index
+ *
+ *   Index of the device.
+ */
+static void IRAM_ATTR hal_esp_idf_on_end (size_t index) {
+	hal_esp_idf_device* device = &hal_esp_idf_devices[index];
+	const uint32_t started = device->next_started;
+	if (device->on_transaction == NULL) {
+		return;
+	}
+	device->on_transaction(
+		device->arg,
+		device->queued_us[started & (HAL_ESP_IDF_MAX_PENDING - 1u)],
+		device->start_us,
+		esp_timer_get_time());
+	device->next_started = started + 1u;
+}
+
+/**
+ * @brief Defines the pre- and post-transaction callbacks of a device slot.
+ *
+ * ESP-IDF passes only a transaction to the callbacks,
+ * so every slot has its own pair.
+ */
+#define HAL_ESP_IDF_DEFINE_CALLBACKS(index) \
+	static void IRAM_ATTR hal_esp_idf_pre_cb_##index (spi_transaction_t* trans) { \
+		hal_esp_idf_on_start(index); \
+	} \
+	static void IRAM_ATTR hal_esp_idf_post_cb_##index (spi_transaction_t* trans) { \
+		hal_esp_idf_on_end(index); \
+	}
+
+HAL_ESP_IDF_DEFINE_CALLBACKS(0)
+HAL_ESP_IDF_DEFINE_CALLBACKS(1)
+HAL_ESP_IDF_DEFINE_CALLBACKS(2)
+
+/** @brief Pre-transaction callbacks of the device slots. */
+static const transaction_cb_t HAL_ESP_IDF_PRE_CBS[HAL_SPI_MAX_DEVICES] = {
+	hal_esp_idf_pre_cb_0,
+	hal_esp_idf_pre_cb_1,
+	hal_esp_idf_pre_cb_2
+};
+
+/** @brief Post-transaction callbacks of the device slots. */
+static const transaction_cb_t HAL_ESP_IDF_POST_CBS[HAL_SPI_MAX_DEVICES] = {
+	hal_esp_idf_post_cb_0,
+	hal_esp_idf_post_cb_1,
+	hal_esp_idf_post_cb_2
+};
+
+hal_err_t hal_spi_bus_init (const hal_spi_bus_config* config) {
+	spi_bus_config_t buscfg = {
+		.miso_io_num = config->miso_pin,
+		.mosi_io_num = config->mosi_pin,
+		.sclk_io_num = config->clk_pin,
+		.quadwp_io_num = -1, // disabled
+		.quadhd_io_num = -1, // disabled
+		.max_transfer_sz = config->max_transfer_size
+	};
+	return spi_bus_initialize(
+		(spi_host_device_t)config->host,
+		&buscfg,
+		config->dma_channel);
+}
+
+hal_err_t hal_spi_bus_add_device (
+		const hal_spi_bus_config* bus,
+		const hal_spi_device_config* config,
+		hal_spi_device* device)
+{
+	hal_esp_idf_device* slot;
+	spi_device_interface_config_t devcfg = {
+		.clock_speed_hz = config->clock_speed_hz,
+		.mode = config->mode,
+		.spics_io_num = config->cs_pin,
+		.command_bits = config->command_bits,
+		.queue_size = config->queue_size
+	};
+	esp_err_t ret;
+	if ((hal_esp_idf_num_devices >= HAL_SPI_MAX_DEVICES) ||
+		(config->queue_size >= (int)HAL_ESP_IDF_MAX_PENDING))
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	slot = &hal_esp_idf_devices[hal_esp_idf_num_devices];
+	slot->on_transaction = config->on_transaction;
+	slot->arg = config->arg;
+	slot->next_queued = 0u;
+	slot->next_started = 0u;
+	if (config->on_transaction != NULL) {
+		devcfg.pre_cb = HAL_ESP_IDF_PRE_CBS[hal_esp_idf_num_devices];
+		devcfg.post_cb = HAL_ESP_IDF_POST_CBS[hal_esp_idf_num_devices];
+	}
+	ret = spi_bus_add_device((spi_host_device_t)bus->host, &devcfg, device);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	slot->handle = *device;
+	++hal_esp_idf_num_devices;
+	return ESP_OK;
+}
+
+hal_err_t hal_spi_transmit (hal_spi_device spi, hal_spi_transaction* trans) {
+	esp_err_t ret;
+	hal_esp_idf_record_queued(spi);
+	ret = spi_device_polling_transmit(spi, trans);
+	if (ret != ESP_OK) {
+		hal_esp_idf_cancel_queued(spi);
+	}
+	return ret;
+}
+
+hal_err_t hal_spi_queue (hal_spi_device spi, hal_spi_transaction* trans) {
+	esp_err_t ret;
+	hal_esp_idf_record_queued(spi);
+	ret = spi_device_queue_trans(spi, trans, portMAX_DELAY);
+	if (ret != ESP_OK) {
+		hal_esp_idf_cancel_queued(spi);
+	}
+	return ret;
+}
+
+hal_err_t hal_spi_get_result (hal_spi_device spi, hal_spi_transaction** trans) {
+	return spi_device_get_trans_result(spi, trans, portMAX_DELAY);
+}
+
+hal_err_t hal_gpio_set_output (int pin) {
+	return gpio_set_direction(pin, GPIO_MODE_OUTPUT);
+}
+
+hal_err_t hal_gpio_set_input (int pin) {
+	return gpio_set_direction(pin, GPIO_MODE_INPUT);
+}
+
+hal_err_t hal_gpio_set_level (int pin, uint32_t level) {
+	return gpio_set_level(pin, level);
+}
+
+int hal_gpio_get_level (int pin) {
+	return gpio_get_level(pin);
+}
+
+hal_err_t hal_gpio_set_isr (
+		int pin,
+		hal_gpio_edge edge,
+		hal_gpio_isr handler,
+		void* arg)
+{
+	esp_err_t ret;
+	ret = gpio_set_direction(pin, GPIO_MODE_INPUT);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	ret = gpio_set_intr_type(
+		pin,
+		(edge == HAL_GPIO_RISING_EDGE) ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	ret = gpio_install_isr_service(0);
+	// the service may have been installed for another pin
+	if ((ret != ESP_OK) && (ret != ESP_ERR_INVALID_STATE)) {
+		return ret;
+	}
+	return gpio_isr_handler_add(pin, handler, arg);
+}
+
+/**
+ * @brief Converts milliseconds into ticks, rounding up.
+ *
+ * A time shorter than a tick would otherwise become `0`, which does not
+ * block at all.
+ *
+ * @param[in] ms
+ *
+ *   Time in milliseconds.
+ *
+ * @return
+ *
+ *   Number of ticks. `0` only if `ms` is `0`.
+ */
+static TickType_t hal_ms_to_ticks (uint32_t ms) {
+	return (TickType_t)(((uint64_t)ms + portTICK_PERIOD_MS - 1u) /
+		portTICK_PERIOD_MS);
+}
+
+void hal_delay_ms (uint32_t ms) {
+	vTaskDelay(hal_ms_to_ticks(ms));
+}
+
+void hal_delay_until (int64_t* wake_time_us, uint32_t period_ms) {
+	const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+	int64_t remaining_us;
+	*wake_time_us += (int64_t)period_ms * 1000;
+	remaining_us = *wake_time_us - esp_timer_get_time();
+	if (remaining_us > 0) {
+		// wakes up at the tick boundary at most a tick away from the time
+		vTaskDelay((TickType_t)((remaining_us + tick_us - 1) / tick_us));
+	}
+	// on overrun, keeps the wake time on the grid and returns at once;
+	// the missed periods run back to back until the task catches up
+}
+
+int64_t IRAM_ATTR hal_get_time_us (void) {
+	return esp_timer_get_time();
+}
+
+hal_task hal_task_current (void) {
+	return xTaskGetCurrentTaskHandle();
+}
+
+void IRAM_ATTR hal_task_notify_from_isr (hal_task task) {
+	BaseType_t higher_priority_task_woken = pdFALSE;
+	vTaskNotifyGiveFromISR(task, &higher_priority_task_woken);
+	if (higher_priority_task_woken == pdTRUE) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+uint32_t hal_task_wait_notification (uint32_t timeout_ms) {
+	return ulTaskNotifyTake(
+		pdTRUE,
+		(timeout_ms == HAL_WAIT_FOREVER) ?
+			portMAX_DELAY :
+			hal_ms_to_ticks(timeout_ms));
+}
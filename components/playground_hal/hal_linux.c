@@ -0,0 +1,756 @@
+/**
+ * @file hal_linux.c
+ *
+ * Linux backend of the hardware abstraction layer.
+ */
+
+#include "hal_linux.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Error: invalid argument. Same as `ESP_ERR_INVALID_ARG`. */
+#define HAL_LINUX_ERR_INVALID_ARG  0x102
+/** @brief Error: invalid state. Same as `ESP_ERR_INVALID_STATE`. */
+#define HAL_LINUX_ERR_INVALID_STATE  0x103
+
+/**
+ * @brief Transaction queued on a simulated device.
+ */
+typedef struct hal_linux_queued_t {
+	/** @brief Transaction. */
+	hal_spi_transaction* trans;
+	/** @brief Time when the transaction was queued. */
+	int64_t queued_ns;
+	/** @brief Time when the transaction starts. Valid once it starts. */
+	int64_t start_ns;
+	/** @brief Time when the transaction ends. Valid once it starts. */
+	int64_t end_ns;
+} hal_linux_queued;
+
+/**
+ * @brief Simulated SPI device.
+ */
+struct hal_spi_device_t {
+	/** @brief Timing. */
+	hal_linux_spi_timing timing;
+	/** @brief Maximum number of transactions waiting to start. */
+	uint32_t queue_size;
+	/** @brief Receives the timing of transactions. */
+	hal_spi_timing_callback on_transaction;
+	/** @brief Passed to `on_transaction`. */
+	void* arg;
+	/** @brief Model of the device. */
+	hal_linux_spi_responder responder;
+	/** @brief Passed to `responder`. */
+	void* user_data;
+	/** @brief Queued transactions whose results are not taken yet. */
+	hal_linux_queued queue[HAL_LINUX_MAX_QUEUE_SIZE];
+	/** @brief Index of the oldest queued transaction. */
+	uint32_t queue_head;
+	/** @brief Number of queued transactions. */
+	uint32_t num_queued;
+	/** @brief Number of queued transactions that have started. */
+	uint32_t num_started;
+};
+
+/**
+ * @brief Task scheduled by `::hal_linux_schedule`.
+ */
+typedef struct hal_linux_timer_t {
+	/** @brief Time to run the task. */
+	int64_t at_ns;
+	/** @brief Task. */
+	hal_linux_task task;
+	/** @brief Passed to `task`. */
+	void* arg;
+} hal_linux_timer;
+
+/**
+ * @brief The only task.
+ */
+struct hal_task_t {
+	/** @brief Number of notifications not taken yet. */
+	uint32_t num_notifications;
+	/** @brief Time of the first notification not taken yet in nanoseconds. */
+	int64_t notified_ns;
+};
+
+/**
+ * @brief Simulated GPIO pin.
+ */
+typedef struct hal_linux_gpio_t {
+	/** @brief Level. */
+	int level;
+	/** @brief Edge of the interrupt. */
+	hal_gpio_edge edge;
+	/** @brief Interrupt handler. `NULL` if not registered. */
+	hal_gpio_isr handler;
+	/** @brief Passed to `handler`. */
+	void* arg;
+} hal_linux_gpio;
+
+/** @brief Devices. */
+static struct hal_spi_device_t hal_linux_devices[HAL_LINUX_MAX_SPI_DEVICES];
+
+/** @brief Number of devices. */
+static size_t hal_linux_num_devices = 0u;
+
+/** @brief Pins. */
+static hal_linux_gpio hal_linux_gpios[HAL_LINUX_NUM_GPIOS];
+
+/** @brief Recorded events. */
+static hal_linux_event hal_linux_events[HAL_LINUX_MAX_EVENTS];
+
+/** @brief Number of events including ones not recorded. */
+static size_t hal_linux_num_events = 0u;
+
+/** @brief Simulated clock in nanoseconds. */
+static int64_t hal_linux_time_ns = 0;
+
+/** @brief Time when the bus gets free in nanoseconds. */
+static int64_t hal_linux_bus_free_ns = 0;
+
+/** @brief Scheduled tasks in the order they were scheduled. */
+static hal_linux_timer hal_linux_timers[HAL_LINUX_MAX_TASKS];
+
+/** @brief Number of scheduled tasks. */
+static size_t hal_linux_num_timers = 0u;
+
+/** @brief Time to write a GPIO pin in nanoseconds. */
+static int64_t hal_linux_gpio_write_ns = HAL_LINUX_DEFAULT_GPIO_WRITE_NS;
+
+/** @brief Time for a notified task to run again in nanoseconds. */
+static int64_t hal_linux_task_wakeup_ns = HAL_LINUX_DEFAULT_TASK_WAKEUP_NS;
+
+/** @brief The only task. */
+static struct hal_task_t hal_linux_current_task = { 0u, 0 };
+
+/** @brief Accumulated costs except for `elapsed_ns`. */
+static hal_linux_stats hal_linux_stats_ = { 0 };
+
+/**
+ * @brief Records an event.
+ *
+ * @param[in] event
+ *
+ *   Event to record.
+ */
+static void hal_linux_record (const hal_linux_event* event) {
+	if (hal_linux_num_events < HAL_LINUX_MAX_EVENTS) {
+		hal_linux_events[hal_linux_num_events] = *event;
+	}
+	++hal_linux_num_events;
+}
+
+/**
+ * @brief Runs a transaction on a device.
+ *
+ * The device model answers the transaction, and the bus is busy until it
+ * ends.
+ *
+ * @param[in,out] spi
+ *
+ *   Device.
+ *
+ * @param[in,out] trans
+ *
+ *   Transaction.
+ *
+ * @param[in] setup_ns
+ *
+ *   Time to start the transaction in nanoseconds.
+ *
+ * @param[in] queued_ns
+ *
+ *   Time when the transaction was queued or transmitted.
+ *
+ * @param[in] start_ns
+ *
+ *   Time when the transaction starts. Not before the bus gets free.
+ *
+ * @return
+ *
+ *   Time when the transaction ends in nanoseconds.
+ */
+static int64_t hal_linux_run (
+		hal_spi_device spi,
+		hal_spi_transaction* trans,
+		int64_t setup_ns,
+		int64_t queued_ns,
+		int64_t start_ns)
+{
+	const hal_linux_spi_timing* timing = &spi->timing;
+	const size_t num_bytes = (trans->length + 7u) / 8u;
+	const uint8_t* tx = ((trans->flags & HAL_SPI_USE_TXDATA) != 0u) ?
+		trans->tx_data :
+		(const uint8_t*)trans->tx_buffer;
+	uint8_t* rx = ((trans->flags & HAL_SPI_USE_RXDATA) != 0u) ?
+		trans->rx_data :
+		(uint8_t*)trans->rx_buffer;
+	const uint64_t bits = (uint64_t)timing->command_bits + trans->length;
+	int64_t overhead_ns = setup_ns + timing->cs_setup_ns + timing->cs_hold_ns;
+	hal_linux_event event;
+	if (rx != NULL) {
+		memset(rx, 0, num_bytes);
+	}
+	if (spi->responder != NULL) {
+		spi->responder(spi->user_data, trans, tx, rx, num_bytes);
+	}
+	if ((num_bytes > 4u) && (timing->dma_descriptor_size > 0u)) {
+		overhead_ns += timing->dma_descriptor_ns * (int64_t)(
+			(num_bytes - 1u) / timing->dma_descriptor_size);
+	}
+	event.kind = HAL_LINUX_EVENT_SPI;
+	event.start_ns = start_ns;
+	event.wire_ns = (int64_t)(
+		(bits * 1000000000u) / (uint64_t)timing->clock_speed_hz);
+	event.end_ns = event.start_ns + overhead_ns + event.wire_ns;
+	event.device = spi;
+	event.command_or_pin = trans->cmd;
+	event.length_or_level = (uint32_t)trans->length;
+	hal_linux_record(&event);
+	++hal_linux_stats_.num_transactions;
+	hal_linux_stats_.num_bits += bits;
+	hal_linux_stats_.wire_ns += event.wire_ns;
+	hal_linux_stats_.overhead_ns += overhead_ns;
+	hal_linux_bus_free_ns = event.end_ns;
+	if (spi->on_transaction != NULL) {
+		spi->on_transaction(
+			spi->arg,
+			queued_ns / 1000,
+			event.start_ns / 1000,
+			event.end_ns / 1000);
+	}
+	return event.end_ns;
+}
+
+/**
+ * @brief Whether a given transaction fits a device.
+ *
+ * @param[in] spi
+ *
+ *   Device.
+ *
+ * @param[in] trans
+ *
+ *   Transaction.
+ *
+ * @return
+ *
+ *   Whether the length of `trans` is within `max_transfer_size`.
+ */
+static int hal_linux_fits (hal_spi_device spi, const hal_spi_transaction* trans) {
+	const size_t max_size = spi->timing.max_transfer_size;
+	return (max_size == 0u) || (trans->length <= 8u * max_size);
+}
+
+/**
+ * @brief Starts queued transactions that the bus reaches before a given
+ * time.
+ *
+ * When the bus gets free, the device added earliest among those with
+ * waiting transactions goes first, like the ESP-IDF SPI master driver.
+ *
+ * @param[in] limit_ns
+ *
+ *   Transactions that would start at or after this time are left waiting.
+ */
+static void hal_linux_run_bus (int64_t limit_ns) {
+	hal_spi_device next;
+	hal_linux_queued* queued;
+	int64_t start_ns;
+	int64_t next_start_ns;
+	size_t i;
+	for (;;) {
+		next = NULL;
+		next_start_ns = INT64_MAX;
+		for (i = 0u; i < hal_linux_num_devices; ++i) {
+			hal_spi_device spi = &hal_linux_devices[i];
+			if (spi->num_started == spi->num_queued) {
+				continue;
+			}
+			queued = &spi->queue[
+				(spi->queue_head + spi->num_started) % HAL_LINUX_MAX_QUEUE_SIZE];
+			start_ns = (queued->queued_ns > hal_linux_bus_free_ns) ?
+				queued->queued_ns :
+				hal_linux_bus_free_ns;
+			// ties go to the device added earlier
+			if (start_ns < next_start_ns) {
+				next = spi;
+				next_start_ns = start_ns;
+			}
+		}
+		if ((next == NULL) || (next_start_ns >= limit_ns)) {
+			break;
+		}
+		queued = &next->queue[
+			(next->queue_head + next->num_started) % HAL_LINUX_MAX_QUEUE_SIZE];
+		queued->start_ns = next_start_ns;
+		queued->end_ns = hal_linux_run(
+			next,
+			queued->trans,
+			next->timing.queued_setup_ns,
+			queued->queued_ns,
+			next_start_ns);
+		++next->num_started;
+	}
+}
+
+/**
+ * @brief Time of the earliest scheduled task.
+ *
+ * @return
+ *
+ *   Time in nanoseconds. `INT64_MAX` if no task is scheduled.
+ */
+static int64_t hal_linux_next_timer_ns (void) {
+	int64_t at_ns = INT64_MAX;
+	size_t i;
+	for (i = 0u; i < hal_linux_num_timers; ++i) {
+		if (hal_linux_timers[i].at_ns < at_ns) {
+			at_ns = hal_linux_timers[i].at_ns;
+		}
+	}
+	return at_ns;
+}
+
+/**
+ * @brief Runs the earliest scheduled task.
+ *
+ * The clock is moved to the time of the task if it is behind.
+ * There must be a scheduled task.
+ */
+static void hal_linux_run_next_timer (void) {
+	const int64_t at_ns = hal_linux_next_timer_ns();
+	hal_linux_timer timer;
+	size_t i;
+	for (i = 0u; hal_linux_timers[i].at_ns != at_ns; ++i);
+	timer = hal_linux_timers[i];
+	// keeps the order of tasks at the same time
+	memmove(
+		&hal_linux_timers[i],
+		&hal_linux_timers[i + 1u],
+		(hal_linux_num_timers - i - 1u) * sizeof(hal_linux_timer));
+	--hal_linux_num_timers;
+	hal_linux_run_bus(at_ns);
+	if (hal_linux_time_ns < at_ns) {
+		hal_linux_time_ns = at_ns;
+	}
+	timer.task(timer.arg);
+}
+
+/**
+ * @brief Advances the clock to a given time.
+ *
+ * Runs tasks and starts queued transactions due by then.
+ * Tasks may advance the clock beyond `time_ns`.
+ *
+ * @param[in] time_ns
+ *
+ *   Time to advance to in nanoseconds.
+ */
+static void hal_linux_advance_to (int64_t time_ns) {
+	while (hal_linux_next_timer_ns() <= time_ns) {
+		hal_linux_run_next_timer();
+	}
+	hal_linux_run_bus(time_ns);
+	if (hal_linux_time_ns < time_ns) {
+		hal_linux_time_ns = time_ns;
+	}
+}
+
+/**
+ * @brief Waits until the oldest waiting transaction of a device starts.
+ *
+ * Tasks due before that run meanwhile.
+ *
+ * @param[in,out] spi
+ *
+ *   Device with a waiting transaction.
+ *
+ * @return
+ *
+ *   Queued transaction that started.
+ */
+static hal_linux_queued* hal_linux_wait_start (hal_spi_device spi) {
+	const uint32_t index = spi->num_started;
+	int64_t at_ns;
+	for (;;) {
+		at_ns = hal_linux_next_timer_ns();
+		hal_linux_run_bus(at_ns);
+		if (spi->num_started > index) {
+			break;
+		}
+		hal_linux_run_next_timer();
+	}
+	return &spi->queue[(spi->queue_head + index) % HAL_LINUX_MAX_QUEUE_SIZE];
+}
+
+void hal_linux_reset (void) {
+	memset(hal_linux_devices, 0, sizeof(hal_linux_devices));
+	hal_linux_num_devices = 0u;
+	memset(hal_linux_gpios, 0, sizeof(hal_linux_gpios));
+	hal_linux_num_events = 0u;
+	hal_linux_time_ns = 0;
+	hal_linux_bus_free_ns = 0;
+	hal_linux_num_timers = 0u;
+	hal_linux_gpio_write_ns = HAL_LINUX_DEFAULT_GPIO_WRITE_NS;
+	hal_linux_task_wakeup_ns = HAL_LINUX_DEFAULT_TASK_WAKEUP_NS;
+	hal_linux_current_task.num_notifications = 0u;
+	hal_linux_current_task.notified_ns = 0;
+	memset(&hal_linux_stats_, 0, sizeof(hal_linux_stats_));
+}
+
+hal_spi_device hal_linux_add_spi_device (
+		const hal_linux_spi_timing* timing,
+		hal_linux_spi_responder responder,
+		void* user_data)
+{
+	hal_spi_device spi;
+	if ((hal_linux_num_devices >= HAL_LINUX_MAX_SPI_DEVICES) ||
+		(timing->clock_speed_hz <= 0))
+	{
+		return NULL;
+	}
+	spi = &hal_linux_devices[hal_linux_num_devices++];
+	memset(spi, 0, sizeof(*spi));
+	spi->timing = *timing;
+	spi->queue_size = HAL_LINUX_MAX_QUEUE_SIZE;
+	spi->responder = responder;
+	spi->user_data = user_data;
+	return spi;
+}
+
+void hal_linux_set_spi_responder (
+		hal_spi_device spi,
+		hal_linux_spi_responder responder,
+		void* user_data)
+{
+	spi->responder = responder;
+	spi->user_data = user_data;
+}
+
+void hal_linux_set_spi_timing (
+		hal_spi_device spi,
+		const hal_linux_spi_timing* timing)
+{
+	spi->timing = *timing;
+}
+
+int hal_linux_schedule (int64_t at_ns, hal_linux_task task, void* arg) {
+	hal_linux_timer* timer;
+	if (hal_linux_num_timers >= HAL_LINUX_MAX_TASKS) {
+		return -1;
+	}
+	timer = &hal_linux_timers[hal_linux_num_timers++];
+	timer->at_ns = (at_ns > hal_linux_time_ns) ? at_ns : hal_linux_time_ns;
+	timer->task = task;
+	timer->arg = arg;
+	return 0;
+}
+
+void hal_linux_set_gpio_write_ns (int64_t ns) {
+	hal_linux_gpio_write_ns = ns;
+}
+
+void hal_linux_set_task_wakeup_ns (int64_t ns) {
+	hal_linux_task_wakeup_ns = ns;
+}
+
+void hal_linux_set_input_level (int pin, int level) {
+	hal_linux_gpio* gpio;
+	int previous;
+	if ((pin < 0) || (pin >= HAL_LINUX_NUM_GPIOS)) {
+		return;
+	}
+	gpio = &hal_linux_gpios[pin];
+	previous = gpio->level;
+	gpio->level = (level != 0);
+	if ((gpio->handler != NULL) && (previous != gpio->level) &&
+		((gpio->edge == HAL_GPIO_RISING_EDGE) == (gpio->level == 1)))
+	{
+		gpio->handler(gpio->arg);
+	}
+}
+
+void hal_linux_get_stats (hal_linux_stats* stats) {
+	*stats = hal_linux_stats_;
+	stats->elapsed_ns = hal_linux_time_ns;
+}
+
+void hal_linux_stats_diff (
+		const hal_linux_stats* end,
+		const hal_linux_stats* start,
+		hal_linux_stats* diff)
+{
+	diff->num_transactions = end->num_transactions - start->num_transactions;
+	diff->num_bits = end->num_bits - start->num_bits;
+	diff->num_gpio_writes = end->num_gpio_writes - start->num_gpio_writes;
+	diff->wire_ns = end->wire_ns - start->wire_ns;
+	diff->overhead_ns = end->overhead_ns - start->overhead_ns;
+	diff->delay_ns = end->delay_ns - start->delay_ns;
+	diff->elapsed_ns = end->elapsed_ns - start->elapsed_ns;
+}
+
+double hal_linux_stats_efficiency (const hal_linux_stats* stats) {
+	const int64_t bus_ns = stats->wire_ns + stats->overhead_ns;
+	return (bus_ns > 0) ? (double)stats->wire_ns / (double)bus_ns : 0.0;
+}
+
+void hal_linux_advance_time_ns (int64_t ns) {
+	hal_linux_advance_to(hal_linux_time_ns + ns);
+}
+
+int64_t hal_linux_get_time_ns (void) {
+	return hal_linux_time_ns;
+}
+
+const hal_linux_event* hal_linux_get_events (size_t* num_events) {
+	*num_events = (hal_linux_num_events < HAL_LINUX_MAX_EVENTS) ?
+		hal_linux_num_events :
+		HAL_LINUX_MAX_EVENTS;
+	return hal_linux_events;
+}
+
+size_t hal_linux_count_events (void) {
+	return hal_linux_num_events;
+}
+
+hal_err_t hal_spi_bus_init (const hal_spi_bus_config* config) {
+	// there is only one simulated bus
+	if (config->max_transfer_size < 0) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	return HAL_OK;
+}
+
+hal_err_t hal_spi_bus_add_device (
+		const hal_spi_bus_config* bus,
+		const hal_spi_device_config* config,
+		hal_spi_device* device)
+{
+	hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		config->clock_speed_hz,
+		config->command_bits,
+		(size_t)bus->max_transfer_size);
+	hal_spi_device spi;
+	if ((config->queue_size <= 0) ||
+		(config->queue_size > (int)HAL_LINUX_MAX_QUEUE_SIZE))
+	{
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	if (spi == NULL) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	spi->queue_size = (uint32_t)config->queue_size;
+	spi->on_transaction = config->on_transaction;
+	spi->arg = config->arg;
+	*device = spi;
+	return HAL_OK;
+}
+
+hal_err_t hal_spi_transmit (hal_spi_device spi, hal_spi_transaction* trans) {
+	int64_t start_ns;
+	if ((spi == NULL) || (trans == NULL)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	if (!hal_linux_fits(spi, trans)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	if (spi->num_queued > 0u) {
+		// same as ESP-IDF; polling is not allowed while transactions queue
+		return HAL_LINUX_ERR_INVALID_STATE;
+	}
+	// takes the bus when the transaction in progress ends,
+	// ahead of queued transactions
+	hal_linux_run_bus(hal_linux_time_ns);
+	start_ns = (hal_linux_bus_free_ns > hal_linux_time_ns) ?
+		hal_linux_bus_free_ns :
+		hal_linux_time_ns;
+	hal_linux_advance_to(hal_linux_run(
+		spi,
+		trans,
+		spi->timing.polling_setup_ns,
+		hal_linux_time_ns,
+		start_ns));
+	return HAL_OK;
+}
+
+hal_err_t hal_spi_queue (hal_spi_device spi, hal_spi_transaction* trans) {
+	hal_linux_queued* queued;
+	if ((spi == NULL) || (trans == NULL)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	if (!hal_linux_fits(spi, trans)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	if (spi->num_queued >= HAL_LINUX_MAX_QUEUE_SIZE) {
+		return HAL_LINUX_ERR_INVALID_STATE;
+	}
+	if (spi->num_queued - spi->num_started >= spi->queue_size) {
+		// blocks until the oldest waiting transaction starts
+		queued = hal_linux_wait_start(spi);
+		hal_linux_advance_to(queued->start_ns);
+	}
+	queued = &spi->queue[
+		(spi->queue_head + spi->num_queued) % HAL_LINUX_MAX_QUEUE_SIZE];
+	queued->trans = trans;
+	queued->queued_ns = hal_linux_time_ns;
+	++spi->num_queued;
+	return HAL_OK;
+}
+
+hal_err_t hal_spi_get_result (hal_spi_device spi, hal_spi_transaction** trans) {
+	hal_linux_queued* queued;
+	if ((spi == NULL) || (trans == NULL)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	if (spi->num_queued == 0u) {
+		// would block forever
+		return HAL_LINUX_ERR_INVALID_STATE;
+	}
+	queued = (spi->num_started > 0u) ?
+		&spi->queue[spi->queue_head] :
+		hal_linux_wait_start(spi);
+	hal_linux_advance_to(queued->end_ns);
+	*trans = queued->trans;
+	spi->queue_head = (spi->queue_head + 1u) % HAL_LINUX_MAX_QUEUE_SIZE;
+	--spi->num_queued;
+	--spi->num_started;
+	return HAL_OK;
+}
+
+hal_err_t hal_gpio_set_output (int pin) {
+	if ((pin < 0) || (pin >= HAL_LINUX_NUM_GPIOS)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	return HAL_OK;
+}
+
+hal_err_t hal_gpio_set_input (int pin) {
+	if ((pin < 0) || (pin >= HAL_LINUX_NUM_GPIOS)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	return HAL_OK;
+}
+
+hal_err_t hal_gpio_set_level (int pin, uint32_t level) {
+	hal_linux_event event;
+	if ((pin < 0) || (pin >= HAL_LINUX_NUM_GPIOS)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	hal_linux_gpios[pin].level = (level != 0u);
+	event.kind = HAL_LINUX_EVENT_GPIO;
+	event.start_ns = hal_linux_time_ns;
+	event.end_ns = hal_linux_time_ns + hal_linux_gpio_write_ns;
+	event.wire_ns = 0;
+	event.device = NULL;
+	event.command_or_pin = (uint32_t)pin;
+	event.length_or_level = (level != 0u);
+	hal_linux_record(&event);
+	++hal_linux_stats_.num_gpio_writes;
+	hal_linux_stats_.overhead_ns += hal_linux_gpio_write_ns;
+	hal_linux_advance_to(event.end_ns);
+	return HAL_OK;
+}
+
+int hal_gpio_get_level (int pin) {
+	if ((pin < 0) || (pin >= HAL_LINUX_NUM_GPIOS)) {
+		return 0;
+	}
+	return hal_linux_gpios[pin].level;
+}
+
+hal_err_t hal_gpio_set_isr (
+		int pin,
+		hal_gpio_edge edge,
+		hal_gpio_isr handler,
+		void* arg)
+{
+	if ((pin < 0) || (pin >= HAL_LINUX_NUM_GPIOS)) {
+		return HAL_LINUX_ERR_INVALID_ARG;
+	}
+	hal_linux_gpios[pin].edge = edge;
+	hal_linux_gpios[pin].handler = handler;
+	hal_linux_gpios[pin].arg = arg;
+	return HAL_OK;
+}
+
+void hal_delay_ms (uint32_t ms) {
+	hal_linux_stats_.delay_ns += (int64_t)ms * 1000000;
+	hal_linux_advance_to(hal_linux_time_ns + (int64_t)ms * 1000000);
+}
+
+void hal_delay_until (int64_t* wake_time_us, uint32_t period_ms) {
+	int64_t wake_time_ns;
+	*wake_time_us += (int64_t)period_ms * 1000;
+	wake_time_ns = *wake_time_us * 1000;
+	if (wake_time_ns > hal_linux_time_ns) {
+		hal_linux_stats_.delay_ns += wake_time_ns - hal_linux_time_ns;
+		hal_linux_advance_to(wake_time_ns);
+	}
+}
+
+int64_t hal_get_time_us (void) {
+	return hal_linux_time_ns / 1000;
+}
+
+hal_task hal_task_current (void) {
+	return &hal_linux_current_task;
+}
+
+void hal_task_notify_from_isr (hal_task task) {
+	if (task->num_notifications == 0u) {
+		task->notified_ns = hal_linux_time_ns;
+	}
+	++task->num_notifications;
+}
+
+uint32_t hal_task_wait_notification (uint32_t timeout_ms) {
+	const int64_t deadline_ns = (timeout_ms == HAL_WAIT_FOREVER) ?
+		INT64_MAX :
+		hal_linux_time_ns + (int64_t)timeout_ms * 1000000;
+	uint32_t num_notifications;
+	// scheduled tasks stand for devices and tasks of higher priority
+	while ((hal_linux_current_task.num_notifications == 0u) &&
+		(hal_linux_num_timers > 0u) &&
+		(hal_linux_next_timer_ns() <= deadline_ns))
+	{
+		hal_linux_run_next_timer();
+	}
+	if ((hal_linux_current_task.num_notifications == 0u) &&
+		(deadline_ns != INT64_MAX))
+	{
+		hal_linux_advance_to(deadline_ns);
+	}
+	if ((hal_linux_current_task.num_notifications > 0u) &&
+		(hal_linux_current_task.notified_ns + hal_linux_task_wakeup_ns >
+			hal_linux_time_ns))
+	{
+		// the task runs again after the ISR and a context switch
+		hal_linux_advance_to(
+			hal_linux_current_task.notified_ns + hal_linux_task_wakeup_ns);
+	}
+	num_notifications = hal_linux_current_task.num_notifications;
+	hal_linux_current_task.num_notifications = 0u;
+	return num_notifications;
+}
+
+void hal_error_check_failed (
+		hal_err_t err,
+		const char* file,
+		int line,
+		const char* expression)
+{
+	fprintf(
+		stderr,
+		"%s:%d: error 0x%x: %s\n",
+		file,
+		line,
+		(unsigned)err,
+		expression);
+	abort();
+}
@@ -0,0 +1,492 @@
+#ifndef _HAL_LINUX_H
+#define _HAL_LINUX_H
+
+/**
+ * @file hal_linux.h
+ *
+ * Control of the Linux backend of the hardware abstraction layer.
+ *
+ * The Linux backend runs on a simulated clock, which advances only when
+ * a driver talks to hardware or waits; i.e., transmits an SPI transaction,
+ * waits for a queued one, writes a GPIO pin, or delays. Time to run other
+ * code is not counted, so a measurement shows how long the bus and delays
+ * take.
+ *
+ * A transaction spends time on the wire and in overhead.
+ * - Wire time: clocking out the command and data bits.
+ * - Overhead: setting up the transaction, asserting and releasing CS,
+ *   and moving on to the next DMA descriptor. See `::hal_linux_spi_timing`.
+ *
+ * Writing a GPIO pin, e.g., switching the D/C line of a display, is also
+ * overhead. `::hal_linux_get_stats` sums them up so that the cost of an
+ * operation is the difference of the statistics before and after it.
+ *
+ * All devices share one simulated bus. Queued transactions start when the bus
+ * gets free, and the device added earliest goes first among those waiting.
+ * A polling transaction takes the bus as soon as the transaction in progress
+ * ends.
+ *
+ * `::hal_linux_schedule` runs a function at a given time, as if a task of
+ * higher priority woke up. It may also talk to devices.
+ * `::hal_task_wait_notification` runs scheduled functions until one of them
+ * notifies the task; e.g., by driving an input whose interrupt handler calls
+ * `::hal_task_notify_from_isr`.
+ *
+ * Every SPI transaction and GPIO output is recorded as a `::hal_linux_event`.
+ * A device model answers transactions through a `::hal_linux_spi_responder`,
+ * and drives inputs with `::hal_linux_set_input_level`.
+ * The backend is not thread-safe.
+ */
+
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of SPI devices. */
+#define HAL_LINUX_MAX_SPI_DEVICES  4u
+
+/** @brief Maximum number of queued transactions per device. */
+#define HAL_LINUX_MAX_QUEUE_SIZE  64u
+
+/** @brief Maximum number of events recorded. Later events are counted. */
+#define HAL_LINUX_MAX_EVENTS  4096u
+
+/** @brief Number of GPIO pins. */
+#define HAL_LINUX_NUM_GPIOS  40
+
+/** @brief Maximum number of tasks scheduled at once. */
+#define HAL_LINUX_MAX_TASKS  16u
+
+/**
+ * @brief Default time to start a polling transaction in nanoseconds.
+ *
+ * Rough interval between one-byte polling transactions on an ESP32 at
+ * 240MHz.
+ */
+#define HAL_LINUX_DEFAULT_POLLING_SETUP_NS  10000
+
+/**
+ * @brief Default time to start a queued transaction in nanoseconds.
+ *
+ * Rough interval between one-byte queued (interrupt-driven) transactions on
+ * an ESP32 at 240MHz.
+ */
+#define HAL_LINUX_DEFAULT_QUEUED_SETUP_NS  25000
+
+/** @brief Default size of a DMA descriptor in bytes. Same as ESP32. */
+#define HAL_LINUX_DEFAULT_DMA_DESCRIPTOR_SIZE  4092u
+
+/** @brief Default time to move on to the next DMA descriptor. */
+#define HAL_LINUX_DEFAULT_DMA_DESCRIPTOR_NS  100
+
+/** @brief Default time to write a GPIO pin in nanoseconds. */
+#define HAL_LINUX_DEFAULT_GPIO_WRITE_NS  200
+
+/**
+ * @brief Default time for a notified task to run again in nanoseconds.
+ *
+ * `0`, so that a task takes a notification as soon as it is given.
+ * See `::hal_linux_set_task_wakeup_ns`.
+ */
+#define HAL_LINUX_DEFAULT_TASK_WAKEUP_NS  0
+
+/**
+ * @brief Timing of an SPI device.
+ *
+ * A transaction of `n` bits of data takes
+ * - wire time: `(command_bits + n) / clock_speed_hz`
+ * - overhead: `polling_setup_ns` or `queued_setup_ns`, plus
+ *   `cs_setup_ns + cs_hold_ns`, plus `dma_descriptor_ns` for every DMA
+ *   descriptor but the first one.
+ *
+ * Transactions of more than 32 bits of data go through DMA, as
+ * `tx_data` and `rx_data` hold only 4 bytes.
+ */
+typedef struct hal_linux_spi_timing_t {
+	/** @brief SPI clock in Hz. */
+	int clock_speed_hz;
+	/** @brief Number of bits of a command. */
+	int command_bits;
+	/** @brief Time to start a polling transaction in nanoseconds. */
+	int64_t polling_setup_ns;
+	/** @brief Time to start a queued transaction in nanoseconds. */
+	int64_t queued_setup_ns;
+	/** @brief Time from asserting CS to the first clock in nanoseconds. */
+	int64_t cs_setup_ns;
+	/** @brief Time from the last clock to releasing CS in nanoseconds. */
+	int64_t cs_hold_ns;
+	/**
+	 * @brief Maximum length of a transaction in bytes.
+	 *
+	 * Longer transactions fail like `max_transfer_sz` of the bus.
+	 * `0` for no limit.
+	 */
+	size_t max_transfer_size;
+	/** @brief Size of a DMA descriptor in bytes. */
+	size_t dma_descriptor_size;
+	/** @brief Time to move on to the next DMA descriptor in nanoseconds. */
+	int64_t dma_descriptor_ns;
+} hal_linux_spi_timing;
+
+/**
+ * @brief Initializer of a `::hal_linux_spi_timing` with default costs.
+ *
+ * CS is asserted and released a clock cycle before and after data,
+ * which is the minimum of the ESP32 SPI master.
+ *
+ * @param[in] clock_speed_hz
+ *
+ *   SPI clock in Hz.
+ *
+ * @param[in] command_bits
+ *
+ *   Number of bits of a command.
+ *
+ * @param[in] max_transfer_size
+ *
+ *   Maximum length of a transaction in bytes. `0` for no limit.
+ */
+#define hal_linux_spi_timing_initializer(clock_speed_hz, command_bits, max_transfer_size) \
+	{ \
+		(clock_speed_hz), \
+		(command_bits), \
+		HAL_LINUX_DEFAULT_POLLING_SETUP_NS, \
+		HAL_LINUX_DEFAULT_QUEUED_SETUP_NS, \
+		(int64_t)(1000000000 / (clock_speed_hz)), \
+		(int64_t)(1000000000 / (clock_speed_hz)), \
+		(max_transfer_size), \
+		HAL_LINUX_DEFAULT_DMA_DESCRIPTOR_SIZE, \
+		HAL_LINUX_DEFAULT_DMA_DESCRIPTOR_NS \
+	}
+
+/**
+ * @brief Accumulated costs of the Linux backend.
+ *
+ * Counts from the last `::hal_linux_reset`.
+ */
+typedef struct hal_linux_stats_t {
+	/** @brief Number of SPI transactions. */
+	size_t num_transactions;
+	/** @brief Number of bits clocked including commands. */
+	uint64_t num_bits;
+	/** @brief Number of GPIO writes. */
+	size_t num_gpio_writes;
+	/** @brief Time on the wire in nanoseconds. */
+	int64_t wire_ns;
+	/** @brief Overhead of transactions and GPIO writes in nanoseconds. */
+	int64_t overhead_ns;
+	/** @brief Time spent in `::hal_delay_ms` and `::hal_delay_until` in nanoseconds. */
+	int64_t delay_ns;
+	/** @brief Time on the clock in nanoseconds. */
+	int64_t elapsed_ns;
+} hal_linux_stats;
+
+/**
+ * @brief Kind of a `::hal_linux_event`.
+ */
+typedef enum hal_linux_event_kind_t {
+	/** @brief SPI transaction. */
+	HAL_LINUX_EVENT_SPI = 0,
+	/** @brief Level of an output pin. */
+	HAL_LINUX_EVENT_GPIO
+} hal_linux_event_kind;
+
+/**
+ * @brief Event recorded by the Linux backend.
+ */
+typedef struct hal_linux_event_t {
+	/** @brief Kind. */
+	hal_linux_event_kind kind;
+	/** @brief Time when the event started in nanoseconds. */
+	int64_t start_ns;
+	/** @brief Time when the event ended in nanoseconds. */
+	int64_t end_ns;
+	/** @brief Wire time of a transaction in nanoseconds. `0` for GPIO. */
+	int64_t wire_ns;
+	/** @brief SPI device. `NULL` for GPIO. */
+	hal_spi_device device;
+	/** @brief Command of a transaction, or GPIO# of an output. */
+	uint32_t command_or_pin;
+	/** @brief Length of a transaction in bits, or a level of an output. */
+	uint32_t length_or_level;
+} hal_linux_event;
+
+/**
+ * @brief Model of an SPI device that answers transactions.
+ *
+ * @param[in] user_data
+ *
+ *   `user_data` given to `::hal_linux_add_spi_device`.
+ *
+ * @param[in] trans
+ *
+ *   Transaction. Its command is in `trans->cmd`.
+ *
+ * @param[in] tx
+ *
+ *   Transmitted data of `num_bytes` bytes.
+ *   `NULL` if the transaction only receives.
+ *
+ * @param[out] rx
+ *
+ *   Buffer to receive data of `num_bytes` bytes.
+ *   Zero-filled before this function is called.
+ *   `NULL` if the transaction only transmits.
+ *
+ * @param[in] num_bytes
+ *
+ *   Number of bytes of data.
+ */
+typedef void (*hal_linux_spi_responder)(
+		void* user_data,
+		const hal_spi_transaction* trans,
+		const uint8_t* tx,
+		uint8_t* rx,
+		size_t num_bytes);
+
+/**
+ * @brief Task run by `::hal_linux_schedule`.
+ *
+ * @param[in] arg
+ *
+ *   `arg` given to `::hal_linux_schedule`.
+ */
+typedef void (*hal_linux_task)(void* arg);
+
+/**
+ * @brief Clears devices, events, pins, tasks, notifications and the clock.
+ */
+void hal_linux_reset (void);
+
+/**
+ * @brief Adds an SPI device.
+ *
+ * Up to `HAL_LINUX_MAX_QUEUE_SIZE` transactions may be queued on the device.
+ *
+ * @param[in] timing
+ *
+ *   Timing of the device. Copied.
+ *
+ * @param[in] responder
+ *
+ *   Model of the device. `NULL` receives zeros.
+ *
+ * @param[in] user_data
+ *
+ *   Passed to `responder`.
+ *
+ * @return
+ *
+ *   Handle of the device. `NULL` if there are too many devices.
+ */
+hal_spi_device hal_linux_add_spi_device (
+		const hal_linux_spi_timing* timing,
+		hal_linux_spi_responder responder,
+		void* user_data);
+
+/**
+ * @brief Replaces the model of an SPI device.
+ *
+ * Useful for a device added by `::hal_spi_bus_add_device`.
+ *
+ * @param[in,out] spi
+ *
+ *   Device.
+ *
+ * @param[in] responder
+ *
+ *   Model of the device. `NULL` receives zeros.
+ *
+ * @param[in] user_data
+ *
+ *   Passed to `responder`.
+ */
+void hal_linux_set_spi_responder (
+		hal_spi_device spi,
+		hal_linux_spi_responder responder,
+		void* user_data);
+
+/**
+ * @brief Replaces the timing of an SPI device.
+ *
+ * A device added by `::hal_spi_bus_add_device` has the timing of
+ * `::hal_linux_spi_timing_initializer`.
+ *
+ * @param[in,out] spi
+ *
+ *   Device.
+ *
+ * @param[in] timing
+ *
+ *   Timing. Copied.
+ */
+void hal_linux_set_spi_timing (
+		hal_spi_device spi,
+		const hal_linux_spi_timing* timing);
+
+/**
+ * @brief Schedules a task.
+ *
+ * The task runs when a driver waits past `at_ns`; e.g., in
+ * `::hal_spi_get_result`, `::hal_delay_ms`, `::hal_delay_until` or
+ * `::hal_task_wait_notification`.
+ * The clock reads `at_ns` when the task starts. Tasks run in the order of
+ * time, and those at the same time in the order they are scheduled. A task may schedule another task, and may
+ * wait for devices, during which other tasks may run.
+ *
+ * @param[in] at_ns
+ *
+ *   Time to run the task in nanoseconds. A past time runs the task at
+ *   the next wait.
+ *
+ * @param[in] task
+ *
+ *   Task to run.
+ *
+ * @param[in] arg
+ *
+ *   Passed to `task`.
+ *
+ * @return
+ *
+ *   `0` if scheduled, or `-1` if there are too many tasks.
+ */
+int hal_linux_schedule (int64_t at_ns, hal_linux_task task, void* arg);
+
+/**
+ * @brief Sets the time to write a GPIO pin.
+ *
+ * `HAL_LINUX_DEFAULT_GPIO_WRITE_NS` after `::hal_linux_reset`.
+ *
+ * @param[in] ns
+ *
+ *   Time in nanoseconds.
+ */
+void hal_linux_set_gpio_write_ns (int64_t ns);
+
+/**
+ * @brief Sets the time for a notified task to run again.
+ *
+ * A task waiting in `::hal_task_wait_notification` returns this long after
+ * `::hal_task_notify_from_isr`; e.g., the exit of the ISR and the context
+ * switch on an ESP32.
+ * `HAL_LINUX_DEFAULT_TASK_WAKEUP_NS` after `::hal_linux_reset`.
+ *
+ * @param[in] ns
+ *
+ *   Time in nanoseconds.
+ */
+void hal_linux_set_task_wakeup_ns (int64_t ns);
+
+/**
+ * @brief Sets the level of an input pin.
+ *
+ * Calls the interrupt handler if the level makes the registered edge.
+ *
+ * @param[in] pin
+ *
+ *   GPIO#.
+ *
+ * @param[in] level
+ *
+ *   `0` for LOW, `1` for HIGH.
+ */
+void hal_linux_set_input_level (int pin, int level);
+
+/**
+ * @brief Advances the clock.
+ *
+ * Runs tasks and starts queued transactions due by then.
+ *
+ * @param[in] ns
+ *
+ *   Time to advance in nanoseconds.
+ */
+void hal_linux_advance_time_ns (int64_t ns);
+
+/**
+ * @brief Current time of the clock.
+ *
+ * @return
+ *
+ *   Time in nanoseconds.
+ */
+int64_t hal_linux_get_time_ns (void);
+
+/**
+ * @brief Recorded events.
+ *
+ * @param[out] num_events
+ *
+ *   Receives the number of recorded events;
+ *   at most `HAL_LINUX_MAX_EVENTS`.
+ *
+ * @return
+ *
+ *   Recorded events in order.
+ */
+const hal_linux_event* hal_linux_get_events (size_t* num_events);
+
+/**
+ * @brief Obtains the accumulated costs.
+ *
+ * @param[out] stats
+ *
+ *   Receives the costs.
+ */
+void hal_linux_get_stats (hal_linux_stats* stats);
+
+/**
+ * @brief Costs between two `::hal_linux_get_stats`.
+ *
+ * @param[in] end
+ *
+ *   Later statistics.
+ *
+ * @param[in] start
+ *
+ *   Earlier statistics.
+ *
+ * @param[out] diff
+ *
+ *   Receives `end - start`. May be `end` or `start`.
+ */
+void hal_linux_stats_diff (
+		const hal_linux_stats* end,
+		const hal_linux_stats* start,
+		hal_linux_stats* diff);
+
+/**
+ * @brief Ratio of wire time to the bus time.
+ *
+ * Delays are excluded.
+ *
+ * @param[in] stats
+ *
+ *   Statistics.
+ *
+ * @return
+ *
+ *   `wire_ns / (wire_ns + overhead_ns)`. `0` if nothing happened.
+ */
+double hal_linux_stats_efficiency (const hal_linux_stats* stats);
+
+/**
+ * @brief Number of events including ones not recorded.
+ *
+ * @return
+ *
+ *   Number of events since the last `::hal_linux_reset`.
+ */
+size_t hal_linux_count_events (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * @file spi_bus_manager.c
+ *
+ * Implementation of the owner of a shared SPI bus.
+ */
+
+#include "spi_bus_manager.h"
+
+#include <assert.h>
+#include <string.h>
+
+/** @brief Error: invalid argument. Same as `ESP_ERR_INVALID_ARG`. */
+#define SPI_BUS_MANAGER_ERR_INVALID_ARG  0x102
+/** @brief Error: invalid state. Same as `ESP_ERR_INVALID_STATE`. */
+#define SPI_BUS_MANAGER_ERR_INVALID_STATE  0x103
+
+/**
+ * @brief Accumulates the timing of a transaction.
+ *
+ * Runs in an ISR on ESP-IDF. Only one transaction of a device ends at a time,
+ * so there is a single writer of the statistics.
+ *
+ * @param[in] arg
+ *
+ *   `::spi_bus_manager_device`.
+ *
+ * @param[in] queued_us
+ *
+ *   Time when the transaction was queued.
+ *
+ * @param[in] start_us
+ *
+ *   Time when the transaction started.
+ *
+ * @param[in] end_us
+ *
+ *   Time when the transaction ended.
+ */
+static void HAL_ISR_ATTR spi_bus_manager_on_transaction (
+		void* arg,
+		int64_t queued_us,
+		int64_t start_us,
+		int64_t end_us)
+{
+	spi_bus_manager_device* device = (spi_bus_manager_device*)arg;
+	const int64_t latency_us = start_us - queued_us;
+	++device->sequence;
+	__sync_synchronize();
+	++device->stats.num_transactions;
+	device->stats.busy_us += end_us - start_us;
+	device->stats.total_latency_us += latency_us;
+	if (latency_us > device->stats.max_latency_us) {
+		device->stats.max_latency_us = latency_us;
+	}
+	__sync_synchronize();
+	++device->sequence;
+}
+
+/**
+ * @brief Reads consistent statistics of a device.
+ *
+ * @param[in] device
+ *
+ *   Device.
+ *
+ * @param[out] stats
+ *
+ *   Receives the statistics.
+ */
+static void spi_bus_manager_read_stats (
+		const spi_bus_manager_device* device,
+		spi_bus_device_stats* stats)
+{
+	uint32_t sequence;
+	do {
+		sequence = device->sequence;
+		__sync_synchronize();
+		*stats = device->stats;
+		__sync_synchronize();
+	} while (((sequence & 1u) != 0u) || (sequence != device->sequence));
+}
+
+hal_err_t spi_bus_manager_add_device (
+		spi_bus_manager* manager,
+		const hal_spi_device_config* config,
+		int rank,
+		hal_spi_device* device)
+{
+	spi_bus_manager_device* slot;
+	if (manager->started ||
+		(manager->num_devices >= SPI_BUS_MANAGER_MAX_DEVICES))
+	{
+		return SPI_BUS_MANAGER_ERR_INVALID_STATE;
+	}
+	// the registration order is the order of service
+	assert((manager->num_devices == 0u) ||
+		(manager->devices[manager->num_devices - 1u].rank >= rank));
+	slot = &manager->devices[manager->num_devices++];
+	memset(slot, 0, sizeof(*slot));
+	slot->config = *config;
+	slot->config.on_transaction = spi_bus_manager_on_transaction;
+	slot->config.arg = slot;
+	slot->rank = rank;
+	slot->handle = device;
+	return HAL_OK;
+}
+
+hal_err_t spi_bus_manager_start (spi_bus_manager* manager) {
+	spi_bus_manager_device* device;
+	hal_err_t ret;
+	size_t i;
+	if (manager->started) {
+		return SPI_BUS_MANAGER_ERR_INVALID_STATE;
+	}
+	ret = hal_spi_bus_init(&manager->bus);
+	if (ret != HAL_OK) {
+		return ret;
+	}
+	for (i = 0u; i < manager->num_devices; ++i) {
+		device = &manager->devices[i];
+		ret = hal_spi_bus_add_device(
+			&manager->bus,
+			&device->config,
+			device->handle);
+		if (ret != HAL_OK) {
+			return ret;
+		}
+	}
+	manager->started = 1;
+	manager->start_us = hal_get_time_us();
+	return HAL_OK;
+}
+
+hal_err_t spi_bus_manager_get_stats (
+		const spi_bus_manager* manager,
+		hal_spi_device device,
+		spi_bus_device_stats* stats)
+{
+	spi_bus_device_stats device_stats;
+	size_t i;
+	if (device != NULL) {
+		for (i = 0u; i < manager->num_devices; ++i) {
+			if (*manager->devices[i].handle == device) {
+				spi_bus_manager_read_stats(&manager->devices[i], stats);
+				return HAL_OK;
+			}
+		}
+		return SPI_BUS_MANAGER_ERR_INVALID_ARG;
+	}
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0u; i < manager->num_devices; ++i) {
+		spi_bus_manager_read_stats(&manager->devices[i], &device_stats);
+		stats->num_transactions += device_stats.num_transactions;
+		stats->busy_us += device_stats.busy_us;
+		stats->total_latency_us += device_stats.total_latency_us;
+		if (device_stats.max_latency_us > stats->max_latency_us) {
+			stats->max_latency_us = device_stats.max_latency_us;
+		}
+	}
+	return HAL_OK;
+}
+
+uint32_t spi_bus_manager_utilization (const spi_bus_manager* manager) {
+	const int64_t elapsed_us = hal_get_time_us() - manager->start_us;
+	spi_bus_device_stats stats;
+	spi_bus_manager_get_stats(manager, NULL, &stats);
+	if (elapsed_us <= 0) {
+		return 0u;
+	}
+	return (uint32_t)((stats.busy_us * 1000) / elapsed_us);
+}
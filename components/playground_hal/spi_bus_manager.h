@@ -0,0 +1,229 @@
+#ifndef _SPI_BUS_MANAGER_H
+#define _SPI_BUS_MANAGER_H
+
+/**
+ * @file spi_bus_manager.h
+ *
+ * Owner of an SPI bus shared by several devices.
+ *
+ * There is no arbitration of its own. Devices are registered in the order
+ * they should be served, and `::spi_bus_manager_start` initializes the bus
+ * and adds them in that registration order. Because the SPI master driver
+ * serves the device added earliest first when queued transactions of more
+ * than one device are waiting, a queued transaction of a device registered
+ * earlier starts as soon as the transaction in progress ends; e.g., between
+ * chunks of a long transfer of a display. So a device registered later
+ * should split its transfers into chunks short enough for the earlier ones
+ * to wait.
+ *
+ * Polling transactions (`::hal_spi_transmit`) bypass that order: one takes
+ * the bus as soon as the transaction in progress ends, ahead of queued
+ * transactions of any device, and a device registered earlier waits for it.
+ * Keep polling transactions short on a shared bus; e.g., a register access.
+ *
+ * Each device is registered with a rank, which states the intended order:
+ * the ranks must not increase in registration order, and
+ * `::spi_bus_manager_add_device` asserts it.
+ *
+ * The manager also measures how long the bus is busy for each device,
+ * and how long transactions wait to start.
+ */
+
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of devices on a bus. */
+#define SPI_BUS_MANAGER_MAX_DEVICES  HAL_SPI_MAX_DEVICES
+
+/**
+ * @brief Statistics of transactions of a device.
+ */
+typedef struct spi_bus_device_stats_t {
+	/** @brief Number of transactions. */
+	uint32_t num_transactions;
+	/** @brief Time from the starts to the ends of transactions in us. */
+	int64_t busy_us;
+	/** @brief Sum of times from queueing to starting transactions in us. */
+	int64_t total_latency_us;
+	/** @brief Longest time from queueing to starting a transaction in us. */
+	int64_t max_latency_us;
+} spi_bus_device_stats;
+
+/**
+ * @brief Device registered with a `::spi_bus_manager`.
+ */
+typedef struct spi_bus_manager_device_t {
+	/** @brief Configuration of the device. */
+	hal_spi_device_config config;
+	/** @brief Rank in the registration order. Larger is served earlier. */
+	int rank;
+	/** @brief Receives the handle at `::spi_bus_manager_start`. */
+	hal_spi_device* handle;
+	/**
+	 * @brief Incremented before and after `stats` is updated.
+	 *
+	 * `stats` is being updated while this is odd.
+	 */
+	volatile uint32_t sequence;
+	/** @brief Statistics. Updated in an ISR on ESP-IDF. */
+	spi_bus_device_stats stats;
+} spi_bus_manager_device;
+
+/**
+ * @brief Owner of an SPI bus.
+ *
+ * Initialize with `::spi_bus_manager_initializer`.
+ */
+typedef struct spi_bus_manager_t {
+	/** @brief Configuration of the bus. */
+	hal_spi_bus_config bus;
+	/** @brief Registered devices. */
+	spi_bus_manager_device devices[SPI_BUS_MANAGER_MAX_DEVICES];
+	/** @brief Number of registered devices. */
+	size_t num_devices;
+	/** @brief Whether the bus has been started. */
+	int started;
+	/** @brief Time when the bus was started in microseconds. */
+	int64_t start_us;
+} spi_bus_manager;
+
+/**
+ * @brief Initializer of a `::spi_bus_manager`.
+ *
+ * @param[in] host
+ *
+ *   SPI host; `spi_host_device_t` on ESP-IDF.
+ *
+ * @param[in] mosi_pin
+ *
+ *   GPIO# for MOSI.
+ *
+ * @param[in] miso_pin
+ *
+ *   GPIO# for MISO.
+ *
+ * @param[in] clk_pin
+ *
+ *   GPIO# for SCLK.
+ *
+ * @param[in] max_transfer_size
+ *
+ *   Maximum length of a transaction in bytes. `0` for the default.
+ *
+ * @param[in] dma_channel
+ *
+ *   DMA channel. `0` does not use DMA.
+ */
+#define spi_bus_manager_initializer(_host, _mosi_pin, _miso_pin, _clk_pin, _max_transfer_size, _dma_channel) \
+{ \
+	.bus = { \
+		.host = (_host), \
+		.mosi_pin = (_mosi_pin), \
+		.miso_pin = (_miso_pin), \
+		.clk_pin = (_clk_pin), \
+		.max_transfer_size = (_max_transfer_size), \
+		.dma_channel = (_dma_channel) \
+	}, \
+	.num_devices = 0u, \
+	.started = 0, \
+	.start_us = 0 \
+}
+
+/**
+ * @brief Registers a device.
+ *
+ * The device is added to the bus at `::spi_bus_manager_start`, after
+ * the devices registered before it.
+ *
+ * @param[in,out] manager
+ *
+ *   Manager not started yet.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the device. Copied.
+ *   `on_transaction` and `arg` are replaced by the manager.
+ *
+ * @param[in] rank
+ *
+ *   Rank of the device. Larger is served earlier.
+ *   Must not be larger than the rank of the device registered before;
+ *   i.e., register devices in descending order of rank.
+ *
+ * @param[out] device
+ *
+ *   Receives the handle of the device at `::spi_bus_manager_start`.
+ *   Must live until then.
+ *
+ * @return
+ *
+ *   `HAL_OK`, or an error if the manager has started or is full.
+ */
+hal_err_t spi_bus_manager_add_device (
+		spi_bus_manager* manager,
+		const hal_spi_device_config* config,
+		int rank,
+		hal_spi_device* device);
+
+/**
+ * @brief Initializes the bus and adds registered devices to it.
+ *
+ * @param[in,out] manager
+ *
+ *   Manager to start.
+ *
+ * @return
+ *
+ *   `HAL_OK` or an error.
+ */
+hal_err_t spi_bus_manager_start (spi_bus_manager* manager);
+
+/**
+ * @brief Obtains the statistics of a device.
+ *
+ * @param[in] manager
+ *
+ *   Started manager.
+ *
+ * @param[in] device
+ *
+ *   Handle of the device. `NULL` sums up all the devices.
+ *
+ * @param[out] stats
+ *
+ *   Receives the statistics.
+ *
+ * @return
+ *
+ *   `HAL_OK`, or an error if `device` is not on the bus.
+ */
+hal_err_t spi_bus_manager_get_stats (
+		const spi_bus_manager* manager,
+		hal_spi_device device,
+		spi_bus_device_stats* stats);
+
+/**
+ * @brief Ratio of time that the bus is busy.
+ *
+ * @param[in] manager
+ *
+ *   Started manager.
+ *
+ * @return
+ *
+ *   Busy time of all the devices per elapsed time since
+ *   `::spi_bus_manager_start` in per mille.
+ */
+uint32_t spi_bus_manager_utilization (const spi_bus_manager* manager);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
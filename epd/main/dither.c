@@ -0,0 +1,165 @@
+/**
+ * @file dither.c
+ *
+ * Implementation of dithering.
+ */
+
+#include "dither.h"
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * @brief Thresholds of ordered dithering.
+ *
+ * `4 * m + 1` where `m` is an element of the 8x8 Bayer matrix.
+ * A pixel brighter than a threshold is white.
+ */
+static const uint8_t DITHER_ORDERED_THRESHOLDS[8][8] = {
+	{   1u, 129u,  33u, 161u,   9u, 137u,  41u, 169u },
+	{ 193u,  65u, 225u,  97u, 201u,  73u, 233u, 105u },
+	{  49u, 177u,  17u, 145u,  57u, 185u,  25u, 153u },
+	{ 241u, 113u, 209u,  81u, 249u, 121u, 217u,  89u },
+	{  13u, 141u,  45u, 173u,   5u, 133u,  37u, 165u },
+	{ 205u,  77u, 237u, 109u, 197u,  69u, 229u, 101u },
+	{  61u, 189u,  29u, 157u,  53u, 181u,  21u, 149u },
+	{ 253u, 125u, 221u,  93u, 245u, 117u, 213u,  85u }
+};
+
+/**
+ * @brief Dithers a row with a fixed threshold.
+ */
+static void dither_threshold_row (
+		const dither* dither,
+		const uint8_t* gray,
+		uint8_t* row)
+{
+	uint8_t bits = 0u;
+	int x;
+	for (x = 0; x < dither->width; ++x) {
+		bits = (uint8_t)((bits << 1) | (gray[x] > 127u));
+		if ((x & 7) == 7) {
+			*row++ = bits;
+		}
+	}
+	if ((x & 7) != 0) {
+		*row = (uint8_t)(bits << (8 - (x & 7)));
+	}
+}
+
+/**
+ * @brief Dithers a row with the Bayer matrix.
+ */
+static void dither_ordered_row (
+		const dither* dither,
+		const uint8_t* gray,
+		uint8_t* row)
+{
+	const uint8_t* thresholds = DITHER_ORDERED_THRESHOLDS[dither->y & 7u];
+	uint8_t bits = 0u;
+	int x;
+	for (x = 0; x < dither->width; ++x) {
+		bits = (uint8_t)((bits << 1) | (gray[x] > thresholds[x & 7]));
+		if ((x & 7) == 7) {
+			*row++ = bits;
+		}
+	}
+	if ((x & 7) != 0) {
+		*row = (uint8_t)(bits << (8 - (x & 7)));
+	}
+}
+
+/**
+ * @brief Dithers a row with Floyd-Steinberg error diffusion.
+ *
+ * `errors[x + 1]` holds the error diffused to the pixel `x` in the current
+ * row until the pixel is processed, then the error diffused to the pixel
+ * `x` in the next row.
+ * `errors[0]` receives the error diffused to the left of the image, and is
+ * discarded.
+ * Errors are divided with truncation toward zero, and the remainder goes
+ * to the lower right so that no error is lost.
+ */
+static void dither_floyd_steinberg_row (
+		dither* dither,
+		const uint8_t* gray,
+		uint8_t* row)
+{
+	int16_t* errors = dither->errors;
+	int right = 0;
+	int lower_right = 0;
+	int value;
+	int error;
+	int e7;
+	int e3;
+	int e5;
+	uint8_t bits = 0u;
+	int x;
+	if (dither->y == 0u) {
+		memset(errors, 0, DITHER_ERROR_BUFFER_SIZE(dither->width) * sizeof(int16_t));
+	}
+	errors[0] = 0;
+	for (x = 0; x < dither->width; ++x) {
+		value = gray[x] + right + errors[x + 1];
+		if (value > 127) {
+			bits = (uint8_t)((bits << 1) | 1u);
+			error = value - 255;
+		} else {
+			bits = (uint8_t)(bits << 1);
+			error = value;
+		}
+		e7 = (error * 7) / 16;
+		e3 = (error * 3) / 16;
+		e5 = (error * 5) / 16;
+		errors[x] = (int16_t)(errors[x] + e3);
+		errors[x + 1] = (int16_t)(e5 + lower_right);
+		lower_right = error - e7 - e3 - e5;
+		right = e7;
+		if ((x & 7) == 7) {
+			*row++ = bits;
+		}
+	}
+	if ((x & 7) != 0) {
+		*row = (uint8_t)(bits << (8 - (x & 7)));
+	}
+}
+
+void dither_reset (dither* dither) {
+	dither->y = 0u;
+}
+
+void dither_convert_row (
+		dither* dither,
+		const uint8_t* gray,
+		uint8_t* row)
+{
+	switch (dither->method) {
+	case DITHER_THRESHOLD:
+		dither_threshold_row(dither, gray, row);
+		break;
+	case DITHER_ORDERED:
+		dither_ordered_row(dither, gray, row);
+		break;
+	case DITHER_FLOYD_STEINBERG:
+		assert(dither->errors != NULL);
+		dither_floyd_steinberg_row(dither, gray, row);
+		break;
+	default:
+		assert(0);
+		break;
+	}
+	++dither->y;
+}
+
+void dither_draw_row (
+		dither* dither,
+		image_buffer* buffer,
+		const uint8_t* gray,
+		int left,
+		int top)
+{
+	uint8_t row[(DITHER_MAX_WIDTH + 7u) / 8u];
+	assert(dither->width <= DITHER_MAX_WIDTH);
+	dither_convert_row(dither, gray, row);
+	image_buffer_draw_image(buffer, row, left, top, dither->width, 1);
+}
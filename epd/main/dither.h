@@ -0,0 +1,174 @@
+#ifndef _DITHER_H
+#define _DITHER_H
+
+/**
+ * @file dither.h
+ *
+ * Dithering of 8-bit grayscale images into black-and-white binary images.
+ *
+ * An image is converted row by row, and only a single row of errors is
+ * kept in memory even for error diffusion.
+ * `py/make_binary_image.py` implements the same algorithms
+ * (`--dither` option), so it gives the same results as this module.
+ */
+
+#include "image_buffer.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum width of an image to be dithered.
+ *
+ * Same as the maximum row size of `::rle_image`.
+ */
+#define DITHER_MAX_WIDTH  800u
+
+/**
+ * @brief Number of `int16_t` elements in an error buffer.
+ *
+ * @param[in] width
+ *
+ *   Width of an image to be dithered.
+ *
+ * @return
+ *
+ *   Number of elements in an error buffer for `width`.
+ */
+#define DITHER_ERROR_BUFFER_SIZE(width)  ((width) + 1u)
+
+/**
+ * @brief Dithering method.
+ */
+typedef enum dither_method_t {
+	/** @brief Pixels brighter than `127` are white without dithering. */
+	DITHER_THRESHOLD = 0,
+	/** @brief Ordered dithering with an 8x8 Bayer matrix. */
+	DITHER_ORDERED,
+	/** @brief Floyd-Steinberg error diffusion. */
+	DITHER_FLOYD_STEINBERG
+} dither_method;
+
+/**
+ * @brief State of dithering an image.
+ */
+typedef struct dither_t {
+	/** @brief Dithering method. */
+	dither_method method;
+	/** @brief Width of the image. */
+	uint16_t width;
+	/** @brief Index of the next row. */
+	uint16_t y;
+	/**
+	 * @brief Errors diffused to the next row.
+	 *
+	 * Has `DITHER_ERROR_BUFFER_SIZE(width)` elements.
+	 * Used only by `DITHER_FLOYD_STEINBERG`.
+	 */
+	int16_t* errors;
+} dither;
+
+/**
+ * @brief Initializer of a `::dither`.
+ *
+ * @param[in] _method
+ *
+ *   (`dither_method`) Dithering method.
+ *
+ * @param[in] _width
+ *
+ *   (`uint16_t`) Width of the image.
+ *   Must not exceed `DITHER_MAX_WIDTH`.
+ *
+ * @param[in] _errors
+ *
+ *   (`int16_t*`) Error buffer.
+ *   You have to allocate `DITHER_ERROR_BUFFER_SIZE(_width)` elements.
+ *   May be `NULL` unless `_method` is `DITHER_FLOYD_STEINBERG`.
+ *   Need not be initialized.
+ *
+ * @return
+ *
+ *   Initializer of a `::dither`.
+ */
+#define dither_initializer(_method, _width, _errors) \
+{ \
+	.method = (_method), \
+	.width = (_width), \
+	.y = 0u, \
+	.errors = (_errors) \
+}
+
+/**
+ * @brief Restarts from the first row.
+ *
+ * Call this function before dithering another image with the same
+ * `::dither`.
+ *
+ * @param[in,out] dither
+ *
+ *   `::dither` to be reset.
+ */
+void dither_reset (dither* dither);
+
+/**
+ * @brief Dithers the next row.
+ *
+ * @param[in,out] dither
+ *
+ *   State of dithering.
+ *
+ * @param[in] gray
+ *
+ *   8-bit grayscale pixels of the row; `0` is black and `255` is white.
+ *   Has `width` pixels.
+ *
+ * @param[out] row
+ *
+ *   Block to receive the packed row, `1` is white.
+ *   Has to be as large as `(width + 7) / 8` bytes.
+ *   The last byte is padded with zeros.
+ */
+void dither_convert_row (
+		dither* dither,
+		const uint8_t* gray,
+		uint8_t* row);
+
+/**
+ * @brief Dithers the next row and draws it in an `::image_buffer`.
+ *
+ * @param[in,out] dither
+ *
+ *   State of dithering.
+ *
+ * @param[in,out] buffer
+ *
+ *   `::image_buffer` where the row is to be drawn.
+ *
+ * @param[in] gray
+ *
+ *   8-bit grayscale pixels of the row.
+ *
+ * @param[in] left
+ *
+ *   Left position of the row.
+ *
+ * @param[in] top
+ *
+ *   Top position of the row.
+ */
+void dither_draw_row (
+		dither* dither,
+		image_buffer* buffer,
+		const uint8_t* gray,
+		int left,
+		int top);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
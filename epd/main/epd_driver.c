@@ -0,0 +1,1213 @@
+/**
+ * @file epd_driver.c
+ *
+ * Driver of EPDs with the SSD168x controllers.
+ */
+
+#include "epd_driver.h"
+
+#include "frame_diff.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef EPD_DRIVER_VERBOSE
+/**
+ * @brief Whether the driver prints every operation.
+ *
+ * Host tests and benchmarks define it `0` to keep their output readable.
+ */
+#define EPD_DRIVER_VERBOSE  1
+#endif
+
+#if EPD_DRIVER_VERBOSE
+/** @brief Prints a log of the driver. */
+#define EPD_LOG(...)  printf(__VA_ARGS__)
+#else
+/** @brief Prints a log of the driver. */
+#define EPD_LOG(...)  ((void)0)
+#endif
+
+/**
+ * @brief Size of the white block to clear an EPD.
+ *
+ * `::epd_clear_range` repeatedly sends this block.
+ */
+#define EPD_WHITE_BLOCK_SIZE  1000u
+
+/** @brief Number of blocks to stream a decoded image, strips or windows. */
+#define EPD_NUM_STREAM_BLOCKS  2
+
+/**
+ * @brief Timeout of waiting for the BUSY pin to go LOW (ms).
+ *
+ * Longer than a full refresh, which takes about 2 seconds on a 1.54" panel
+ * and about 4 seconds on a 4.2" panel.
+ */
+#define EPD_BUSY_TIMEOUT_MS  5000u
+
+/**
+ * @brief Maximum number of identical rows uploaded to join runs of
+ * changed rows.
+ *
+ * Setting the X and Y ranges for another run takes about as long as
+ * sending 8 rows at 20 MHz.
+ */
+#define EPD_DIFF_MAX_GAP  8u
+
+/** @brief Maximum number of runs of changed rows in a frame. */
+#define EPD_DIFF_MAX_RUNS  8
+
+/**
+ * @brief Number of bytes that take as long to send as setting the X and Y
+ * ranges of a window.
+ *
+ * A window costs 9 transactions before its data.
+ * `::epd_draw_image_buffer_changed` charges every window and run of rows
+ * this size on top of its data.
+ */
+#define EPD_WINDOW_SETUP_SIZE  500u
+
+/** @brief Driver Output Control command. */
+#define EPD_COMMAND_DRIVER_OUTPUT_CONTROL  0x01u
+/** @brief Data Entry Mode command. */
+#define EPD_COMMAND_DATA_ENTRY_MODE  0x11u
+/** @brief Software Reset command. */
+#define EPD_COMMAND_SW_RESET  0x12u
+/** @brief Temperature Sensor Control command. */
+#define EPD_COMMAND_TEMPERATURE_SENSOR_CONTROL  0x1Au
+/** @brief Master Activation command. */
+#define EPD_COMMAND_MASTER_ACTIVATION  0x20u
+/** @brief Display Update Control command. */
+#define EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2  0x22u
+/** @brief Write RAM (Black and White) command. */
+#define EPD_COMMAND_WRITE_RAM_BW  0x24u
+/**
+ * @brief Write RAM (Red) command.
+ *
+ * The red RAM holds the previous frame for a partial refresh.
+ */
+#define EPD_COMMAND_WRITE_RAM_RED  0x26u
+/**
+ * @brief Border Waveform Control command.
+ *
+ * Undocumented in the datasheet.
+ */
+#define EPD_COMMAND_BORDER_WAVEFORM_CONTROL  0x3Cu
+/** @brief RAM X Start / End Address command. */
+#define EPD_COMMAND_RAM_X_START_END_ADDRESS  0x44u
+/** @brief RAM Y Start / End Address command. */
+#define EPD_COMMAND_RAM_Y_START_END_ADDRESS  0x45u
+/** @brief RAM X Address command. */
+#define EPD_COMMAND_RAM_X_ADDRESS  0x4Eu
+/** @brief RAM Y Address command. */
+#define EPD_COMMAND_RAM_Y_ADDRESS  0x4Fu
+
+// Define `EPD_SPECIFY_TEMPERATURE` if you want to manually set temperature.
+// #define EPD_MANUAL_TEMPERATURE  1
+
+/** @brief Data for Data Entry Mode command. */
+static const uint8_t DATA_ENTRY_MODE_DATA[] = {
+	// b[2]: address counter direction. 0: x → y, 1: y → x
+	// b[1..0]:
+	// - 00(0): Y-decrement, X-decrement
+	// - 01(1): Y-decrement, X-increment
+	// - 10(2): Y-increment, X-decrement
+	// - 11(3): Y-increment, X-increment
+	0x03u
+};
+
+#ifdef  EPD_MANUAL_TEMPERATURE
+/**
+ * @brief Data for Temperature Sensor Control command.
+ *
+ * Represents 25℃.
+ *
+ * A fixed point number 8.4.
+ * Two's complement.
+ */
+static const uint8_t DATA_TEMPERATURE_SENSOR_CONTROL_25_C[] = {
+	// 25℃
+	// b[7..0]: integer part
+	25u,
+	// b[7..4]: fraction
+	0u
+};
+#endif
+
+/**
+ * @brief White block to clear an EPD.
+ *
+ * Directly transferred via DMA.
+ * Filled with `0xFF` by `::epd_clear_range`.
+ */
+static HAL_DMA_ATTR uint8_t white_block[EPD_WHITE_BLOCK_SIZE];
+
+/**
+ * @brief Blocks to stream a decoded image, strips of a frame, or rows of
+ * a window.
+ *
+ * Directly transferred via DMA.
+ * Shared by all of the EPDs, so the functions using them draw on one EPD
+ * at a time.
+ */
+static HAL_DMA_ATTR uint8_t stream_blocks
+	[EPD_NUM_STREAM_BLOCKS][EPD_STREAM_BLOCK_SIZE];
+
+void epd_device_init (
+		epd_device* epd,
+		const epd_panel* panel,
+		hal_spi_device spi,
+		int dc_pin,
+		int rst_pin,
+		int busy_pin,
+		uint8_t* panel_memory)
+{
+	image_buffer panel_image = image_buffer_initializer(
+		panel_memory,
+		panel->ram_width,
+		panel->height);
+	epd->panel = panel;
+	epd->spi = spi;
+	epd->dc_pin = dc_pin;
+	epd->rst_pin = rst_pin;
+	epd->busy_pin = busy_pin;
+	epd->panel_image = panel_image;
+	epd->busy_waiting_task = NULL;
+	epd->refreshing = 0;
+	epd->refresh_callbacks.on_started = NULL;
+	epd->refresh_callbacks.on_done = NULL;
+	epd->refresh_callbacks.user_data = NULL;
+	epd->max_partial_refreshes = panel->max_partial_refreshes;
+	epd->num_partial_refreshes = 0;
+}
+
+/**
+ * @brief Handles a falling edge of the BUSY pin.
+ *
+ * Wakes up the task waiting in `::epd_wait_busy_timeout` and notifies
+ * `epd_refresh_callbacks::on_done` if a refresh is in progress.
+ *
+ * @param[in] arg
+ *
+ *   (`::epd_device*`) EPD whose BUSY pin went LOW.
+ */
+static void HAL_ISR_ATTR epd_busy_isr_handler (void* arg) {
+	epd_device* epd = (epd_device*)arg;
+	hal_task waiting_task = epd->busy_waiting_task;
+	if (epd->refreshing) {
+		epd->refreshing = 0;
+		if (epd->refresh_callbacks.on_done != NULL) {
+			epd->refresh_callbacks.on_done(epd->refresh_callbacks.user_data);
+		}
+	}
+	if (waiting_task != NULL) {
+		hal_task_notify_from_isr(waiting_task);
+	}
+}
+
+void epd_set_refresh_callbacks (
+		epd_device* epd,
+		const epd_refresh_callbacks* callbacks)
+{
+	if (callbacks != NULL) {
+		epd->refresh_callbacks = *callbacks;
+	} else {
+		epd->refresh_callbacks.on_started = NULL;
+		epd->refresh_callbacks.on_done = NULL;
+		epd->refresh_callbacks.user_data = NULL;
+	}
+}
+
+void epd_configure_gpios (epd_device* epd) {
+	hal_err_t ret;
+	EPD_LOG("epd_configure_gpios\n");
+	ret = hal_gpio_set_isr(
+		epd->busy_pin,
+		HAL_GPIO_FALLING_EDGE,
+		epd_busy_isr_handler,
+		epd);
+	HAL_ERROR_CHECK(ret);
+	ret = hal_gpio_set_output(epd->rst_pin);
+	HAL_ERROR_CHECK(ret);
+	ret = hal_gpio_set_output(epd->dc_pin);
+	HAL_ERROR_CHECK(ret);
+}
+
+void epd_reset (epd_device* epd) {
+	hal_err_t ret;
+	EPD_LOG("epd_reset\n");
+	ret = hal_gpio_set_level(epd->rst_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	hal_delay_ms(200);
+	ret = hal_gpio_set_level(epd->rst_pin, 0u);
+	HAL_ERROR_CHECK(ret);
+	hal_delay_ms(10);
+	ret = hal_gpio_set_level(epd->rst_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	hal_delay_ms(200);
+}
+
+hal_err_t epd_wait_busy_timeout (epd_device* epd, uint32_t timeout_ms) {
+	hal_err_t ret = HAL_OK;
+	EPD_LOG("epd_wait_busy\n");
+	// registers the task before checking the level,
+	// so that an edge between them is not missed
+	epd->busy_waiting_task = hal_task_current();
+	// discards a stale notification
+	hal_task_wait_notification(0u);
+	if (hal_gpio_get_level(epd->busy_pin) == 1u) {
+		if ((hal_task_wait_notification(timeout_ms) == 0u) &&
+			(hal_gpio_get_level(epd->busy_pin) == 1u))
+		{
+			ret = HAL_ERR_TIMEOUT;
+		}
+	}
+	epd->busy_waiting_task = NULL;
+	EPD_LOG("epd_wait_busy: %s\n", (ret == HAL_OK) ? "done" : "timeout");
+	return ret;
+}
+
+void epd_wait_busy (epd_device* epd) {
+	hal_err_t ret;
+	ret = epd_wait_busy_timeout(epd, EPD_BUSY_TIMEOUT_MS);
+	HAL_ERROR_CHECK(ret);
+}
+
+/**
+ * @brief Sends a command to an EPD.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] command
+ *
+ *   Command to be sent.
+ */
+static void epd_send_command (epd_device* epd, uint8_t command) {
+	hal_err_t ret;
+	hal_spi_transaction trans = {
+		.length = 8u, // in bits
+		.tx_buffer = &command
+	};
+	EPD_LOG("epd_send_command: 0x%02X\n", (int)command);
+	ret = hal_gpio_set_level(epd->dc_pin, 0u);
+	HAL_ERROR_CHECK(ret);
+	ret = hal_spi_transmit(epd->spi, &trans);
+	HAL_ERROR_CHECK(ret);
+}
+
+/**
+ * @brief Sends a single-byte data to an EPD.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] data
+ *
+ *   Data byte to be sent.
+ */
+static void epd_send_data_byte (epd_device* epd, uint8_t data) {
+	hal_err_t ret;
+	hal_spi_transaction trans = {
+		.length = 8u, // in bits
+		.tx_buffer = &data
+	};
+	ret = hal_gpio_set_level(epd->dc_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	ret = hal_spi_transmit(epd->spi, &trans);
+	HAL_ERROR_CHECK(ret);
+}
+
+/**
+ * @brief Sends data to an EPD.
+ *
+ * It will cause undefined behavior if `data` is `NULL` or does not point to
+ * a block smaller than `size`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] data
+ *
+ *   Data to be sent.
+ *
+ * @param[in] size_in_bytes
+ *
+ *   Number of bytes to be sent.
+ *   Subjects to the maximum size allowed in a single SPI transaction.
+ */
+static void epd_send_data (
+	epd_device* epd,
+	const uint8_t* data,
+	size_t size_in_bytes)
+{
+	hal_err_t ret;
+	hal_spi_transaction trans = {
+		.length = 8u * size_in_bytes, // in bits
+		.tx_buffer = data
+	};
+	ret = hal_gpio_set_level(epd->dc_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	ret = hal_spi_transmit(epd->spi, &trans);
+	HAL_ERROR_CHECK(ret);
+}
+
+/**
+ * @brief Sends bulk rows of data to an EPD via DMA.
+ *
+ * This function sets the DC pin only once, splits rows into chunks no
+ * larger than `EPD_MAX_TRANSFER_SIZE`, and queues them.
+ * Contiguous rows; i.e., `row_size == stride`, are sent as a single block.
+ * Blocks until all of the chunks are transferred.
+ *
+ * `data` has to be DMA-capable; i.e., must not reside in the flash.
+ *
+ * It will cause undefined behavior if `data` is `NULL` or does not point to
+ * a block smaller than `stride * (num_rows - 1) + row_size`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] data
+ *
+ *   Beginning of the first row to be sent.
+ *
+ * @param[in] row_size
+ *
+ *   Number of bytes to be sent from each row.
+ *
+ * @param[in] stride
+ *
+ *   Distance in bytes between the beginnings of adjacent rows.
+ *
+ * @param[in] num_rows
+ *
+ *   Number of rows to be sent.
+ */
+static void epd_send_rows_bulk (
+	epd_device* epd,
+	const uint8_t* data,
+	size_t row_size,
+	size_t stride,
+	size_t num_rows)
+{
+	hal_err_t ret;
+	hal_spi_transaction trans[EPD_TRANSACTION_QUEUE_SIZE];
+	hal_spi_transaction* done;
+	const uint8_t* row;
+	size_t chunk_size;
+	size_t remaining;
+	int num_queued = 0;
+	int next = 0;
+	if (row_size == stride) {
+		row_size *= num_rows;
+		num_rows = 1u;
+	}
+	ret = hal_gpio_set_level(epd->dc_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	for (; num_rows > 0u; --num_rows) {
+		row = data;
+		remaining = row_size;
+		while (remaining > 0u) {
+			if (num_queued == EPD_TRANSACTION_QUEUE_SIZE) {
+				// the oldest transaction is always done first,
+				// so its slot is the next one to be reused
+				ret = hal_spi_get_result(epd->spi, &done);
+				HAL_ERROR_CHECK(ret);
+				--num_queued;
+			}
+			chunk_size = MIN(remaining, EPD_MAX_TRANSFER_SIZE);
+			memset(&trans[next], 0, sizeof(trans[next]));
+			trans[next].length = 8u * chunk_size; // in bits
+			trans[next].tx_buffer = row;
+			ret = hal_spi_queue(epd->spi, &trans[next]);
+			HAL_ERROR_CHECK(ret);
+			++num_queued;
+			next = (next + 1) % EPD_TRANSACTION_QUEUE_SIZE;
+			row += chunk_size;
+			remaining -= chunk_size;
+		}
+		data += stride;
+	}
+	while (num_queued > 0) {
+		ret = hal_spi_get_result(epd->spi, &done);
+		HAL_ERROR_CHECK(ret);
+		--num_queued;
+	}
+}
+
+/**
+ * @brief Sends bulk data to an EPD via DMA.
+ *
+ * See `::epd_send_rows_bulk` for details.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] data
+ *
+ *   Data to be sent.
+ *   Has to be DMA-capable.
+ *
+ * @param[in] size_in_bytes
+ *
+ *   Number of bytes to be sent.
+ */
+static void epd_send_data_bulk (
+	epd_device* epd,
+	const uint8_t* data,
+	size_t size_in_bytes)
+{
+	epd_send_rows_bulk(epd, data, size_in_bytes, size_in_bytes, 1u);
+}
+
+/**
+ * @brief Sends short rows of data to an EPD through the stream blocks.
+ *
+ * Rows are packed into a stream block while the previous block is
+ * transferred, so a narrow window costs a transaction per block instead of
+ * a transaction per row. The controller wraps the address at the end of
+ * the X range, so packed rows land in the rows of the window.
+ *
+ * This function sets the DC pin only once.
+ * Blocks until all of the blocks are transferred.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] data
+ *
+ *   Beginning of the first row to be sent.
+ *
+ * @param[in] row_size
+ *
+ *   Number of bytes to be sent from each row.
+ *   Must not exceed `EPD_STREAM_BLOCK_SIZE`.
+ *
+ * @param[in] stride
+ *
+ *   Distance in bytes between the beginnings of adjacent rows.
+ *
+ * @param[in] num_rows
+ *
+ *   Number of rows to be sent.
+ */
+static void epd_send_rows_packed (
+	epd_device* epd,
+	const uint8_t* data,
+	size_t row_size,
+	size_t stride,
+	size_t num_rows)
+{
+	hal_err_t ret;
+	hal_spi_transaction trans[EPD_NUM_STREAM_BLOCKS];
+	hal_spi_transaction* done;
+	size_t fill;
+	int num_queued = 0;
+	int next = 0;
+	assert(row_size <= EPD_STREAM_BLOCK_SIZE);
+	ret = hal_gpio_set_level(epd->dc_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	while (num_rows > 0u) {
+		if (num_queued == EPD_NUM_STREAM_BLOCKS) {
+			// the oldest block is the next one to be filled
+			ret = hal_spi_get_result(epd->spi, &done);
+			HAL_ERROR_CHECK(ret);
+			--num_queued;
+		}
+		fill = 0u;
+		while ((num_rows > 0u) && ((fill + row_size) <= EPD_STREAM_BLOCK_SIZE)) {
+			memcpy(&stream_blocks[next][fill], data, row_size);
+			fill += row_size;
+			data += stride;
+			--num_rows;
+		}
+		memset(&trans[next], 0, sizeof(trans[next]));
+		trans[next].length = 8u * fill; // in bits
+		trans[next].tx_buffer = stream_blocks[next];
+		ret = hal_spi_queue(epd->spi, &trans[next]);
+		HAL_ERROR_CHECK(ret);
+		++num_queued;
+		next = (next + 1) % EPD_NUM_STREAM_BLOCKS;
+	}
+	while (num_queued > 0) {
+		ret = hal_spi_get_result(epd->spi, &done);
+		HAL_ERROR_CHECK(ret);
+		--num_queued;
+	}
+}
+
+/**
+ * @brief Sets the x address range of an EPD.
+ *
+ * The current x address is reset to `start`.
+ *
+ * **Limitation:**
+ * `start` and `end` are rounded to a largest multiple of 8 not exceeding it.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] start
+ *
+ *   Start x (**inclusive**).
+ *
+ * @param[in] end
+ *
+ *   End x (**inclusive**).
+ */
+static void epd_set_x_range (
+	epd_device* epd,
+	uint32_t start,
+	uint32_t end)
+{
+	uint8_t data[] = {
+		(uint8_t)(start / 8u),
+		(uint8_t)(end / 8u)
+	};
+	EPD_LOG("epd_set_x_range: %d, %d\n", (int)start, (int)end);
+	epd_send_command(epd, EPD_COMMAND_RAM_X_START_END_ADDRESS);
+	epd_send_data(epd, data, sizeof(data));
+	epd_send_command(epd, EPD_COMMAND_RAM_X_ADDRESS);
+	epd_send_data_byte(epd, data[0]);
+}
+
+/**
+ * @brief Sets the y address range of an EPD.
+ *
+ * The current y address is reset to `start`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] start
+ *
+ *   Start y (**inclusive**).
+ *
+ * @param[in] end
+ *
+ *   End y (**inclusive**).
+ */
+static void epd_set_y_range (
+	epd_device* epd,
+	uint32_t start,
+	uint32_t end)
+{
+	uint8_t data[] = {
+		// b[7..0]: lower bits of the start y
+		(uint8_t)start,
+		// b[0]: upper bit of the start y
+		(uint8_t)((start >> 8) & 0x1u),
+		// b[7..0]: lower bits of the end y
+		(uint8_t)end,
+		// b[0]: upper bit of the end y
+		(uint8_t)((end >> 8) & 0x1u)
+	};
+	EPD_LOG("epd_set_y_range: %d, %d\n", (int)start, (int)end);
+	epd_send_command(epd, EPD_COMMAND_RAM_Y_START_END_ADDRESS);
+	epd_send_data(epd, data, sizeof(data));
+	epd_send_command(epd, EPD_COMMAND_RAM_Y_ADDRESS);
+	epd_send_data(epd, data, 2u);
+}
+
+void epd_set_border (epd_device* epd, uint8_t fill) {
+	uint8_t data = (fill == 0u) ? 0u : 1u;
+	EPD_LOG("epd_set_border: 0x%02X\n", (int)fill);
+	epd_send_command(epd, EPD_COMMAND_BORDER_WAVEFORM_CONTROL);
+	epd_send_data_byte(epd, data);
+}
+
+void epd_initialize (epd_device* epd) {
+	uint8_t driver_output_control_data[3];
+	EPD_LOG("epd_initialize: %s\n", epd->panel->name);
+	epd_reset(epd);
+	// panel reset
+	epd_wait_busy(epd);
+	epd_send_command(epd, EPD_COMMAND_SW_RESET);
+	epd_wait_busy(epd);
+	// data output control
+	epd_panel_driver_output_control(epd->panel, driver_output_control_data);
+	epd_send_command(epd, EPD_COMMAND_DRIVER_OUTPUT_CONTROL);
+	epd_send_data(
+		epd,
+		driver_output_control_data,
+		sizeof(driver_output_control_data));
+	// data entry mode
+	epd_send_command(epd, EPD_COMMAND_DATA_ENTRY_MODE);
+	epd_send_data(
+		epd,
+		DATA_ENTRY_MODE_DATA,
+		sizeof(DATA_ENTRY_MODE_DATA));
+	// RAM X start / end address
+	epd_set_x_range(epd, 0u, epd->panel->ram_width - 1u);
+	// RAM Y start / end address
+	epd_set_y_range(epd, 0u, epd->panel->height - 1u);
+	// Border Waveform Control
+	epd_set_border(epd, 0u); // black border
+	// without setting temperature, a display gets noisy
+#ifdef  EPD_MANUAL_TEMPERATURE
+	// Temperature Sensor Control
+	// supposes the temperature is 25℃
+	epd_send_command(epd, EPD_COMMAND_TEMPERATURE_SENSOR_CONTROL);
+	epd_send_data(
+		epd,
+		DATA_TEMPERATURE_SENSOR_CONTROL_25_C,
+		sizeof(DATA_TEMPERATURE_SENSOR_CONTROL_25_C));
+#else
+	// 0x18 is an unknown command
+	// so far I guess that it turns automatic temperature sensing on
+	// https://github.com/waveshare/e-Paper/blob/8973995e53cb78bac6d1f8a66c2d398c18392f71/RaspberryPi%26JetsonNano/c/lib/e-Paper/EPD_1in54_V2.c#L150-L151
+	epd_send_command(epd, 0x18u);
+	epd_send_data_byte(epd, 0x80u);
+#endif
+}
+
+/**
+ * @brief Starts a given display update sequence of an EPD.
+ *
+ * Notifies `epd_refresh_callbacks::on_started` and returns without waiting
+ * for the BUSY pin.
+ * `epd_refresh_callbacks::on_done` is notified when the BUSY pin goes LOW.
+ *
+ * Call `::epd_wait_busy` before sending another command.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] sequence
+ *
+ *   Display update sequence; e.g., `epd_sequences::display_1` of the panel.
+ */
+static void epd_activate (epd_device* epd, uint8_t sequence) {
+	epd_send_command(epd, EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2);
+	epd_send_data_byte(epd, sequence);
+	epd->refreshing = 1;
+	epd_send_command(epd, EPD_COMMAND_MASTER_ACTIVATION);
+	if (epd->refresh_callbacks.on_started != NULL) {
+		epd->refresh_callbacks.on_started(epd->refresh_callbacks.user_data);
+	}
+}
+
+void epd_enable_display_mode_1 (epd_device* epd) {
+	EPD_LOG("epd_enable_display_mode_1\n");
+	epd_activate(epd, epd->panel->sequences.load_lut_1);
+	epd_wait_busy(epd);
+}
+
+void epd_enable_display_mode_2 (epd_device* epd) {
+	EPD_LOG("epd_enable_display_mode_2\n");
+	epd_activate(epd, epd->panel->sequences.load_lut_2);
+	epd_wait_busy(epd);
+}
+
+void epd_start_refresh_display_mode_1 (epd_device* epd) {
+	EPD_LOG("epd_start_refresh_display_mode_1\n");
+	epd_activate(epd, epd->panel->sequences.display_1);
+}
+
+void epd_start_refresh_display_mode_2 (epd_device* epd) {
+	EPD_LOG("epd_start_refresh_display_mode_2\n");
+	epd_activate(epd, epd->panel->sequences.display_2);
+}
+
+void epd_refresh_display_mode_1 (epd_device* epd) {
+	epd_start_refresh_display_mode_1(epd);
+	epd_wait_busy(epd);
+}
+
+void epd_refresh_display_mode_2 (epd_device* epd) {
+	epd_start_refresh_display_mode_2(epd);
+	epd_wait_busy(epd);
+}
+
+void epd_start_refresh_full (epd_device* epd) {
+	EPD_LOG("epd_start_refresh_full\n");
+	epd_activate(epd, epd->panel->sequences.full);
+}
+
+void epd_start_refresh_partial (epd_device* epd) {
+	EPD_LOG("epd_start_refresh_partial\n");
+	epd_activate(epd, epd->panel->sequences.partial);
+}
+
+void epd_start_refresh_partial_mode (epd_device* epd) {
+	if (epd->num_partial_refreshes < epd->max_partial_refreshes) {
+		epd_start_refresh_partial(epd);
+		++epd->num_partial_refreshes;
+	} else {
+		epd_start_refresh_full(epd);
+		epd->num_partial_refreshes = 0;
+	}
+}
+
+void epd_clear_range (
+		epd_device* epd,
+		uint32_t left,
+		uint32_t top,
+		uint32_t width,
+		uint32_t height)
+{
+	size_t chunk_size;
+	size_t data_size = (size_t)(height * (width / 8u));
+	assert((left % 8u) == 0u);
+	assert((width % 8u) == 0u);
+	EPD_LOG(
+		"epd_clear_range: x=%d, y=%d, w=%d, h=%d\n",
+		(int)left,
+		(int)top,
+		(int)width,
+		(int)height);
+	epd_set_x_range(epd, left, left + (width - 1u));
+	epd_set_y_range(epd, top, top + (height - 1u));
+	epd_send_command(epd, EPD_COMMAND_WRITE_RAM_BW);
+	memset(white_block, 0xFF, sizeof(white_block));
+	while (data_size > 0u) {
+		chunk_size = MIN(data_size, sizeof(white_block));
+		epd_send_data_bulk(epd, white_block, chunk_size);
+		data_size -= chunk_size;
+	}
+	if (epd_has_panel_image(epd)) {
+		image_buffer_clear_range(&epd->panel_image, left, top, width, height);
+	}
+}
+
+void epd_clear_all (epd_device* epd) {
+	EPD_LOG("epd_clear_all\n");
+	epd_clear_range(epd, 0u, 0u, epd->panel->ram_width, epd->panel->height);
+}
+
+/**
+ * @brief Writes a given rectangle of an image buffer to a RAM of an EPD.
+ *
+ * This function leaves the X and Y ranges at `rect`.
+ *
+ * Rows in full width are contiguous, and the memory block of `buffer` is
+ * transferred via DMA, so it has to be DMA-capable.
+ * Narrower rows are packed into the stream blocks
+ * (see `::epd_send_rows_packed`).
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] command
+ *
+ *   `EPD_COMMAND_WRITE_RAM_BW` or `EPD_COMMAND_WRITE_RAM_RED`.
+ *
+ * @param[in] buffer
+ *
+ *   Image buffer to write.
+ *
+ * @param[in] rect
+ *
+ *   Rectangle to write. Left and right positions are multiples of `8`.
+ */
+static void epd_write_ram_rect (
+		epd_device* epd,
+		uint8_t command,
+		const image_buffer* buffer,
+		const image_buffer_rect* rect)
+{
+	const size_t stride = image_buffer_width(buffer) / 8u;
+	const size_t row_size = (rect->right - rect->left) / 8;
+	const uint8_t* data =
+		image_buffer_begin(buffer) + (rect->top * stride) + (rect->left / 8);
+	epd_set_x_range(epd, rect->left, rect->right - 1);
+	epd_set_y_range(epd, rect->top, rect->bottom - 1);
+	epd_send_command(epd, command);
+	if (row_size == stride) {
+		epd_send_rows_bulk(epd, data, row_size, stride, rect->bottom - rect->top);
+	} else {
+		epd_send_rows_packed(epd, data, row_size, stride, rect->bottom - rect->top);
+	}
+}
+
+/**
+ * @brief Copies a given rectangle of an image buffer to
+ * `epd_device::panel_image`.
+ *
+ * Call this function when the rectangle is written to the black and white
+ * RAM. The rectangle becomes dirty in `epd_device::panel_image`.
+ * Does nothing if the EPD keeps no copy of the RAM.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] buffer
+ *
+ *   Image buffer written to the EPD.
+ *
+ * @param[in] rect
+ *
+ *   Rectangle written to the EPD. Left and right positions are multiples of
+ *   `8`.
+ */
+static void epd_copy_to_panel_image (
+		epd_device* epd,
+		const image_buffer* buffer,
+		const image_buffer_rect* rect)
+{
+	const size_t src_stride = image_buffer_width(buffer) / 8u;
+	const size_t dst_stride = epd->panel->ram_width / 8u;
+	int y;
+	if (!epd_has_panel_image(epd)) {
+		return;
+	}
+	if ((rect->left == 0) &&
+		((uint32_t)rect->right == epd->panel->ram_width) &&
+		(src_stride == dst_stride))
+	{
+		// whole rows, as a diff writes them, are copied at once
+		memcpy(
+			image_buffer_begin(&epd->panel_image) + (rect->top * dst_stride),
+			image_buffer_begin(buffer) + (rect->top * src_stride),
+			(rect->bottom - rect->top) * dst_stride);
+	} else {
+		for (y = rect->top; y < rect->bottom; ++y) {
+			memcpy(
+				image_buffer_begin(&epd->panel_image) +
+					(y * dst_stride) +
+					(rect->left / 8),
+				image_buffer_begin(buffer) + (y * src_stride) + (rect->left / 8),
+				(rect->right - rect->left) / 8);
+		}
+	}
+	image_buffer_mark_dirty(
+		&epd->panel_image,
+		rect->left,
+		rect->top,
+		rect->right - rect->left,
+		rect->bottom - rect->top);
+}
+
+void epd_draw_image_buffer (
+		epd_device* epd,
+		const image_buffer* buffer)
+{
+	const image_buffer_rect all = { 0, 0, buffer->width, buffer->height };
+	EPD_LOG("epd_draw_image_buffer\n");
+	epd_set_x_range(epd, 0u, buffer->width - 1u);
+	epd_set_y_range(epd, 0u, buffer->height - 1u);
+	epd_send_command(epd, EPD_COMMAND_WRITE_RAM_BW);
+	epd_send_data_bulk(
+		epd,
+		image_buffer_begin(buffer),
+		image_buffer_end(buffer) - image_buffer_begin(buffer));
+	epd_copy_to_panel_image(epd, buffer, &all);
+}
+
+void epd_draw_image_buffer_dirty (
+		epd_device* epd,
+		image_buffer* buffer)
+{
+	const image_buffer_rect* rect;
+	int i;
+	EPD_LOG(
+		"epd_draw_image_buffer_dirty: %d rect(s)\n",
+		image_buffer_num_dirty_rects(buffer));
+	for (i = 0; i < image_buffer_num_dirty_rects(buffer); ++i) {
+		rect = image_buffer_dirty_rect(buffer, i);
+		epd_write_ram_rect(epd, EPD_COMMAND_WRITE_RAM_BW, buffer, rect);
+		epd_copy_to_panel_image(epd, buffer, rect);
+	}
+	image_buffer_clear_dirty(buffer);
+}
+
+/**
+ * @brief Writes given runs of rows of an image buffer to the black and white
+ * RAM of an EPD in full width.
+ *
+ * The dirty rectangles of `buffer` are cleared after the transfer.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in,out] buffer
+ *
+ *   Image buffer to write.
+ *
+ * @param[in] runs
+ *
+ *   Runs of rows to write, given by `::frame_diff_rows`.
+ *
+ * @param[in] num_runs
+ *
+ *   Number of `runs`.
+ */
+static void epd_write_row_runs (
+		epd_device* epd,
+		image_buffer* buffer,
+		const frame_diff_run* runs,
+		size_t num_runs)
+{
+	image_buffer_rect rect = { 0, 0, epd->panel->ram_width, 0 };
+	size_t i;
+	for (i = 0u; i < num_runs; ++i) {
+		rect.top = runs[i].top;
+		rect.bottom = runs[i].bottom;
+		epd_write_ram_rect(epd, EPD_COMMAND_WRITE_RAM_BW, buffer, &rect);
+		epd_copy_to_panel_image(epd, buffer, &rect);
+	}
+	image_buffer_clear_dirty(buffer);
+}
+
+void epd_draw_image_buffer_diff (
+		epd_device* epd,
+		image_buffer* buffer)
+{
+	frame_diff_run runs[EPD_DIFF_MAX_RUNS];
+	size_t num_runs;
+	assert(epd_has_panel_image(epd));
+	num_runs = frame_diff_rows(
+		buffer,
+		&epd->panel_image,
+		EPD_DIFF_MAX_GAP,
+		runs,
+		EPD_DIFF_MAX_RUNS);
+	EPD_LOG("epd_draw_image_buffer_diff: %d run(s)\n", (int)num_runs);
+	epd_write_row_runs(epd, buffer, runs, num_runs);
+}
+
+void epd_draw_image_buffer_changed (
+		epd_device* epd,
+		image_buffer* buffer)
+{
+	frame_diff_run runs[EPD_DIFF_MAX_RUNS];
+	const image_buffer_rect* rect;
+	const size_t stride = epd->panel->ram_width / 8u;
+	size_t num_runs;
+	size_t dirty_size = 0u;
+	size_t diff_size = 0u;
+	size_t i;
+	assert(epd_has_panel_image(epd));
+	num_runs = frame_diff_rows(
+		buffer,
+		&epd->panel_image,
+		EPD_DIFF_MAX_GAP,
+		runs,
+		EPD_DIFF_MAX_RUNS);
+	for (i = 0u; i < num_runs; ++i) {
+		diff_size += EPD_WINDOW_SETUP_SIZE +
+			((runs[i].bottom - runs[i].top) * stride);
+	}
+	for (i = 0u; i < (size_t)image_buffer_num_dirty_rects(buffer); ++i) {
+		rect = image_buffer_dirty_rect(buffer, (int)i);
+		dirty_size += EPD_WINDOW_SETUP_SIZE +
+			(((rect->right - rect->left) / 8) * (rect->bottom - rect->top));
+	}
+	EPD_LOG(
+		"epd_draw_image_buffer_changed: %d bytes in rect(s), %d bytes in run(s)\n",
+		(int)dirty_size,
+		(int)diff_size);
+	// a buffer without dirty rectangles may have been written directly
+	if ((image_buffer_num_dirty_rects(buffer) > 0) && (dirty_size < diff_size)) {
+		epd_draw_image_buffer_dirty(epd, buffer);
+	} else {
+		epd_write_row_runs(epd, buffer, runs, num_runs);
+	}
+}
+
+void epd_enable_partial_refresh (epd_device* epd) {
+	const image_buffer_rect all = {
+		0,
+		0,
+		epd->panel->ram_width,
+		epd->panel->height
+	};
+	EPD_LOG("epd_enable_partial_refresh\n");
+	assert(epd_has_panel_image(epd));
+	image_buffer_clear_all(&epd->panel_image);
+	image_buffer_clear_dirty(&epd->panel_image);
+	epd_write_ram_rect(epd, EPD_COMMAND_WRITE_RAM_RED, &epd->panel_image, &all);
+	epd_write_ram_rect(epd, EPD_COMMAND_WRITE_RAM_BW, &epd->panel_image, &all);
+	epd_start_refresh_full(epd);
+	epd_wait_busy(epd);
+	epd->num_partial_refreshes = 0;
+}
+
+void epd_draw_image_buffer_partial (
+		epd_device* epd,
+		image_buffer* buffer)
+{
+	int i;
+	EPD_LOG(
+		"epd_draw_image_buffer_partial: %d previous rect(s)\n",
+		image_buffer_num_dirty_rects(&epd->panel_image));
+	for (i = 0; i < image_buffer_num_dirty_rects(&epd->panel_image); ++i) {
+		epd_write_ram_rect(
+			epd,
+			EPD_COMMAND_WRITE_RAM_RED,
+			&epd->panel_image,
+			image_buffer_dirty_rect(&epd->panel_image, i));
+	}
+	image_buffer_clear_dirty(&epd->panel_image);
+	epd_draw_image_buffer_changed(epd, buffer);
+}
+
+int epd_draw_rle_image (
+		epd_device* epd,
+		const rle_image* image,
+		uint32_t left,
+		uint32_t top)
+{
+	hal_err_t ret;
+	rle_decoder decoder;
+	hal_spi_transaction trans[EPD_NUM_STREAM_BLOCKS];
+	hal_spi_transaction* done;
+	uint8_t row[RLE_IMAGE_MAX_ROW_SIZE];
+	const size_t row_size = rle_image_row_size(image);
+	const size_t panel_stride = epd->panel->ram_width / 8u;
+	size_t fill;
+	uint32_t y = 0u;
+	int result = 0;
+	int num_queued = 0;
+	int next = 0;
+	assert((left % 8u) == 0u);
+	assert(row_size <= RLE_IMAGE_MAX_ROW_SIZE);
+	assert((left + 8u * row_size) <= epd->panel->ram_width);
+	assert((top + image->height) <= epd->panel->height);
+	EPD_LOG(
+		"epd_draw_rle_image: x=%d, y=%d, w=%d, h=%d\n",
+		(int)left,
+		(int)top,
+		(int)image->width,
+		(int)image->height);
+	epd_set_x_range(epd, left, left + (8u * row_size - 1u));
+	epd_set_y_range(epd, top, top + (image->height - 1u));
+	epd_send_command(epd, EPD_COMMAND_WRITE_RAM_BW);
+	ret = hal_gpio_set_level(epd->dc_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	rle_decoder_init(&decoder, image);
+	memset(row, 0, row_size);
+	while ((y < image->height) && (result == 0)) {
+		if (num_queued == EPD_NUM_STREAM_BLOCKS) {
+			// the oldest block is the next one to be filled
+			ret = hal_spi_get_result(epd->spi, &done);
+			HAL_ERROR_CHECK(ret);
+			--num_queued;
+		}
+		fill = 0u;
+		while ((y < image->height) &&
+			((fill + row_size) <= EPD_STREAM_BLOCK_SIZE))
+		{
+			if (rle_decoder_read_row(&decoder, row, row_size) != 0) {
+				EPD_LOG("epd_draw_rle_image: truncated at y=%d\n", (int)y);
+				result = -1;
+				break;
+			}
+			memcpy(&stream_blocks[next][fill], row, row_size);
+			if (epd_has_panel_image(epd)) {
+				memcpy(
+					image_buffer_begin(&epd->panel_image) +
+						((top + y) * panel_stride) +
+						(left / 8u),
+					row,
+					row_size);
+			}
+			fill += row_size;
+			++y;
+		}
+		if (fill == 0u) {
+			break;
+		}
+		memset(&trans[next], 0, sizeof(trans[next]));
+		trans[next].length = 8u * fill; // in bits
+		trans[next].tx_buffer = stream_blocks[next];
+		ret = hal_spi_queue(epd->spi, &trans[next]);
+		HAL_ERROR_CHECK(ret);
+		++num_queued;
+		next = (next + 1) % EPD_NUM_STREAM_BLOCKS;
+	}
+	while (num_queued > 0) {
+		ret = hal_spi_get_result(epd->spi, &done);
+		HAL_ERROR_CHECK(ret);
+		--num_queued;
+	}
+	if (epd_has_panel_image(epd) && (y > 0u)) {
+		image_buffer_mark_dirty(
+			&epd->panel_image,
+			(int)left,
+			(int)top,
+			(int)(8u * row_size),
+			(int)y);
+	}
+	return result;
+}
+
+void epd_draw_strips (
+		epd_device* epd,
+		epd_render_strip_fn render_strip,
+		void* user_data)
+{
+	hal_err_t ret;
+	hal_spi_transaction trans[EPD_NUM_STREAM_BLOCKS];
+	hal_spi_transaction* done;
+	const size_t row_size = epd_panel_row_size(epd->panel);
+	const uint32_t strip_height = EPD_STREAM_BLOCK_SIZE / row_size;
+	uint32_t top;
+	uint32_t num_rows;
+	int num_queued = 0;
+	int next = 0;
+	assert(strip_height > 0u);
+	EPD_LOG("epd_draw_strips: %d row(s) per strip\n", (int)strip_height);
+	epd_set_x_range(epd, 0u, epd->panel->ram_width - 1u);
+	epd_set_y_range(epd, 0u, epd->panel->height - 1u);
+	epd_send_command(epd, EPD_COMMAND_WRITE_RAM_BW);
+	ret = hal_gpio_set_level(epd->dc_pin, 1u);
+	HAL_ERROR_CHECK(ret);
+	for (top = 0u; top < epd->panel->height; top += num_rows) {
+		image_buffer strip = image_buffer_initializer(
+			stream_blocks[next],
+			epd->panel->ram_width,
+			MIN(strip_height, epd->panel->height - top));
+		num_rows = image_buffer_height(&strip);
+		if (num_queued == EPD_NUM_STREAM_BLOCKS) {
+			// the oldest block is the next one to be rendered
+			ret = hal_spi_get_result(epd->spi, &done);
+			HAL_ERROR_CHECK(ret);
+			--num_queued;
+		}
+		image_buffer_clear_all(&strip);
+		render_strip(&strip, (int)top, user_data);
+		if (epd_has_panel_image(epd)) {
+			memcpy(
+				image_buffer_begin(&epd->panel_image) + (top * row_size),
+				stream_blocks[next],
+				num_rows * row_size);
+		}
+		memset(&trans[next], 0, sizeof(trans[next]));
+		trans[next].length = 8u * num_rows * row_size; // in bits
+		trans[next].tx_buffer = stream_blocks[next];
+		ret = hal_spi_queue(epd->spi, &trans[next]);
+		HAL_ERROR_CHECK(ret);
+		++num_queued;
+		next = (next + 1) % EPD_NUM_STREAM_BLOCKS;
+	}
+	while (num_queued > 0) {
+		ret = hal_spi_get_result(epd->spi, &done);
+		HAL_ERROR_CHECK(ret);
+		--num_queued;
+	}
+	if (epd_has_panel_image(epd)) {
+		image_buffer_mark_dirty(
+			&epd->panel_image,
+			0,
+			0,
+			epd->panel->ram_width,
+			epd->panel->height);
+	}
+}
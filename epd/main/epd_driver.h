@@ -0,0 +1,722 @@
+#ifndef _EPD_DRIVER_H
+#define _EPD_DRIVER_H
+
+/**
+ * @file epd_driver.h
+ *
+ * Driver of EPDs with the SSD168x controllers.
+ *
+ * Talks to an EPD only through `hal.h`, so it also runs on Linux.
+ * An `::epd_device` binds a panel to an SPI device and GPIO pins.
+ * Functions of an EPD block the calling task until the EPD accepts the
+ * next command, except for those starting a refresh.
+ */
+
+#include "hal.h"
+
+#include "epd_panel.h"
+#include "image_buffer.h"
+#include "rle_image.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of bytes in a single SPI transaction.
+ *
+ * Bulk data larger than this is split into chunks.
+ * Limited by the length of a single DMA descriptor (4092 bytes).
+ */
+#define EPD_MAX_TRANSFER_SIZE  4092u
+
+/**
+ * @brief Maximum number of SPI transactions queued at once.
+ *
+ * Four chunks are enough to send an entire 400x300 frame.
+ */
+#define EPD_TRANSACTION_QUEUE_SIZE  8
+
+#ifndef EPD_STREAM_BLOCK_SIZE
+/**
+ * @brief Size of each block to stream a decoded image, a strip or a window.
+ *
+ * `::epd_draw_rle_image` decodes an image, `::epd_draw_strips` renders
+ * a strip of a frame, and `::epd_draw_image_buffer_dirty` packs rows of
+ * a narrow window, into one block while the other block is being
+ * transferred.
+ * A strip has as many rows as fit in a block. Every strip costs the setup
+ * of a transaction, so a larger block sends a frame faster.
+ */
+#define EPD_STREAM_BLOCK_SIZE  500u
+#endif
+
+/**
+ * @brief Renders a strip of a frame.
+ *
+ * Called by `::epd_draw_strips` for each strip from the top.
+ *
+ * @param[in,out] strip
+ *
+ *   Strip to render, cleared to white.
+ *   The first row of `strip` is the row `top` of the frame,
+ *   so things at `(x, y)` in the frame are drawn at `(x, y - top)`.
+ *   Drawing functions of `::image_buffer` clip them.
+ *
+ * @param[in] top
+ *
+ *   Row of the frame at the top of `strip`.
+ *
+ * @param[in] user_data
+ *
+ *   Arbitrary data given to `::epd_draw_strips`.
+ */
+typedef void (*epd_render_strip_fn)(
+		image_buffer* strip,
+		int top,
+		void* user_data);
+
+/**
+ * @brief Callbacks notified of refreshes of an EPD.
+ *
+ * Set them with `::epd_set_refresh_callbacks`.
+ */
+typedef struct epd_refresh_callbacks_t {
+	/**
+	 * @brief Called when a refresh (or LUT loading) is started.
+	 *
+	 * Called in the task that started the refresh.
+	 * May be `NULL`.
+	 */
+	void (*on_started)(void* user_data);
+	/**
+	 * @brief Called when the BUSY pin goes LOW after a refresh is started.
+	 *
+	 * **Called in an ISR context.**
+	 * Has to be placed in IRAM and may call only `FromISR` APIs.
+	 * May be `NULL`.
+	 */
+	void (*on_done)(void* user_data);
+	/** @brief Arbitrary data passed to the callbacks. */
+	void* user_data;
+} epd_refresh_callbacks;
+
+/**
+ * @brief EPD connected to an SPI bus and GPIO pins.
+ *
+ * Initialize with `::epd_device_init`.
+ * Functions that take an `::epd_device` may be called for different devices
+ * from different tasks, except for `::epd_draw_rle_image`,
+ * `::epd_draw_strips`, `::epd_draw_image_buffer_dirty` and
+ * `::epd_draw_image_buffer_partial`, which share the stream blocks among
+ * devices.
+ */
+typedef struct epd_device_t {
+	/** @brief Panel of the EPD. */
+	const epd_panel* panel;
+	/** @brief SPI device. */
+	hal_spi_device spi;
+	/** @brief GPIO# for DC. */
+	int dc_pin;
+	/** @brief GPIO# for RST. */
+	int rst_pin;
+	/** @brief GPIO# for BUSY. */
+	int busy_pin;
+	/**
+	 * @brief Copy of the black and white RAM of the EPD.
+	 *
+	 * Updated by every function that writes the black and white RAM.
+	 * Its dirty rectangles are the areas where the red RAM is not updated
+	 * yet.
+	 *
+	 * Has no memory block if the EPD is drawn only in strips.
+	 * See `::epd_has_panel_image`.
+	 */
+	image_buffer panel_image;
+	/**
+	 * @brief Task waiting for the BUSY pin to go LOW.
+	 *
+	 * `NULL` if no task is waiting.
+	 */
+	volatile hal_task busy_waiting_task;
+	/** @brief Whether a refresh is in progress. */
+	volatile int refreshing;
+	/** @brief Callbacks notified of refreshes. */
+	epd_refresh_callbacks refresh_callbacks;
+	/**
+	 * @brief Number of partial refreshes before a full refresh.
+	 *
+	 * `epd_panel::max_partial_refreshes` of `panel` after
+	 * `::epd_device_init`. May be changed to trade ghosting for fewer
+	 * full refreshes; e.g., on a panel that ghosts less.
+	 * See `::epd_start_refresh_partial_mode`.
+	 */
+	int max_partial_refreshes;
+	/**
+	 * @brief Number of partial refreshes since the last full refresh.
+	 *
+	 * Counted by `::epd_start_refresh_partial_mode`.
+	 */
+	int num_partial_refreshes;
+} epd_device;
+
+/**
+ * @brief Initializes an `::epd_device`.
+ *
+ * Does not touch the EPD. Call `::epd_configure_gpios` and
+ * `::epd_initialize` next.
+ *
+ * @param[out] epd
+ *
+ *   EPD device to initialize.
+ *
+ * @param[in] panel
+ *
+ *   Panel of the EPD. Must live as long as `epd`.
+ *
+ * @param[in] spi
+ *
+ *   SPI device of the EPD.
+ *
+ * @param[in] dc_pin
+ *
+ *   GPIO# for DC.
+ *
+ * @param[in] rst_pin
+ *
+ *   GPIO# for RST.
+ *
+ * @param[in] busy_pin
+ *
+ *   GPIO# for BUSY.
+ *
+ * @param[in] panel_memory
+ *
+ *   Memory block of `epd_device::panel_image`.
+ *   Has to be DMA-capable and as large as `::epd_panel_frame_size`.
+ *   `NULL` keeps no copy of the RAM, and then only `::epd_draw_strips`
+ *   draws frames.
+ */
+void epd_device_init (
+		epd_device* epd,
+		const epd_panel* panel,
+		hal_spi_device spi,
+		int dc_pin,
+		int rst_pin,
+		int busy_pin,
+		uint8_t* panel_memory);
+
+/**
+ * @brief Whether an EPD keeps a copy of its black and white RAM.
+ *
+ * @param[in] epd
+ *
+ *   EPD.
+ *
+ * @return
+ *
+ *   Non-zero if `epd_device::panel_image` has a memory block.
+ */
+static inline int epd_has_panel_image (const epd_device* epd) {
+	return image_buffer_begin(&epd->panel_image) != NULL;
+}
+
+/**
+ * @brief Sets the callbacks notified of refreshes.
+ *
+ * Do not call this function while a refresh is in progress.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] callbacks
+ *
+ *   Callbacks to be set. Copied.
+ *   `NULL` removes the callbacks.
+ */
+void epd_set_refresh_callbacks (
+		epd_device* epd,
+		const epd_refresh_callbacks* callbacks);
+
+/**
+ * @brief Resets non-SPI GPIO pins.
+ *
+ * @param[in] epd
+ *
+ *   EPD.
+ */
+void epd_configure_gpios (epd_device* epd);
+
+/**
+ * @brief Resets an EPD.
+ *
+ * @param[in] epd
+ *
+ *   EPD.
+ */
+void epd_reset (epd_device* epd);
+
+/**
+ * @brief Waits until the BUSY pin goes LOW or a given timeout elapses.
+ *
+ * The calling task is blocked until `::epd_busy_isr_handler` notifies
+ * a falling edge of the BUSY pin.
+ *
+ * Only one task may wait for an EPD at a time.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] timeout_ms
+ *
+ *   Maximum time to wait in milliseconds.
+ *   `HAL_WAIT_FOREVER` waits forever.
+ *
+ * @return
+ *
+ *   - `HAL_OK`: the BUSY pin is LOW.
+ *   - `HAL_ERR_TIMEOUT`: the BUSY pin is still HIGH after `timeout`.
+ */
+hal_err_t epd_wait_busy_timeout (epd_device* epd, uint32_t timeout_ms);
+
+/**
+ * @brief Waits until the BUSY pin goes LOW.
+ *
+ * Aborts if the BUSY pin is still HIGH after `EPD_BUSY_TIMEOUT_MS`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_wait_busy (epd_device* epd);
+
+/**
+ * @brief Sets the border filling of an EPD.
+ *
+ * Rendering is deferred until
+ * `::epd_refresh_display_mode_1` or `::epd_refresh_display_mode_2` is called.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] fill
+ *
+ *   Border filling.
+ *   - `0`: black
+ *   - non-zero: white
+ */
+void epd_set_border (epd_device* epd, uint8_t fill);
+
+/**
+ * @brief Initializes an EPD.
+ *
+ * After calling this function, you need to enable a display mode with
+ * either of the following functions,
+ * - `::epd_enable_display_mode_1`
+ * - `::epd_enable_display_mode_2`
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_initialize (epd_device* epd);
+
+/**
+ * @brief Enables the display mode 1 of an EPD.
+ *
+ * If you want to switch to the display mode 2,
+ * you have to call `::epd_enable_display_mode_2`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_enable_display_mode_1 (epd_device* epd);
+
+/**
+ * @brief Enables the display mode 2 of an EPD.
+ *
+ * If you want to switch to the display mode 1,
+ * you have to call `::epd_enable_display_mode_1`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_enable_display_mode_2 (epd_device* epd);
+
+/**
+ * @brief Starts refreshing an EPD with the display mode 1.
+ *
+ * Returns without waiting for the refresh to finish,
+ * so that the next frame can be rendered during the refresh.
+ * Call `::epd_wait_busy` before sending another command.
+ *
+ * Before calling this function,
+ * you have to enable the display mode 1 with `::epd_enable_display_mode_1`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_start_refresh_display_mode_1 (epd_device* epd);
+
+/**
+ * @brief Starts refreshing an EPD with the display mode 2.
+ *
+ * Returns without waiting for the refresh to finish,
+ * so that the next frame can be rendered during the refresh.
+ * Call `::epd_wait_busy` before sending another command.
+ *
+ * Before calling this function,
+ * you have to enable the display mode 2 with `::epd_enable_display_mode_2`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_start_refresh_display_mode_2 (epd_device* epd);
+
+/**
+ * @brief Refreshes an EPD with the display mode 1.
+ *
+ * Blocks until the refresh finishes.
+ *
+ * Before calling this function,
+ * you have to enable the display mode 1 with `::epd_enable_display_mode_1`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_refresh_display_mode_1 (epd_device* epd);
+
+/**
+ * @brief Refreshes an EPD with the display mode 2.
+ *
+ * Blocks until the refresh finishes.
+ *
+ * Before calling this function,
+ * you have to enable the display mode 2 with `::epd_enable_display_mode_2`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_refresh_display_mode_2 (epd_device* epd);
+
+/**
+ * @brief Starts a full refresh of an EPD.
+ *
+ * Needs no display mode enabled beforehand.
+ * Returns without waiting for the refresh to finish.
+ * Call `::epd_wait_busy` before sending another command.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_start_refresh_full (epd_device* epd);
+
+/**
+ * @brief Starts a partial refresh of an EPD.
+ *
+ * Only pixels that differ between the black and white RAM and the red RAM
+ * change.
+ * Returns without waiting for the refresh to finish.
+ * Call `::epd_wait_busy` before sending another command.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_start_refresh_partial (epd_device* epd);
+
+/**
+ * @brief Starts the refresh of a frame drawn for a partial refresh.
+ *
+ * Starts a partial refresh, or a full refresh instead if
+ * `epd_device::max_partial_refreshes` partial refreshes have been made since
+ * the last full refresh, so that every `max_partial_refreshes + 1`th frame
+ * clears ghosting.
+ * Returns without waiting for the refresh to finish.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_start_refresh_partial_mode (epd_device* epd);
+
+/**
+ * @brief Clears a given range of an EPD.
+ *
+ * This function sets X and Y ranges to `[x, x + width - 1]` and
+ * `[y, y + height - 1]` respectively.
+ *
+ * Will cause undefined behavior if `left` or `width` is not a multiple of `8`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] left
+ *
+ *   Left position of the area to be cleared.
+ *
+ * @param[in] top
+ *
+ *   Top position of the area to be cleared.
+ *
+ * @param[in] width
+ *
+ *   Width of the are to be cleared.
+ *
+ * @param[in] height
+ *
+ *   Height of the are to be cleared.
+ */
+void epd_clear_range (
+		epd_device* epd,
+		uint32_t left,
+		uint32_t top,
+		uint32_t width,
+		uint32_t height);
+
+/**
+ * @brief Clears all of the pixels of an EPD.
+ *
+ * This function resets x and y ranges to the entire RAM.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_clear_all (epd_device* epd);
+
+/**
+ * @brief Draws a given image buffer on an EPD.
+ *
+ * The whole buffer is transferred in bulk, whatever changed.
+ * Also copied to `epd_device::panel_image` if the EPD keeps a copy of
+ * the RAM.
+ *
+ * This function sets the X and Y ranges to `[0, buffer->width-1]` and
+ * `[0, buffer->height-1]` respectively.
+ *
+ * The memory block of `buffer` is transferred via DMA,
+ * so it has to be DMA-capable.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] buffer
+ *
+ *   Image buffer to draw on the EPD.
+ */
+void epd_draw_image_buffer (
+		epd_device* epd,
+		const image_buffer* buffer);
+
+/**
+ * @brief Draws the dirty rectangles of a given image buffer on an EPD.
+ *
+ * Only the dirty rectangles of `buffer` are transferred, each in a window
+ * of the X and Y ranges. So `buffer` has to be marked dirty wherever it
+ * differs from the black and white RAM.
+ * The dirty rectangles of `buffer` are cleared after the transfer.
+ *
+ * This function leaves the X and Y ranges at the last dirty rectangle.
+ *
+ * Rectangles in full width are transferred from `buffer` via DMA, so the
+ * memory block of `buffer` has to be DMA-capable. Rows of narrower
+ * rectangles are packed into the stream blocks shared with
+ * `::epd_draw_rle_image`.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in,out] buffer
+ *
+ *   Image buffer to draw on the EPD.
+ *   Has to be `epd_panel::ram_width` x `epd_panel::height` of the EPD.
+ */
+void epd_draw_image_buffer_dirty (
+		epd_device* epd,
+		image_buffer* buffer);
+
+/**
+ * @brief Draws the rows of a given image buffer that differ from
+ * the black and white RAM of an EPD.
+ *
+ * `buffer` is compared with `epd_device::panel_image`, and runs of changed rows
+ * are transferred in full width. So this function does not depend on the
+ * dirty rectangles of `buffer`, which are cleared after the transfer.
+ * The EPD has to keep a copy of the RAM.
+ *
+ * This function leaves the X and Y ranges at the last run.
+ *
+ * The memory block of `buffer` is transferred via DMA,
+ * so it has to be DMA-capable.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in,out] buffer
+ *
+ *   Image buffer to draw on the EPD.
+ *   Has to be `epd_panel::ram_width` x `epd_panel::height` of the EPD.
+ */
+void epd_draw_image_buffer_diff (
+		epd_device* epd,
+		image_buffer* buffer);
+
+/**
+ * @brief Draws the changed areas of a given image buffer on an EPD by
+ * `::epd_draw_image_buffer_dirty` or `::epd_draw_image_buffer_diff`,
+ * whichever sends fewer bytes.
+ *
+ * The size of the dirty rectangles of `buffer` is compared with the size of
+ * the runs of rows that differ from `epd_device::panel_image`, charging
+ * every window the setting of the X and Y ranges. Windows win for small
+ * sprites on a wide panel; runs of rows win when the dirty rectangles are
+ * larger than the actual changes, e.g., a sprite drawn where it was.
+ * Runs of rows are also taken if `buffer` has no dirty rectangles.
+ * The EPD has to keep a copy of the RAM.
+ *
+ * The dirty rectangles of `buffer` are cleared after the transfer.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in,out] buffer
+ *
+ *   Image buffer to draw on the EPD.
+ *   Has to be `epd_panel::ram_width` x `epd_panel::height` of the EPD.
+ *   Has to be DMA-capable.
+ */
+void epd_draw_image_buffer_changed (
+		epd_device* epd,
+		image_buffer* buffer);
+
+/**
+ * @brief Enables partial refreshes of an EPD, and clears the EPD.
+ *
+ * Both of the RAMs and `epd_device::panel_image` are whitened,
+ * and the EPD is fully refreshed. Blocks until the refresh finishes.
+ * Resets `epd_device::num_partial_refreshes`.
+ * The EPD has to keep a copy of the RAM.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ */
+void epd_enable_partial_refresh (epd_device* epd);
+
+/**
+ * @brief Draws a given image buffer on an EPD for a partial refresh.
+ *
+ * First the areas changed by the previous frame are written from
+ * `epd_device::panel_image` to the red RAM, so that the red RAM holds the frame
+ * on the EPD.
+ * Then the changed areas of `buffer` are drawn by
+ * `::epd_draw_image_buffer_changed`.
+ *
+ * Call `::epd_enable_partial_refresh` before the first frame.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in,out] buffer
+ *
+ *   Image buffer to draw on the EPD.
+ *   Has to be `epd_panel::ram_width` x `epd_panel::height` of the EPD.
+ */
+void epd_draw_image_buffer_partial (
+		epd_device* epd,
+		image_buffer* buffer);
+
+/**
+ * @brief Draws a given `::rle_image` directly on an EPD.
+ *
+ * This function sets the X and Y ranges to the area of `image`.
+ * Rows are decoded into a block while the previous block is transferred,
+ * so the entire image is never decompressed in memory.
+ * Decoded rows are also copied to `epd_device::panel_image`, so a later
+ * `::epd_draw_image_buffer_diff` does not transfer them again if they are
+ * unchanged.
+ *
+ * Will cause undefined behavior if `left` is not a multiple of `8`,
+ * or `image` does not fit in the EPD.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] image
+ *
+ *   Image to draw.
+ *
+ * @param[in] left
+ *
+ *   Left position of the image.
+ *
+ * @param[in] top
+ *
+ *   Top position of the image.
+ *
+ * @return
+ *
+ *   - `0`: succeeded.
+ *   - `-1`: the compressed stream is truncated.
+ *     Rows decoded so far are transferred.
+ */
+int epd_draw_rle_image (
+		epd_device* epd,
+		const rle_image* image,
+		uint32_t left,
+		uint32_t top);
+
+/**
+ * @brief Draws a frame on an EPD in strips.
+ *
+ * The frame is rendered by `render_strip` into strips of as many rows as
+ * fit in a stream block, and each strip is transferred while the next one
+ * is rendered. So no image buffer as large as the frame is needed.
+ *
+ * If the EPD keeps a copy of the RAM, strips are also copied to it.
+ *
+ * This function sets the X and Y ranges to the entire RAM.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] render_strip
+ *
+ *   Renders each strip.
+ *
+ * @param[in] user_data
+ *
+ *   Passed to `render_strip`.
+ */
+void epd_draw_strips (
+		epd_device* epd,
+		epd_render_strip_fn render_strip,
+		void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
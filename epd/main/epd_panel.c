@@ -0,0 +1,114 @@
+/**
+ * @file epd_panel.c
+ *
+ * Descriptors of EPD panels.
+ */
+
+#include "epd_panel.h"
+
+#include <assert.h>
+
+/**
+ * @brief Fails to compile unless a given panel fits the static buffers.
+ *
+ * Its RAM has to be whole bytes wide, and its frame has to fit in
+ * `EPD_PANEL_MAX_FRAME_SIZE`.
+ *
+ * @param[in] id
+ *
+ *   Name of a panel in `::epd_panel_id`.
+ */
+#define EPD_PANEL_CHECK_GEOMETRY(id) \
+	typedef char id ## _fits[ \
+		((((id ## _RAM_WIDTH) % 8u) == 0u) && \
+			(EPD_PANEL_FRAME_SIZE_OF(id) <= EPD_PANEL_MAX_FRAME_SIZE)) ? 1 : -1]
+
+EPD_PANEL_CHECK_GEOMETRY(EPD_PANEL_1IN54_V2);
+EPD_PANEL_CHECK_GEOMETRY(EPD_PANEL_2IN13_V4);
+EPD_PANEL_CHECK_GEOMETRY(EPD_PANEL_2IN9_V2);
+EPD_PANEL_CHECK_GEOMETRY(EPD_PANEL_4IN2_V2);
+
+// a new panel needs its geometry in `EPD_PANEL_MAX_FRAME_SIZE` and a check above
+typedef char epd_panels_checked[(EPD_NUM_PANELS == 4) ? 1 : -1];
+
+/**
+ * @brief Display update sequences of the SSD168x controllers.
+ *
+ * Shared by every panel in `EPD_PANELS`, as is the SPI clock of 20MHz.
+ * Both were verified on the 1.54" panel (SSD1681), and are assumed for the
+ * other controllers. They are unverified on the SSD1683 of the 4.2" panel;
+ * give that panel its own sequences or a lower clock if it misbehaves.
+ */
+#define EPD_SSD168X_SEQUENCES \
+{ \
+	.load_lut_1 = EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_1, \
+	.load_lut_2 = EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_2, \
+	.display_1 = EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_1, \
+	.display_2 = EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_2, \
+	.full = EPD_DISPLAY_UPDATE_SEQUENCE_FULL, \
+	.partial = EPD_DISPLAY_UPDATE_SEQUENCE_PARTIAL \
+}
+
+/**
+ * @brief Number of partial refreshes before a full refresh on the SSD168x
+ * controllers.
+ *
+ * Shared by every panel in `EPD_PANELS`, as are the sequences above.
+ */
+#define EPD_SSD168X_MAX_PARTIAL_REFRESHES  10
+
+const epd_panel EPD_PANELS[EPD_NUM_PANELS] = {
+	{
+		.name = "1.54in V2",
+		.width = 200u,
+		.height = EPD_PANEL_1IN54_V2_HEIGHT,
+		.ram_width = EPD_PANEL_1IN54_V2_RAM_WIDTH,
+		.gate_scan = 0x00u,
+		.sequences = EPD_SSD168X_SEQUENCES,
+		.max_clock_hz = 20000000,
+		.max_partial_refreshes = EPD_SSD168X_MAX_PARTIAL_REFRESHES
+	},
+	{
+		// the RAM of the SSD1680 is 176 columns wide,
+		// and the X range covers only the 16 bytes of a row
+		.name = "2.13in V4",
+		.width = 122u,
+		.height = EPD_PANEL_2IN13_V4_HEIGHT,
+		.ram_width = EPD_PANEL_2IN13_V4_RAM_WIDTH,
+		.gate_scan = 0x00u,
+		.sequences = EPD_SSD168X_SEQUENCES,
+		.max_clock_hz = 20000000,
+		.max_partial_refreshes = EPD_SSD168X_MAX_PARTIAL_REFRESHES
+	},
+	{
+		.name = "2.9in V2",
+		.width = 128u,
+		.height = EPD_PANEL_2IN9_V2_HEIGHT,
+		.ram_width = EPD_PANEL_2IN9_V2_RAM_WIDTH,
+		.gate_scan = 0x00u,
+		.sequences = EPD_SSD168X_SEQUENCES,
+		.max_clock_hz = 20000000,
+		.max_partial_refreshes = EPD_SSD168X_MAX_PARTIAL_REFRESHES
+	},
+	{
+		// the sequences and the clock are not verified on the SSD1683
+		.name = "4.2in V2",
+		.width = 400u,
+		.height = EPD_PANEL_4IN2_V2_HEIGHT,
+		.ram_width = EPD_PANEL_4IN2_V2_RAM_WIDTH,
+		.gate_scan = 0x00u,
+		.sequences = EPD_SSD168X_SEQUENCES,
+		.max_clock_hz = 20000000,
+		.max_partial_refreshes = EPD_SSD168X_MAX_PARTIAL_REFRESHES
+	}
+};
+
+void epd_panel_driver_output_control (const epd_panel* panel, uint8_t data[3]) {
+	const uint32_t last_gate = panel->height - 1u;
+	assert((panel->height > 0u) && (panel->height <= 512u));
+	// b[7..0]: lower bits of the number of gates - 1
+	data[0] = (uint8_t)last_gate;
+	// b[0]: high bit of the number of gates - 1
+	data[1] = (uint8_t)((last_gate >> 8) & 0x1u);
+	data[2] = panel->gate_scan;
+}
@@ -0,0 +1,298 @@
+#ifndef _EPD_PANEL_H
+#define _EPD_PANEL_H
+
+/**
+ * @file epd_panel.h
+ *
+ * Descriptors of EPD panels.
+ *
+ * Panels driven by the Solomon Systech SSD168x controllers share the command
+ * set, and differ in their geometry and the clock they accept.
+ * An `::epd_panel` describes a panel, and `EPD_PANELS` lists known panels.
+ * They share the display update sequences and the SPI clock, which are
+ * verified only on the 1.54" panel and not on the SSD1683 of the 4.2" panel.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Display Update Sequence `0xB1`.
+ *
+ * Represents the following sequence,
+ * 1. Enable clock signal
+ * 2. Load temperature value
+ * 3. Load LUT with DISPLAY Mode 1
+ * 4. Disable clock signal
+ */
+#define EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_1  0xB1u
+
+/**
+ * @brief Display Update Sequence `0xB9`.
+ *
+ * Represents the following sequence,
+ * 1. Enable clock signal
+ * 2. Load temperature value
+ * 3. Load LUT with DISPLAY Mode 2
+ * 4. Disable clock signal
+ */
+#define EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_2  0xB9u
+
+/**
+ * @brief Display Update Sequence `0xC7`.
+ *
+ * Represents the following sequence,
+ * 1. Enable clock signal
+ * 2. Enable Analog
+ * 3. Display with DISPLAY Mode 1
+ * 4. Disable Analog
+ * 5. Disable OSC (clock signal?)
+ */
+#define EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_1  0xC7u
+
+/**
+ * @brief Display Update Sequence `0xCF`.
+ *
+ * Represents the following sequence,
+ * 1. Enable clock signal
+ * 2. Enable Analog
+ * 3. Display with DISPLAY Mode 2
+ * 4. Disable Analog
+ * 5. Disable OSC (clock signal?)
+ */
+#define EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_2  0xCFu
+
+/**
+ * @brief Display Update Sequence `0xF7`.
+ *
+ * Represents the following sequence,
+ * 1. Enable clock signal
+ * 2. Enable Analog
+ * 3. Load temperature value
+ * 4. Load LUT with DISPLAY Mode 1
+ * 5. Display with DISPLAY Mode 1
+ * 6. Disable Analog
+ * 7. Disable OSC
+ *
+ * A full refresh that needs no preceding LUT loading.
+ */
+#define EPD_DISPLAY_UPDATE_SEQUENCE_FULL  0xF7u
+
+/**
+ * @brief Display Update Sequence `0xFC`.
+ *
+ * Represents the following sequence,
+ * 1. Enable clock signal
+ * 2. Enable Analog
+ * 3. Load temperature value
+ * 4. Load LUT with DISPLAY Mode 2
+ * 5. Display with DISPLAY Mode 2
+ *
+ * DISPLAY Mode 2 drives each pixel from its value in the red RAM to
+ * its value in the black and white RAM, so pixels that are the same in both
+ * do not flash.
+ * Clock and Analog stay enabled for the next partial refresh.
+ */
+#define EPD_DISPLAY_UPDATE_SEQUENCE_PARTIAL  0xFCu
+
+/**
+ * @brief Display update sequences of a panel.
+ *
+ * Each is the data for the Display Update Control 2 command.
+ */
+typedef struct epd_sequences_t {
+	/** @brief Loads the LUT of the display mode 1. */
+	uint8_t load_lut_1;
+	/** @brief Loads the LUT of the display mode 2. */
+	uint8_t load_lut_2;
+	/** @brief Displays with the display mode 1. */
+	uint8_t display_1;
+	/** @brief Displays with the display mode 2. */
+	uint8_t display_2;
+	/** @brief Loads the LUT of the display mode 1 and displays with it. */
+	uint8_t full;
+	/** @brief Loads the LUT of the display mode 2 and displays with it. */
+	uint8_t partial;
+} epd_sequences;
+
+/**
+ * @brief Descriptor of an EPD panel.
+ */
+typedef struct epd_panel_t {
+	/** @brief Name of the panel for logs. */
+	const char* name;
+	/** @brief Number of visible columns (sources). */
+	uint32_t width;
+	/** @brief Number of rows; i.e., gates driven. */
+	uint32_t height;
+	/**
+	 * @brief Number of columns in a row of the RAM.
+	 *
+	 * `width` rounded up to a multiple of `8`.
+	 * Image buffers of the panel are this wide.
+	 */
+	uint32_t ram_width;
+	/**
+	 * @brief Scanning of the gates.
+	 *
+	 * Third data byte of the Driver Output Control command.
+	 * - b[2]: first output gate
+	 * - b[1]: 0: normal, 1: interlace (even → odd)
+	 * - b[0]: 0: G0 → Gn, 1: Gn → G0
+	 */
+	uint8_t gate_scan;
+	/** @brief Display update sequences. */
+	epd_sequences sequences;
+	/** @brief Maximum SPI clock in Hz. */
+	int max_clock_hz;
+	/**
+	 * @brief Number of partial refreshes before a full refresh.
+	 *
+	 * Partial refreshes leave ghosting, which a full refresh clears.
+	 * Default of `epd_device::max_partial_refreshes`.
+	 */
+	int max_partial_refreshes;
+} epd_panel;
+
+/** @brief Identifier of a panel in `EPD_PANELS`. */
+typedef enum epd_panel_id_t {
+	/** @brief Waveshare 1.54" V2 (200x200, SSD1681). */
+	EPD_PANEL_1IN54_V2 = 0,
+	/** @brief Waveshare 2.13" V4 (122x250, SSD1680). */
+	EPD_PANEL_2IN13_V4,
+	/** @brief Waveshare 2.9" V2 (128x296, SSD1680). */
+	EPD_PANEL_2IN9_V2,
+	/**
+	 * @brief Waveshare 4.2" V2 (400x300, SSD1683).
+	 *
+	 * The display update sequences and the SPI clock are not verified.
+	 */
+	EPD_PANEL_4IN2_V2,
+	/** @brief Number of panels. */
+	EPD_NUM_PANELS
+} epd_panel_id;
+
+/**
+ * @brief Number of bytes in a frame of a given geometry.
+ *
+ * A constant expression for the sizes of static arrays.
+ * See `::epd_panel_frame_size` for a panel at run time.
+ *
+ * @param[in] ram_width
+ *
+ *   Number of columns in a row of the RAM. A multiple of `8`.
+ *
+ * @param[in] height
+ *
+ *   Number of rows.
+ */
+#define EPD_PANEL_FRAME_SIZE(ram_width, height)  (((ram_width) / 8u) * (height))
+
+/** @brief Number of columns in a row of the RAM of the 1.54" V2 panel. */
+#define EPD_PANEL_1IN54_V2_RAM_WIDTH  200u
+/** @brief Number of rows of the 1.54" V2 panel. */
+#define EPD_PANEL_1IN54_V2_HEIGHT  200u
+/** @brief Number of columns in a row of the RAM of the 2.13" V4 panel. */
+#define EPD_PANEL_2IN13_V4_RAM_WIDTH  128u
+/** @brief Number of rows of the 2.13" V4 panel. */
+#define EPD_PANEL_2IN13_V4_HEIGHT  250u
+/** @brief Number of columns in a row of the RAM of the 2.9" V2 panel. */
+#define EPD_PANEL_2IN9_V2_RAM_WIDTH  128u
+/** @brief Number of rows of the 2.9" V2 panel. */
+#define EPD_PANEL_2IN9_V2_HEIGHT  296u
+/** @brief Number of columns in a row of the RAM of the 4.2" V2 panel. */
+#define EPD_PANEL_4IN2_V2_RAM_WIDTH  400u
+/** @brief Number of rows of the 4.2" V2 panel. */
+#define EPD_PANEL_4IN2_V2_HEIGHT  300u
+
+/**
+ * @brief Number of bytes in a frame of a panel in `EPD_PANELS`.
+ *
+ * A constant expression; e.g., `EPD_PANEL_FRAME_SIZE_OF(EPD_PANEL_2IN9_V2)`.
+ * `id` has to be the name of an `::epd_panel_id`, or a macro that expands
+ * to one, not its value.
+ *
+ * @param[in] id
+ *
+ *   Name of a panel in `::epd_panel_id`.
+ */
+#define EPD_PANEL_FRAME_SIZE_OF(id)  EPD_PANEL_FRAME_SIZE_OF_(id)
+
+/** @brief Pastes the name expanded by `EPD_PANEL_FRAME_SIZE_OF`. */
+#define EPD_PANEL_FRAME_SIZE_OF_(id) \
+	EPD_PANEL_FRAME_SIZE(id ## _RAM_WIDTH, id ## _HEIGHT)
+
+/** @brief Larger one of two constants. */
+#define EPD_PANEL_MAX_(a, b)  (((a) > (b)) ? (a) : (b))
+
+/**
+ * @brief Size of the largest frame of the panels in `EPD_PANELS` in bytes.
+ *
+ * Derived from the geometries of the panels. `epd_panel.c` fails to compile
+ * if a panel does not fit.
+ */
+#define EPD_PANEL_MAX_FRAME_SIZE \
+	EPD_PANEL_MAX_( \
+		EPD_PANEL_MAX_( \
+			EPD_PANEL_FRAME_SIZE_OF(EPD_PANEL_1IN54_V2), \
+			EPD_PANEL_FRAME_SIZE_OF(EPD_PANEL_2IN13_V4)), \
+		EPD_PANEL_MAX_( \
+			EPD_PANEL_FRAME_SIZE_OF(EPD_PANEL_2IN9_V2), \
+			EPD_PANEL_FRAME_SIZE_OF(EPD_PANEL_4IN2_V2)))
+
+/** @brief Known panels indexed by `::epd_panel_id`. */
+extern const epd_panel EPD_PANELS[EPD_NUM_PANELS];
+
+/**
+ * @brief Number of bytes in a row of the RAM of a given panel.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @return
+ *
+ *   Number of bytes in a row.
+ */
+static inline size_t epd_panel_row_size (const epd_panel* panel) {
+	return panel->ram_width / 8u;
+}
+
+/**
+ * @brief Number of bytes in a frame of a given panel.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @return
+ *
+ *   Number of bytes in a frame.
+ */
+static inline size_t epd_panel_frame_size (const epd_panel* panel) {
+	return panel->height * epd_panel_row_size(panel);
+}
+
+/**
+ * @brief Makes the data for the Driver Output Control command of
+ * a given panel.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @param[out] data
+ *
+ *   Receives the 3 data bytes.
+ */
+void epd_panel_driver_output_control (const epd_panel* panel, uint8_t data[3]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
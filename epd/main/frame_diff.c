@@ -0,0 +1,89 @@
+/**
+ * @file frame_diff.c
+ *
+ * Implementation of the detection of differing rows.
+ */
+
+#include "frame_diff.h"
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * @brief Whether two rows are the same.
+ *
+ * Compares 32 bits at a time and returns at the first difference.
+ * Rows need not be aligned; `memcpy` of a word compiles to a load.
+ *
+ * @param[in] row1
+ *
+ *   Row to compare.
+ *
+ * @param[in] row2
+ *
+ *   Row to compare.
+ *
+ * @param[in] size
+ *
+ *   Size of a row in bytes.
+ *
+ * @return
+ *
+ *   Non-zero if the rows are the same.
+ */
+static int frame_diff_rows_equal (
+		const uint8_t* row1,
+		const uint8_t* row2,
+		size_t size)
+{
+	uint32_t word1;
+	uint32_t word2;
+	size_t i;
+	for (i = 0u; (i + sizeof(uint32_t)) <= size; i += sizeof(uint32_t)) {
+		memcpy(&word1, row1 + i, sizeof(uint32_t));
+		memcpy(&word2, row2 + i, sizeof(uint32_t));
+		if ((word1 ^ word2) != 0u) {
+			return 0;
+		}
+	}
+	for (; i < size; ++i) {
+		if (row1[i] != row2[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+size_t frame_diff_rows (
+		const image_buffer* frame,
+		const image_buffer* shadow,
+		uint32_t max_gap,
+		frame_diff_run* runs,
+		size_t max_runs)
+{
+	const size_t row_size = image_buffer_width(frame) / 8u;
+	const uint8_t* row1 = image_buffer_begin(frame);
+	const uint8_t* row2 = image_buffer_begin(shadow);
+	frame_diff_run* last = NULL;
+	size_t num_runs = 0u;
+	uint32_t y;
+	assert(image_buffer_width(frame) == image_buffer_width(shadow));
+	assert(image_buffer_height(frame) == image_buffer_height(shadow));
+	assert(max_runs > 0u);
+	for (y = 0u; y < image_buffer_height(frame); ++y) {
+		if (!frame_diff_rows_equal(row1, row2, row_size)) {
+			if ((last != NULL) &&
+				(((y - last->bottom) <= max_gap) || (num_runs == max_runs)))
+			{
+				last->bottom = y + 1u;
+			} else {
+				last = &runs[num_runs++];
+				last->top = y;
+				last->bottom = y + 1u;
+			}
+		}
+		row1 += row_size;
+		row2 += row_size;
+	}
+	return num_runs;
+}
@@ -0,0 +1,81 @@
+#ifndef _FRAME_DIFF_H
+#define _FRAME_DIFF_H
+
+/**
+ * @file frame_diff.h
+ *
+ * Detection of rows that differ between two frames.
+ *
+ * Used to upload only the rows of a frame that differ from what the RAM of
+ * an EPD holds, even if the frame does not track its dirty rectangles.
+ */
+
+#include "image_buffer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run of rows that differ.
+ */
+typedef struct frame_diff_run_t {
+	/** @brief First row (inclusive). */
+	uint32_t top;
+	/** @brief Last row (**exclusive**). */
+	uint32_t bottom;
+} frame_diff_run;
+
+/**
+ * @brief Finds runs of rows that differ between two frames.
+ *
+ * Rows are compared 32 bits at a time, and the comparison of a row stops
+ * at the first difference.
+ *
+ * Runs separated by `max_gap` or fewer identical rows are merged,
+ * because starting another run costs more than sending a few rows.
+ * If there are more runs than `max_runs`, the last run is extended to
+ * the last row that differs.
+ *
+ * Will cause undefined behavior if `frame` and `shadow` are not the same
+ * size.
+ *
+ * @param[in] frame
+ *
+ *   New frame.
+ *
+ * @param[in] shadow
+ *
+ *   Frame to compare with; e.g., a copy of the RAM of an EPD.
+ *
+ * @param[in] max_gap
+ *
+ *   Maximum number of identical rows merged into a run.
+ *
+ * @param[out] runs
+ *
+ *   Receives runs from top to bottom.
+ *
+ * @param[in] max_runs
+ *
+ *   Maximum number of runs. Must be at least `1`.
+ *
+ * @return
+ *
+ *   Number of runs. `0` if the frames are the same.
+ */
+size_t frame_diff_rows (
+		const image_buffer* frame,
+		const image_buffer* shadow,
+		uint32_t max_gap,
+		frame_diff_run* runs,
+		size_t max_runs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * @file image_asset.c
+ *
+ * Implementation of image assets.
+ */
+
+#include "image_asset.h"
+#include "rle_image.h"
+
+int image_asset_draw (
+		image_buffer* buffer,
+		const uint8_t* blob,
+		const image_asset* asset,
+		int left,
+		int top)
+{
+	rle_image image = rle_image_initializer(
+		blob + asset->offset,
+		asset->size,
+		asset->width,
+		asset->height,
+		asset->flags & RLE_IMAGE_FLAG_ROW_DELTA);
+	if ((asset->flags & IMAGE_ASSET_FLAG_RLE) == 0u) {
+		image_buffer_draw_image(
+			buffer,
+			blob + asset->offset,
+			left,
+			top,
+			asset->width,
+			asset->height);
+		return 0;
+	}
+	return rle_image_draw(buffer, &image, left, top);
+}
@@ -0,0 +1,134 @@
+#ifndef _IMAGE_ASSET_H
+#define _IMAGE_ASSET_H
+
+/**
+ * @file image_asset.h
+ *
+ * Image assets combined into a single blob.
+ *
+ * `py/make_binary_image.py` combines multiple images into a blob and an
+ * index table of `::image_asset`s.
+ * The blob is a C array in a header, or a binary file laid out as follows.
+ * All integers are little-endian.
+ * - `"EPDA"`: magic.
+ * - `uint32_t`: number of images.
+ * - index table: an `::image_asset` for each image (16 bytes each).
+ * - data of images.
+ *
+ * Offsets are relative to the end of the index table in a binary file.
+ */
+
+#include "image_buffer.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Flag: an image is run-length compressed.
+ *
+ * May be combined with `RLE_IMAGE_FLAG_ROW_DELTA`.
+ */
+#define IMAGE_ASSET_FLAG_RLE  0x10u
+
+/**
+ * @brief Entry of an index table locating an image in a blob.
+ */
+typedef struct image_asset_t {
+	/** @brief Offset of the image in the blob. */
+	uint32_t offset;
+	/** @brief Size of the image in bytes. */
+	uint32_t size;
+	/** @brief Width of the image. */
+	uint16_t width;
+	/** @brief Height of the image. */
+	uint16_t height;
+	/**
+	 * @brief Flags.
+	 *
+	 * Raw image data if `IMAGE_ASSET_FLAG_RLE` is not set.
+	 */
+	uint8_t flags;
+} image_asset;
+
+/**
+ * @brief Initializer of an `::image_asset`.
+ *
+ * @param[in] _offset
+ *
+ *   (`uint32_t`) Offset of the image in the blob.
+ *
+ * @param[in] _size
+ *
+ *   (`uint32_t`) Size of the image in bytes.
+ *
+ * @param[in] _width
+ *
+ *   (`uint16_t`) Width of the image.
+ *
+ * @param[in] _height
+ *
+ *   (`uint16_t`) Height of the image.
+ *
+ * @param[in] _flags
+ *
+ *   (`uint8_t`) Flags.
+ *
+ * @return
+ *
+ *   Initializer of an `::image_asset`.
+ */
+#define image_asset_initializer(_offset, _size, _width, _height, _flags) \
+{ \
+	.offset = (_offset), \
+	.size = (_size), \
+	.width = (_width), \
+	.height = (_height), \
+	.flags = (_flags) \
+}
+
+/**
+ * @brief Draws a given `::image_asset` in an `::image_buffer`.
+ *
+ * A raw image is drawn with `::image_buffer_draw_image`,
+ * and a compressed one with `::rle_image_draw`.
+ *
+ * @param[in,out] buffer
+ *
+ *   `::image_buffer` where the image is to be drawn.
+ *
+ * @param[in] blob
+ *
+ *   Blob containing the image.
+ *
+ * @param[in] asset
+ *
+ *   Image to draw.
+ *
+ * @param[in] left
+ *
+ *   Left position of the image.
+ *
+ * @param[in] top
+ *
+ *   Top position of the image.
+ *
+ * @return
+ *
+ *   - `0`: succeeded.
+ *   - `-1`: the compressed image is truncated.
+ */
+int image_asset_draw (
+		image_buffer* buffer,
+		const uint8_t* blob,
+		const image_asset* asset,
+		int left,
+		int top);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
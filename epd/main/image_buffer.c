@@ -10,27 +10,591 @@
 #include <assert.h>
 #include <string.h>
 
-void image_buffer_clear_all (const image_buffer* buffer) {
+/**
+ * @brief Area of a given rectangle.
+ *
+ * @param[in] rect
+ *
+ *   Rectangle whose area is to be calculated.
+ *
+ * @return
+ *
+ *   Area of `rect`.
+ */
+static int image_buffer_rect_area (const image_buffer_rect* rect) {
+	return (rect->right - rect->left) * (rect->bottom - rect->top);
+}
+
+/**
+ * @brief Obtains the union of given two rectangles.
+ *
+ * @param[in] rect1
+ *
+ *   Rectangle to be united.
+ *
+ * @param[in] rect2
+ *
+ *   Another rectangle to be united.
+ *
+ * @return
+ *
+ *   Smallest rectangle containing both `rect1` and `rect2`.
+ */
+static image_buffer_rect image_buffer_rect_union (
+		const image_buffer_rect* rect1,
+		const image_buffer_rect* rect2)
+{
+	image_buffer_rect united = {
+		.left = MIN(rect1->left, rect2->left),
+		.top = MIN(rect1->top, rect2->top),
+		.right = MAX(rect1->right, rect2->right),
+		.bottom = MAX(rect1->bottom, rect2->bottom)
+	};
+	return united;
+}
+
+/**
+ * @brief Chooses a dirty rectangle to be merged with a given rectangle.
+ *
+ * @param[in] buffer
+ *
+ *   `::image_buffer` whose dirty rectangles are examined.
+ *
+ * @param[in] rect
+ *
+ *   Rectangle to be merged.
+ *
+ * @param[in] force
+ *
+ *   Whether a dirty rectangle has to be chosen.
+ *   If non-zero, the dirty rectangle that grows least is chosen.
+ *   Otherwise, a dirty rectangle is chosen only if merging does not increase
+ *   the total area.
+ *
+ * @return
+ *
+ *   Index of the chosen dirty rectangle.
+ *   `-1` if no dirty rectangle is chosen.
+ */
+static int image_buffer_choose_dirty_rect_to_merge (
+		const image_buffer* buffer,
+		const image_buffer_rect* rect,
+		int force)
+{
+	image_buffer_rect united;
+	int i;
+	int growth;
+	int best_growth = 0;
+	int best_index = -1;
+	int area = image_buffer_rect_area(rect);
+	for (i = 0; i < buffer->num_dirty_rects; ++i) {
+		united = image_buffer_rect_union(rect, &buffer->dirty_rects[i]);
+		growth = image_buffer_rect_area(&united) -
+			image_buffer_rect_area(&buffer->dirty_rects[i]) -
+			area;
+		if ((best_index == -1) || (growth < best_growth)) {
+			best_growth = growth;
+			best_index = i;
+		}
+	}
+	if (!force && (best_growth > 0)) {
+		return -1;
+	}
+	return best_index;
+}
+
+void image_buffer_mark_dirty (
+		image_buffer* buffer,
+		int left,
+		int top,
+		int width,
+		int height)
+{
+	image_buffer_rect rect;
+	int i;
+	assert(width >= 0);
+	assert(height >= 0);
+	rect.left = MAX(0, left);
+	rect.top = MAX(0, top);
+	rect.right = MIN(left + width, (int)image_buffer_width(buffer));
+	rect.bottom = MIN(top + height, (int)image_buffer_height(buffer));
+	// checks before aligning, which would widen an empty area to a byte
+	if ((rect.left >= rect.right) || (rect.top >= rect.bottom)) {
+		return;
+	}
+	rect.left &= ~7;
+	rect.right = (rect.right + 7) & ~7;
+	// merging may make the rectangle mergeable with another one,
+	// so repeats until there is no dirty rectangle to merge
+	for (;;) {
+		i = image_buffer_choose_dirty_rect_to_merge(buffer, &rect, 0);
+		if (i == -1) {
+			if (buffer->num_dirty_rects < IMAGE_BUFFER_MAX_DIRTY_RECTS) {
+				break;
+			}
+			i = image_buffer_choose_dirty_rect_to_merge(buffer, &rect, 1);
+		}
+		rect = image_buffer_rect_union(&rect, &buffer->dirty_rects[i]);
+		--buffer->num_dirty_rects;
+		buffer->dirty_rects[i] = buffer->dirty_rects[buffer->num_dirty_rects];
+	}
+	buffer->dirty_rects[buffer->num_dirty_rects] = rect;
+	++buffer->num_dirty_rects;
+}
+
+void image_buffer_clear_dirty (image_buffer* buffer) {
+	buffer->num_dirty_rects = 0;
+}
+
+void image_buffer_clear_all (image_buffer* buffer) {
 	memset(buffer->memory, 0xFF, buffer->height * (buffer->width / 8u));
+	image_buffer_clear_dirty(buffer);
+	image_buffer_mark_dirty(
+		buffer,
+		0,
+		0,
+		(int)image_buffer_width(buffer),
+		(int)image_buffer_height(buffer));
+}
+
+/**
+ * @brief Mask of bits in a byte starting from a given bit.
+ *
+ * Bits are counted from the MSB.
+ *
+ * @param[in] start
+ *
+ *   First bit (`0`-`7`) in the mask.
+ *
+ * @param[in] count
+ *
+ *   Number of bits in the mask.
+ *   `start + count` must not exceed `8`.
+ *
+ * @return
+ *
+ *   Mask of `count` bits starting from the bit `start`.
+ */
+static inline uint8_t image_buffer_bit_mask (int start, int count) {
+	return (uint8_t)((0xFFu >> start) & ~(0xFFu >> (start + count)));
+}
+
+/**
+ * @brief Loads up to 8 bits starting from a given bit.
+ *
+ * Reads the next byte only if the bits straddle a byte boundary.
+ *
+ * @param[in] src
+ *
+ *   Byte containing the first bit.
+ *
+ * @param[in] bit
+ *
+ *   First bit (`0`-`7`) in `src[0]`, counted from the MSB.
+ *
+ * @param[in] count
+ *
+ *   Number of bits to load (`1`-`8`).
+ *
+ * @return
+ *
+ *   Loaded bits aligned to the MSB.
+ *   Bits after `count` are undefined.
+ */
+static inline uint8_t image_buffer_load_bits (
+		const uint8_t* src,
+		int bit,
+		int count)
+{
+	uint32_t bits = (uint32_t)src[0] << bit;
+	if ((bit + count) > 8) {
+		bits |= (uint32_t)src[1] >> (8 - bit);
+	}
+	return (uint8_t)bits;
+}
+
+/**
+ * @brief Loads 32 bits starting from a given bit.
+ *
+ * Bytes are loaded one by one because unaligned word access is not allowed.
+ *
+ * @param[in] src
+ *
+ *   Byte containing the first bit.
+ *   `src[4]` is read only if `bit` is not `0`.
+ *
+ * @param[in] bit
+ *
+ *   First bit (`0`-`7`) in `src[0]`, counted from the MSB.
+ *
+ * @return
+ *
+ *   Loaded bits. The first bit is the MSB.
+ */
+static inline uint32_t image_buffer_load_word (const uint8_t* src, int bit) {
+	uint32_t word = ((uint32_t)src[0] << 24) |
+		((uint32_t)src[1] << 16) |
+		((uint32_t)src[2] << 8) |
+		(uint32_t)src[3];
+	if (bit != 0) {
+		word = (word << bit) | ((uint32_t)src[4] >> (8 - bit));
+	}
+	return word;
+}
+
+/**
+ * @brief Stores 32 bits at a given byte.
+ *
+ * @param[out] dest
+ *
+ *   Block where the bits are to be stored.
+ *
+ * @param[in] word
+ *
+ *   Bits to be stored. The MSB goes to the MSB of `dest[0]`.
+ */
+static inline void image_buffer_store_word (uint8_t* dest, uint32_t word) {
+	dest[0] = (uint8_t)(word >> 24);
+	dest[1] = (uint8_t)(word >> 16);
+	dest[2] = (uint8_t)(word >> 8);
+	dest[3] = (uint8_t)word;
+}
+
+/**
+ * @brief Applies a raster operation.
+ *
+ * Inlined with a constant `rop` so that the switch is resolved at compile
+ * time.
+ *
+ * @param[in] dest
+ *
+ *   Destination bits.
+ *
+ * @param[in] src
+ *
+ *   Source bits.
+ *
+ * @param[in] rop
+ *
+ *   Raster operation.
+ *
+ * @return
+ *
+ *   Result bits.
+ */
+static inline __attribute__((always_inline)) uint32_t image_buffer_apply_rop (
+		uint32_t dest,
+		uint32_t src,
+		image_buffer_rop rop)
+{
+	switch (rop) {
+	case IMAGE_BUFFER_ROP_AND:
+		return dest & src;
+	case IMAGE_BUFFER_ROP_OR:
+		return dest | src;
+	case IMAGE_BUFFER_ROP_XOR:
+		return dest ^ src;
+	case IMAGE_BUFFER_ROP_NOT_SRC:
+		return ~src;
+	case IMAGE_BUFFER_ROP_COPY:
+	default:
+		return src;
+	}
+}
+
+/**
+ * @brief Combines a row of bits.
+ *
+ * Bits outside the destination range, or where the mask is `0`,
+ * are preserved.
+ *
+ * Inlined with constant `rop` and `masked` by the specialized row functions
+ * defined with `IMAGE_BUFFER_DEFINE_BLIT_ROW`,
+ * so that the inner loops have no branches on them.
+ *
+ * @param[in,out] dest
+ *
+ *   Beginning of the destination row.
+ *
+ * @param[in] dest_x
+ *
+ *   First destination bit.
+ *
+ * @param[in] src
+ *
+ *   Beginning of the source row.
+ *
+ * @param[in] mask
+ *
+ *   Beginning of the mask row.
+ *   Ignored unless `masked` is non-zero.
+ *
+ * @param[in] src_x
+ *
+ *   First source (and mask) bit.
+ *
+ * @param[in] width
+ *
+ *   Number of bits to combine. Must be positive.
+ *
+ * @param[in] rop
+ *
+ *   Raster operation.
+ *
+ * @param[in] masked
+ *
+ *   Whether `mask` is applied.
+ */
+static inline __attribute__((always_inline)) void image_buffer_blit_row (
+		uint8_t* dest,
+		int dest_x,
+		const uint8_t* src,
+		const uint8_t* mask,
+		int src_x,
+		int width,
+		image_buffer_rop rop,
+		int masked)
+{
+	uint32_t word_mask;
+	uint32_t word;
+	uint8_t edge;
+	uint8_t bits;
+	int count;
+	int src_bit = src_x % 8;
+	int dest_bit = dest_x % 8;
+	dest += dest_x / 8;
+	src += src_x / 8;
+	if (masked) {
+		mask += src_x / 8;
+	}
+	// leading partial byte
+	if (dest_bit != 0) {
+		count = MIN(8 - dest_bit, width);
+		edge = image_buffer_bit_mask(dest_bit, count);
+		if (masked) {
+			edge &= image_buffer_load_bits(mask, src_bit, count) >> dest_bit;
+		}
+		bits = (uint8_t)image_buffer_apply_rop(
+			*dest,
+			image_buffer_load_bits(src, src_bit, count) >> dest_bit,
+			rop);
+		*dest = (*dest & ~edge) | (bits & edge);
+		++dest;
+		src_bit += count;
+		src += src_bit / 8;
+		if (masked) {
+			mask += src_bit / 8;
+		}
+		src_bit %= 8;
+		width -= count;
+	}
+	// `dest` is byte-aligned from here
+	if ((rop == IMAGE_BUFFER_ROP_COPY) && !masked && (src_bit == 0)) {
+		memcpy(dest, src, width / 8);
+		dest += width / 8;
+		src += width / 8;
+		width %= 8;
+	} else {
+		for (; width >= 32; width -= 32) {
+			word = image_buffer_load_word(src, src_bit);
+			if ((rop != IMAGE_BUFFER_ROP_COPY) &&
+				(rop != IMAGE_BUFFER_ROP_NOT_SRC))
+			{
+				word = image_buffer_apply_rop(
+					image_buffer_load_word(dest, 0),
+					word,
+					rop);
+			} else {
+				word = image_buffer_apply_rop(0u, word, rop);
+			}
+			if (masked) {
+				word_mask = image_buffer_load_word(mask, src_bit);
+				word = (image_buffer_load_word(dest, 0) & ~word_mask) |
+					(word & word_mask);
+				mask += 4;
+			}
+			image_buffer_store_word(dest, word);
+			dest += 4;
+			src += 4;
+		}
+		for (; width >= 8; width -= 8) {
+			edge = masked ? image_buffer_load_bits(mask, src_bit, 8) : 0xFFu;
+			bits = (uint8_t)image_buffer_apply_rop(
+				*dest,
+				image_buffer_load_bits(src, src_bit, 8),
+				rop);
+			*dest = (*dest & ~edge) | (bits & edge);
+			++dest;
+			++src;
+			if (masked) {
+				++mask;
+			}
+		}
+	}
+	// trailing partial byte
+	if (width > 0) {
+		edge = image_buffer_bit_mask(0, width);
+		if (masked) {
+			edge &= image_buffer_load_bits(mask, src_bit, width);
+		}
+		bits = (uint8_t)image_buffer_apply_rop(
+			*dest,
+			image_buffer_load_bits(src, src_bit, width),
+			rop);
+		*dest = (*dest & ~edge) | (bits & edge);
+	}
+}
+
+/** @brief Signature of a specialized row function. */
+typedef void (*image_buffer_blit_row_fn)(
+		uint8_t* dest,
+		int dest_x,
+		const uint8_t* src,
+		const uint8_t* mask,
+		int src_x,
+		int width);
+
+/**
+ * @brief Defines a row function specialized for a raster operation.
+ *
+ * @param[in] name
+ *
+ *   Name of the function.
+ *
+ * @param[in] rop
+ *
+ *   Raster operation.
+ *
+ * @param[in] masked
+ *
+ *   Whether a mask is applied.
+ */
+#define IMAGE_BUFFER_DEFINE_BLIT_ROW(name, rop, masked) \
+static void name ( \
+		uint8_t* dest, \
+		int dest_x, \
+		const uint8_t* src, \
+		const uint8_t* mask, \
+		int src_x, \
+		int width) \
+{ \
+	image_buffer_blit_row(dest, dest_x, src, mask, src_x, width, rop, masked); \
+}
+
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_row_copy,
+	IMAGE_BUFFER_ROP_COPY,
+	0)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_row_and,
+	IMAGE_BUFFER_ROP_AND,
+	0)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_row_or,
+	IMAGE_BUFFER_ROP_OR,
+	0)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_row_xor,
+	IMAGE_BUFFER_ROP_XOR,
+	0)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_row_not_src,
+	IMAGE_BUFFER_ROP_NOT_SRC,
+	0)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_masked_row_copy,
+	IMAGE_BUFFER_ROP_COPY,
+	1)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_masked_row_and,
+	IMAGE_BUFFER_ROP_AND,
+	1)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_masked_row_or,
+	IMAGE_BUFFER_ROP_OR,
+	1)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_masked_row_xor,
+	IMAGE_BUFFER_ROP_XOR,
+	1)
+IMAGE_BUFFER_DEFINE_BLIT_ROW(
+	image_buffer_blit_masked_row_not_src,
+	IMAGE_BUFFER_ROP_NOT_SRC,
+	1)
+
+/**
+ * @brief Specialized row functions.
+ *
+ * Indexed by `[masked][rop]`.
+ */
+static const image_buffer_blit_row_fn
+	IMAGE_BUFFER_BLIT_ROW_FUNCTIONS[2][IMAGE_BUFFER_NUM_ROPS] =
+{
+	{
+		image_buffer_blit_row_copy,
+		image_buffer_blit_row_and,
+		image_buffer_blit_row_or,
+		image_buffer_blit_row_xor,
+		image_buffer_blit_row_not_src
+	},
+	{
+		image_buffer_blit_masked_row_copy,
+		image_buffer_blit_masked_row_and,
+		image_buffer_blit_masked_row_or,
+		image_buffer_blit_masked_row_xor,
+		image_buffer_blit_masked_row_not_src
+	}
+};
+
+/**
+ * @brief Fills a row of bits with `1`.
+ *
+ * Bits outside the range are preserved.
+ *
+ * @param[out] dest
+ *
+ *   Beginning of the row.
+ *
+ * @param[in] x
+ *
+ *   First bit to fill.
+ *
+ * @param[in] width
+ *
+ *   Number of bits to fill. Must be positive.
+ */
+static void image_buffer_fill_row (uint8_t* dest, int x, int width) {
+	int count;
+	int bit = x % 8;
+	dest += x / 8;
+	if (bit != 0) {
+		count = MIN(8 - bit, width);
+		*dest |= image_buffer_bit_mask(bit, count);
+		++dest;
+		width -= count;
+	}
+	memset(dest, 0xFF, width / 8);
+	dest += width / 8;
+	width %= 8;
+	if (width > 0) {
+		*dest |= image_buffer_bit_mask(0, width);
+	}
 }
 
 void image_buffer_clear_range (
-		const image_buffer* buffer,
+		image_buffer* buffer,
 		int left,
 		int top,
 		int width,
 		int height)
 {
 	uint8_t* dest;
-	uint8_t* dest_next;
 	int y;
 	int right = left + width;
 	int bottom = top + height;
 	int row_bytes = (int)image_buffer_width(buffer) / 8;
 	assert(width >= 0);
 	assert(height >= 0);
-	assert((left % 8) == 0);
-	assert((width % 8) == 0);
 	left = MAX(0, left);
 	top = MAX(0, top);
 	right = MIN(right, (int)image_buffer_width(buffer));
@@ -40,64 +604,95 @@ void image_buffer_clear_range (
 	}
 	width = right - left;
 	height = bottom - top;
-	dest_next = image_buffer_begin(buffer) + (top * row_bytes) + (left / 8);
+	image_buffer_mark_dirty(buffer, left, top, width, height);
+	dest = image_buffer_begin(buffer) + (top * row_bytes);
 	for (y = 0; y < height; ++y) {
-		dest = dest_next;
-		dest_next += row_bytes;
-		memset(dest, 0xFF, width / 8);
+		image_buffer_fill_row(dest, left, width);
+		dest += row_bytes;
 	}
 }
 
-void image_buffer_draw_image (
-		const image_buffer* buffer,
+void image_buffer_blit (
+		image_buffer* buffer,
 		const uint8_t* data,
+		const uint8_t* mask,
 		int left,
 		int top,
 		int width,
-		int height)
+		int height,
+		image_buffer_rop rop)
 {
+	image_buffer_blit_row_fn blit_row;
 	const uint8_t* src;
-	const uint8_t* src_next;
 	uint8_t* dest;
-	uint8_t* dest_next;
 	int y;
-	int src_scan_size = (int)width / 8;
+	int src_x = 0;
+	int src_scan_size = (width + 7) / 8;
 	int dest_scan_size = (int)image_buffer_width(buffer) / 8;
 	int right = left + width;
 	int bottom = top + height;
 	assert(width >= 0);
 	assert(height >= 0);
-	assert((left % 8) == 0);
-	assert((width % 8) == 0);
-	dest_next = image_buffer_begin(buffer) +
-		(top * dest_scan_size) +
-		(left / 8);
-	src_next = data;
+	assert((rop >= 0) && (rop < IMAGE_BUFFER_NUM_ROPS));
+	blit_row = IMAGE_BUFFER_BLIT_ROW_FUNCTIONS[(mask != NULL) ? 1 : 0][rop];
+	src = data;
 	if (left < 0) {
-		src_next += (-left) / 8;
-		dest_next += (-left) / 8;
-		width += left;
+		src_x = -left;
+		left = 0;
 	}
 	if (top < 0) {
-		src_next += (-top) * src_scan_size;
-		dest_next += (-top) * dest_scan_size;
-		height += top;
-	}
-	if (right > (int)image_buffer_width(buffer)) {
-		width -= right - (int)image_buffer_width(buffer);
+		src += (-top) * src_scan_size;
+		if (mask != NULL) {
+			mask += (-top) * src_scan_size;
+		}
+		top = 0;
 	}
-	if (bottom > (int)image_buffer_height(buffer)) {
-		height -= bottom - (int)image_buffer_height(buffer);
+	right = MIN(right, (int)image_buffer_width(buffer));
+	bottom = MIN(bottom, (int)image_buffer_height(buffer));
+	if ((left >= right) || (top >= bottom)) {
+		return;
 	}
-	if ((width <= 0) || (height <= 0)) {
+	width = right - left;
+	height = bottom - top;
+	image_buffer_mark_dirty(buffer, left, top, width, height);
+	dest = image_buffer_begin(buffer) + (top * dest_scan_size);
+	if ((rop == IMAGE_BUFFER_ROP_COPY) &&
+		(mask == NULL) &&
+		(left == 0) &&
+		(src_x == 0) &&
+		(src_scan_size == dest_scan_size) &&
+		(width == (int)image_buffer_width(buffer)))
+	{
+		// whole rows are contiguous in both,
+		// so they are copied at once whatever the width of the panel
+		memcpy(dest, src, (size_t)height * dest_scan_size);
 		return;
 	}
 	for (y = 0; y < height; ++y) {
-		src = src_next;
-		src_next += src_scan_size;
-		dest = dest_next;
-		dest_next += dest_scan_size;
-		memcpy(dest, src, width / 8);
+		blit_row(dest, left, src, mask, src_x, width);
+		src += src_scan_size;
+		if (mask != NULL) {
+			mask += src_scan_size;
+		}
+		dest += dest_scan_size;
 	}
 }
 
+void image_buffer_draw_image (
+		image_buffer* buffer,
+		const uint8_t* data,
+		int left,
+		int top,
+		int width,
+		int height)
+{
+	image_buffer_blit(
+		buffer,
+		data,
+		NULL,
+		left,
+		top,
+		width,
+		height,
+		IMAGE_BUFFER_ROP_COPY);
+}
@@ -13,6 +13,47 @@
 externs "C" {
 #endif
 
+/**
+ * @brief Maximum number of dirty rectangles tracked by an `::image_buffer`.
+ */
+#define IMAGE_BUFFER_MAX_DIRTY_RECTS  4
+
+/**
+ * @brief Rectangle in an `::image_buffer`.
+ *
+ * `right` and `bottom` are **exclusive**.
+ */
+typedef struct image_buffer_rect_t {
+	/** @brief Left position (inclusive). */
+	int left;
+	/** @brief Top position (inclusive). */
+	int top;
+	/** @brief Right position (exclusive). */
+	int right;
+	/** @brief Bottom position (exclusive). */
+	int bottom;
+} image_buffer_rect;
+
+/**
+ * @brief Raster operation to combine a source image with an `::image_buffer`.
+ *
+ * A bit `1` is white and `0` is black.
+ */
+typedef enum image_buffer_rop_t {
+	/** @brief `dest = src` */
+	IMAGE_BUFFER_ROP_COPY = 0,
+	/** @brief `dest = dest & src`; i.e., draws black pixels of `src`. */
+	IMAGE_BUFFER_ROP_AND,
+	/** @brief `dest = dest | src`; i.e., draws white pixels of `src`. */
+	IMAGE_BUFFER_ROP_OR,
+	/** @brief `dest = dest ^ src`; i.e., inverts where `src` is white. */
+	IMAGE_BUFFER_ROP_XOR,
+	/** @brief `dest = ~src` */
+	IMAGE_BUFFER_ROP_NOT_SRC,
+	/** @brief Number of raster operations. Not an operation. */
+	IMAGE_BUFFER_NUM_ROPS
+} image_buffer_rop;
+
 /**
  * @brief Image buffer.
  */
@@ -23,6 +64,15 @@ typedef struct image_buffer_t {
 	uint32_t width;
 	/** @brief Height of the image buffer. */
 	uint32_t height;
+	/**
+	 * @brief Dirty rectangles of the image buffer.
+	 *
+	 * Left and right positions are multiples of `8`.
+	 * Only the first `num_dirty_rects` elements are valid.
+	 */
+	image_buffer_rect dirty_rects[IMAGE_BUFFER_MAX_DIRTY_RECTS];
+	/** @brief Number of dirty rectangles. */
+	int num_dirty_rects;
 } image_buffer;
 
 /**
@@ -32,6 +82,8 @@ typedef struct image_buffer_t {
  *
  * It will cause undefined behavior if `_width` is not a multiple of `8`.
  *
+ * An initialized `::image_buffer` has no dirty rectangles.
+ *
  * @param[in] _memory
  *
  *   (`uint8_t*`) Memory block of the image buffer.
@@ -53,7 +105,8 @@ typedef struct image_buffer_t {
 { \
 	.memory = (_memory), \
 	.width = (_width), \
-	.height = (_height) \
+	.height = (_height), \
+	.num_dirty_rects = 0 \
 }
 
 /**
@@ -111,16 +164,105 @@ typedef struct image_buffer_t {
 #define image_buffer_end(buffer) \
 	((buffer)->memory + ((buffer)->height * ((buffer)->width / 8u)))
 
+/**
+ * @brief Number of dirty rectangles in an `::image_buffer`.
+ *
+ * @param[in] buffer
+ *
+ *   (`const image_buffer*`)
+ *   `::image_buffer` whose dirty rectangles are to be counted.
+ *
+ * @return
+ *
+ *   (`int`) Number of dirty rectangles in `buffer`.
+ */
+#define image_buffer_num_dirty_rects(buffer)  (1 ? (buffer)->num_dirty_rects : 0)
+
+/**
+ * @brief Dirty rectangle at a given index in an `::image_buffer`.
+ *
+ * Will cause undefined behavior if `index` is out of
+ * `[0, image_buffer_num_dirty_rects(buffer))`.
+ *
+ * @param[in] buffer
+ *
+ *   (`const image_buffer*`)
+ *   `::image_buffer` whose dirty rectangle is to be obtained.
+ *
+ * @param[in] index
+ *
+ *   (`int`) Index of the dirty rectangle.
+ *
+ * @return
+ *
+ *   (`const image_buffer_rect*`) Dirty rectangle at `index`.
+ */
+#define image_buffer_dirty_rect(buffer, index) \
+	((const image_buffer_rect*)&(buffer)->dirty_rects[(index)])
+
+/**
+ * @brief Marks a given area of an `::image_buffer` dirty.
+ *
+ * The area is clipped by the bounds of `buffer`,
+ * and horizontally extended to byte boundaries.
+ *
+ * The area is merged with an existing dirty rectangle
+ * if the merged rectangle is not larger than both of them in total.
+ * If there is no room for another dirty rectangle, the area is merged with
+ * the dirty rectangle that grows least.
+ *
+ * Will cause undefined behavior if `width` or `height` is negative.
+ *
+ * @param[in,out] buffer
+ *
+ *   `::image_buffer` to be marked dirty.
+ *
+ * @param[in] left
+ *
+ *   Left position of the dirty area.
+ *
+ * @param[in] top
+ *
+ *   Top position of the dirty area.
+ *
+ * @param[in] width
+ *
+ *   Width of the dirty area.
+ *
+ * @param[in] height
+ *
+ *   Height of the dirty area.
+ */
+void image_buffer_mark_dirty (
+		image_buffer* buffer,
+		int left,
+		int top,
+		int width,
+		int height);
+
+/**
+ * @brief Forgets all of the dirty rectangles of an `::image_buffer`.
+ *
+ * Call this function after the dirty rectangles are transferred.
+ *
+ * @param[in,out] buffer
+ *
+ *   `::image_buffer` whose dirty rectangles are to be cleared.
+ */
+void image_buffer_clear_dirty (image_buffer* buffer);
+
 /**
  * @brief Clears the entire `::image_buffer`.
  *
  * Fills all of the bits in `::image_buffer` with `1`.
  *
- * @param[in] buffer
+ * Marks the entire `buffer` dirty.
+ *
+ * @param[in,out] buffer
  *
  *   `::image_buffer` to clear.
  */
-void image_buffer_clear_all (const image_buffer* buffer);
+void image_buffer_clear_all (image_buffer* buffer);
 
 /**
  * @brief Clears a range in an `::image_buffer`.
@@ -129,9 +271,12 @@ void image_buffer_clear_all (const image_buffer* buffer);
  *
  * Will cause undefined behavior if `width` or `height` is negative.
  *
- * Will cause undefined behavior if `left` or `width` is not a multiple of `8`.
+ * `left` and `width` may be arbitrary; i.e., need not be multiples of `8`.
+ * The area is clipped by the bounds of `buffer`.
  *
- * @param[in] buffer
+ * Marks the cleared area dirty.
+ *
+ * @param[in,out] buffer
  *
  *   `::image_buffer` to clear.
  *
@@ -152,7 +297,7 @@ void image_buffer_clear_all (const image_buffer* buffer);
  *   Height of the area to be cleared.
  */
 void image_buffer_clear_range (
-		const image_buffer* buffer,
+		image_buffer* buffer,
 		int left,
 		int top,
 		int width,
@@ -163,16 +308,25 @@ void image_buffer_clear_range (
  *
  * Will cause undefined behavior if `width` or `height` is negative.
  *
- * Will cause undefined behavior if `left` or `width` is not a multiple of `8`.
+ * `left` and `width` may be arbitrary; i.e., need not be multiples of `8`.
+ * The image is clipped by the bounds of `buffer`.
+ * Byte-aligned images are copied with `memcpy`,
+ * and others are shifted 32 bits at a time.
  *
- * @param[in] buffer
+ * Equivalent to `::image_buffer_blit` with `IMAGE_BUFFER_ROP_COPY` and
+ * no mask.
+ *
+ * Marks the drawn area dirty.
+ *
+ * @param[in,out] buffer
  *
  *   `::image_buffer` where a given image is to be drawn.
  *
  * @param[in] data
  *
  *   Pointer to image data to draw.
- *   Block must be as large as `height * (width / 8)`.
+ *   Each row is padded to a byte boundary.
+ *   Block must be as large as `height * ((width + 7) / 8)`.
  *
  * @param[in] left
  *
@@ -191,13 +345,74 @@ void image_buffer_clear_range (
  *   Height of the image.
  */
 void image_buffer_draw_image (
-		const image_buffer* buffer,
+		image_buffer* buffer,
 		const uint8_t* data,
 		int left,
 		int top,
 		int width,
 		int height);
 
+/**
+ * @brief Combines a given image with an `::image_buffer`.
+ *
+ * Each bit in the area is replaced with the result of `rop`.
+ * If `mask` is not `NULL`, only bits where `mask` is `1` are replaced,
+ * and the other bits are preserved.
+ *
+ * Will cause undefined behavior if `width` or `height` is negative.
+ *
+ * `left` and `width` may be arbitrary; i.e., need not be multiples of `8`.
+ * The image is clipped by the bounds of `buffer`.
+ * Every raster operation has its own inner loop that processes 32 bits at
+ * a time.
+ *
+ * Marks the drawn area dirty.
+ *
+ * @param[in,out] buffer
+ *
+ *   `::image_buffer` where a given image is to be drawn.
+ *
+ * @param[in] data
+ *
+ *   Pointer to image data to draw.
+ *   Each row is padded to a byte boundary.
+ *   Block must be as large as `height * ((width + 7) / 8)`.
+ *
+ * @param[in] mask
+ *
+ *   Pointer to a 1-bpp mask plane in the same layout as `data`.
+ *   `NULL` if no mask is applied.
+ *
+ * @param[in] left
+ *
+ *   Left position of the image.
+ *
+ * @param[in] top
+ *
+ *   Top position of the image.
+ *
+ * @param[in] width
+ *
+ *   Width of the image.
+ *
+ * @param[in] height
+ *
+ *   Height of the image.
+ *
+ * @param[in] rop
+ *
+ *   Raster operation.
+ */
+void image_buffer_blit (
+		image_buffer* buffer,
+		const uint8_t* data,
+		const uint8_t* mask,
+		int left,
+		int top,
+		int width,
+		int height,
+		image_buffer_rop rop);
+
 #ifdef __cplusplus
 }
 #endif
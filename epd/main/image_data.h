@@ -4,6 +4,8 @@
  * Defines image data.
  */
 
+#include "rle_image.h"
+
 /**
  * @brief Example image data.
  *
@@ -78,39 +80,59 @@ static const uint8_t EXAMPLE_IMAGE_DATA[] = {
 };
 
 /**
- * @brief Display Mode 1 image data.
+ * @brief Display Mode 1 image data, run-length compressed.
+ *
+ * Generated by `py/make_binary_image.py --format rle imgs/display-mode-1.png`.
+ */
+static const uint8_t DISPLAY_MODE_1_IMAGE_DATA_RLE[] = {
+	0x03u, 0x0Fu, 0xDFu, 0xFFu, 0xFCu, 0xFEu, 0xFFu, 0x09u, 0x11u, 0xFFu, 0xCFu, 0xFFu, 0xF9u, 0xFFu, 0xB7u, 0xFFu,
+	0xFFu, 0xFEu, 0xFEu, 0xFFu, 0x59u, 0x93u, 0xFFu, 0xEFu, 0xFFu, 0xFDu, 0xFFu, 0xBBu, 0x1Fu, 0x09u, 0x3Eu, 0xF8u,
+	0xC4u, 0x7Fu, 0x93u, 0x8Fu, 0x2Eu, 0x3Fu, 0xFDu, 0xFFu, 0xBBu, 0xDEu, 0xECu, 0xDEu, 0xFFu, 0x6Eu, 0xFFu, 0xABu,
+	0x76u, 0xCDu, 0xDFu, 0xFDu, 0xFFu, 0xBBu, 0xDFu, 0x1Du, 0xDEu, 0xF8u, 0x76u, 0xFFu, 0xABu, 0x76u, 0xECu, 0x1Fu,
+	0xFDu, 0xFFu, 0xBBu, 0xDFu, 0xEDu, 0xDEu, 0xF7u, 0x75u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xFDu, 0xFFu, 0xB7u,
+	0xDEu, 0xEDu, 0xDEu, 0xF7u, 0x79u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xFDu, 0xFFu, 0x0Fu, 0x06u, 0x1Cu, 0x38u,
+	0x38u, 0x3Bu, 0xFFu, 0x11u, 0x8Fu, 0x06u, 0x1Fu, 0xF0u, 0x7Fu, 0xFFu, 0xFFu, 0xFDu, 0xFFu, 0xFFu, 0xFBu, 0xF8u,
+	0xFFu, 0x03u, 0xF8u, 0xFFu, 0xFFu, 0xE1u, 0xFAu, 0xFFu,
+};
+
+/**
+ * @brief Display Mode 1 image.
  *
  * - Width: 104
  * - Height: 10
  */
-static const uint8_t DISPLAY_MODE_1_IMAGE_DATA[] = {
-	0x0Fu, 0xDFu, 0xFFu, 0xFCu, 0xFFu, 0xFFu, 0xFFu, 0x11u, 0xFFu, 0xCFu, 0xFFu, 0xF9u, 0xFFu,
-	0xB7u, 0xFFu, 0xFFu, 0xFEu, 0xFFu, 0xFFu, 0xFFu, 0x93u, 0xFFu, 0xEFu, 0xFFu, 0xFDu, 0xFFu,
-	0xBBu, 0x1Fu, 0x09u, 0x3Eu, 0xF8u, 0xC4u, 0x7Fu, 0x93u, 0x8Fu, 0x2Eu, 0x3Fu, 0xFDu, 0xFFu,
-	0xBBu, 0xDEu, 0xECu, 0xDEu, 0xFFu, 0x6Eu, 0xFFu, 0xABu, 0x76u, 0xCDu, 0xDFu, 0xFDu, 0xFFu,
-	0xBBu, 0xDFu, 0x1Du, 0xDEu, 0xF8u, 0x76u, 0xFFu, 0xABu, 0x76u, 0xECu, 0x1Fu, 0xFDu, 0xFFu,
-	0xBBu, 0xDFu, 0xEDu, 0xDEu, 0xF7u, 0x75u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xFDu, 0xFFu,
-	0xB7u, 0xDEu, 0xEDu, 0xDEu, 0xF7u, 0x79u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xFDu, 0xFFu,
-	0x0Fu, 0x06u, 0x1Cu, 0x38u, 0x38u, 0x3Bu, 0xFFu, 0x11u, 0x8Fu, 0x06u, 0x1Fu, 0xF0u, 0x7Fu,
-	0xFFu, 0xFFu, 0xFDu, 0xFFu, 0xFFu, 0xFBu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
-	0xFFu, 0xFFu, 0xF8u, 0xFFu, 0xFFu, 0xE1u, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+static const rle_image DISPLAY_MODE_1_IMAGE = rle_image_initializer(
+	DISPLAY_MODE_1_IMAGE_DATA_RLE,
+	sizeof(DISPLAY_MODE_1_IMAGE_DATA_RLE),
+	104u,
+	10u,
+	0u);
+
+/**
+ * @brief Display Mode 2 image data, run-length compressed.
+ *
+ * Generated by `py/make_binary_image.py --format rle imgs/display-mode-2.png`.
+ */
+static const uint8_t DISPLAY_MODE_2_IMAGE_DATA_RLE[] = {
+	0x03u, 0x0Fu, 0xDFu, 0xFFu, 0xFCu, 0xFEu, 0xFFu, 0x09u, 0x11u, 0xFFu, 0xCFu, 0xFFu, 0xF8u, 0xFFu, 0xB7u, 0xFFu,
+	0xFFu, 0xFEu, 0xFEu, 0xFFu, 0x59u, 0x93u, 0xFFu, 0xEFu, 0xFFu, 0xF7u, 0x7Fu, 0xBBu, 0x1Fu, 0x09u, 0x3Eu, 0xF8u,
+	0xC4u, 0x7Fu, 0x93u, 0x8Fu, 0x2Eu, 0x3Fu, 0xFFu, 0x7Fu, 0xBBu, 0xDEu, 0xECu, 0xDEu, 0xFFu, 0x6Eu, 0xFFu, 0xABu,
+	0x76u, 0xCDu, 0xDFu, 0xFEu, 0xFFu, 0xBBu, 0xDFu, 0x1Du, 0xDEu, 0xF8u, 0x76u, 0xFFu, 0xABu, 0x76u, 0xECu, 0x1Fu,
+	0xFDu, 0xFFu, 0xBBu, 0xDFu, 0xEDu, 0xDEu, 0xF7u, 0x75u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xFBu, 0xFFu, 0xB7u,
+	0xDEu, 0xEDu, 0xDEu, 0xF7u, 0x79u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xF7u, 0x7Fu, 0x0Fu, 0x06u, 0x1Cu, 0x38u,
+	0x38u, 0x3Bu, 0xFFu, 0x11u, 0x8Fu, 0x06u, 0x1Fu, 0xF0u, 0x7Fu, 0xFFu, 0xFFu, 0xFDu, 0xFFu, 0xFFu, 0xFBu, 0xF8u,
+	0xFFu, 0x03u, 0xF8u, 0xFFu, 0xFFu, 0xE1u, 0xFAu, 0xFFu,
 };
 
 /**
- * @brief Display Mode 2 image data.
+ * @brief Display Mode 2 image.
  *
  * - Width: 104
  * - Height: 10
  */
-static const uint8_t DISPLAY_MODE_2_IMAGE_DATA[] = {
-	0x0Fu, 0xDFu, 0xFFu, 0xFCu, 0xFFu, 0xFFu, 0xFFu, 0x11u, 0xFFu, 0xCFu, 0xFFu, 0xF8u, 0xFFu,
-	0xB7u, 0xFFu, 0xFFu, 0xFEu, 0xFFu, 0xFFu, 0xFFu, 0x93u, 0xFFu, 0xEFu, 0xFFu, 0xF7u, 0x7Fu,
-	0xBBu, 0x1Fu, 0x09u, 0x3Eu, 0xF8u, 0xC4u, 0x7Fu, 0x93u, 0x8Fu, 0x2Eu, 0x3Fu, 0xFFu, 0x7Fu,
-	0xBBu, 0xDEu, 0xECu, 0xDEu, 0xFFu, 0x6Eu, 0xFFu, 0xABu, 0x76u, 0xCDu, 0xDFu, 0xFEu, 0xFFu,
-	0xBBu, 0xDFu, 0x1Du, 0xDEu, 0xF8u, 0x76u, 0xFFu, 0xABu, 0x76u, 0xECu, 0x1Fu, 0xFDu, 0xFFu,
-	0xBBu, 0xDFu, 0xEDu, 0xDEu, 0xF7u, 0x75u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xFBu, 0xFFu,
-	0xB7u, 0xDEu, 0xEDu, 0xDEu, 0xF7u, 0x79u, 0xFFu, 0xBBu, 0x76u, 0xEDu, 0xFFu, 0xF7u, 0x7Fu,
-	0x0Fu, 0x06u, 0x1Cu, 0x38u, 0x38u, 0x3Bu, 0xFFu, 0x11u, 0x8Fu, 0x06u, 0x1Fu, 0xF0u, 0x7Fu,
-	0xFFu, 0xFFu, 0xFDu, 0xFFu, 0xFFu, 0xFBu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
-	0xFFu, 0xFFu, 0xF8u, 0xFFu, 0xFFu, 0xE1u, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
-};
+static const rle_image DISPLAY_MODE_2_IMAGE = rle_image_initializer(
+	DISPLAY_MODE_2_IMAGE_DATA_RLE,
+	sizeof(DISPLAY_MODE_2_IMAGE_DATA_RLE),
+	104u,
+	10u,
+	0u);
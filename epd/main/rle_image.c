@@ -0,0 +1,119 @@
+/**
+ * @file rle_image.c
+ *
+ * Implementation of run-length compressed images.
+ */
+
+#include "rle_image.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * @brief Starts the next run.
+ *
+ * Skips no-operation headers.
+ *
+ * @param[in,out] decoder
+ *
+ *   Decoder whose current run is over.
+ *
+ * @return
+ *
+ *   - `0`: succeeded.
+ *   - `-1`: the compressed stream is exhausted.
+ */
+static int rle_decoder_next_run (rle_decoder* decoder) {
+	int8_t header;
+	do {
+		if (decoder->next == decoder->end) {
+			return -1;
+		}
+		header = (int8_t)*decoder->next++;
+	} while (header == -128);
+	if (header >= 0) {
+		decoder->literal = 1;
+		decoder->run_length = header + 1;
+	} else {
+		if (decoder->next == decoder->end) {
+			return -1;
+		}
+		decoder->literal = 0;
+		decoder->run_length = 1 - header;
+		decoder->run_value = *decoder->next++;
+	}
+	return 0;
+}
+
+void rle_decoder_init (rle_decoder* decoder, const rle_image* image) {
+	decoder->next = image->data;
+	decoder->end = image->data + image->size;
+	decoder->run_length = 0;
+	decoder->literal = 0;
+	decoder->run_value = 0u;
+	decoder->flags = image->flags;
+}
+
+int rle_decoder_read_row (rle_decoder* decoder, uint8_t* row, size_t row_size) {
+	const int delta = (decoder->flags & RLE_IMAGE_FLAG_ROW_DELTA) != 0u;
+	size_t count;
+	size_t i;
+	while (row_size > 0u) {
+		if (decoder->run_length == 0) {
+			if (rle_decoder_next_run(decoder) != 0) {
+				return -1;
+			}
+		}
+		count = MIN(row_size, (size_t)decoder->run_length);
+		if (decoder->literal) {
+			if ((size_t)(decoder->end - decoder->next) < count) {
+				return -1;
+			}
+			if (delta) {
+				for (i = 0u; i < count; ++i) {
+					row[i] ^= decoder->next[i];
+				}
+			} else {
+				memcpy(row, decoder->next, count);
+			}
+			decoder->next += count;
+		} else {
+			if (delta) {
+				for (i = 0u; i < count; ++i) {
+					row[i] ^= decoder->run_value;
+				}
+			} else {
+				memset(row, decoder->run_value, count);
+			}
+		}
+		decoder->run_length -= (int)count;
+		row += count;
+		row_size -= count;
+	}
+	return 0;
+}
+
+int rle_image_draw (
+		image_buffer* buffer,
+		const rle_image* image,
+		int left,
+		int top)
+{
+	rle_decoder decoder;
+	uint8_t row[RLE_IMAGE_MAX_ROW_SIZE];
+	const size_t row_size = rle_image_row_size(image);
+	int y;
+	int bottom = MIN(top + (int)image->height, (int)image_buffer_height(buffer));
+	assert(row_size <= RLE_IMAGE_MAX_ROW_SIZE);
+	rle_decoder_init(&decoder, image);
+	memset(row, 0, row_size);
+	// rows above the buffer are decoded but clipped
+	for (y = top; y < bottom; ++y) {
+		if (rle_decoder_read_row(&decoder, row, row_size) != 0) {
+			return -1;
+		}
+		image_buffer_draw_image(buffer, row, left, y, image->width, 1);
+	}
+	return 0;
+}
@@ -0,0 +1,207 @@
+#ifndef _RLE_IMAGE_H
+#define _RLE_IMAGE_H
+
+/**
+ * @file rle_image.h
+ *
+ * Run-length compressed images.
+ *
+ * A compressed image is a PackBits stream of rows.
+ * Each row is padded to a byte boundary as in `::image_buffer_draw_image`.
+ * A header byte `n` in the stream means,
+ * - `0` to `127`: the next `n + 1` bytes are copied (literal run).
+ * - `-127` to `-1`: the next byte is repeated `1 - n` times (repeat run).
+ * - `-128`: no operation.
+ *
+ * If `RLE_IMAGE_FLAG_ROW_DELTA` is set, each row is XORed with the previous
+ * row (the first row with zeros) before it is compressed.
+ *
+ * `py/make_binary_image.py` emits compressed images.
+ */
+
+#include "image_buffer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Flag: each row is XORed with the previous row. */
+#define RLE_IMAGE_FLAG_ROW_DELTA  0x01u
+
+/**
+ * @brief Maximum number of bytes in a row of an `::rle_image`.
+ *
+ * Large enough for an 800-pixel wide image.
+ */
+#define RLE_IMAGE_MAX_ROW_SIZE  100u
+
+/**
+ * @brief Run-length compressed image.
+ */
+typedef struct rle_image_t {
+	/** @brief Compressed stream. */
+	const uint8_t* data;
+	/** @brief Size of the compressed stream in bytes. */
+	uint32_t size;
+	/** @brief Width of the image. */
+	uint16_t width;
+	/** @brief Height of the image. */
+	uint16_t height;
+	/** @brief Flags; e.g., `RLE_IMAGE_FLAG_ROW_DELTA`. */
+	uint8_t flags;
+} rle_image;
+
+/**
+ * @brief Initializer of an `::rle_image`.
+ *
+ * @param[in] _data
+ *
+ *   (`const uint8_t*`) Compressed stream.
+ *
+ * @param[in] _size
+ *
+ *   (`uint32_t`) Size of the compressed stream in bytes.
+ *
+ * @param[in] _width
+ *
+ *   (`uint16_t`) Width of the image.
+ *
+ * @param[in] _height
+ *
+ *   (`uint16_t`) Height of the image.
+ *
+ * @param[in] _flags
+ *
+ *   (`uint8_t`) Flags.
+ *
+ * @return
+ *
+ *   Initializer of an `::rle_image`.
+ */
+#define rle_image_initializer(_data, _size, _width, _height, _flags) \
+{ \
+	.data = (_data), \
+	.size = (_size), \
+	.width = (_width), \
+	.height = (_height), \
+	.flags = (_flags) \
+}
+
+/**
+ * @brief Number of bytes in a row of an `::rle_image`.
+ *
+ * @param[in] image
+ *
+ *   (`const rle_image*`) `::rle_image` whose row size is to be obtained.
+ *
+ * @return
+ *
+ *   (`size_t`) Number of bytes in a row of `image`.
+ */
+#define rle_image_row_size(image)  ((size_t)(((image)->width + 7u) / 8u))
+
+/**
+ * @brief Streaming decoder of an `::rle_image`.
+ *
+ * Decodes an image row by row without decompressing the entire image.
+ */
+typedef struct rle_decoder_t {
+	/** @brief Next byte in the compressed stream. */
+	const uint8_t* next;
+	/** @brief End of the compressed stream. */
+	const uint8_t* end;
+	/** @brief Number of remaining bytes in the current run. */
+	int run_length;
+	/** @brief Whether the current run is a literal run. */
+	int literal;
+	/** @brief Byte repeated in the current repeat run. */
+	uint8_t run_value;
+	/** @brief Flags of the image. */
+	uint8_t flags;
+} rle_decoder;
+
+/**
+ * @brief Starts decoding a given `::rle_image`.
+ *
+ * @param[out] decoder
+ *
+ *   Decoder to be initialized.
+ *
+ * @param[in] image
+ *
+ *   Image to be decoded.
+ *   Has to outlive the decoding.
+ */
+void rle_decoder_init (rle_decoder* decoder, const rle_image* image);
+
+/**
+ * @brief Decodes the next row.
+ *
+ * If the image has `RLE_IMAGE_FLAG_ROW_DELTA`, `row` has to hold the
+ * previous row; i.e., zeros for the first row.
+ * So reuse the same `row` throughout an image.
+ *
+ * @param[in,out] decoder
+ *
+ *   Decoder.
+ *
+ * @param[in,out] row
+ *
+ *   Block to receive the row.
+ *
+ * @param[in] row_size
+ *
+ *   Number of bytes in a row.
+ *
+ * @return
+ *
+ *   - `0`: succeeded.
+ *   - `-1`: the compressed stream is truncated.
+ */
+int rle_decoder_read_row (rle_decoder* decoder, uint8_t* row, size_t row_size);
+
+/**
+ * @brief Draws a given `::rle_image` in an `::image_buffer`.
+ *
+ * Rows are decoded one by one and drawn with `::image_buffer_draw_image`,
+ * so no extra memory proportional to the image is necessary.
+ *
+ * Will cause undefined behavior if the row size of `image` exceeds
+ * `RLE_IMAGE_MAX_ROW_SIZE`.
+ *
+ * @param[in,out] buffer
+ *
+ *   `::image_buffer` where `image` is to be drawn.
+ *
+ * @param[in] image
+ *
+ *   Image to draw.
+ *
+ * @param[in] left
+ *
+ *   Left position of the image.
+ *
+ * @param[in] top
+ *
+ *   Top position of the image.
+ *
+ * @return
+ *
+ *   - `0`: succeeded.
+ *   - `-1`: the compressed stream is truncated.
+ *     Rows decoded so far are drawn.
+ */
+int rle_image_draw (
+		image_buffer* buffer,
+		const rle_image* image,
+		int left,
+		int top);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
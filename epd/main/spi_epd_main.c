@@ -14,17 +14,26 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "esp_err.h"
 #include "esp_system.h"
-#include "driver/gpio.h"
 #include "driver/spi_master.h"
 
+#include "hal.h"
+#include "spi_bus_manager.h"
+
+#include "epd_driver.h"
+#include "epd_panel.h"
 #include "image_buffer.h"
 #include "image_data.h"
+#include "rle_image.h"
+#include "utils.h"
 
 /** @brief Uses SPI3 (VSPI). */
 #define EPD_HOST  VSPI_HOST
-/** @brief DMA channel is not used. */
-#define DMA_CHAN  0
+/** @brief DMA channel for bulk transfers. */
+#define DMA_CHAN  2
 /**
  * @brief SPI mode.
  *
@@ -75,679 +84,602 @@
 /** @brief GPIO# for BUSY */
 #define PIN_NUM_DC  27
 
-/** @brief Driver Output Control command. */
-#define EPD_COMMAND_DRIVER_OUTPUT_CONTROL  0x01u
-/** @brief Data Entry Mode command. */
-#define EPD_COMMAND_DATA_ENTRY_MODE  0x11u
-/** @brief Software Reset command. */
-#define EPD_COMMAND_SW_RESET  0x12u
-/** @brief Temperature Sensor Control command. */
-#define EPD_COMMAND_TEMPERATURE_SENSOR_CONTROL  0x1Au
-/** @brief Master Activation command. */
-#define EPD_COMMAND_MASTER_ACTIVATION  0x20u
-/** @brief Display Update Control command. */
-#define EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2  0x22u
-/** @brief Write RAM (Black and White) command. */
-#define EPD_COMMAND_WRITE_RAM_BW  0x24u
-/**
- * @brief Border Waveform Control command.
- *
- * Undocumented in the datasheet.
- */
-#define EPD_COMMAND_BORDER_WAVEFORM_CONTROL  0x3Cu
-/** @brief RAM X Start / End Address command. */
-#define EPD_COMMAND_RAM_X_START_END_ADDRESS  0x44u
-/** @brief RAM Y Start / End Address command. */
-#define EPD_COMMAND_RAM_Y_START_END_ADDRESS  0x45u
-/** @brief RAM X Address command. */
-#define EPD_COMMAND_RAM_X_ADDRESS  0x4Eu
-/** @brief RAM Y Address command. */
-#define EPD_COMMAND_RAM_Y_ADDRESS  0x4Fu
-
-/** @brief Width of the EPD. */
-#define EPD_WIDTH  200u
-/** @brief Height of the EPD. */
-#define EPD_HEIGHT  200u
-
+#ifndef EPD_PANEL
 /**
- * @brief Display Update Sequence `0xB1`.
+ * @brief Panel connected to the pins; the name of an `::epd_panel_id`.
  *
- * Represents the following sequence,
- * 1. Enable clock signal
- * 2. Load temperature value
- * 3. Load LUT with DISPLAY Mode 1
- * 4. Disable clock signal
+ * Define it to drive another panel; e.g., `-DEPD_PANEL=EPD_PANEL_2IN9_V2`.
+ * Has to be the name, not the value, because it also sizes the image
+ * buffers (`EPD_MAX_FRAME_SIZE`).
  */
-#define EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_1  0xB1u
+#define EPD_PANEL  EPD_PANEL_1IN54_V2
+#endif
 
+#ifndef EPD_MAX_FRAME_SIZE
 /**
- * @brief Display Update Sequence `0xB9`.
+ * @brief Size of the memory block of an image buffer in bytes.
  *
- * Represents the following sequence,
- * 1. Enable clock signal
- * 2. Load temperature value
- * 3. Load LUT with DISPLAY Mode 2
- * 4. Disable clock signal
+ * A frame of `EPD_PANEL` by default, so a small panel does not pay for
+ * the largest one; e.g., 5000 bytes instead of 15000 for the 1.54" panel.
+ * Define it as `EPD_PANEL_MAX_FRAME_SIZE` to switch panels at run time.
  */
-#define EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_2  0xB9u
+#define EPD_MAX_FRAME_SIZE  EPD_PANEL_FRAME_SIZE_OF(EPD_PANEL)
+#endif
 
-/**
- * @brief Display Update Sequence `0xC7`.
- *
- * Represents the following sequence,
- * 1. Enable clock signal
- * 2. Enable Analog
- * 3. Display with DISPLAY Mode 1
- * 4. Disable Analog
- * 5. Disable OSC (clock signal?)
- */
-#define EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_1  0xC7u
+// Define `EPD_USE_STRIPS` if you want to render frames in strips without
+// image buffers as large as a frame.
+// Partial refreshes are not shown then.
+// #define EPD_USE_STRIPS  1
 
 /**
- * @brief Display Update Sequence `0xCF`.
- *
- * Represents the following sequence,
- * 1. Enable clock signal
- * 2. Enable Analog
- * 3. Display with DISPLAY Mode 2
- * 4. Disable Analog
- * 5. Disable OSC (clock signal?)
+ * @brief Rank of the EPD on the SPI bus.
+ *
+ * Lower than sensors that share the bus, so that the EPD is registered
+ * after them; a frame can wait while a sensor cannot.
  */
-#define EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_2  0xCFu
-
-// Define `EPD_SPECIFY_TEMPERATURE` if you want to manually set temperature.
-// #define EPD_MANUAL_TEMPERATURE  1
-
-/** @brief Data for Driver Output Control command. */
-static const uint8_t DRIVER_OUTPUT_CONTROL_DATA[] = {
-	// b[7..0]: lower bits of the number of lines
-	0xC7u,
-	// b[7..1]: 0
-	// b[0]: high bit of the number of lines
-	0x00u, // (0xC7 + 1) = 200 lines
-	// b[2]: first output gate
-	// b[1]: 0: normal, 1: interlace (even → odd)
-	// b[0]: 0: G0 → G199, 1: G199 → G0
-	0x00u
-};
+#define EPD_BUS_RANK  0
 
-/** @brief Data for Data Entry Mode command. */
-static const uint8_t DATA_ENTRY_MODE_DATA[] = {
-	// b[2]: address counter direction. 0: x → y, 1: y → x
-	// b[1..0]:
-	// - 00(0): Y-decrement, X-decrement
-	// - 01(1): Y-decrement, X-increment
-	// - 10(2): Y-increment, X-decrement
-	// - 11(3): Y-increment, X-increment
-	0x03u
-};
+/** @brief SPI bus of the EPD. */
+static spi_bus_manager epd_spi_bus = spi_bus_manager_initializer(
+	EPD_HOST,
+	PIN_NUM_MOSI,
+	PIN_NUM_MISO,
+	PIN_NUM_CLK,
+	EPD_MAX_TRANSFER_SIZE,
+	DMA_CHAN);
 
-#ifdef  EPD_MANUAL_TEMPERATURE
 /**
- * @brief Data for Temperature Sensor Control command.
- *
- * Represents 25℃.
+ * @brief Number of image buffers in the render / transfer pipeline.
  *
- * A fixed point number 8.4.
- * Two's complement.
+ * One is rendered by the producer while the other is transferred by
+ * the EPD worker task.
  */
-static const uint8_t DATA_TEMPERATURE_SENSOR_CONTROL_25_C[] = {
-	// 25℃
-	// b[7..0]: integer part
-	25u,
-	// b[7..4]: fraction
-	0u
-};
-#endif
+#define EPD_NUM_IMAGE_BUFFERS  2
 
-/** @brief Memory block for an `::image_buffer`. */
-static uint8_t image_memory[EPD_HEIGHT * (EPD_WIDTH / 8u)];
+/** @brief Stack size of the EPD worker task. */
+#define EPD_WORKER_STACK_SIZE  4096u
 
-/**
- * @brief Resets non-SPI GPIO pins.
- */
-static void epd_configure_gpios (void) {
-	esp_err_t ret;
-	printf("epd_configure_gpios\n");
-	ret = gpio_set_direction(PIN_NUM_BUSY, GPIO_MODE_INPUT);
-	ESP_ERROR_CHECK(ret);
-	ret = gpio_set_direction(PIN_NUM_RST, GPIO_MODE_OUTPUT);
-	ESP_ERROR_CHECK(ret);
-	ret = gpio_set_direction(PIN_NUM_DC, GPIO_MODE_OUTPUT);
-	ESP_ERROR_CHECK(ret);
-}
+/** @brief Priority of the EPD worker task. */
+#define EPD_WORKER_PRIORITY  5
 
-/**
- * @brief Resets an EPD.
- */
-static void epd_reset (void) {
-	esp_err_t ret;
-	printf("epd_reset\n");
-	ret = gpio_set_level(PIN_NUM_RST, 1u);
-	ESP_ERROR_CHECK(ret);
-	vTaskDelay(200 / portTICK_PERIOD_MS);
-	ret = gpio_set_level(PIN_NUM_RST, 0u);
-	ESP_ERROR_CHECK(ret);
-	vTaskDelay(10 / portTICK_PERIOD_MS);
-	ret = gpio_set_level(PIN_NUM_RST, 1u);
-	ESP_ERROR_CHECK(ret);
-	vTaskDelay(200 / portTICK_PERIOD_MS);
-}
+/** @brief Maximum number of pending requests to the EPD worker task. */
+#define EPD_REQUEST_QUEUE_SIZE  4
 
 /**
- * @brief Waits until the BUSY pin goes LOW.
+ * @brief Display mode that refreshes only changed pixels.
+ *
+ * Given to `epd_request::display_mode` instead of `1` or `2`.
  */
-static void epd_wait_busy (void) {
-	printf("epd_wait_busy\n");
-	while (gpio_get_level(PIN_NUM_BUSY) == 1u) {
-		vTaskDelay(100 / portTICK_PERIOD_MS);
-	}
-	printf("epd_wait_busy: done\n");
-}
+#define EPD_DISPLAY_MODE_PARTIAL  3
 
+#ifndef EPD_USE_STRIPS
 /**
- * @brief Sends a command to an EPD.
+ * @brief Memory blocks for `::image_buffer`s in the pipeline.
  *
- * @param[in] spi
- *
- *   Handle to an EPD.
- *
- * @param[in] command
- *
- *   Command to be sent.
+ * Directly transferred via DMA.
  */
-static void epd_send_command (spi_device_handle_t spi, uint8_t command) {
-	esp_err_t ret;
-	spi_transaction_t trans = {
-		.length = 8u, // in bits
-		.tx_buffer = &command
-	};
-	printf("epd_send_command: 0x%02X\n", (int)command);
-	ret = gpio_set_level(PIN_NUM_DC, 0u);
-	ESP_ERROR_CHECK(ret);
-	ret = spi_device_polling_transmit(spi, &trans);
-	ESP_ERROR_CHECK(ret);
-}
+static DMA_ATTR uint8_t image_memory
+	[EPD_NUM_IMAGE_BUFFERS][EPD_MAX_FRAME_SIZE];
+
+/** @brief `::image_buffer`s in the pipeline. */
+static image_buffer image_buffers[EPD_NUM_IMAGE_BUFFERS];
 
 /**
- * @brief Sends a single-byte data to an EPD.
- *
- * @param[in] spi
+ * @brief Memory block of `epd_device::panel_image` of the EPD.
  *
- *   Handle to an EPD.
- *
- * @param[in] data
- *
- *   Data byte to be sent.
+ * Directly transferred via DMA.
  */
-static void epd_send_data_byte (spi_device_handle_t spi, uint8_t data) {
-	esp_err_t ret;
-	spi_transaction_t trans = {
-		.length = 8u, // in bits
-		.tx_buffer = &data
-	};
-	ret = gpio_set_level(PIN_NUM_DC, 1u);
-	ESP_ERROR_CHECK(ret);
-	ret = spi_device_polling_transmit(spi, &trans);
-	ESP_ERROR_CHECK(ret);
-}
+static DMA_ATTR uint8_t epd_panel_memory[EPD_MAX_FRAME_SIZE];
+#endif
+
+/** @brief Kind of a request to the EPD worker task. */
+typedef enum epd_request_type_t {
+	/**
+	 * @brief Enables a display mode and clears the EPD.
+	 *
+	 * Draws `epd_request::label` on the cleared EPD in the display modes
+	 * `1` and `2`.
+	 * Subsequent frames are refreshed with the display mode.
+	 */
+	EPD_REQUEST_ENABLE_DISPLAY_MODE,
+	/**
+	 * @brief Draws a frame.
+	 *
+	 * The image buffer is sent back to `epd_free_buffer_queue` as soon as
+	 * it is transferred; i.e., before the refresh finishes.
+	 */
+	EPD_REQUEST_DRAW_FRAME,
+	/**
+	 * @brief Draws a frame rendered in strips.
+	 *
+	 * `epd_request::notified_task` is notified as soon as the frame is
+	 * transferred; i.e., before the refresh finishes.
+	 * Not available in `EPD_DISPLAY_MODE_PARTIAL`.
+	 */
+	EPD_REQUEST_DRAW_STRIPS,
+	/**
+	 * @brief Whitens the EPD and terminates the EPD worker task.
+	 *
+	 * `epd_request::notified_task` is notified when done.
+	 */
+	EPD_REQUEST_FINISH
+} epd_request_type;
+
+/** @brief Request to the EPD worker task. */
+typedef struct epd_request_t {
+	/** @brief Kind of the request. */
+	epd_request_type type;
+	/**
+	 * @brief Display mode (`1`, `2` or `EPD_DISPLAY_MODE_PARTIAL`).
+	 *
+	 * Only for `EPD_REQUEST_ENABLE_DISPLAY_MODE`.
+	 */
+	int display_mode;
+	/**
+	 * @brief Label drawn on the top-left corner. `NULL` draws no label.
+	 *
+	 * Only for `EPD_REQUEST_ENABLE_DISPLAY_MODE`.
+	 */
+	const rle_image* label;
+	/**
+	 * @brief Image buffer to draw.
+	 *
+	 * Only for `EPD_REQUEST_DRAW_FRAME`.
+	 */
+	image_buffer* buffer;
+	/**
+	 * @brief Renders strips of a frame.
+	 *
+	 * Only for `EPD_REQUEST_DRAW_STRIPS`.
+	 */
+	epd_render_strip_fn render_strip;
+	/**
+	 * @brief Passed to `render_strip`.
+	 *
+	 * Only for `EPD_REQUEST_DRAW_STRIPS`.
+	 */
+	void* user_data;
+	/**
+	 * @brief Task to be notified.
+	 *
+	 * Only for `EPD_REQUEST_DRAW_STRIPS` and `EPD_REQUEST_FINISH`.
+	 */
+	TaskHandle_t notified_task;
+} epd_request;
+
+/** @brief Queue of `::epd_request`s to the EPD worker task. */
+static QueueHandle_t epd_request_queue;
 
 /**
- * @brief Sends data to an EPD.
- *
- * It will cause undefined behavior if `data` is `NULL` or does not point to
- * a block smaller than `size`.
- *
- * @param[in] spi
- *
- *   Handle to an EPD.
- *
- * @param[in] data
+ * @brief Queue of `::image_buffer` pointers free to render.
  *
- *   Data to be sent.
- *
- * @param[in] size_in_bytes
- *
- *   Number of bytes to be sent.
- *   Subjects to the maximum size allowed in a single SPI transaction.
+ * Filled with all of the `image_buffers` at first.
  */
-static void epd_send_data (
-	spi_device_handle_t spi,
-	const uint8_t* data,
-	size_t size_in_bytes)
-{
-	esp_err_t ret;
-	spi_transaction_t trans = {
-		.length = 8u * size_in_bytes, // in bits
-		.tx_buffer = data
-	};
-	ret = gpio_set_level(PIN_NUM_DC, 1u);
-	ESP_ERROR_CHECK(ret);
-	ret = spi_device_polling_transmit(spi, &trans);
-	ESP_ERROR_CHECK(ret);
-}
+static QueueHandle_t epd_free_buffer_queue;
+
+/** @brief Left position of a label. */
+#define LABEL_LEFT  8
+/** @brief Top position of a label. */
+#define LABEL_TOP  2
 
 /**
- * @brief Sets the x address range of an EPD.
+ * @brief Draws a label directly on an EPD.
  *
- * The current x address is reset to `start`.
+ * The label is decoded while it is transferred, so it needs no image
+ * buffer.
  *
- * **Limitation:**
- * `start` and `end` are rounded to a largest multiple of 8 not exceeding it.
+ * @param[in,out] epd
  *
- * @param[in] spi
+ *   EPD.
  *
- *   Handle to an EPD.
+ * @param[in] label
  *
- * @param[in] start
- *
- *   Start x (**inclusive**).
- *
- * @param[in] end
- *
- *   End x (**inclusive**).
+ *   Label to draw. `NULL` draws nothing.
  */
-static void epd_set_x_range (
-	spi_device_handle_t spi,
-	uint32_t start,
-	uint32_t end)
-{
-	uint8_t data[] = {
-		(uint8_t)(start / 8u),
-		(uint8_t)(end / 8u)
-	};
-	printf("epd_set_x_range: %d, %d\n", (int)start, (int)end);
-	epd_send_command(spi, EPD_COMMAND_RAM_X_START_END_ADDRESS);
-	epd_send_data(spi, data, sizeof(data));
-	epd_send_command(spi, EPD_COMMAND_RAM_X_ADDRESS);
-	epd_send_data_byte(spi, data[0]);
+static void draw_label (epd_device* epd, const rle_image* label) {
+	int ret;
+	if (label != NULL) {
+		ret = epd_draw_rle_image(epd, label, LABEL_LEFT, LABEL_TOP);
+		assert(ret == 0);
+	}
 }
 
 /**
- * @brief Sets the y address range of an EPD.
+ * @brief Task that owns an EPD and processes requests.
  *
- * The current y address is reset to `start`.
+ * Receives `::epd_request`s from `epd_request_queue`.
  *
- * @param[in] spi
+ * A frame is transferred as soon as the previous refresh finishes, and
+ * its image buffer is released before the refresh of the frame starts.
+ * Only the dirty rectangles or the rows that differ from the black and white
+ * RAM, whichever are fewer bytes, are transferred.
+ * So the producer can render the next frames while the EPD is refreshing.
+ * The image buffers are the back buffers; the red RAM of the EPD cannot be
+ * one, because the EPD ignores RAM writes while BUSY.
  *
- *   Handle to an EPD.
+ * A frame may instead be rendered in strips by the worker task with
+ * `EPD_REQUEST_DRAW_STRIPS`.
  *
- * @param[in] start
+ * The refresh sequences of the display modes 1 and 2 load only the black
+ * and white RAM. In `EPD_DISPLAY_MODE_PARTIAL`, the red RAM holds the
+ * previous frame, and every `epd_device::max_partial_refreshes + 1`th frame
+ * is fully refreshed to clear ghosting.
  *
- *   Start y (**inclusive**).
+ * @param[in] pvParameters
  *
- * @param[in] end
- *
- *   End y (**inclusive**).
+ *   (`::epd_device*`) EPD owned by the task.
  */
-static void epd_set_y_range (
-	spi_device_handle_t spi,
-	uint32_t start,
-	uint32_t end)
-{
-	uint8_t data[] = {
-		// b[7..0]: lower bits of the start y
-		(uint8_t)start,
-		// b[0]: upper bit of the start y
-		(uint8_t)((start >> 8) & 0x1u),
-		// b[7..0]: lower bits of the end y
-		(uint8_t)end,
-		// b[0]: upper bit of the end y
-		(uint8_t)((end >> 8) & 0x1u)
-	};
-	printf("epd_set_y_range: %d, %d\n", (int)start, (int)end);
-	epd_send_command(spi, EPD_COMMAND_RAM_Y_START_END_ADDRESS);
-	epd_send_data(spi, data, sizeof(data));
-	epd_send_command(spi, EPD_COMMAND_RAM_Y_ADDRESS);
-	epd_send_data(spi, data, 2u);
+static void epd_worker_task (void* pvParameters) {
+	epd_request request;
+	BaseType_t ret;
+	int display_mode = 1;
+	epd_device* epd = (epd_device*)pvParameters;
+	while (1) {
+		ret = xQueueReceive(epd_request_queue, &request, portMAX_DELAY);
+		assert(ret == pdTRUE);
+		epd_wait_busy(epd);
+		switch (request.type) {
+		case EPD_REQUEST_ENABLE_DISPLAY_MODE:
+			display_mode = request.display_mode;
+			if (display_mode == 1) {
+				epd_enable_display_mode_1(epd);
+				epd_clear_all(epd);
+				draw_label(epd, request.label);
+				epd_refresh_display_mode_1(epd);
+			} else if (display_mode == 2) {
+				epd_enable_display_mode_2(epd);
+				epd_clear_all(epd);
+				draw_label(epd, request.label);
+				epd_refresh_display_mode_2(epd);
+			} else {
+				epd_enable_partial_refresh(epd);
+			}
+			break;
+		case EPD_REQUEST_DRAW_FRAME:
+			if (display_mode == EPD_DISPLAY_MODE_PARTIAL) {
+				epd_draw_image_buffer_partial(epd, request.buffer);
+			} else {
+				epd_draw_image_buffer_changed(epd, request.buffer);
+			}
+			ret = xQueueSend(
+				epd_free_buffer_queue,
+				&request.buffer,
+				portMAX_DELAY);
+			assert(ret == pdTRUE);
+			if (display_mode == 1) {
+				epd_start_refresh_display_mode_1(epd);
+			} else if (display_mode == 2) {
+				epd_start_refresh_display_mode_2(epd);
+			} else {
+				epd_start_refresh_partial_mode(epd);
+			}
+			break;
+		case EPD_REQUEST_DRAW_STRIPS:
+			assert(display_mode != EPD_DISPLAY_MODE_PARTIAL);
+			epd_draw_strips(epd, request.render_strip, request.user_data);
+			xTaskNotifyGive(request.notified_task);
+			if (display_mode == 1) {
+				epd_start_refresh_display_mode_1(epd);
+			} else {
+				epd_start_refresh_display_mode_2(epd);
+			}
+			break;
+		case EPD_REQUEST_FINISH:
+			// uses the display mode 1
+			// because the display mode 2 is not good for ghosting prevention.
+			epd_enable_display_mode_1(epd);
+			epd_set_border(epd, 1u); // white border
+			epd_clear_all(epd);
+			epd_refresh_display_mode_1(epd);
+			xTaskNotifyGive(request.notified_task);
+			vTaskDelete(NULL);
+			break;
+		}
+	}
 }
 
 /**
- * @brief Sets the border filling of an EPD.
- *
- * Rendering is deferred until
- * `::epd_refresh_display_mode_1` or `::epd_refresh_display_mode_2` is called.
+ * @brief Sends a request to the EPD worker task.
  *
- * @param[in] spi
+ * Blocks while the request queue is full.
  *
- *   Handle to an EPD.
+ * @param[in] request
  *
- * @param[in] fill
- *
- *   Border filling.
- *   - `0`: black
- *   - non-zero: white
+ *   Request to be sent. Copied.
  */
-static void epd_set_border (spi_device_handle_t spi, uint8_t fill) {
-	uint8_t data = (fill == 0u) ? 0u : 1u;
-	printf("epd_set_border: 0x%02X\n", (int)fill);
-	epd_send_command(spi, EPD_COMMAND_BORDER_WAVEFORM_CONTROL);
-	epd_send_data_byte(spi, data);
+static void epd_send_request (const epd_request* request) {
+	BaseType_t ret;
+	ret = xQueueSend(epd_request_queue, request, portMAX_DELAY);
+	assert(ret == pdTRUE);
 }
 
+/** @brief Positions of the example image in frames. */
+static const struct {
+	int x;
+	int y;
+} IMAGE_POSITIONS[] = {
+	{ 0, 12 },
+	{ 136, 50 },
+	{ 24, 130 },
+	{ 64, 20 },
+	{ 96, 90 }
+};
+
+/** @brief Number of `IMAGE_POSITIONS`. */
+#define NUM_IMAGE_POSITIONS \
+	(int)(sizeof(IMAGE_POSITIONS) / sizeof(IMAGE_POSITIONS[0]))
+
+/** @brief Width and height of the area `IMAGE_POSITIONS` are given in. */
+#define IMAGE_POSITIONS_AREA_SIZE  200
+
 /**
- * @brief Initializes an EPD.
+ * @brief Obtains a position of the example image on a given panel.
  *
- * After calling this function, you need to enable a display mode with
- * either of the following functions,
- * - `::epd_enable_display_mode_1`
- * - `::epd_enable_display_mode_2`
+ * `IMAGE_POSITIONS` are scaled so that the example image stays inside
+ * the panel.
  *
- * @param[in] spi
+ * @param[in] panel
  *
- *   Handle to an EPD.
- */
-static void epd_initialize (spi_device_handle_t spi) {
-	printf("epd_initialize\n");
-	epd_reset();
-	// panel reset
-	epd_wait_busy();
-	epd_send_command(spi, EPD_COMMAND_SW_RESET);
-	epd_wait_busy();
-	// data output control
-	epd_send_command(spi, EPD_COMMAND_DRIVER_OUTPUT_CONTROL);
-	epd_send_data(
-		spi,
-		DRIVER_OUTPUT_CONTROL_DATA,
-		sizeof(DRIVER_OUTPUT_CONTROL_DATA));
-	// data entry mode
-	epd_send_command(spi, EPD_COMMAND_DATA_ENTRY_MODE);
-	epd_send_data(
-		spi,
-		DATA_ENTRY_MODE_DATA,
-		sizeof(DATA_ENTRY_MODE_DATA));
-	// RAM X start / end address
-	epd_set_x_range(spi, 0u, EPD_WIDTH - 1u);
-	// RAM Y start / end address
-	epd_set_y_range(spi, 0u, EPD_HEIGHT - 1u);
-	// Border Waveform Control
-	epd_set_border(spi, 0u); // black border
-	// without setting temperature, a display gets noisy
-#ifdef  EPD_MANUAL_TEMPERATURE
-	// Temperature Sensor Control
-	// supposes the temperature is 25℃
-	epd_send_command(spi, EPD_COMMAND_TEMPERATURE_SENSOR_CONTROL);
-	epd_send_data(
-		spi,
-		DATA_TEMPERATURE_SENSOR_CONTROL_25_C,
-		sizeof(DATA_TEMPERATURE_SENSOR_CONTROL_25_C));
-#else
-	// 0x18 is an unknown command
-	// so far I guess that it turns automatic temperature sensing on
-	// https://github.com/waveshare/e-Paper/blob/8973995e53cb78bac6d1f8a66c2d398c18392f71/RaspberryPi%26JetsonNano/c/lib/e-Paper/EPD_1in54_V2.c#L150-L151
-	epd_send_command(spi, 0x18u);
-	epd_send_data_byte(spi, 0x80u);
-#endif
-}
-
-/**
- * @brief Enables the display mode 1 of an EPD.
+ *   Panel to draw the example image on.
  *
- * If you want to switch to the display mode 2,
- * you have to call `::epd_enable_display_mode_2`.
+ * @param[in] i
  *
- * @param[in] spi
+ *   Index of the position in `IMAGE_POSITIONS`.
  *
- *   Handle to an EPD.
- */
-static void epd_enable_display_mode_1 (spi_device_handle_t spi) {
-	printf("epd_enable_display_mode_1\n");
-	epd_send_command(spi, EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2);
-	epd_send_data_byte(spi, EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_1);
-	epd_send_command(spi, EPD_COMMAND_MASTER_ACTIVATION);
-	epd_wait_busy();
-}
-
-/**
- * @brief Enables the display mode 2 of an EPD.
+ * @param[out] x
  *
- * If you want to switch to the display mode 1,
- * you have to call `::epd_enable_display_mode_1`.
+ *   Receives the left position.
  *
- * @param[in] spi
+ * @param[out] y
  *
- *   Handle to an EPD.
+ *   Receives the top position.
  */
-static void epd_enable_display_mode_2 (spi_device_handle_t spi) {
-	printf("epd_enable_display_mode_2\n");
-	epd_send_command(spi, EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2);
-	epd_send_data_byte(spi, EPD_DISPLAY_UPDATE_SEQUENCE_TEMP_LUT_2);
-	epd_send_command(spi, EPD_COMMAND_MASTER_ACTIVATION);
-	epd_wait_busy();
+static void get_image_position (
+		const epd_panel* panel,
+		int i,
+		int* x,
+		int* y)
+{
+	*x = (IMAGE_POSITIONS[i].x * ((int)panel->width - 64)) /
+		(IMAGE_POSITIONS_AREA_SIZE - 64);
+	*y = (IMAGE_POSITIONS[i].y * ((int)panel->height - 64)) /
+		(IMAGE_POSITIONS_AREA_SIZE - 64);
 }
 
+#ifndef EPD_USE_STRIPS
 /**
- * @brief Refreshes an EPD with the display mode 1.
+ * @brief Renders frames and requests the EPD worker task to draw them.
  *
- * Before calling this function,
- * you have to enable the display mode 1 with `::epd_enable_display_mode_1`.
+ * Each frame is rendered into an image buffer obtained from
+ * `epd_free_buffer_queue`.
+ * As image buffers alternate, an image buffer holds the frame before
+ * the previous one.
+ * So this function erases the example images of the last two frames
+ * before it draws the example image of the current frame.
  *
- * @param[in] spi
+ * @param[in] panel
  *
- *   Handle to an EPD.
- */
-static void epd_refresh_display_mode_1 (spi_device_handle_t spi) {
-	printf("epd_refresh_display_mode_1\n");
-	epd_send_command(spi, EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2);
-	epd_send_data_byte(spi, EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_1);
-	epd_send_command(spi, EPD_COMMAND_MASTER_ACTIVATION);
-	epd_wait_busy();
-}
-
-/**
- * @brief Refreshes an EPD with the display mode 2.
+ *   Panel of the EPD.
  *
- * Before calling this function,
- * you have to enable the display mode 2 with `::epd_enable_display_mode_2`.
+ * @param[in] label
  *
- * @param[in] spi
- *
- *   Handle to an EPD.
+ *   Label drawn on the top-left corner; the same as the one given to
+ *   `EPD_REQUEST_ENABLE_DISPLAY_MODE`, so its rows are not transferred
+ *   again. `NULL` draws no label.
  */
-static void epd_refresh_display_mode_2 (spi_device_handle_t spi) {
-	printf("epd_refresh_display_mode_2\n");
-	epd_send_command(spi, EPD_COMMAND_DISPLAY_UPDATE_CONTROL_2);
-	epd_send_data_byte(spi, EPD_DISPLAY_UPDATE_SEQUENCE_DISPLAY_2);
-	epd_send_command(spi, EPD_COMMAND_MASTER_ACTIVATION);
-	epd_wait_busy();
+static void produce_frames (
+		const epd_panel* panel,
+		const rle_image* label)
+{
+	image_buffer* buffer;
+	BaseType_t ret;
+	epd_request request = {
+		.type = EPD_REQUEST_DRAW_FRAME
+	};
+	int i;
+	int j;
+	int x;
+	int y;
+	for (i = 0; i < NUM_IMAGE_POSITIONS; ++i) {
+		ret = xQueueReceive(epd_free_buffer_queue, &buffer, portMAX_DELAY);
+		assert(ret == pdTRUE);
+		if (i < EPD_NUM_IMAGE_BUFFERS) {
+			// the buffer holds a frame of another sequence
+			image_buffer_clear_all(buffer);
+			if (label != NULL) {
+				rle_image_draw(buffer, label, LABEL_LEFT, LABEL_TOP);
+			}
+		} else {
+			for (j = i - EPD_NUM_IMAGE_BUFFERS; j < i; ++j) {
+				get_image_position(panel, j, &x, &y);
+				image_buffer_clear_range(buffer, x, y, 64, 64);
+			}
+		}
+		get_image_position(panel, i, &x, &y);
+		image_buffer_draw_image(buffer, EXAMPLE_IMAGE_DATA, x, y, 64, 64);
+		request.buffer = buffer;
+		epd_send_request(&request);
+	}
 }
+#else
+/** @brief Frame rendered by `::render_example_strip`. */
+typedef struct example_frame_t {
+	/** @brief Panel of the EPD. */
+	const epd_panel* panel;
+	/** @brief Label. `NULL` draws no label. */
+	const rle_image* label;
+	/** @brief Index of the position of the example image. */
+	int position;
+} example_frame;
 
 /**
- * @brief Clears a given range of an EPD.
- *
- * This function sets X and Y ranges to `[x, x + width - 1]` and
- * `[y, y + height - 1]` respectively.
- *
- * Will cause undefined behavior if `left` or `width` is not a multiple of `8`.
+ * @brief Renders a strip of an `::example_frame`.
  *
- * @param[in] spi
+ * @param[in,out] strip
  *
- *   Handle to an EPD.
- *
- * @param[in] left
- *
- *   Left position of the area to be cleared.
+ *   Strip to render.
  *
  * @param[in] top
  *
- *   Top position of the area to be cleared.
- *
- * @param[in] width
+ *   Row of the frame at the top of `strip`.
  *
- *   Width of the are to be cleared.
+ * @param[in] user_data
  *
- * @param[in] height
- *
- *   Height of the are to be cleared.
+ *   (`::example_frame*`) Frame to render.
  */
-static void epd_clear_range (
-		spi_device_handle_t spi,
-		uint32_t left,
-		uint32_t top,
-		uint32_t width,
-		uint32_t height)
-{
-	unsigned int i;
-	unsigned int data_size = (unsigned int)(height * (width / 8u));
-	assert((left % 8u) == 0u);
-	assert((width % 8u) == 0u);
-	printf(
-		"epd_clear_range: x=%d, y=%d, w=%d, h=%d\n",
-		(int)left,
-		(int)top,
-		(int)width,
-		(int)height);
-	epd_set_x_range(spi, left, left + (width - 1u));
-	epd_set_y_range(spi, top, top + (height - 1u));
-	epd_send_command(spi, EPD_COMMAND_WRITE_RAM_BW);
-	for (i = 0u; i < data_size; ++i) {
-		epd_send_data_byte(spi, 0xFFu);
+static void render_example_strip (image_buffer* strip, int top, void* user_data) {
+	const example_frame* frame = (const example_frame*)user_data;
+	int x;
+	int y;
+	if (frame->label != NULL) {
+		rle_image_draw(strip, frame->label, LABEL_LEFT, LABEL_TOP - top);
 	}
+	get_image_position(frame->panel, frame->position, &x, &y);
+	image_buffer_draw_image(strip, EXAMPLE_IMAGE_DATA, x, y - top, 64, 64);
 }
 
 /**
- * @brief Clears all of the pixels of an EPD.
+ * @brief Requests the EPD worker task to draw frames in strips.
  *
- * This function resets x and y ranges to
- * `[0, EPD_WIDTH]` and `[0, EPD_HEIGHT]`.
+ * Draws the same frames as `produce_frames` does, but every frame is
+ * rendered from scratch in strips by the EPD worker task.
+ * Waits for each frame to be transferred, because the frame is rendered
+ * from a local variable.
  *
- * @param[in] spi
+ * @param[in] panel
  *
- *   Handle to an EPD.
- */
-static void epd_clear_all (spi_device_handle_t spi) {
-	printf("epd_clear_all\n");
-	epd_clear_range(spi, 0u, 0u, EPD_WIDTH, EPD_HEIGHT);
-}
-
-/**
- * @brief Draws a given image buffer on an EPD.
+ *   Panel of the EPD.
  *
- * This function sets the X and Y ranges to `[0, buffer->width-1]` and
- * `[0, buffer->height-1]` respectively.
+ * @param[in] label
  *
- * @param[in] spi
- *
- *   Handle to an EPD.
- *
- * @param[in] buffer
- *
- *   Image buffer to draw on the EPD.
+ *   Label drawn on the top-left corner.
+ *   `NULL` draws no label.
  */
-static void epd_draw_image_buffer (
-		spi_device_handle_t spi,
-		const image_buffer* buffer)
+static void produce_strip_frames (
+		const epd_panel* panel,
+		const rle_image* label)
 {
-	const uint8_t* current;
-	const uint8_t* end;
-	printf("epd_draw_image_buffer\n");
-	epd_set_x_range(spi, 0u, buffer->width - 1u);
-	epd_set_y_range(spi, 0u, buffer->height - 1u);
-	epd_send_command(spi, EPD_COMMAND_WRITE_RAM_BW);
-	current = image_buffer_begin(buffer);
-	end = image_buffer_end(buffer);
-	while (current != end) {
-		epd_send_data_byte(spi, *current);
-		++current;
+	example_frame frame = {
+		.panel = panel,
+		.label = label,
+		.position = 0
+	};
+	epd_request request = {
+		.type = EPD_REQUEST_DRAW_STRIPS,
+		.render_strip = render_example_strip,
+		.user_data = &frame,
+		.notified_task = xTaskGetCurrentTaskHandle()
+	};
+	for (frame.position = 0; frame.position < NUM_IMAGE_POSITIONS; ++frame.position) {
+		epd_send_request(&request);
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 	}
 }
+#endif
+
+/** @brief EPD driven by this program. */
+static epd_device epd_display;
 
 void app_main (void) {
     esp_err_t ret;
-    spi_device_handle_t spi;
-    spi_bus_config_t buscfg = {
-        .miso_io_num = PIN_NUM_MISO,
-        .mosi_io_num = PIN_NUM_MOSI,
-        .sclk_io_num = PIN_NUM_CLK,
-        .quadwp_io_num = -1, // disabled
-        .quadhd_io_num = -1 // disabled
-    };
-    spi_device_interface_config_t devcfg = {
-		.clock_speed_hz = 20000000, // 20MHz. nearest clock will be chosen.
-        .mode = 0, // CPOL=0, CPHA=0
-        .spics_io_num = PIN_NUM_CS, // CS is controlled by this program
-        .queue_size = 1 // I do not know an appropriate size.
+    const epd_panel* panel = &EPD_PANELS[EPD_PANEL];
+    hal_spi_device spi;
+    const hal_spi_device_config devcfg = {
+		.cs_pin = PIN_NUM_CS, // CS is controlled by this program
+		.clock_speed_hz = panel->max_clock_hz, // nearest clock will be chosen.
+		.mode = 0, // CPOL=0, CPHA=0
+		.queue_size = EPD_TRANSACTION_QUEUE_SIZE // for bulk transfers
     };
-	image_buffer buffer = image_buffer_initializer(
-		image_memory,
-		EPD_WIDTH,
-		EPD_HEIGHT);
-	const struct {
-		int x;
-		int y;
-	} image_positions[] = {
-		{ 0, 12 },
-		{ 136, 50 },
-		{ 24, 130 },
-		{ 64, 20 },
-		{ 96, 90 }
-	};
-	const int num_image_positions =
-		sizeof(image_positions) / sizeof(image_positions[0]);
+	epd_request request;
+#ifndef EPD_USE_STRIPS
+	image_buffer* buffer;
 	int i;
-    // initializes the SPI bus
-    ret = spi_bus_initialize(EPD_HOST, &buscfg, DMA_CHAN);
-    ESP_ERROR_CHECK(ret);
-    // attaches the ADXL to the SPI bus
-    ret = spi_bus_add_device(EPD_HOST, &devcfg, &spi);
-    ESP_ERROR_CHECK(ret);
+	assert(epd_panel_frame_size(panel) <= EPD_MAX_FRAME_SIZE);
+#endif
+	// attaches the EPD to the SPI bus
+	ret = spi_bus_manager_add_device(&epd_spi_bus, &devcfg, EPD_BUS_RANK, &spi);
+	ESP_ERROR_CHECK(ret);
+	// initializes the SPI bus
+	ret = spi_bus_manager_start(&epd_spi_bus);
+	ESP_ERROR_CHECK(ret);
+	epd_device_init(
+		&epd_display,
+		panel,
+		spi,
+		PIN_NUM_DC,
+		PIN_NUM_RST,
+		PIN_NUM_BUSY,
+#ifndef EPD_USE_STRIPS
+		epd_panel_memory);
+#else
+		NULL);
+#endif
 	// configures GPIOs
-	epd_configure_gpios();
+	epd_configure_gpios(&epd_display);
 	// initializes the display
-	epd_initialize(spi);
-	// displays images with the display mode 1
-	epd_enable_display_mode_1(spi);
-	epd_clear_all(spi);
-	epd_refresh_display_mode_1(spi);
-	for (i = 0; i < num_image_positions; ++i) {
-		image_buffer_clear_all(&buffer);
-		image_buffer_draw_image(
-			&buffer,
-			DISPLAY_MODE_1_IMAGE_DATA,
-			8,
-			2,
-			104,
-			10);
-		image_buffer_draw_image(
-			&buffer,
-			EXAMPLE_IMAGE_DATA,
-			image_positions[i].x,
-			image_positions[i].y,
-			64,
-			64);
-		epd_draw_image_buffer(spi, &buffer);
-		epd_refresh_display_mode_1(spi);
+	epd_initialize(&epd_display);
+	// prepares the pipeline
+	epd_request_queue = xQueueCreate(
+		EPD_REQUEST_QUEUE_SIZE,
+		sizeof(epd_request));
+	assert(epd_request_queue != NULL);
+#ifndef EPD_USE_STRIPS
+	epd_free_buffer_queue = xQueueCreate(
+		EPD_NUM_IMAGE_BUFFERS,
+		sizeof(image_buffer*));
+	assert(epd_free_buffer_queue != NULL);
+	for (i = 0; i < EPD_NUM_IMAGE_BUFFERS; ++i) {
+		image_buffer initial = image_buffer_initializer(
+			image_memory[i],
+			panel->ram_width,
+			panel->height);
+		image_buffers[i] = initial;
+		buffer = &image_buffers[i];
+		xQueueSend(epd_free_buffer_queue, &buffer, portMAX_DELAY);
 	}
-	vTaskDelay(2000 / portTICK_PERIOD_MS);
+#endif
+	// the EPD worker task owns the EPD from now on
+	xTaskCreate(
+		epd_worker_task,
+		"epd_worker_task",
+		EPD_WORKER_STACK_SIZE,
+		&epd_display,
+		EPD_WORKER_PRIORITY,
+		NULL);
+	// displays images with the display mode 1
+	request.type = EPD_REQUEST_ENABLE_DISPLAY_MODE;
+	request.display_mode = 1;
+	request.label = &DISPLAY_MODE_1_IMAGE;
+	epd_send_request(&request);
+#ifndef EPD_USE_STRIPS
+	produce_frames(panel, &DISPLAY_MODE_1_IMAGE);
+#else
+	produce_strip_frames(panel, &DISPLAY_MODE_1_IMAGE);
+#endif
+	hal_delay_ms(2000);
 	// displays images with the display mode 2
-	epd_enable_display_mode_2(spi);
-	epd_clear_all(spi);
-	epd_refresh_display_mode_2(spi);
-	for (i = 0; i < num_image_positions; ++i) {
-		image_buffer_clear_all(&buffer);
-		image_buffer_draw_image(
-			&buffer,
-			DISPLAY_MODE_2_IMAGE_DATA,
-			8,
-			2,
-			104,
-			10);
-		image_buffer_draw_image(
-			&buffer,
-			EXAMPLE_IMAGE_DATA,
-			image_positions[i].x,
-			image_positions[i].y,
-			64,
-			64);
-		epd_draw_image_buffer(spi, &buffer);
-		epd_refresh_display_mode_2(spi);
-	}
+	request.type = EPD_REQUEST_ENABLE_DISPLAY_MODE;
+	request.display_mode = 2;
+	request.label = &DISPLAY_MODE_2_IMAGE;
+	epd_send_request(&request);
+#ifndef EPD_USE_STRIPS
+	produce_frames(panel, &DISPLAY_MODE_2_IMAGE);
+#else
+	produce_strip_frames(panel, &DISPLAY_MODE_2_IMAGE);
+#endif
+	hal_delay_ms(2000);
+#ifndef EPD_USE_STRIPS
+	// displays images with partial refreshes
+	request.type = EPD_REQUEST_ENABLE_DISPLAY_MODE;
+	request.display_mode = EPD_DISPLAY_MODE_PARTIAL;
+	request.label = NULL;
+	epd_send_request(&request);
+	produce_frames(panel, NULL);
+#endif
 	// clears the display to prevent ghosting.
-	// uses the display mode 1
-	// because the display mode 2 is not good for ghosting prevention.
-	vTaskDelay(5000 / portTICK_PERIOD_MS);
-	epd_enable_display_mode_1(spi);
-	epd_set_border(spi, 1u); // white border
-	epd_clear_all(spi);
-	epd_refresh_display_mode_1(spi);
+	hal_delay_ms(5000);
+	request.type = EPD_REQUEST_FINISH;
+	request.notified_task = xTaskGetCurrentTaskHandle();
+	epd_send_request(&request);
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 }
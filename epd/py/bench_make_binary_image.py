@@ -0,0 +1,243 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Benchmarks ``make_binary_image.py`` on generated images.
+
+Generates 200x200 and 800x600 images into a temporary directory, and
+compares,
+
+- ``legacy``: packing pixels with a Python loop per 8 pixels, like the
+  script used to, on a sample of the images; the total is extrapolated.
+- ``raw``, ``rle`` and ``rle-delta``: converting all of the images in one
+  batch with ``convert_images``.
+- ``load``: only loading the images, which every way above includes.
+
+Prints a table in Markdown.
+"""
+
+import argparse
+import logging
+import os
+import sys
+import tempfile
+import time
+from matplotlib import image as mpimg
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import make_binary_image  # noqa: E402
+
+
+LOGGER = logging.getLogger(__name__)
+
+IMAGE_SIZES = ((200, 200), (800, 600))
+"""Width and height of generated images."""
+
+FORMATS = ('raw', 'rle', 'rle-delta')
+"""Formats converted in batches."""
+
+
+def legacy_pack_pixels(pixels, threshold):
+    """Packs given pixels into a single value, a pixel at a time.
+
+    The way ``make_binary_image.py`` used to pack pixels.
+
+    :param pixels: 8 pixels to be packed.
+    :type pixels: numpy.ndarray
+
+    :param threshold: threshold to determine a pixel is black or white.
+    :type threshold: float
+
+    :return: packed pixels.
+    :rtype: int
+    """
+    packed = 0
+    for p in pixels:
+        packed <<= 1
+        packed |= (p > threshold) and 1 or 0
+    return packed
+
+
+def legacy_convert_image(image_path, threshold):
+    """Converts a given image with ``legacy_pack_pixels``.
+
+    Widths of generated images are multiples of ``8``, so rows need no
+    padding.
+
+    :param image_path: path to an image to be converted.
+    :type image_path: str
+
+    :param threshold: threshold to determine a pixel is black or white.
+    :type threshold: float
+
+    :return: list of rows of packed pixels.
+    :rtype: list
+    """
+    target = make_binary_image.load_channel(image_path)
+    return [
+        [legacy_pack_pixels(pixels, threshold)
+         for pixels in row.reshape((len(row) // 8, 8))]
+        for row in target]
+
+
+def generate_image(rng, width, height):
+    """Generates an image with a gradient, circles and noise.
+
+    Large flat areas and edges resemble icons and screens more than
+    pure noise does.
+
+    :param rng: random number generator.
+    :type rng: numpy.random.Generator
+
+    :param width: width of the image.
+    :type width: int
+
+    :param height: height of the image.
+    :type height: int
+
+    :return: 2D array of pixel values in ``[0.0, 1.0]``.
+    :rtype: numpy.ndarray
+    """
+    y, x = np.mgrid[0:height, 0:width]
+    angle = rng.uniform(0.0, 2.0 * np.pi)
+    image = 0.5 + 0.5 * np.sin(
+        (np.cos(angle) * x + np.sin(angle) * y) / rng.uniform(20.0, 80.0))
+    for _ in range(rng.integers(3, 8)):
+        cx = rng.uniform(0, width)
+        cy = rng.uniform(0, height)
+        r = rng.uniform(0.05, 0.3) * min(width, height)
+        image[(x - cx) ** 2 + (y - cy) ** 2 < r ** 2] = rng.uniform()
+    image += rng.normal(0.0, 0.05, image.shape)
+    return np.clip(image, 0.0, 1.0)
+
+
+def generate_images(directory, count, width, height, seed):
+    """Generates PNG images in a given directory.
+
+    :param directory: directory where images are to be saved.
+    :type directory: str
+
+    :param count: number of images.
+    :type count: int
+
+    :param width: width of the images.
+    :type width: int
+
+    :param height: height of the images.
+    :type height: int
+
+    :param seed: seed of the random number generator.
+    :type seed: int
+
+    :return: paths to the generated images.
+    :rtype: list
+    """
+    rng = np.random.default_rng(seed)
+    paths = []
+    for i in range(count):
+        path = os.path.join(
+            directory, 'image-%dx%d-%04d.png' % (width, height, i))
+        mpimg.imsave(path, generate_image(rng, width, height), cmap='gray')
+        paths.append(path)
+    return paths
+
+
+def time_batch(image_paths, output_format):
+    """Converts given images in one batch, and measures the time.
+
+    :param image_paths: paths to images to be converted.
+    :type image_paths: list
+
+    :param output_format: ``'raw'``, ``'rle'`` or ``'rle-delta'``.
+    :type output_format: str
+
+    :return: tuple of seconds and the size of the blob in bytes.
+    :rtype: tuple
+    """
+    start = time.perf_counter()
+    _, blob = make_binary_image.convert_images(
+        image_paths, output_format, 0, 0.5)
+    return time.perf_counter() - start, len(blob)
+
+
+def time_load(image_paths):
+    """Loads given images, and measures the time.
+
+    :param image_paths: paths to images to be loaded.
+    :type image_paths: list
+
+    :return: seconds.
+    :rtype: float
+    """
+    start = time.perf_counter()
+    for image_path in image_paths:
+        make_binary_image.load_channel(image_path)
+    return time.perf_counter() - start
+
+
+def time_legacy(image_paths):
+    """Converts given images with the legacy packer, and measures the time.
+
+    Also checks that the legacy packer and ``binarize`` agree.
+
+    :param image_paths: paths to images to be converted.
+    :type image_paths: list
+
+    :return: seconds.
+    :rtype: float
+    """
+    elapsed = 0.0
+    for image_path in image_paths:
+        start = time.perf_counter()
+        rows = legacy_convert_image(image_path, 0.5)
+        elapsed += time.perf_counter() - start
+        expected = make_binary_image.binarize(
+            make_binary_image.load_channel(image_path), 0.5)
+        if not np.array_equal(np.array(rows, dtype=np.uint8), expected):
+            raise ValueError('legacy packer disagrees: %s' % image_path)
+    return elapsed
+
+
+def main():
+    """Runs the benchmark."""
+    arg_parser = argparse.ArgumentParser(
+        description='Benchmark make_binary_image.py on generated images')
+    arg_parser.add_argument(
+        '--count', dest='count', type=int, default=300,
+        help='number of images of each size (default: 300)')
+    arg_parser.add_argument(
+        '--legacy-count', dest='legacy_count', type=int, default=10,
+        help='number of images of each size converted by the legacy packer'
+             ' (default: 10)')
+    arg_parser.add_argument(
+        '--seed', dest='seed', type=int, default=1,
+        help='seed of generated images (default: 1)')
+    args = arg_parser.parse_args()
+    # keeps the table readable
+    logging.getLogger(make_binary_image.__name__).setLevel(logging.WARNING)
+    with tempfile.TemporaryDirectory() as directory:
+        print('| images | load | legacy (extrapolated) | %s |' % (
+            ' | '.join(FORMATS)))
+        print('|--------|------|----------------------|%s' % (
+            '------|' * len(FORMATS)))
+        for width, height in IMAGE_SIZES:
+            LOGGER.info(
+                'generating %d %dx%d images', args.count, width, height)
+            image_paths = generate_images(
+                directory, args.count, width, height, args.seed)
+            num_legacy = min(args.legacy_count, len(image_paths))
+            legacy = time_legacy(image_paths[:num_legacy])
+            legacy *= float(len(image_paths)) / num_legacy
+            cells = []
+            for output_format in FORMATS:
+                elapsed, size = time_batch(image_paths, output_format)
+                cells.append('%.2f s (x%.0f), %d KB' % (
+                    elapsed, legacy / elapsed, size // 1024))
+            print('| %d x %dx%d | %.2f s | %.1f s | %s |' % (
+                len(image_paths), width, height, time_load(image_paths),
+                legacy, ' | '.join(cells)))
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO)
+    main()
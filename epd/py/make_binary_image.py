@@ -4,88 +4,349 @@
 
 import argparse
 import logging
+import os
+import re
+import struct
+import sys
 from matplotlib import image as mpimg
+import numpy as np
 
 
-LOGGER = None
+LOGGER = logging.getLogger(__name__)
 
+IMAGE_EXTENSIONS = ('.png', '.jpg', '.jpeg', '.bmp', '.gif', '.tif', '.tiff')
+"""Extensions of image files collected from a directory."""
 
-def pack_pixels(pixels, threshold):
-    """Packs given pixels into a single value.
+IMAGE_ASSET_FLAG_ROW_DELTA = 0x01
+"""Same as ``RLE_IMAGE_FLAG_ROW_DELTA`` in ``main/rle_image.h``."""
 
-    :param pixels: pixels to be packed.
-    :type pixels: numpy.ndarray
+IMAGE_ASSET_FLAG_RLE = 0x10
+"""Same as ``IMAGE_ASSET_FLAG_RLE`` in ``main/image_asset.h``."""
+
+BLOB_MAGIC = b'EPDA'
+"""Magic bytes at the beginning of a binary blob."""
+
+FORMAT_FLAGS = {
+    'raw': 0,
+    'rle': IMAGE_ASSET_FLAG_RLE,
+    'rle-delta': IMAGE_ASSET_FLAG_RLE | IMAGE_ASSET_FLAG_ROW_DELTA,
+}
+"""Flags of an image asset associated with each output format."""
+
+BAYER_MATRIX = np.array([
+    [0, 32, 8, 40, 2, 34, 10, 42],
+    [48, 16, 56, 24, 50, 18, 58, 26],
+    [12, 44, 4, 36, 14, 46, 6, 38],
+    [60, 28, 52, 20, 62, 30, 54, 22],
+    [3, 35, 11, 43, 1, 33, 9, 41],
+    [51, 19, 59, 27, 49, 17, 57, 25],
+    [15, 47, 7, 39, 13, 45, 5, 37],
+    [63, 31, 55, 23, 61, 29, 53, 21],
+])
+"""8x8 Bayer matrix for ordered dithering."""
+
+ORDERED_THRESHOLDS = 4 * BAYER_MATRIX + 1
+"""Same as ``DITHER_ORDERED_THRESHOLDS`` in ``main/dither.c``."""
+
+DITHER_METHODS = ('none', 'ordered', 'floyd-steinberg')
+"""Dithering methods."""
+
+
+def load_channel(image_path, channel=0):
+    """Loads a given channel of an image.
+
+    The image is loaded by ``matplotlib.image.imread``.
+    Pixel values are normalized into ``[0.0, 1.0]``.
+    A grayscale image has only one channel and ``channel`` is ignored.
+
+    :param image_path: path to an image to be loaded.
+    :type image_path: str
+
+    :param channel: channel to be loaded, defaults to ``0``.
+    :type channel: int, optional
+
+    :return: 2D array of pixel values.
+    :rtype: numpy.ndarray
+    """
+    image = mpimg.imread(image_path)
+    if image.ndim == 3:
+        image = image[:, :, channel]
+    if np.issubdtype(image.dtype, np.integer):
+        image = image / float(np.iinfo(image.dtype).max)
+    return image
+
+
+def binarize(target, threshold):
+    """Converts given pixel values into packed rows.
+
+    Each row is padded with zeros to a byte boundary.
+
+    :param target: 2D array of pixel values.
+    :type target: numpy.ndarray
 
     :param threshold: threshold to determine a pixel is black or white.
     :type threshold: float
 
-    :return: packed pixels.
-    :rtype: int
+    :return: 2D array of packed rows.
+    :rtype: numpy.ndarray
     """
-    packed = 0
-    for p in pixels:
-        packed <<= 1
-        packed |= (p > threshold) and 1 or 0
-    return packed
+    return np.packbits(target > threshold, axis=1)
+
+
+def to_gray(target):
+    """Converts given pixel values into 8-bit grayscale.
+
+    :param target: 2D array of pixel values in ``[0.0, 1.0]``.
+    :type target: numpy.ndarray
+
+    :return: 2D array of 8-bit grayscale pixels.
+    :rtype: numpy.ndarray
+    """
+    return np.rint(np.clip(target, 0.0, 1.0) * 255).astype(np.uint8)
+
+
+def ordered_dither(gray):
+    """Dithers given grayscale pixels with the 8x8 Bayer matrix.
 
+    Gives the same result as ``DITHER_ORDERED`` in ``main/dither.h``.
 
-def convert_row(row, threshold):
-    """Converts a given row into a list of packed bits.
+    :param gray: 2D array of 8-bit grayscale pixels.
+    :type gray: numpy.ndarray
 
-    Each 8 pixels are packed into a single byte; i.e., 8 bit value.
+    :return: 2D array of packed rows.
+    :rtype: numpy.ndarray
+    """
+    height, width = gray.shape
+    thresholds = np.tile(
+        ORDERED_THRESHOLDS, ((height + 7) // 8, (width + 7) // 8))
+    return np.packbits(gray > thresholds[:height, :width], axis=1)
+
+
+def floyd_steinberg_dither(gray):
+    """Dithers given grayscale pixels with Floyd-Steinberg error diffusion.
+
+    Gives the same result as ``DITHER_FLOYD_STEINBERG`` in
+    ``main/dither.h``; i.e., errors are divided with truncation toward zero
+    and the remainder goes to the lower right.
 
-    If the size of ``row`` is not a multiple of ``8``,
-    zeros are appended so that the size becomes a multiple of ``8``.
+    :param gray: 2D array of 8-bit grayscale pixels.
+    :type gray: numpy.ndarray
+
+    :return: 2D array of packed rows.
+    :rtype: numpy.ndarray
+    """
+    def trunc16(value):
+        return value // 16 if value >= 0 else -(-value // 16)
+    height, width = gray.shape
+    bits = np.zeros((height, width), dtype=bool)
+    # errors[x + 1] is diffused to the pixel x
+    errors = [0] * (width + 1)
+    for y in range(height):
+        row = gray[y].tolist()
+        out = [False] * width
+        right = 0
+        lower_right = 0
+        errors[0] = 0
+        for x in range(width):
+            value = row[x] + right + errors[x + 1]
+            if value > 127:
+                out[x] = True
+                error = value - 255
+            else:
+                error = value
+            e7 = trunc16(error * 7)
+            e3 = trunc16(error * 3)
+            e5 = trunc16(error * 5)
+            errors[x] += e3
+            errors[x + 1] = e5 + lower_right
+            lower_right = error - e7 - e3 - e5
+            right = e7
+        bits[y] = out
+    return np.packbits(bits, axis=1)
+
+
+def dither(target, method):
+    """Dithers given pixel values into packed rows.
+
+    :param target: 2D array of pixel values in ``[0.0, 1.0]``.
+    :type target: numpy.ndarray
+
+    :param method: ``'ordered'`` or ``'floyd-steinberg'``.
+    :type method: str
+
+    :return: 2D array of packed rows.
+    :rtype: numpy.ndarray
+    """
+    gray = to_gray(target)
+    if method == 'ordered':
+        return ordered_dither(gray)
+    elif method == 'floyd-steinberg':
+        return floyd_steinberg_dither(gray)
+    raise ValueError('unknown dithering method: %s' % method)
 
-    :param row: row to be converted.
-    :type row: numpy.ndarray
+
+def to_binary(target, threshold, dither_method='none'):
+    """Converts given pixel values into packed rows.
+
+    :param target: 2D array of pixel values in ``[0.0, 1.0]``.
+    :type target: numpy.ndarray
 
     :param threshold: threshold to determine a pixel is black or white.
+                      Ignored unless ``dither_method`` is ``'none'``.
     :type threshold: float
 
-    :return: list of packed pixels.
-    :rtype: list
+    :param dither_method: one of ``DITHER_METHODS``, defaults to ``'none'``.
+    :type dither_method: str, optional
+
+    :return: 2D array of packed rows.
+    :rtype: numpy.ndarray
     """
-    if (len(row) % 8) == 0:
-        pixels_by_8 = row.reshape((int(len(row) / 8), 8))
-    else:
-        pixels_by_8 = row.resize((int(len(row) / 8), 8))
-    return [pack_pixels(pixels, threshold) for pixels in pixels_by_8]
+    if dither_method == 'none':
+        return binarize(target, threshold)
+    return dither(target, dither_method)
 
 
-def convert_image(image_path, channel=0, threshold=0.5):
-    """Converts a given image into a black-and-white binary image.
+def packbits(data):
+    """Compresses given bytes with PackBits.
 
-    The image is loaded by ``matplotlib.image.imread`` in an RGB format.
+    A header byte ``n`` is followed by,
+    - ``0`` to ``127``: ``n + 1`` literal bytes.
+    - ``-127`` to ``-1`` (``129`` to ``255``): a byte repeated ``1 - n`` times.
 
-    ``channel``
-    - ``0``: red
-    - ``1``: green
-    - ``2``: blue
+    Repeats of three or more bytes are encoded as repeat runs.
 
-    If a pixel value is greater than ``threshold``, the pixel is mapped to
-    a white bit (``=1``).
-    Otherwise it is mapped to a black bit (``=0``).
+    :param data: bytes to be compressed.
+    :type data: bytes or numpy.ndarray
 
-    :param image_path: path to an image to be converted into a binary image.
-    :type image_path: str
+    :return: compressed bytes.
+    :rtype: bytearray
+    """
+    data = np.frombuffer(bytes(data), dtype=np.uint8)
+    packed = bytearray()
+    if len(data) == 0:
+        return packed
+    # finds every run of identical bytes at once
+    starts = np.flatnonzero(np.concatenate(([True], data[1:] != data[:-1])))
+    lengths = np.diff(np.append(starts, len(data)))
+    literal_start = None
+
+    def flush_literal(end):
+        for i in range(literal_start, end, 128):
+            chunk = data[i:min(i + 128, end)]
+            packed.append(len(chunk) - 1)
+            packed.extend(chunk.tobytes())
+
+    for start, length in zip(starts.tolist(), lengths.tolist()):
+        if length < 3:
+            if literal_start is None:
+                literal_start = start
+            continue
+        if literal_start is not None:
+            flush_literal(start)
+            literal_start = None
+        while length >= 3:
+            count = min(length, 128)
+            packed.append(257 - count)
+            packed.append(int(data[start]))
+            start += count
+            length -= count
+        if length > 0:
+            literal_start = start
+    if literal_start is not None:
+        flush_literal(len(data))
+    return packed
+
+
+def delta_rows(rows):
+    """XORs each of given rows with the previous row.
+
+    The first row is XORed with zeros; i.e., kept as it is.
+
+    :param rows: rows forming a binary image.
+    :type rows: numpy.ndarray
+
+    :return: XORed rows.
+    :rtype: numpy.ndarray
+    """
+    rows = np.asarray(rows, dtype=np.uint8)
+    deltas = rows.copy()
+    deltas[1:] ^= rows[:-1]
+    return deltas
+
+
+def compress_rows(rows, delta=False):
+    """Compresses given rows in the format of ``main/rle_image.h``.
+
+    :param rows: rows forming a binary image.
+    :type rows: numpy.ndarray
 
-    :param channel: channel to be converted into a binary image,
-                    defaults to ``0``.
-    :type dimension: int, optional
+    :param delta: whether each row is XORed with the previous row before
+                  compression, defaults to ``False``.
+    :type delta: bool, optional
+
+    :return: compressed bytes.
+    :rtype: bytearray
+    """
+    rows = np.asarray(rows, dtype=np.uint8)
+    if delta:
+        rows = delta_rows(rows)
+    return packbits(rows.tobytes())
 
-    :param threshold: threshold to determine a pixel is black or white,
-                      defaults to ``0.5``.
-    :type threshold: float, optional
 
-    :return: list of rows composing the binary image.
+def encode_rows(rows, output_format):
+    """Encodes given rows in a given output format.
+
+    :param rows: rows forming a binary image.
+    :type rows: numpy.ndarray
+
+    :param output_format: ``'raw'``, ``'rle'`` or ``'rle-delta'``.
+    :type output_format: str
+
+    :return: encoded bytes.
+    :rtype: bytes
+    """
+    if output_format == 'raw':
+        return np.asarray(rows, dtype=np.uint8).tobytes()
+    return bytes(compress_rows(rows, output_format == 'rle-delta'))
+
+
+def collect_image_paths(paths):
+    """Collects image files from given paths.
+
+    A directory is expanded into image files directly in it,
+    sorted by name.
+
+    :param paths: paths to image files or directories.
+    :type paths: list
+
+    :return: paths to image files.
     :rtype: list
     """
-    LOGGER.info('loading image: ')
-    image = mpimg.imread(image_path)
-    LOGGER.info('converting')
-    target = image[:, :, channel]
-    return [convert_row(row, threshold) for row in target]
+    image_paths = []
+    for path in paths:
+        if os.path.isdir(path):
+            image_paths.extend(sorted(
+                os.path.join(path, name) for name in os.listdir(path)
+                if name.lower().endswith(IMAGE_EXTENSIONS)))
+        else:
+            image_paths.append(path)
+    return image_paths
+
+
+def make_symbol(image_path):
+    """Makes a C symbol suffix from a given image path.
+
+    :param image_path: path to an image.
+    :type image_path: str
+
+    :return: upper case symbol made of the base name of ``image_path``.
+    :rtype: str
+    """
+    name = os.path.splitext(os.path.basename(image_path))[0]
+    symbol = re.sub(r'[^0-9A-Za-z]', '_', name).upper()
+    if symbol[:1].isdigit():
+        symbol = '_' + symbol
+    return symbol
 
 
 def print_row(row):
@@ -109,16 +370,206 @@ def print_rows(rows):
     print('};')
 
 
+def print_rle_image(compressed, width, height, delta):
+    """Prints a given compressed image.
+
+    :param compressed: compressed bytes.
+    :type compressed: bytearray
+
+    :param width: width of the image.
+    :type width: int
+
+    :param height: height of the image.
+    :type height: int
+
+    :param delta: whether rows are XORed with the previous rows.
+    :type delta: bool
+    """
+    print('static const uint8_t IMAGE_DATA_RLE[] = {')
+    for i in range(0, len(compressed), 16):
+        print_row(compressed[i:i + 16])
+    print('};')
+    print('static const rle_image IMAGE = rle_image_initializer(')
+    print('\tIMAGE_DATA_RLE,')
+    print('\tsizeof(IMAGE_DATA_RLE),')
+    print('\t%du,' % width)
+    print('\t%du,' % height)
+    print('\t%s);' % (delta and 'RLE_IMAGE_FLAG_ROW_DELTA' or '0u'))
+
+
+def write_header(out, assets, blob):
+    """Writes a combined C header of given assets.
+
+    The header defines,
+    - ``IMAGE_BLOB``: encoded images concatenated.
+    - ``IMAGE_INDEX``: ``image_asset`` table locating each image in
+      ``IMAGE_BLOB``.
+    - ``IMAGE_INDEX_<NAME>``: index of each image in ``IMAGE_INDEX``.
+    - ``NUM_IMAGES``: number of images.
+
+    :param out: stream where the header is to be written.
+    :type out: io.TextIOBase
+
+    :param assets: list of ``(symbol, offset, size, width, height, flags)``.
+    :type assets: list
+
+    :param blob: encoded images concatenated.
+    :type blob: bytes
+    """
+    out.write('/**\n * @file\n *\n * Image assets.\n *\n')
+    out.write(' * Generated by make_binary_image.py.\n */\n\n')
+    out.write('#include "image_asset.h"\n\n')
+    out.write('/** @brief Encoded images. */\n')
+    out.write('static const uint8_t IMAGE_BLOB[] = {\n')
+    for i in range(0, len(blob), 16):
+        out.write('\t%s,\n' % ', '.join(
+            '0x%02Xu' % b for b in blob[i:i + 16]))
+    out.write('};\n\n')
+    out.write('/** @brief Index of `IMAGE_BLOB`. */\n')
+    out.write('static const image_asset IMAGE_INDEX[] = {\n')
+    for symbol, offset, size, width, height, flags in assets:
+        out.write(
+            '\timage_asset_initializer(%du, %du, %du, %du, 0x%02Xu), // %s\n'
+            % (offset, size, width, height, flags, symbol))
+    out.write('};\n\n')
+    for i, asset in enumerate(assets):
+        out.write('#define IMAGE_INDEX_%s  %d\n' % (asset[0], i))
+    out.write('\n/** @brief Number of images in `IMAGE_INDEX`. */\n')
+    out.write('#define NUM_IMAGES  %d\n' % len(assets))
+
+
+def write_blob(out, assets, blob):
+    """Writes a binary blob of given assets.
+
+    The blob starts with an index table,
+    - magic ``b'EPDA'``
+    - number of images (``uint32_t``)
+    - for each image: offset and size in bytes (``uint32_t``),
+      width and height (``uint16_t``), flags (``uint8_t``) and three padding
+      bytes; i.e., the layout of ``image_asset``.
+
+    Encoded images follow the index table and offsets are relative to the
+    end of the index table. All integers are little endian.
+
+    :param out: stream where the blob is to be written.
+    :type out: io.RawIOBase
+
+    :param assets: list of ``(symbol, offset, size, width, height, flags)``.
+    :type assets: list
+
+    :param blob: encoded images concatenated.
+    :type blob: bytes
+    """
+    out.write(BLOB_MAGIC)
+    out.write(struct.pack('<I', len(assets)))
+    for _, offset, size, width, height, flags in assets:
+        out.write(struct.pack(
+            '<IIHHB3x', offset, size, width, height, flags))
+    out.write(blob)
+
+
+def convert_images(
+        image_paths, output_format, channel, threshold, dither_method='none'):
+    """Converts and encodes given images into a single blob.
+
+    :param image_paths: paths to images to be converted.
+    :type image_paths: list
+
+    :param output_format: ``'raw'``, ``'rle'`` or ``'rle-delta'``.
+    :type output_format: str
+
+    :param channel: channel to be converted.
+    :type channel: int
+
+    :param threshold: threshold to determine a pixel is black or white.
+    :type threshold: float
+
+    :param dither_method: one of ``DITHER_METHODS``, defaults to ``'none'``.
+    :type dither_method: str, optional
+
+    :return: tuple of a list of
+             ``(symbol, offset, size, width, height, flags)`` and the blob.
+    :rtype: tuple
+    """
+    assets = []
+    chunks = []
+    offset = 0
+    raw_size = 0
+    for image_path in image_paths:
+        target = load_channel(image_path, channel)
+        rows = to_binary(target, threshold, dither_method)
+        encoded = encode_rows(rows, output_format)
+        assets.append((
+            make_symbol(image_path), offset, len(encoded),
+            target.shape[1], target.shape[0], FORMAT_FLAGS[output_format]))
+        chunks.append(encoded)
+        offset += len(encoded)
+        raw_size += rows.size
+    LOGGER.info(
+        'converted %d image(s): %d -> %d bytes (%.1f%%)',
+        len(image_paths), raw_size, offset,
+        100.0 * offset / max(raw_size, 1))
+    return assets, b''.join(chunks)
+
+
 if __name__ == '__main__':
-    logging.basicConfig(level=logging.DEBUG)
-    LOGGER = logging.getLogger(__name__)
+    logging.basicConfig(level=logging.INFO)
     arg_parser = argparse.ArgumentParser(
         description='Convert image into a black and white binary image')
     arg_parser.add_argument(
-        'image_path', metavar='IMAGE', type=str,
-        help='path to an image to be converted')
+        'image_paths', metavar='IMAGE', type=str, nargs='+',
+        help='path to an image to be converted, or a directory of images')
+    arg_parser.add_argument(
+        '--format', dest='format', choices=['raw', 'rle', 'rle-delta'],
+        default='raw',
+        help='output format (default: raw).'
+             ' rle: PackBits compressed.'
+             ' rle-delta: PackBits compressed after XORing each row with'
+             ' the previous row.')
+    arg_parser.add_argument(
+        '--channel', dest='channel', type=int, choices=[0, 1, 2], default=0,
+        help='channel to be converted; 0: red, 1: green, 2: blue'
+             ' (default: 0)')
+    arg_parser.add_argument(
+        '--threshold', dest='threshold', type=float, default=0.5,
+        help='pixels brighter than this are white (default: 0.5)')
+    arg_parser.add_argument(
+        '--dither', dest='dither', choices=DITHER_METHODS, default='none',
+        help='dithering method (default: none). ordered: 8x8 Bayer matrix.'
+             ' floyd-steinberg: error diffusion.'
+             ' --threshold is ignored if dithered.')
+    arg_parser.add_argument(
+        '-o', '--output', dest='output', type=str, default=None,
+        help='combines all of the images into a single C header,'
+             ' or a binary blob if the path ends with .bin')
     args = arg_parser.parse_args()
-    LOGGER.info('IMAGE: %s', args.image_path)
-    rows = convert_image(args.image_path)
-    LOGGER.info('exporting')
-    print_rows(rows)
+    image_paths = collect_image_paths(args.image_paths)
+    if (len(image_paths) == 1) and (args.output is None):
+        LOGGER.info('IMAGE: %s', image_paths[0])
+        target = load_channel(image_paths[0], args.channel)
+        rows = to_binary(target, args.threshold, args.dither)
+        LOGGER.info('exporting')
+        if args.format == 'raw':
+            print_rows(rows)
+        else:
+            delta = args.format == 'rle-delta'
+            compressed = compress_rows(rows, delta)
+            LOGGER.info(
+                'compressed: %d -> %d bytes (%.1f%%)',
+                rows.size, len(compressed),
+                100.0 * len(compressed) / rows.size)
+            print_rle_image(
+                compressed, target.shape[1], target.shape[0], delta)
+    else:
+        assets, blob = convert_images(
+            image_paths, args.format, args.channel, args.threshold,
+            args.dither)
+        LOGGER.info('exporting')
+        if (args.output is not None) and args.output.endswith('.bin'):
+            with open(args.output, 'wb') as out:
+                write_blob(out, assets, blob)
+        elif args.output is not None:
+            with open(args.output, 'w') as out:
+                write_header(out, assets, blob)
+        else:
+            write_header(sys.stdout, assets, blob)
@@ -0,0 +1,165 @@
+/**
+ * @file bench_adxl345_bus.c
+ *
+ * Streams a simulated ADXL345 for a second at each output data rate, as
+ * the tasks of `spi_adxl345_main.c` do, and compares the bits on the bus
+ * with `adxl345_bus_bits_per_second`.
+ *
+ * Runs on the simulated clock of the Linux HAL at the SPI clock chosen by
+ * `adxl345_spi_clock_hz`. Besides the wire time, the bus is busy for the
+ * overhead of every transaction; see `hal_linux.h`.
+ */
+
+#include <stdio.h>
+
+#include "adxl345.h"
+#include "hal_linux.h"
+
+#include "adxl345_sim.h"
+
+/** @brief GPIO# for INT1. */
+#define BENCH_PIN_INT1  33
+
+/** @brief Watermark of the FIFO. Same as `spi_adxl345_main.c`. */
+#define BENCH_WATERMARK  16u
+
+/** @brief Time to wait for the watermark interrupt (ms). */
+#define BENCH_FIFO_TIMEOUT_MS  100u
+
+/** @brief Period of polling (ms). Same as `spi_adxl345_main.c`. */
+#define BENCH_POLLING_PERIOD_MS  10u
+
+/** @brief Time to stream (ms). */
+#define BENCH_DURATION_MS  1000u
+
+/** @brief Time of the last rising edge of INT1 in microseconds. */
+static int64_t bench_int1_timestamp = 0;
+
+/**
+ * @brief Handles a rising edge of INT1.
+ *
+ * @param[in] arg
+ *
+ *   (`hal_task`) Task to notify.
+ */
+static void bench_int1_isr (void* arg) {
+	bench_int1_timestamp = hal_get_time_us();
+	hal_task_notify_from_isr((hal_task)arg);
+}
+
+/**
+ * @brief Time of the last rising edge of INT1.
+ *
+ * @return
+ *
+ *   Time in microseconds.
+ */
+static int64_t bench_get_int1_timestamp (void) {
+	return bench_int1_timestamp;
+}
+
+/**
+ * @brief Streams samples, and prints a row of the table.
+ *
+ * @param[in] rate
+ *
+ *   Output data rate.
+ *
+ * @param[in] watermark
+ *
+ *   Watermark of the FIFO. `0` polls every `BENCH_POLLING_PERIOD_MS`
+ *   instead, and the rate has to be 100Hz.
+ */
+static void bench_stream (adxl345_rate rate, uint32_t watermark) {
+	const adxl345_config config =
+		adxl345_config_initializer(rate, ADXL345_RANGE_16G, 1, 0);
+	const int clock_hz = adxl345_spi_clock_hz(&config, watermark);
+	const hal_linux_spi_timing timing =
+		hal_linux_spi_timing_initializer(clock_hz, 8, 0u);
+	const uint32_t expected_bits = adxl345_bus_bits_per_second(&config, watermark);
+	adxl345_fifo_clock clock = {
+		.odr_millihz = adxl345_odr_millihz(&config),
+		.next_index = 0u,
+		.anchor_index = 0u,
+		.anchor_timestamp = 0,
+		.drain_end_timestamp = 0
+	};
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	adxl345_sim sim;
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	hal_spi_device spi;
+	int64_t end_ns;
+	double seconds;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	adxl345_sim_init(&sim, BENCH_PIN_INT1);
+	adxl345_sim_attach(&sim, spi);
+	hal_gpio_set_isr(
+		BENCH_PIN_INT1,
+		HAL_GPIO_RISING_EDGE,
+		bench_int1_isr,
+		hal_task_current());
+	adxl345_configure(spi, &config);
+	if (watermark > 0u) {
+		adxl345_configure_fifo(spi, watermark);
+	}
+	adxl345_start(spi);
+	if (watermark > 0u) {
+		adxl345_discard_fifo(spi, &clock, adxl345_odr_millihz(&config));
+	}
+	hal_linux_get_stats(&start);
+	end_ns = hal_linux_get_time_ns() + (int64_t)BENCH_DURATION_MS * 1000000;
+	if (watermark > 0u) {
+		uint8_t int_source;
+		size_t num_samples;
+		while (hal_linux_get_time_ns() < end_ns) {
+			do {
+				num_samples = adxl345_drain_fifo(
+					spi,
+					&clock,
+					watermark,
+					bench_get_int1_timestamp,
+					samples,
+					&int_source);
+			} while (num_samples >= watermark);
+			hal_task_wait_notification(BENCH_FIFO_TIMEOUT_MS);
+		}
+	} else {
+		int64_t wake_time = hal_get_time_us();
+		while (hal_linux_get_time_ns() < end_ns) {
+			adxl345_read_acceleration(spi, samples[0].accs);
+			hal_delay_until(&wake_time, BENCH_POLLING_PERIOD_MS);
+		}
+	}
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	seconds = stats.elapsed_ns * 1e-9;
+	printf(
+		"%4uHz %-7s | %4.1fMHz | %10u | %10.0f | %7.0f | %5.1f%% | %5.1f%%\n",
+		(unsigned)(adxl345_odr_millihz(&config) / 1000u),
+		(watermark > 0u) ? "FIFO" : "polling",
+		clock_hz * 1e-6,
+		(unsigned)expected_bits,
+		stats.num_bits / seconds,
+		stats.num_transactions / seconds,
+		stats.wire_ns * 100.0 / stats.elapsed_ns,
+		(stats.wire_ns + stats.overhead_ns) * 100.0 / stats.elapsed_ns);
+}
+
+int main (void) {
+	static const adxl345_rate FIFO_RATES[] = {
+		ADXL345_RATE_400HZ,
+		ADXL345_RATE_800HZ,
+		ADXL345_RATE_1600HZ,
+		ADXL345_RATE_3200HZ
+	};
+	size_t i;
+	printf("ODR            | SPI     | bits/s     | simulated  | trans/s | wire   | busy\n");
+	printf("---------------|---------|------------|------------|---------|--------|-------\n");
+	bench_stream(ADXL345_RATE_100HZ, 0u);
+	for (i = 0; i < sizeof(FIFO_RATES) / sizeof(FIFO_RATES[0]); ++i) {
+		bench_stream(FIFO_RATES[i], BENCH_WATERMARK);
+	}
+	return 0;
+}
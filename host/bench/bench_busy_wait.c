@@ -0,0 +1,159 @@
+/**
+ * @file bench_busy_wait.c
+ *
+ * Compares the latency of waiting for BUSY to go LOW.
+ *
+ * - interrupt: `epd_wait_busy_timeout` blocks in `hal_task_wait_notification`
+ *   and the ISR of the falling edge notifies it
+ * - polling: a loop reads BUSY every 100 ms, like the driver used to
+ *
+ * The falling edge is scheduled at several phases of the polling period.
+ * Latency is the time from the edge, when the ISR calls
+ * `hal_task_notify_from_isr`, to the return of the wait, on the simulated
+ * clock of the Linux HAL. A notified task runs again after
+ * `BENCH_TASK_WAKEUP_NS`, the exit of the ISR and a context switch.
+ */
+
+#include <stdio.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+
+/** @brief GPIO# for DC. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_DC  27
+/** @brief GPIO# for RST. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_RST  25
+/** @brief GPIO# for BUSY. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_BUSY  26
+
+/** @brief Time for a notified task to run again (ns); a context switch. */
+#define BENCH_TASK_WAKEUP_NS  20000
+
+/** @brief Period of polling BUSY (ms). Same as the driver used to. */
+#define BENCH_POLLING_PERIOD_MS  100u
+
+/** @brief Timeout of a wait (ms). */
+#define BENCH_TIMEOUT_MS  5000u
+
+/** @brief Times from the start of a wait to the edge (ms). */
+static const int BENCH_EDGE_MS[] = { 1, 25, 50, 99, 101, 250, 1450 };
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t bench_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Time when BUSY went LOW (ns). */
+static int64_t bench_busy_fell_ns;
+
+/**
+ * @brief Drives BUSY LOW, which notifies the waiting task from the ISR.
+ *
+ * @param[in] arg
+ *
+ *   Unused.
+ */
+static void bench_busy_falls (void* arg) {
+	(void)arg;
+	bench_busy_fell_ns = hal_linux_get_time_ns();
+	hal_linux_set_input_level(BENCH_PIN_BUSY, 0);
+}
+
+/**
+ * @brief Waits for BUSY like the driver did before the interrupt.
+ *
+ * @param[in] busy_pin
+ *
+ *   GPIO# for BUSY.
+ */
+static void bench_wait_busy_polling (int busy_pin) {
+	while (hal_gpio_get_level(busy_pin) == 1u) {
+		hal_delay_ms(BENCH_POLLING_PERIOD_MS);
+	}
+}
+
+/**
+ * @brief Sets up an EPD device on a simulated controller.
+ *
+ * @param[out] epd
+ *
+ *   EPD device to initialize.
+ *
+ * @param[out] sim
+ *
+ *   Simulated controller to initialize.
+ */
+static void bench_setup (epd_device* epd, epd_sim* sim) {
+	const epd_panel* panel = &EPD_PANELS[EPD_PANEL_1IN54_V2];
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	hal_spi_device spi;
+	hal_linux_reset();
+	hal_linux_set_task_wakeup_ns(BENCH_TASK_WAKEUP_NS);
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(sim, BENCH_PIN_DC, BENCH_PIN_BUSY, NULL);
+	epd_sim_attach(sim, spi);
+	epd_device_init(
+		epd,
+		panel,
+		spi,
+		BENCH_PIN_DC,
+		BENCH_PIN_RST,
+		BENCH_PIN_BUSY,
+		bench_panel_memory);
+	epd_configure_gpios(epd);
+}
+
+/**
+ * @brief Measures the latency of a wait for an edge at a given time.
+ *
+ * @param[in] epd
+ *
+ *   EPD device.
+ *
+ * @param[in] edge_ms
+ *
+ *   Time from the start of the wait to the edge (ms).
+ *
+ * @param[in] polling
+ *
+ *   Whether the wait polls BUSY instead of waiting for the interrupt.
+ *
+ * @return
+ *
+ *   Latency in nanoseconds.
+ */
+static int64_t bench_wait (epd_device* epd, int edge_ms, int polling) {
+	hal_linux_set_input_level(BENCH_PIN_BUSY, 1);
+	hal_linux_schedule(
+		hal_linux_get_time_ns() + (int64_t)edge_ms * 1000000,
+		bench_busy_falls,
+		NULL);
+	if (polling) {
+		bench_wait_busy_polling(BENCH_PIN_BUSY);
+	} else {
+		epd_wait_busy_timeout(epd, BENCH_TIMEOUT_MS);
+	}
+	return hal_linux_get_time_ns() - bench_busy_fell_ns;
+}
+
+int main (void) {
+	epd_device epd;
+	epd_sim sim;
+	size_t i;
+	bench_setup(&epd, &sim);
+	printf("%8s %14s %14s\n", "edge ms", "interrupt ms", "polling ms");
+	for (i = 0; i < sizeof(BENCH_EDGE_MS) / sizeof(BENCH_EDGE_MS[0]); ++i) {
+		const int64_t interrupt_ns = bench_wait(&epd, BENCH_EDGE_MS[i], 0);
+		const int64_t polling_ns = bench_wait(&epd, BENCH_EDGE_MS[i], 1);
+		printf(
+			"%8d %14.3f %14.3f\n",
+			BENCH_EDGE_MS[i],
+			interrupt_ns / 1e6,
+			polling_ns / 1e6);
+	}
+	return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file bench_dither.c
+ *
+ * Measures how many rows per second `dither.h` converts with every method.
+ *
+ * Rows are converted into packed bytes with `::dither_convert_row`, and
+ * drawn at an unaligned position of an `image_buffer` with
+ * `::dither_draw_row`, as a producer of frames does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dither.h"
+#include "image_buffer.h"
+
+#include "bench_util.h"
+
+/** @brief Number of rows converted per measured call. */
+#define BENCH_NUM_ROWS  64
+
+/** @brief Widths of the rows. */
+static const uint16_t BENCH_WIDTHS[] = { 200u, 400u, 800u };
+
+/** @brief Number of `BENCH_WIDTHS`. */
+#define BENCH_NUM_WIDTHS \
+	(int)(sizeof(BENCH_WIDTHS) / sizeof(BENCH_WIDTHS[0]))
+
+/** @brief Methods to measure. */
+static const dither_method BENCH_METHODS[] = {
+	DITHER_THRESHOLD,
+	DITHER_ORDERED,
+	DITHER_FLOYD_STEINBERG
+};
+
+/** @brief Names of `BENCH_METHODS`. */
+static const char* const BENCH_METHOD_NAMES[] = {
+	"threshold",
+	"ordered",
+	"floyd-steinberg"
+};
+
+/** @brief Number of `BENCH_METHODS`. */
+#define BENCH_NUM_METHODS \
+	(int)(sizeof(BENCH_METHODS) / sizeof(BENCH_METHODS[0]))
+
+/** @brief Grayscale pixels of the rows. */
+static uint8_t bench_gray[BENCH_NUM_ROWS][DITHER_MAX_WIDTH];
+
+/** @brief Packed rows. */
+static uint8_t bench_rows[BENCH_NUM_ROWS][DITHER_MAX_WIDTH / 8];
+
+/** @brief Memory of the buffer rows are drawn in. */
+static uint8_t bench_frame_memory[BENCH_NUM_ROWS * (DITHER_MAX_WIDTH + 8) / 8];
+
+/** @brief Errors of Floyd-Steinberg dithering. */
+static int16_t bench_errors[DITHER_ERROR_BUFFER_SIZE(DITHER_MAX_WIDTH)];
+
+/** @brief Conversion to measure. */
+typedef struct {
+	/** @brief Dithering state. */
+	dither dither;
+	/** @brief Buffer to draw in. */
+	image_buffer buffer;
+} bench_dither;
+
+/**
+ * @brief Converts `BENCH_NUM_ROWS` rows into packed bytes.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_dither*`) Conversion.
+ */
+static void bench_convert (void* arg) {
+	bench_dither* bench = (bench_dither*)arg;
+	int y;
+	dither_reset(&bench->dither);
+	for (y = 0; y < BENCH_NUM_ROWS; ++y) {
+		dither_convert_row(&bench->dither, bench_gray[y], bench_rows[y]);
+	}
+}
+
+/**
+ * @brief Draws `BENCH_NUM_ROWS` rows at x = 3.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_dither*`) Conversion.
+ */
+static void bench_draw (void* arg) {
+	bench_dither* bench = (bench_dither*)arg;
+	int y;
+	dither_reset(&bench->dither);
+	image_buffer_clear_dirty(&bench->buffer);
+	for (y = 0; y < BENCH_NUM_ROWS; ++y) {
+		dither_draw_row(&bench->dither, &bench->buffer, bench_gray[y], 3, y);
+	}
+}
+
+int main (void) {
+	int i;
+	int method;
+	for (i = 0; i < BENCH_NUM_ROWS * (int)DITHER_MAX_WIDTH; ++i) {
+		bench_gray[i / DITHER_MAX_WIDTH][i % DITHER_MAX_WIDTH] = (uint8_t)rand();
+	}
+	printf("method          | width | convert        | draw at x = 3\n");
+	printf("----------------|-------|----------------|---------------\n");
+	for (method = 0; method < BENCH_NUM_METHODS; ++method) {
+		for (i = 0; i < BENCH_NUM_WIDTHS; ++i) {
+			const uint16_t width = BENCH_WIDTHS[i];
+			bench_dither bench = {
+				.dither = dither_initializer(
+					BENCH_METHODS[method],
+					width,
+					bench_errors),
+				.buffer = image_buffer_initializer(
+					bench_frame_memory,
+					width + 8u,
+					BENCH_NUM_ROWS)
+			};
+			const double convert_ns = bench_measure(bench_convert, &bench);
+			const double draw_ns = bench_measure(bench_draw, &bench);
+			printf(
+				"%-15s | %5u | %7.0f krow/s | %7.0f krow/s\n",
+				BENCH_METHOD_NAMES[method],
+				(unsigned)width,
+				BENCH_NUM_ROWS / convert_ns * 1e6,
+				BENCH_NUM_ROWS / draw_ns * 1e6);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file bench_dsp.c
+ *
+ * Measures how many samples per second every stage of `dsp.h` processes,
+ * and the chain of `spi_adxl345_main.c` with `ADXL345_USE_DSP`.
+ *
+ * Every call processes a block of noise one value at a time, as the
+ * consumer task does for each axis. The last column compares the throughput
+ * with 3 axes at 3200Hz, the stream the chain has to keep up with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dsp.h"
+
+#include "bench_util.h"
+
+/** @brief Number of values processed per measured call. */
+#define BENCH_BLOCK_SIZE  4096
+
+/** @brief Samples per second of 3 axes at 3200Hz. */
+#define BENCH_STREAM_RATE  (3.0 * 3200.0)
+
+/** @brief Biquad filters. Same as `ADXL345_DSP_BIQUADS` in `spi_adxl345_main.c`. */
+static const dsp_biquad_coefficients BENCH_BIQUADS[2] = {
+	dsp_biquad_coefficients_initializer(
+		0.9565432255568768, -1.9130864511137535, 0.9565432255568768,
+		-1.9111970674260732, 0.9149758348014339),
+	dsp_biquad_coefficients_initializer(
+		0.6389455251590224, 1.2778910503180447, 0.6389455251590224,
+		1.1429805025399007, 0.41280159809618855)
+};
+
+/** @brief Input values. */
+static int16_t bench_xs[BENCH_BLOCK_SIZE];
+
+/** @brief Keeps outputs from being optimized away. */
+static volatile int16_t bench_sink;
+
+/** @brief Stages of the chain. */
+typedef struct {
+	/** @brief CIC decimator. */
+	dsp_cic cic;
+	/** @brief Biquad filters. */
+	dsp_biquad biquads[2];
+	/** @brief Number of biquad filters to apply. */
+	size_t num_biquads;
+	/** @brief Window. */
+	dsp_window window;
+} bench_dsp;
+
+/**
+ * @brief Decimates a block.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_dsp*`) Stages.
+ */
+static void bench_cic (void* arg) {
+	bench_dsp* bench = (bench_dsp*)arg;
+	int16_t y = 0;
+	int i;
+	for (i = 0; i < BENCH_BLOCK_SIZE; ++i) {
+		dsp_cic_process(&bench->cic, bench_xs[i], &y);
+	}
+	bench_sink = y;
+}
+
+/**
+ * @brief Filters a block with `num_biquads` biquad filters.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_dsp*`) Stages.
+ */
+static void bench_biquad (void* arg) {
+	bench_dsp* bench = (bench_dsp*)arg;
+	int16_t y = 0;
+	int i;
+	for (i = 0; i < BENCH_BLOCK_SIZE; ++i) {
+		y = dsp_biquad_cascade_process(bench->biquads, bench->num_biquads, bench_xs[i]);
+	}
+	bench_sink = y;
+}
+
+/**
+ * @brief Accumulates a block in the window.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_dsp*`) Stages.
+ */
+static void bench_window (void* arg) {
+	bench_dsp* bench = (bench_dsp*)arg;
+	dsp_features features = { 0, 0u, 0u };
+	int i;
+	for (i = 0; i < BENCH_BLOCK_SIZE; ++i) {
+		dsp_window_add(&bench->window, bench_xs[i], &features);
+	}
+	bench_sink = features.mean;
+}
+
+/**
+ * @brief Runs a block through the chain of `spi_adxl345_main.c`.
+ *
+ * Filters and windows only decimated values.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_dsp*`) Stages.
+ */
+static void bench_chain (void* arg) {
+	bench_dsp* bench = (bench_dsp*)arg;
+	dsp_features features = { 0, 0u, 0u };
+	int16_t y;
+	int i;
+	for (i = 0; i < BENCH_BLOCK_SIZE; ++i) {
+		if (dsp_cic_process(&bench->cic, bench_xs[i], &y)) {
+			y = dsp_biquad_cascade_process(bench->biquads, bench->num_biquads, y);
+			dsp_window_add(&bench->window, y, &features);
+		}
+	}
+	bench_sink = features.mean;
+}
+
+/**
+ * @brief Measures a stage, and prints a row of the table.
+ *
+ * @param[in] name
+ *
+ *   Name of the stage.
+ *
+ * @param[in] fn
+ *
+ *   Function that processes a block.
+ *
+ * @param[in] num_biquads
+ *
+ *   Number of biquad filters to apply.
+ */
+static void bench_stage (const char* name, void (*fn)(void*), size_t num_biquads) {
+	bench_dsp bench = {
+		.cic = dsp_cic_initializer(3u, 4u),
+		.biquads = {
+			dsp_biquad_initializer(&BENCH_BIQUADS[0]),
+			dsp_biquad_initializer(&BENCH_BIQUADS[1])
+		},
+		.num_biquads = num_biquads,
+		.window = dsp_window_initializer(200u)
+	};
+	const double ns = bench_measure(fn, &bench);
+	const double rate = BENCH_BLOCK_SIZE / ns * 1e9;
+	printf(
+		"%-26s | %8.1f Msample/s | %6.2f ns | %8.0fx\n",
+		name,
+		rate * 1e-6,
+		ns / BENCH_BLOCK_SIZE,
+		rate / BENCH_STREAM_RATE);
+}
+
+int main (void) {
+	int i;
+	for (i = 0; i < BENCH_BLOCK_SIZE; ++i) {
+		bench_xs[i] = (int16_t)rand();
+	}
+	printf("stage                      | throughput         | per value | 3 x 3200Hz\n");
+	printf("---------------------------|--------------------|-----------|-----------\n");
+	bench_stage("CIC order 3, 1/16", bench_cic, 0u);
+	bench_stage("biquad x1", bench_biquad, 1u);
+	bench_stage("biquad x2", bench_biquad, 2u);
+	bench_stage("window 200", bench_window, 0u);
+	bench_stage("CIC + biquad x2 + window", bench_chain, 2u);
+	return 0;
+}
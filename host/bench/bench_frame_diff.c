@@ -0,0 +1,237 @@
+/**
+ * @file bench_frame_diff.c
+ *
+ * Measures the upload of frames by `epd_draw_image_buffer_diff` in typical
+ * workloads, on every panel.
+ *
+ * - none: the frame is the same as the RAM; the scan reads every row
+ * - ticker: a band of 16 rows at the bottom changes, like a ticker or
+ *   a clock
+ * - scroll: a region of 64 rows scrolls up by a row, so every row of it
+ *   changes
+ * - full: every row changes; the scan stops at the first word of a row
+ *
+ * The scan of `frame_diff_rows` runs on the clock of the host; the upload
+ * runs through the timing model of the Linux HAL at the clock of the panel.
+ * "saved" is the time on the bus saved against uploading the whole frame.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "frame_diff.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "bench_util.h"
+
+/** @brief GPIO# for DC. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_DC  27
+/** @brief GPIO# for RST. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_RST  25
+/** @brief GPIO# for BUSY. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_BUSY  26
+
+/** @brief Merge gap of runs. Same as `EPD_DIFF_MAX_GAP` of `epd_driver.c`. */
+#define BENCH_MAX_GAP  8u
+/** @brief Maximum number of runs. Same as `EPD_DIFF_MAX_RUNS` of `epd_driver.c`. */
+#define BENCH_MAX_RUNS  8
+
+/** @brief Height of the band of the ticker workload. */
+#define BENCH_TICKER_ROWS  16u
+/** @brief Height of the region of the scroll workload. */
+#define BENCH_SCROLL_ROWS  64u
+
+/** @brief Workloads. */
+typedef enum {
+	BENCH_WORKLOAD_NONE,
+	BENCH_WORKLOAD_TICKER,
+	BENCH_WORKLOAD_SCROLL,
+	BENCH_WORKLOAD_FULL,
+	BENCH_NUM_WORKLOADS
+} bench_workload;
+
+/** @brief Names of the workloads. */
+static const char* const BENCH_WORKLOAD_NAMES[BENCH_NUM_WORKLOADS] = {
+	"none",
+	"ticker",
+	"scroll",
+	"full"
+};
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t bench_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t bench_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame on the EPD before a workload. */
+static uint8_t bench_base_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Scan to measure. */
+typedef struct {
+	/** @brief New frame. */
+	const image_buffer* frame;
+	/** @brief Copy of the RAM. */
+	const image_buffer* shadow;
+	/** @brief Runs found by the last scan. */
+	frame_diff_run runs[BENCH_MAX_RUNS];
+	/** @brief Number of `runs`. */
+	size_t num_runs;
+} bench_scan;
+
+/**
+ * @brief Runs `frame_diff_rows` like `epd_draw_image_buffer_diff`.
+ *
+ * @param[in,out] arg
+ *
+ *   (`bench_scan*`) Scan to run.
+ */
+static void bench_run_scan (void* arg) {
+	bench_scan* scan = (bench_scan*)arg;
+	scan->num_runs = frame_diff_rows(
+		scan->frame,
+		scan->shadow,
+		BENCH_MAX_GAP,
+		scan->runs,
+		BENCH_MAX_RUNS);
+}
+
+/**
+ * @brief Makes the frame of a given workload from the base frame.
+ *
+ * @param[in] workload
+ *
+ *   Workload.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ */
+static void bench_make_frame (bench_workload workload, const epd_panel* panel) {
+	const size_t stride = panel->ram_width / 8u;
+	const size_t frame_size = epd_panel_frame_size(panel);
+	const uint32_t scroll_top = (panel->height - BENCH_SCROLL_ROWS) / 2u;
+	size_t i;
+	memcpy(bench_frame_memory, bench_base_memory, frame_size);
+	switch (workload) {
+	case BENCH_WORKLOAD_NONE:
+		break;
+	case BENCH_WORKLOAD_TICKER:
+		for (i = frame_size - BENCH_TICKER_ROWS * stride; i < frame_size; ++i) {
+			bench_frame_memory[i] ^= 0x0Fu;
+		}
+		break;
+	case BENCH_WORKLOAD_SCROLL:
+		memmove(
+			bench_frame_memory + scroll_top * stride,
+			bench_frame_memory + (scroll_top + 1u) * stride,
+			(BENCH_SCROLL_ROWS - 1u) * stride);
+		memset(
+			bench_frame_memory + (scroll_top + BENCH_SCROLL_ROWS - 1u) * stride,
+			0xFF,
+			stride);
+		break;
+	case BENCH_WORKLOAD_FULL:
+		for (i = 0u; i < frame_size; ++i) {
+			bench_frame_memory[i] = (uint8_t)~bench_frame_memory[i];
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Measures the workloads on a given panel, and prints their rows.
+ *
+ * @param[in] panel_id
+ *
+ *   Panel.
+ */
+static void bench_panel (epd_panel_id panel_id) {
+	const epd_panel* panel = &EPD_PANELS[panel_id];
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	const size_t frame_size = epd_panel_frame_size(panel);
+	image_buffer frame = image_buffer_initializer(
+		bench_frame_memory,
+		panel->ram_width,
+		panel->height);
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	bench_scan scan;
+	double scan_ns[BENCH_NUM_WORKLOADS];
+	int64_t bus_ns[BENCH_NUM_WORKLOADS];
+	uint32_t num_rows[BENCH_NUM_WORKLOADS];
+	size_t num_runs[BENCH_NUM_WORKLOADS];
+	hal_spi_device spi;
+	epd_device epd;
+	epd_sim sim;
+	size_t i;
+	int workload;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(&sim, BENCH_PIN_DC, BENCH_PIN_BUSY, NULL);
+	epd_sim_attach(&sim, spi);
+	epd_device_init(
+		&epd,
+		panel,
+		spi,
+		BENCH_PIN_DC,
+		BENCH_PIN_RST,
+		BENCH_PIN_BUSY,
+		bench_panel_memory);
+	epd_configure_gpios(&epd);
+	epd_reset(&epd);
+	epd_initialize(&epd);
+	epd_clear_all(&epd);
+	// every row differs from the next one, so that a scroll changes them
+	for (i = 0u; i < frame_size; ++i) {
+		bench_base_memory[i] = (uint8_t)(i * 7u + i / 13u);
+	}
+	for (workload = 0; workload < BENCH_NUM_WORKLOADS; ++workload) {
+		// starts from the base frame on the EPD
+		memcpy(bench_frame_memory, bench_base_memory, frame_size);
+		epd_draw_image_buffer_diff(&epd, &frame);
+		bench_make_frame((bench_workload)workload, panel);
+		scan.frame = &frame;
+		scan.shadow = &epd.panel_image;
+		scan_ns[workload] = bench_measure(bench_run_scan, &scan);
+		num_runs[workload] = scan.num_runs;
+		num_rows[workload] = 0u;
+		for (i = 0u; i < scan.num_runs; ++i) {
+			num_rows[workload] += scan.runs[i].bottom - scan.runs[i].top;
+		}
+		hal_linux_get_stats(&start);
+		epd_draw_image_buffer_diff(&epd, &frame);
+		hal_linux_get_stats(&stats);
+		hal_linux_stats_diff(&stats, &start, &stats);
+		bus_ns[workload] = stats.wire_ns + stats.overhead_ns;
+	}
+	for (workload = 0; workload < BENCH_NUM_WORKLOADS; ++workload) {
+		printf(
+			"%-9s | %-8s | %4u | %4u | %9.2f | %8.3f | %8.3f\n",
+			panel->name,
+			BENCH_WORKLOAD_NAMES[workload],
+			(unsigned)num_rows[workload],
+			(unsigned)num_runs[workload],
+			scan_ns[workload] * 1e-3,
+			bus_ns[workload] * 1e-6,
+			(bus_ns[BENCH_WORKLOAD_FULL] - bus_ns[workload]) * 1e-6);
+	}
+}
+
+int main (void) {
+	int panel_id;
+	printf("panel     | workload | rows | runs | scan (us) | bus (ms) | saved (ms)\n");
+	printf("----------|----------|------|------|-----------|----------|-----------\n");
+	for (panel_id = 0; panel_id < EPD_NUM_PANELS; ++panel_id) {
+		bench_panel((epd_panel_id)panel_id);
+	}
+	return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file bench_image_blit.c
+ *
+ * Compares byte-aligned and unaligned blits of `image_buffer`, and
+ * measures the throughput of every raster operation.
+ *
+ * An aligned image is copied row by row with `memcpy`, and an unaligned
+ * one is shifted 32 bits at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "image_buffer.h"
+
+#include "bench_util.h"
+
+/** @brief Largest width of the buffers. */
+#define BENCH_MAX_WIDTH  800
+/** @brief Largest height of the buffers. */
+#define BENCH_MAX_HEIGHT  600
+/** @brief Size of the largest frame in bytes. */
+#define BENCH_MAX_FRAME_SIZE  (BENCH_MAX_WIDTH * BENCH_MAX_HEIGHT / 8)
+
+/** @brief Sizes of the buffers. */
+static const struct {
+	int width;
+	int height;
+} BENCH_BUFFER_SIZES[] = {
+	{ 200, 200 },
+	{ 400, 300 },
+	{ 800, 600 }
+};
+
+/** @brief Number of `BENCH_BUFFER_SIZES`. */
+#define BENCH_NUM_BUFFER_SIZES \
+	(int)(sizeof(BENCH_BUFFER_SIZES) / sizeof(BENCH_BUFFER_SIZES[0]))
+
+/** @brief Memory of the buffer. */
+static uint8_t bench_frame_memory[BENCH_MAX_FRAME_SIZE];
+
+/** @brief Image to blit. */
+static uint8_t bench_image[BENCH_MAX_FRAME_SIZE];
+
+/** @brief Mask of the image. */
+static uint8_t bench_mask[BENCH_MAX_FRAME_SIZE];
+
+/** @brief Names of the raster operations. */
+static const char* const BENCH_ROP_NAMES[IMAGE_BUFFER_NUM_ROPS] = {
+	"COPY",
+	"AND",
+	"OR",
+	"XOR",
+	"NOT-SRC"
+};
+
+/** @brief Blit to measure. */
+typedef struct {
+	/** @brief Buffer to blit in. */
+	image_buffer buffer;
+	/** @brief Mask of the image. `NULL` if no mask is applied. */
+	const uint8_t* mask;
+	/** @brief Raster operation. */
+	image_buffer_rop rop;
+	/** @brief Left position of the image. */
+	int left;
+	/** @brief Width of the image. */
+	int width;
+	/** @brief Height of the image. */
+	int height;
+} bench_blit;
+
+/**
+ * @brief Draws the image.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_blit*`) Blit.
+ */
+static void bench_draw_image (void* arg) {
+	bench_blit* blit = (bench_blit*)arg;
+	image_buffer_clear_dirty(&blit->buffer);
+	image_buffer_draw_image(
+		&blit->buffer,
+		bench_image,
+		blit->left,
+		0,
+		blit->width,
+		blit->height);
+}
+
+/**
+ * @brief Blits the image with a raster operation.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_blit*`) Blit.
+ */
+static void bench_blit_image (void* arg) {
+	bench_blit* blit = (bench_blit*)arg;
+	image_buffer_clear_dirty(&blit->buffer);
+	image_buffer_blit(
+		&blit->buffer,
+		bench_image,
+		blit->mask,
+		blit->left,
+		0,
+		blit->width,
+		blit->height,
+		blit->rop);
+}
+
+/**
+ * @brief Prints the throughput of every raster operation.
+ *
+ * Blits an unaligned image of 192x200 pixels in a 200x200 buffer.
+ */
+static void bench_rops (void) {
+	bench_blit blit = {
+		.buffer = image_buffer_initializer(bench_frame_memory, 200u, 200u),
+		.left = 3,
+		.width = 192,
+		.height = 200
+	};
+	int rop;
+	printf("\nop      | no mask      | mask\n");
+	printf("--------|--------------|-------------\n");
+	for (rop = 0; rop < IMAGE_BUFFER_NUM_ROPS; ++rop) {
+		double unmasked_ns;
+		double masked_ns;
+		blit.rop = (image_buffer_rop)rop;
+		blit.mask = NULL;
+		unmasked_ns = bench_measure(bench_blit_image, &blit);
+		blit.mask = bench_mask;
+		masked_ns = bench_measure(bench_blit_image, &blit);
+		printf(
+			"%-7s | %6.0f Mpx/s | %6.0f Mpx/s\n",
+			BENCH_ROP_NAMES[rop],
+			blit.width * blit.height / unmasked_ns * 1e3,
+			blit.width * blit.height / masked_ns * 1e3);
+	}
+}
+
+int main (void) {
+	int i;
+	for (i = 0; i < BENCH_MAX_FRAME_SIZE; ++i) {
+		bench_image[i] = (uint8_t)rand();
+		bench_mask[i] = (uint8_t)rand();
+	}
+	printf("buffer  | image   | aligned  | unaligned | ratio\n");
+	printf("--------|---------|----------|-----------|------\n");
+	for (i = 0; i < BENCH_NUM_BUFFER_SIZES; ++i) {
+		const int width = BENCH_BUFFER_SIZES[i].width;
+		const int height = BENCH_BUFFER_SIZES[i].height;
+		bench_blit blit = {
+			.buffer = image_buffer_initializer(
+				bench_frame_memory,
+				(uint32_t)width,
+				(uint32_t)height),
+			// leaves room for the shift
+			.width = width - 8,
+			.height = height
+		};
+		double aligned_ns;
+		double unaligned_ns;
+		blit.left = 0;
+		aligned_ns = bench_measure(bench_draw_image, &blit);
+		blit.left = 3;
+		unaligned_ns = bench_measure(bench_draw_image, &blit);
+		printf(
+			"%3dx%-3d | %3dx%-3d | %5.1f us | %6.1f us  | x%.2f\n",
+			width,
+			height,
+			blit.width,
+			blit.height,
+			aligned_ns / 1e3,
+			unaligned_ns / 1e3,
+			unaligned_ns / aligned_ns);
+	}
+	bench_rops();
+	return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file bench_rle_image.c
+ *
+ * Compares drawing the images in `epd/imgs` raw, compressed with RLE, and
+ * compressed with RLE of row deltas, with `image_asset_draw`.
+ *
+ * The build exports the images as binary blobs (`<dither>-<format>.bin`)
+ * in `BENCH_BLOB_DIR`; see `host/CMakeLists.txt`.
+ * Throughput is the size of the decoded image over the time to draw it
+ * into an image buffer on the clock of the host; a compressed image trades
+ * decoding time for flash.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_asset.h"
+#include "image_buffer.h"
+
+#include "bench_util.h"
+
+#ifndef BENCH_BLOB_DIR
+#error "define BENCH_BLOB_DIR"
+#endif
+
+/** @brief Size of the magic and the number of images of a blob. */
+#define BENCH_BLOB_HEADER_SIZE  8u
+
+/** @brief Size of an entry of the index table of a blob. */
+#define BENCH_BLOB_ENTRY_SIZE  16u
+
+/** @brief Dithering methods the images are exported with. */
+static const char* const BENCH_DITHER_METHODS[] = {
+	"none",
+	"floyd-steinberg"
+};
+
+/** @brief Number of `BENCH_DITHER_METHODS`. */
+#define BENCH_NUM_DITHER_METHODS \
+	(int)(sizeof(BENCH_DITHER_METHODS) / sizeof(BENCH_DITHER_METHODS[0]))
+
+/** @brief Formats the images are exported in. */
+static const char* const BENCH_FORMATS[] = {
+	"raw",
+	"rle",
+	"rle-delta"
+};
+
+/** @brief Number of `BENCH_FORMATS`. */
+#define BENCH_NUM_FORMATS \
+	(int)(sizeof(BENCH_FORMATS) / sizeof(BENCH_FORMATS[0]))
+
+/** @brief Binary blob loaded from a file. */
+typedef struct {
+	/** @brief Contents of the file. */
+	uint8_t* data;
+	/** @brief Number of images. */
+	uint32_t num_images;
+	/** @brief Index table. */
+	image_asset* assets;
+	/** @brief Encoded images after the index table. */
+	const uint8_t* images;
+} bench_blob;
+
+/** @brief Image to draw. */
+typedef struct {
+	/** @brief Image buffer to draw into. */
+	image_buffer* buffer;
+	/** @brief Blob of the image. */
+	const bench_blob* blob;
+	/** @brief Image in `blob`. */
+	const image_asset* asset;
+} bench_draw_args;
+
+/**
+ * @brief Reads a little-endian integer.
+ *
+ * @param[in] data
+ *
+ *   Bytes of the integer.
+ *
+ * @param[in] size
+ *
+ *   Number of bytes.
+ *
+ * @return
+ *
+ *   Integer.
+ */
+static uint32_t bench_read_le (const uint8_t* data, size_t size) {
+	uint32_t value = 0u;
+	while (size > 0u) {
+		--size;
+		value = (value << 8) | data[size];
+	}
+	return value;
+}
+
+/**
+ * @brief Loads a blob exported by `make_binary_image.py`.
+ *
+ * @param[out] blob
+ *
+ *   Receives the blob. Free with `::bench_free_blob`.
+ *
+ * @param[in] dither
+ *
+ *   Dithering method.
+ *
+ * @param[in] format
+ *
+ *   Format; `raw`, `rle` or `rle-delta`.
+ *
+ * @return
+ *
+ *   `0` if loaded, `-1` otherwise.
+ */
+static int bench_load_blob (bench_blob* blob, const char* dither, const char* format) {
+	char path[512];
+	FILE* file;
+	long size;
+	uint32_t i;
+	memset(blob, 0, sizeof(bench_blob));
+	snprintf(path, sizeof(path), "%s/%s-%s.bin", BENCH_BLOB_DIR, dither, format);
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	blob->data = (uint8_t*)malloc((size_t)size);
+	if (fread(blob->data, 1u, (size_t)size, file) != (size_t)size) {
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	if ((size < (long)BENCH_BLOB_HEADER_SIZE) ||
+		(memcmp(blob->data, "EPDA", 4u) != 0))
+	{
+		fprintf(stderr, "%s is not a blob\n", path);
+		return -1;
+	}
+	blob->num_images = bench_read_le(blob->data + 4, 4u);
+	blob->assets = (image_asset*)calloc(blob->num_images, sizeof(image_asset));
+	for (i = 0u; i < blob->num_images; ++i) {
+		const uint8_t* entry =
+			blob->data + BENCH_BLOB_HEADER_SIZE + (i * BENCH_BLOB_ENTRY_SIZE);
+		blob->assets[i].offset = bench_read_le(entry, 4u);
+		blob->assets[i].size = bench_read_le(entry + 4, 4u);
+		blob->assets[i].width = (uint16_t)bench_read_le(entry + 8, 2u);
+		blob->assets[i].height = (uint16_t)bench_read_le(entry + 10, 2u);
+		blob->assets[i].flags = entry[12];
+	}
+	blob->images = blob->data +
+		BENCH_BLOB_HEADER_SIZE +
+		(blob->num_images * BENCH_BLOB_ENTRY_SIZE);
+	return 0;
+}
+
+/**
+ * @brief Frees a blob loaded by `::bench_load_blob`.
+ *
+ * @param[in,out] blob
+ *
+ *   Blob to free.
+ */
+static void bench_free_blob (bench_blob* blob) {
+	free(blob->assets);
+	free(blob->data);
+}
+
+/**
+ * @brief Draws an image at the top-left corner.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_draw_args*`) Image to draw.
+ */
+static void bench_draw (void* arg) {
+	bench_draw_args* args = (bench_draw_args*)arg;
+	image_asset_draw(args->buffer, args->blob->images, args->asset, 0, 0);
+}
+
+/**
+ * @brief Measures the images exported with a given dithering method in
+ * every format.
+ *
+ * @param[in] dither
+ *
+ *   Dithering method.
+ */
+static void bench_dither (const char* dither) {
+	bench_blob blobs[BENCH_NUM_FORMATS];
+	uint32_t i;
+	int f;
+	for (f = 0; f < BENCH_NUM_FORMATS; ++f) {
+		if (bench_load_blob(&blobs[f], dither, BENCH_FORMATS[f]) != 0) {
+			exit(1);
+		}
+	}
+	for (i = 0u; i < blobs[0].num_images; ++i) {
+		const image_asset* raw = &blobs[0].assets[i];
+		const uint32_t width = ((raw->width + 7u) / 8u) * 8u;
+		uint8_t* memory = (uint8_t*)malloc(raw->height * (width / 8u));
+		image_buffer buffer = image_buffer_initializer(memory, width, raw->height);
+		image_buffer_clear_all(&buffer);
+		for (f = 0; f < BENCH_NUM_FORMATS; ++f) {
+			bench_draw_args args;
+			double ns;
+			args.buffer = &buffer;
+			args.blob = &blobs[f];
+			args.asset = &blobs[f].assets[i];
+			ns = bench_measure(bench_draw, &args);
+			printf(
+				"%-15s #%u %3ux%-3u %-9s %6u bytes (%5.1f%%) %8.1f us %8.1f MB/s\n",
+				dither,
+				(unsigned)i,
+				(unsigned)raw->width,
+				(unsigned)raw->height,
+				BENCH_FORMATS[f],
+				(unsigned)args.asset->size,
+				100.0 * args.asset->size / raw->size,
+				ns / 1e3,
+				raw->size / ns * 1e3);
+		}
+		free(memory);
+	}
+	for (f = 0; f < BENCH_NUM_FORMATS; ++f) {
+		bench_free_blob(&blobs[f]);
+	}
+}
+
+int main (void) {
+	int i;
+	for (i = 0; i < BENCH_NUM_DITHER_METHODS; ++i) {
+		bench_dither(BENCH_DITHER_METHODS[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file bench_sample_ring.c
+ *
+ * Measures the throughput of `sample_ring` in records per second.
+ *
+ * - one thread: pushes and pops a batch in turn, which is the cost of
+ *   the copies and index updates alone.
+ * - two threads: a producer and a consumer thread pass records through
+ *   a ring as large as that of `spi_adxl345_main.c`, which adds the
+ *   traffic of cache lines between the cores.
+ *
+ * The ADXL345 produces at most 3200 records per second.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "sample_ring.h"
+
+#include "bench_util.h"
+
+/** @brief Capacity of the ring. Same as `spi_adxl345_main.c`. */
+#define BENCH_RING_SIZE  1024u
+
+/** @brief Number of records passed between the threads per batch size. */
+#define BENCH_NUM_RECORDS  20000000u
+
+/** @brief Largest batch. */
+#define BENCH_MAX_BATCH  64u
+
+/** @brief Batch sizes to measure. */
+static const uint32_t BENCH_BATCH_SIZES[] = { 1u, 16u, 64u };
+
+/** @brief Number of `BENCH_BATCH_SIZES`. */
+#define BENCH_NUM_BATCH_SIZES \
+	(int)(sizeof(BENCH_BATCH_SIZES) / sizeof(BENCH_BATCH_SIZES[0]))
+
+/** @brief Records of the ring. */
+static sample_record bench_records[BENCH_RING_SIZE];
+
+/** @brief Ring. */
+static sample_ring bench_ring = sample_ring_initializer(bench_records, BENCH_RING_SIZE);
+
+/** @brief Side of the ring run by a thread. */
+typedef struct {
+	/** @brief Number of records per call. */
+	uint32_t batch_size;
+	/** @brief Number of calls that moved no record. */
+	uint32_t num_empty_calls;
+	/** @brief Sum of timestamps popped, so that nothing is optimized out. */
+	int64_t checksum;
+} bench_side;
+
+/**
+ * @brief Pushes and pops a batch.
+ *
+ * @param[in,out] arg
+ *
+ *   (`bench_side*`) Batch.
+ */
+static void bench_push_pop (void* arg) {
+	bench_side* side = (bench_side*)arg;
+	sample_record batch[BENCH_MAX_BATCH] = { { 0 } };
+	sample_ring_push(&bench_ring, batch, side->batch_size);
+	sample_ring_pop(&bench_ring, batch, side->batch_size);
+	side->checksum += batch[0].timestamp;
+}
+
+/**
+ * @brief Pushes `BENCH_NUM_RECORDS` records.
+ *
+ * @param[in,out] arg
+ *
+ *   (`bench_side*`) Producer.
+ *
+ * @return
+ *
+ *   `NULL`.
+ */
+static void* bench_produce (void* arg) {
+	bench_side* side = (bench_side*)arg;
+	sample_record batch[BENCH_MAX_BATCH] = { { 0 } };
+	uint32_t num_pushed = 0u;
+	while (num_pushed < BENCH_NUM_RECORDS) {
+		const size_t pushed = sample_ring_push(&bench_ring, batch, side->batch_size);
+		if (pushed == 0u) {
+			++side->num_empty_calls;
+			sched_yield();
+		}
+		batch[0].timestamp += (int64_t)pushed;
+		num_pushed += (uint32_t)pushed;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Pops `BENCH_NUM_RECORDS` records.
+ *
+ * @param[in,out] arg
+ *
+ *   (`bench_side*`) Consumer.
+ *
+ * @return
+ *
+ *   `NULL`.
+ */
+static void* bench_consume (void* arg) {
+	bench_side* side = (bench_side*)arg;
+	sample_record batch[BENCH_MAX_BATCH];
+	uint32_t num_popped = 0u;
+	while (num_popped < BENCH_NUM_RECORDS) {
+		const size_t popped = sample_ring_pop(&bench_ring, batch, side->batch_size);
+		if (popped == 0u) {
+			++side->num_empty_calls;
+			sched_yield();
+			continue;
+		}
+		side->checksum += batch[0].timestamp;
+		num_popped += (uint32_t)popped;
+	}
+	return NULL;
+}
+
+int main (void) {
+	int i;
+	printf("batch | one thread     | two threads    | full pushes | empty pops\n");
+	printf("------|----------------|----------------|-------------|-----------\n");
+	for (i = 0; i < BENCH_NUM_BATCH_SIZES; ++i) {
+		const uint32_t batch_size = BENCH_BATCH_SIZES[i];
+		bench_side single = { batch_size, 0u, 0 };
+		bench_side producer = { batch_size, 0u, 0 };
+		bench_side consumer = { batch_size, 0u, 0 };
+		pthread_t producer_thread;
+		pthread_t consumer_thread;
+		double single_ns;
+		int64_t start_ns;
+		int64_t elapsed_ns;
+		single_ns = bench_measure(bench_push_pop, &single);
+		start_ns = bench_now_ns();
+		if ((pthread_create(&consumer_thread, NULL, bench_consume, &consumer) != 0) ||
+			(pthread_create(&producer_thread, NULL, bench_produce, &producer) != 0))
+		{
+			fprintf(stderr, "cannot create threads\n");
+			return 1;
+		}
+		pthread_join(producer_thread, NULL);
+		pthread_join(consumer_thread, NULL);
+		elapsed_ns = bench_now_ns() - start_ns;
+		printf(
+			"%5u | %6.1f Mrec/s | %6.1f Mrec/s | %11u | %10u\n",
+			(unsigned)batch_size,
+			batch_size / single_ns * 1e3,
+			(double)BENCH_NUM_RECORDS / elapsed_ns * 1e3,
+			(unsigned)producer.num_empty_calls,
+			(unsigned)consumer.num_empty_calls);
+	}
+	return 0;
+}
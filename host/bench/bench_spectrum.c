@@ -0,0 +1,117 @@
+/**
+ * @file bench_spectrum.c
+ *
+ * Measures `::spectrum_fft` and spectra of three axes by `::spectrum_add`
+ * at FFT sizes from 256 to 4096.
+ *
+ * An update of spectra removes the mean of, windows and transforms every
+ * axis, and takes place every `size / 2` samples. The last column is the
+ * share of a host core that updates take at 3200Hz.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spectrum.h"
+
+#include "bench_util.h"
+
+/** @brief Sampling rate in mHz. */
+#define BENCH_SAMPLE_RATE_MILLIHZ  3200000u
+
+/** @brief Smallest FFT size to measure. */
+#define BENCH_MIN_SIZE  256u
+
+/** @brief Hann window. */
+static float bench_window[SPECTRUM_WINDOW_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Twiddle factors. */
+static float bench_twiddles[SPECTRUM_TWIDDLES_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Work buffer. */
+static float bench_work[SPECTRUM_WORK_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief History. */
+static int16_t bench_history[SPECTRUM_HISTORY_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Magnitudes. */
+static float bench_magnitudes[SPECTRUM_MAGNITUDES_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Input of FFTs. */
+static float bench_inputs[SPECTRUM_WORK_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Samples fed to spectra. */
+static sample_record bench_samples[SPECTRUM_MAX_SIZE / 2u];
+
+/**
+ * @brief Transforms the same input.
+ *
+ * Copies the input first; transforming the output again would overflow.
+ *
+ * @param[in] arg
+ *
+ *   (`spectrum*`) Spectra whose size and twiddle factors are used.
+ */
+static void bench_fft (void* arg) {
+	const spectrum* s = (const spectrum*)arg;
+	memcpy(s->work, bench_inputs, SPECTRUM_WORK_SIZE(s->size) * sizeof(float));
+	spectrum_fft(s->work, s->size, s->twiddles);
+}
+
+/**
+ * @brief Adds half of the history, which updates spectra once.
+ *
+ * @param[in] arg
+ *
+ *   (`spectrum*`) Spectra with a full history.
+ */
+static void bench_update (void* arg) {
+	spectrum* s = (spectrum*)arg;
+	uint32_t i;
+	for (i = 0u; i < s->size / 2u; ++i) {
+		spectrum_add(s, &bench_samples[i]);
+	}
+}
+
+int main (void) {
+	uint32_t size;
+	uint32_t i;
+	for (i = 0u; i < SPECTRUM_MAX_SIZE / 2u; ++i) {
+		bench_samples[i].timestamp = 0;
+		bench_samples[i].accs[0] = (int16_t)(rand() % 1024 - 512);
+		bench_samples[i].accs[1] = (int16_t)(rand() % 1024 - 512);
+		bench_samples[i].accs[2] = (int16_t)(rand() % 1024 + 256 - 512);
+	}
+	printf("size | FFT        | 3 axes     | per sample | at 3200Hz\n");
+	printf("-----|------------|------------|------------|----------\n");
+	for (size = BENCH_MIN_SIZE; size <= SPECTRUM_MAX_SIZE; size <<= 1) {
+		spectrum s = spectrum_initializer(
+			size,
+			BENCH_SAMPLE_RATE_MILLIHZ,
+			bench_history,
+			bench_window,
+			bench_twiddles,
+			bench_work,
+			bench_magnitudes);
+		double fft_ns;
+		double update_ns;
+		spectrum_init(&s);
+		// fills the history, so that every measured call updates once
+		bench_update(&s);
+		bench_update(&s);
+		for (i = 0u; i < SPECTRUM_WORK_SIZE(size); ++i) {
+			bench_inputs[i] = (float)(rand() % 1024 - 512);
+		}
+		fft_ns = bench_measure(bench_fft, &s);
+		update_ns = bench_measure(bench_update, &s);
+		printf(
+			"%4u | %7.2f us | %7.2f us | %7.1f ns | %7.3f%%\n",
+			(unsigned)size,
+			fft_ns * 1e-3,
+			update_ns * 1e-3,
+			update_ns / (size / 2u),
+			update_ns * (BENCH_SAMPLE_RATE_MILLIHZ / 1000.0) / (size / 2u) * 1e-7);
+	}
+	return 0;
+}
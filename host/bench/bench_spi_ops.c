@@ -0,0 +1,177 @@
+/**
+ * @file bench_spi_ops.c
+ *
+ * Replays operations of the EPD and ADXL345 drivers through the timing
+ * model of the Linux HAL, and reports the cost of each on the bus.
+ *
+ * - init: `epd_initialize` after a hardware reset
+ * - clear_all: `epd_clear_all`
+ * - draw_image_buffer: `epd_draw_image_buffer_diff` of a frame that
+ *   differs in every row, so that the whole frame is sent
+ * - read_acceleration: 100 calls of `adxl345_read_acceleration` at the
+ *   clock of polling at 100Hz
+ *
+ * Wire time is bits at the SPI clock; overhead is the setup of transactions,
+ * CS edges, extra DMA descriptors and GPIO writes such as DC changes.
+ * Delays and waits for BUSY are excluded. Efficiency is the share of wire
+ * time in the time the bus is busy. Compare the table before and after a
+ * change of a driver.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "adxl345.h"
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "adxl345_sim.h"
+#include "epd_sim.h"
+
+/** @brief GPIO# for DC. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_DC  27
+/** @brief GPIO# for RST. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_RST  25
+/** @brief GPIO# for BUSY. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_BUSY  26
+
+/** @brief Number of reads of acceleration in a row. */
+#define BENCH_NUM_READS  100u
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t bench_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t bench_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/**
+ * @brief Prints a row of the table.
+ *
+ * @param[in] device
+ *
+ *   Name of the device.
+ *
+ * @param[in] operation
+ *
+ *   Name of the operation.
+ *
+ * @param[in] clock_hz
+ *
+ *   SPI clock in Hz.
+ *
+ * @param[in] stats
+ *
+ *   Costs of the operation.
+ */
+static void bench_print (
+		const char* device,
+		const char* operation,
+		int clock_hz,
+		const hal_linux_stats* stats)
+{
+	printf(
+		"%-10s | %-17s | %4.1fMHz | %5u | %4u | %9.3f | %9.3f | %5.1f%%\n",
+		device,
+		operation,
+		clock_hz * 1e-6,
+		(unsigned)stats->num_transactions,
+		(unsigned)stats->num_gpio_writes,
+		stats->wire_ns * 1e-6,
+		stats->overhead_ns * 1e-6,
+		hal_linux_stats_efficiency(stats) * 100.0);
+}
+
+/**
+ * @brief Replays the operations of the EPD driver on a given panel.
+ *
+ * @param[in] panel_id
+ *
+ *   Panel.
+ */
+static void bench_epd (epd_panel_id panel_id) {
+	const epd_panel* panel = &EPD_PANELS[panel_id];
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	image_buffer frame = image_buffer_initializer(
+		bench_frame_memory,
+		panel->ram_width,
+		panel->height);
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	hal_spi_device spi;
+	epd_device epd;
+	epd_sim sim;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(&sim, BENCH_PIN_DC, BENCH_PIN_BUSY, NULL);
+	epd_sim_attach(&sim, spi);
+	epd_device_init(
+		&epd,
+		panel,
+		spi,
+		BENCH_PIN_DC,
+		BENCH_PIN_RST,
+		BENCH_PIN_BUSY,
+		bench_panel_memory);
+	epd_configure_gpios(&epd);
+	epd_reset(&epd);
+	hal_linux_get_stats(&start);
+	epd_initialize(&epd);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	bench_print(panel->name, "init", panel->max_clock_hz, &stats);
+	hal_linux_get_stats(&start);
+	epd_clear_all(&epd);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	bench_print(panel->name, "clear_all", panel->max_clock_hz, &stats);
+	// every row differs from the white RAM
+	memset(bench_frame_memory, 0x00, epd_panel_frame_size(panel));
+	hal_linux_get_stats(&start);
+	epd_draw_image_buffer_diff(&epd, &frame);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	bench_print(panel->name, "draw_image_buffer", panel->max_clock_hz, &stats);
+}
+
+/** @brief Replays reads of acceleration of the ADXL345 driver. */
+static void bench_adxl345 (void) {
+	const adxl345_config config =
+		adxl345_config_initializer(ADXL345_RATE_100HZ, ADXL345_RANGE_16G, 1, 0);
+	const int clock_hz = adxl345_spi_clock_hz(&config, 0u);
+	const hal_linux_spi_timing timing =
+		hal_linux_spi_timing_initializer(clock_hz, 8, 0u);
+	int16_t accs[3];
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	hal_spi_device spi;
+	adxl345_sim sim;
+	uint32_t i;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	adxl345_sim_init(&sim, -1);
+	adxl345_sim_attach(&sim, spi);
+	adxl345_configure(spi, &config);
+	adxl345_start(spi);
+	hal_linux_get_stats(&start);
+	for (i = 0u; i < BENCH_NUM_READS; ++i) {
+		adxl345_read_acceleration(spi, accs);
+	}
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	bench_print("ADXL345", "read_acceleration", clock_hz, &stats);
+}
+
+int main (void) {
+	int panel_id;
+	printf("device     | operation         | SPI     | trans | GPIO | wire (ms) | over (ms) | eff.\n");
+	printf("-----------|-------------------|---------|-------|------|-----------|-----------|-------\n");
+	for (panel_id = 0; panel_id < EPD_NUM_PANELS; ++panel_id) {
+		bench_epd((epd_panel_id)panel_id);
+	}
+	bench_adxl345();
+	return 0;
+}
@@ -0,0 +1,276 @@
+/**
+ * @file bench_strips.c
+ *
+ * Compares rendering a frame in strips with `epd_draw_strips` against
+ * rendering it into a full image buffer, on every panel.
+ *
+ * - full buffer: the frame is rendered into an image buffer and uploaded by
+ *   `epd_draw_image_buffer_diff`, like the sample project by default; it
+ *   needs the image buffer and the copy of the RAM
+ * - strips: every strip is rendered into a stream block while the previous
+ *   one is transferred, like the sample project with `EPD_USE_STRIPS`; it
+ *   needs only the stream blocks
+ *
+ * Every row of the frame changes, so both upload the whole frame.
+ * RAM is the memory of frames and blocks, not counting the pipeline of two
+ * image buffers of the sample project. Frame time is on the simulated clock
+ * of the Linux HAL, where rendering takes no time, so it is the time on
+ * the bus. Rendering is measured separately on the clock of the host;
+ * strips call the drawing functions once per strip, and most of the calls
+ * are clipped away.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "bench_util.h"
+
+/** @brief GPIO# for DC. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_DC  27
+/** @brief GPIO# for RST. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_RST  25
+/** @brief GPIO# for BUSY. Same as `spi_epd_main.c`. */
+#define BENCH_PIN_BUSY  26
+
+/** @brief Number of stream blocks. Same as `EPD_NUM_STREAM_BLOCKS` of `epd_driver.c`. */
+#define BENCH_NUM_STREAM_BLOCKS  2u
+
+/** @brief Largest height of the panels. */
+#define BENCH_MAX_HEIGHT  EPD_PANEL_4IN2_V2_HEIGHT
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t bench_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t bench_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Stream block to render strips into without the driver. */
+static uint8_t bench_strip_memory[EPD_STREAM_BLOCK_SIZE];
+
+/** @brief Black bar of 8 pixels wide on every row. */
+static const uint8_t BENCH_BAR[BENCH_MAX_HEIGHT];
+
+/** @brief Black square of 64x64 pixels. */
+static const uint8_t BENCH_BLACK_SQUARE[64u * 64u / 8u];
+
+/**
+ * @brief Renders the frame, or a strip of it.
+ *
+ * A black bar on the left edge changes every row, and black squares are
+ * scattered over the frame.
+ *
+ * @param[in,out] strip
+ *
+ *   Strip to render, or the whole frame.
+ *
+ * @param[in] top
+ *
+ *   First row of `strip` in the frame.
+ *
+ * @param[in] user_data
+ *
+ *   (`const epd_panel*`) Panel.
+ */
+static void bench_render (image_buffer* strip, int top, void* user_data) {
+	const epd_panel* panel = (const epd_panel*)user_data;
+	int x;
+	int y;
+	image_buffer_draw_image(strip, BENCH_BAR, 0, -top, 8, (int)panel->height);
+	for (y = 8; y < (int)panel->height; y += 96) {
+		for (x = 16; x < (int)panel->ram_width; x += 96) {
+			image_buffer_draw_image(strip, BENCH_BLACK_SQUARE, x, y - top, 64, 64);
+		}
+	}
+}
+
+/** @brief Frame to render into a full image buffer. */
+typedef struct {
+	/** @brief Image buffer of the frame. */
+	image_buffer* frame;
+	/** @brief Panel. */
+	const epd_panel* panel;
+} bench_frame;
+
+/**
+ * @brief Renders the whole frame as a single strip.
+ *
+ * @param[in] arg
+ *
+ *   (`bench_frame*`) Frame to render.
+ */
+static void bench_render_frame (void* arg) {
+	bench_frame* frame = (bench_frame*)arg;
+	image_buffer_clear_all(frame->frame);
+	bench_render(frame->frame, 0, (void*)frame->panel);
+}
+
+/**
+ * @brief Renders the frame in strips like `epd_draw_strips`, without
+ * sending them.
+ *
+ * @param[in] arg
+ *
+ *   (`const epd_panel*`) Panel.
+ */
+static void bench_render_strips (void* arg) {
+	const epd_panel* panel = (const epd_panel*)arg;
+	const uint32_t strip_height =
+		EPD_STREAM_BLOCK_SIZE / epd_panel_row_size(panel);
+	uint32_t top;
+	for (top = 0u; top < panel->height; top += strip_height) {
+		const uint32_t num_rows = (panel->height - top < strip_height) ?
+			(panel->height - top) :
+			strip_height;
+		image_buffer strip = image_buffer_initializer(
+			bench_strip_memory,
+			panel->ram_width,
+			num_rows);
+		image_buffer_clear_all(&strip);
+		bench_render(&strip, (int)top, (void*)panel);
+	}
+}
+
+/**
+ * @brief Prints a row of the table.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @param[in] method
+ *
+ *   Name of the way.
+ *
+ * @param[in] ram
+ *
+ *   Bytes of frames and blocks.
+ *
+ * @param[in] render_ns
+ *
+ *   Time to render a frame on the host in nanoseconds.
+ *
+ * @param[in] stats
+ *
+ *   Costs of uploading a frame.
+ */
+static void bench_print (
+		const epd_panel* panel,
+		const char* method,
+		size_t ram,
+		double render_ns,
+		const hal_linux_stats* stats)
+{
+	printf(
+		"%-9s | %-11s | %6u | %11.2f | %5u | %10.3f\n",
+		panel->name,
+		method,
+		(unsigned)ram,
+		render_ns * 1e-3,
+		(unsigned)stats->num_transactions,
+		stats->elapsed_ns * 1e-6);
+}
+
+/**
+ * @brief Attaches a simulated EPD of a given panel, and clears it.
+ *
+ * @param[out] epd
+ *
+ *   EPD.
+ *
+ * @param[out] sim
+ *
+ *   Simulated controller.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @param[in] panel_memory
+ *
+ *   Memory block of the copy of the RAM. `NULL` keeps no copy.
+ */
+static void bench_setup (
+		epd_device* epd,
+		epd_sim* sim,
+		const epd_panel* panel,
+		uint8_t* panel_memory)
+{
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	hal_spi_device spi;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(sim, BENCH_PIN_DC, BENCH_PIN_BUSY, NULL);
+	epd_sim_attach(sim, spi);
+	epd_device_init(
+		epd,
+		panel,
+		spi,
+		BENCH_PIN_DC,
+		BENCH_PIN_RST,
+		BENCH_PIN_BUSY,
+		panel_memory);
+	epd_configure_gpios(epd);
+	epd_reset(epd);
+	epd_initialize(epd);
+	epd_clear_all(epd);
+}
+
+/**
+ * @brief Uploads a frame in both ways on a given panel.
+ *
+ * @param[in] panel_id
+ *
+ *   Panel.
+ */
+static void bench_panel (epd_panel_id panel_id) {
+	const epd_panel* panel = &EPD_PANELS[panel_id];
+	const size_t frame_size = epd_panel_frame_size(panel);
+	image_buffer frame = image_buffer_initializer(
+		bench_frame_memory,
+		panel->ram_width,
+		panel->height);
+	const bench_frame full = { &frame, panel };
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	double render_ns;
+	epd_device epd;
+	epd_sim sim;
+	bench_setup(&epd, &sim, panel, bench_panel_memory);
+	render_ns = bench_measure(bench_render_frame, (void*)&full);
+	hal_linux_get_stats(&start);
+	bench_render_frame((void*)&full);
+	epd_draw_image_buffer_diff(&epd, &frame);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	bench_print(panel, "full buffer", 2u * frame_size, render_ns, &stats);
+	render_ns = bench_measure(bench_render_strips, (void*)panel);
+	bench_setup(&epd, &sim, panel, NULL);
+	hal_linux_get_stats(&start);
+	epd_draw_strips(&epd, bench_render, (void*)panel);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	bench_print(
+		panel,
+		"strips",
+		BENCH_NUM_STREAM_BLOCKS * EPD_STREAM_BLOCK_SIZE,
+		render_ns,
+		&stats);
+}
+
+int main (void) {
+	int panel_id;
+	printf("panel     | method      | RAM    | render (us) | trans | frame (ms)\n");
+	printf("----------|-------------|--------|-------------|-------|-----------\n");
+	for (panel_id = 0; panel_id < EPD_NUM_PANELS; ++panel_id) {
+		bench_panel((epd_panel_id)panel_id);
+	}
+	return 0;
+}
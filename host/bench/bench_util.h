@@ -0,0 +1,72 @@
+#ifndef _BENCH_UTIL_H
+#define _BENCH_UTIL_H
+
+/**
+ * @file bench_util.h
+ *
+ * Timing shared by the host benchmarks.
+ *
+ * Benchmarks of code measure the wall clock of the host, unlike tests and
+ * benchmarks of devices, which run on the simulated clock of the Linux HAL.
+ * So their numbers compare ways on the same host, and are not times on
+ * an ESP32.
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+/** @brief Minimum time to repeat a measured function in nanoseconds. */
+#define BENCH_MIN_NS  50000000
+
+/**
+ * @brief Current time of the monotonic clock of the host.
+ *
+ * @return
+ *
+ *   Time in nanoseconds.
+ */
+static inline int64_t bench_now_ns (void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * @brief Measures the time of a function.
+ *
+ * Calls `fn` in doubling batches until a batch takes `BENCH_MIN_NS`.
+ *
+ * @param[in] fn
+ *
+ *   Function to measure.
+ *
+ * @param[in] arg
+ *
+ *   Passed to `fn`.
+ *
+ * @return
+ *
+ *   Average time of a call in nanoseconds.
+ */
+static inline double bench_measure (void (*fn)(void* arg), void* arg) {
+	long num_calls = 1;
+	while (1) {
+		const int64_t start_ns = bench_now_ns();
+		int64_t elapsed_ns;
+		long i;
+		for (i = 0; i < num_calls; ++i) {
+			fn(arg);
+		}
+		elapsed_ns = bench_now_ns() - start_ns;
+		if (elapsed_ns >= BENCH_MIN_NS) {
+			return (double)elapsed_ns / num_calls;
+		}
+		num_calls *= 2;
+	}
+}
+
+#endif
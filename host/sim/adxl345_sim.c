@@ -0,0 +1,369 @@
+/**
+ * @file adxl345_sim.c
+ *
+ * Simulated ADXL345 on the Linux HAL.
+ *
+ * Addresses and bits are defined here again rather than taken from
+ * `adxl345.h`, so that the model does not share mistakes with the driver.
+ */
+
+#include "adxl345_sim.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "hal_linux.h"
+
+/** @brief Flag of a read in the command. */
+#define ADXL345_SIM_READ_FLAG  0x80u
+/** @brief Flag of a multibyte transaction in the command. */
+#define ADXL345_SIM_MB_FLAG  0x40u
+/** @brief Mask of an address in the command. */
+#define ADXL345_SIM_ADDRESS_MASK  0x3Fu
+
+/** @brief DEVID register. */
+#define ADXL345_SIM_REG_DEVID  0x00u
+/** @brief ACT_TAP_STATUS register. */
+#define ADXL345_SIM_REG_ACT_TAP_STATUS  0x2Bu
+/** @brief BW_RATE register. */
+#define ADXL345_SIM_REG_BW_RATE  0x2Cu
+/** @brief POWER_CTL register. */
+#define ADXL345_SIM_REG_POWER_CTL  0x2Du
+/** @brief INT_ENABLE register. */
+#define ADXL345_SIM_REG_INT_ENABLE  0x2Eu
+/** @brief INT_MAP register. */
+#define ADXL345_SIM_REG_INT_MAP  0x2Fu
+/** @brief INT_SOURCE register. */
+#define ADXL345_SIM_REG_INT_SOURCE  0x30u
+/** @brief DATA_FORMAT register. */
+#define ADXL345_SIM_REG_DATA_FORMAT  0x31u
+/** @brief DATAX0 register. */
+#define ADXL345_SIM_REG_DATAX0  0x32u
+/** @brief DATAZ1 register. */
+#define ADXL345_SIM_REG_DATAZ1  0x37u
+/** @brief FIFO_CTL register. */
+#define ADXL345_SIM_REG_FIFO_CTL  0x38u
+/** @brief FIFO_STATUS register. */
+#define ADXL345_SIM_REG_FIFO_STATUS  0x39u
+
+/** @brief Measure bit of POWER_CTL. */
+#define ADXL345_SIM_POWER_CTL_MEASURE  0x08u
+/** @brief Rate bits of BW_RATE. */
+#define ADXL345_SIM_BW_RATE_RATE_MASK  0x0Fu
+/** @brief INT_INVERT bit of DATA_FORMAT; interrupts are active low. */
+#define ADXL345_SIM_DATA_FORMAT_INT_INVERT  0x20u
+/** @brief Mode bits of FIFO_CTL. */
+#define ADXL345_SIM_FIFO_CTL_MODE_MASK  0xC0u
+/** @brief Bypass mode of FIFO_CTL. */
+#define ADXL345_SIM_FIFO_CTL_BYPASS  0x00u
+/** @brief FIFO mode of FIFO_CTL; stops taking samples when full. */
+#define ADXL345_SIM_FIFO_CTL_FIFO  0x40u
+/** @brief Samples bits of FIFO_CTL; i.e., the watermark. */
+#define ADXL345_SIM_FIFO_CTL_SAMPLES_MASK  0x1Fu
+
+/** @brief DATA_READY bit of INT_SOURCE. */
+#define ADXL345_SIM_INT_DATA_READY  0x80u
+/** @brief Watermark bit of INT_SOURCE. */
+#define ADXL345_SIM_INT_WATERMARK  0x02u
+/** @brief Overrun bit of INT_SOURCE. */
+#define ADXL345_SIM_INT_OVERRUN  0x01u
+/**
+ * @brief Bits of INT_SOURCE that follow the FIFO.
+ *
+ * Other bits are events, which reading INT_SOURCE clears.
+ */
+#define ADXL345_SIM_INT_FIFO_BITS \
+	(ADXL345_SIM_INT_DATA_READY | ADXL345_SIM_INT_WATERMARK | ADXL345_SIM_INT_OVERRUN)
+
+/** @brief Period of 3200Hz in nanoseconds. */
+#define ADXL345_SIM_3200HZ_PERIOD_NS  312500
+
+/** @brief Rate code of 3200Hz in BW_RATE. */
+#define ADXL345_SIM_RATE_3200HZ  0x0Fu
+
+/**
+ * @brief Whether a register is read-only.
+ *
+ * @param[in] address
+ *
+ *   Address of the register.
+ *
+ * @return
+ *
+ *   Whether writes to the register are ignored.
+ */
+static int adxl345_sim_is_read_only (uint8_t address) {
+	return (address == ADXL345_SIM_REG_DEVID) ||
+		(address == ADXL345_SIM_REG_ACT_TAP_STATUS) ||
+		(address == ADXL345_SIM_REG_INT_SOURCE) ||
+		((address >= ADXL345_SIM_REG_DATAX0) &&
+		 (address <= ADXL345_SIM_REG_DATAZ1)) ||
+		(address == ADXL345_SIM_REG_FIFO_STATUS) ||
+		(address > ADXL345_SIM_REG_FIFO_STATUS);
+}
+
+/**
+ * @brief Number of samples the FIFO holds in the current mode.
+ *
+ * @param[in] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @return
+ *
+ *   `1` in the bypass mode, which keeps only the output registers.
+ *   `ADXL345_SIM_FIFO_SIZE` otherwise.
+ */
+static size_t adxl345_sim_capacity (const adxl345_sim* sim) {
+	const uint8_t mode =
+		sim->registers[ADXL345_SIM_REG_FIFO_CTL] & ADXL345_SIM_FIFO_CTL_MODE_MASK;
+	return (mode == ADXL345_SIM_FIFO_CTL_BYPASS) ? 1u : ADXL345_SIM_FIFO_SIZE;
+}
+
+/**
+ * @brief Updates the output registers, FIFO_STATUS, INT_SOURCE and INT1.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated ADXL345.
+ */
+static void adxl345_sim_update (adxl345_sim* sim) {
+	const size_t watermark =
+		sim->registers[ADXL345_SIM_REG_FIFO_CTL] & ADXL345_SIM_FIFO_CTL_SAMPLES_MASK;
+	uint8_t int_source = sim->registers[ADXL345_SIM_REG_INT_SOURCE] &
+		(uint8_t)~(ADXL345_SIM_INT_DATA_READY | ADXL345_SIM_INT_WATERMARK);
+	uint8_t int1;
+	int level;
+	int i;
+	if (sim->num_entries > 0u) {
+		// output registers show the oldest sample, little-endian
+		for (i = 0; i < 3; ++i) {
+			const uint16_t acc = (uint16_t)sim->fifo[sim->fifo_head][i];
+			sim->registers[ADXL345_SIM_REG_DATAX0 + 2 * i] = (uint8_t)acc;
+			sim->registers[ADXL345_SIM_REG_DATAX0 + 2 * i + 1] = (uint8_t)(acc >> 8);
+		}
+		int_source |= ADXL345_SIM_INT_DATA_READY;
+	}
+	if ((watermark > 0u) && (sim->num_entries >= watermark)) {
+		int_source |= ADXL345_SIM_INT_WATERMARK;
+	}
+	sim->registers[ADXL345_SIM_REG_INT_SOURCE] = int_source;
+	sim->registers[ADXL345_SIM_REG_FIFO_STATUS] = (uint8_t)sim->num_entries;
+	if (sim->num_entries > sim->max_entries) {
+		sim->max_entries = sim->num_entries;
+	}
+	if (sim->int1_pin < 0) {
+		return;
+	}
+	// a 0 in INT_MAP maps an interrupt to INT1
+	int1 = int_source &
+		sim->registers[ADXL345_SIM_REG_INT_ENABLE] &
+		(uint8_t)~sim->registers[ADXL345_SIM_REG_INT_MAP];
+	level = (int1 != 0u);
+	if ((sim->registers[ADXL345_SIM_REG_DATA_FORMAT] &
+		ADXL345_SIM_DATA_FORMAT_INT_INVERT) != 0u)
+	{
+		level = !level;
+	}
+	hal_linux_set_input_level(sim->int1_pin, level);
+}
+
+/**
+ * @brief Pops the oldest sample from the FIFO.
+ *
+ * Also clears the overrun, as reading data does.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated ADXL345.
+ */
+static void adxl345_sim_pop (adxl345_sim* sim) {
+	sim->registers[ADXL345_SIM_REG_INT_SOURCE] &=
+		(uint8_t)~ADXL345_SIM_INT_OVERRUN;
+	if (sim->num_entries == 0u) {
+		return;
+	}
+	sim->fifo_head = (sim->fifo_head + 1u) % ADXL345_SIM_FIFO_SIZE;
+	--sim->num_entries;
+	++sim->num_popped;
+}
+
+/**
+ * @brief Takes a sample, and schedules the next one.
+ *
+ * Stops if the measure bit of POWER_CTL has been cleared.
+ *
+ * @param[in] arg
+ *
+ *   (`::adxl345_sim*`) Simulated ADXL345.
+ */
+static void adxl345_sim_take_sample (void* arg) {
+	adxl345_sim* sim = (adxl345_sim*)arg;
+	const uint8_t mode =
+		sim->registers[ADXL345_SIM_REG_FIFO_CTL] & ADXL345_SIM_FIFO_CTL_MODE_MASK;
+	int16_t accs[3];
+	int ret;
+	if ((sim->registers[ADXL345_SIM_REG_POWER_CTL] &
+		ADXL345_SIM_POWER_CTL_MEASURE) == 0u)
+	{
+		sim->sampling = 0;
+		return;
+	}
+	sim->sample_fn(sim->sample_user_data, sim->num_samples, accs);
+	++sim->num_samples;
+	if (sim->num_entries >= adxl345_sim_capacity(sim)) {
+		++sim->num_overrun_samples;
+		sim->registers[ADXL345_SIM_REG_INT_SOURCE] |= ADXL345_SIM_INT_OVERRUN;
+		// the FIFO mode keeps the oldest samples and loses the new one
+		if (mode != ADXL345_SIM_FIFO_CTL_FIFO) {
+			sim->fifo_head = (sim->fifo_head + 1u) % ADXL345_SIM_FIFO_SIZE;
+			--sim->num_entries;
+		}
+	}
+	if (sim->num_entries < adxl345_sim_capacity(sim)) {
+		memcpy(
+			sim->fifo[(sim->fifo_head + sim->num_entries) % ADXL345_SIM_FIFO_SIZE],
+			accs,
+			sizeof(accs));
+		++sim->num_entries;
+	}
+	adxl345_sim_update(sim);
+	sim->next_sample_ns += adxl345_sim_period_ns(sim);
+	ret = hal_linux_schedule(sim->next_sample_ns, adxl345_sim_take_sample, sim);
+	assert(ret == 0);
+	(void)ret;
+}
+
+/**
+ * @brief Applies a write to a register.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] address
+ *
+ *   Address of the register.
+ *
+ * @param[in] value
+ *
+ *   Written value.
+ */
+static void adxl345_sim_write (adxl345_sim* sim, uint8_t address, uint8_t value) {
+	int ret;
+	++sim->num_writes;
+	if (adxl345_sim_is_read_only(address)) {
+		return;
+	}
+	sim->registers[address] = value;
+	if ((address == ADXL345_SIM_REG_FIFO_CTL) &&
+		((value & ADXL345_SIM_FIFO_CTL_MODE_MASK) == ADXL345_SIM_FIFO_CTL_BYPASS))
+	{
+		// the bypass mode clears the FIFO
+		sim->num_entries = 0u;
+	}
+	if ((address == ADXL345_SIM_REG_POWER_CTL) &&
+		((value & ADXL345_SIM_POWER_CTL_MEASURE) != 0u) &&
+		!sim->sampling)
+	{
+		sim->sampling = 1;
+		sim->next_sample_ns = hal_linux_get_time_ns() + adxl345_sim_period_ns(sim);
+		ret = hal_linux_schedule(sim->next_sample_ns, adxl345_sim_take_sample, sim);
+		assert(ret == 0);
+		(void)ret;
+	}
+}
+
+/**
+ * @brief Answers a transaction to a simulated ADXL345.
+ *
+ * See `::hal_linux_spi_responder`.
+ */
+static void adxl345_sim_respond (
+		void* user_data,
+		const hal_spi_transaction* trans,
+		const uint8_t* tx,
+		uint8_t* rx,
+		size_t num_bytes)
+{
+	adxl345_sim* sim = (adxl345_sim*)user_data;
+	const uint8_t command = (uint8_t)trans->cmd;
+	const uint8_t first = command & ADXL345_SIM_ADDRESS_MASK;
+	int reads_data = 0;
+	int reads_int_source = 0;
+	size_t i;
+	++sim->num_transactions;
+	for (i = 0; i < num_bytes; ++i) {
+		const uint8_t address = ((command & ADXL345_SIM_MB_FLAG) != 0u) ?
+			(uint8_t)((first + i) & ADXL345_SIM_ADDRESS_MASK) :
+			first;
+		if ((command & ADXL345_SIM_READ_FLAG) != 0u) {
+			if (rx != NULL) {
+				rx[i] = sim->registers[address];
+			}
+			if ((address >= ADXL345_SIM_REG_DATAX0) &&
+				(address <= ADXL345_SIM_REG_DATAZ1))
+			{
+				reads_data = 1;
+			}
+			if (address == ADXL345_SIM_REG_INT_SOURCE) {
+				reads_int_source = 1;
+			}
+		} else if (tx != NULL) {
+			adxl345_sim_write(sim, address, tx[i]);
+		}
+	}
+	if (reads_int_source) {
+		sim->registers[ADXL345_SIM_REG_INT_SOURCE] &= ADXL345_SIM_INT_FIFO_BITS;
+	}
+	// the FIFO pops when the transaction ends
+	if (reads_data) {
+		adxl345_sim_pop(sim);
+	}
+	adxl345_sim_update(sim);
+}
+
+void adxl345_sim_init (adxl345_sim* sim, int int1_pin) {
+	memset(sim, 0, sizeof(adxl345_sim));
+	sim->int1_pin = int1_pin;
+	sim->sample_fn = adxl345_sim_counter_sample;
+	// reset values in the datasheet; INT_SOURCE follows the FIFO
+	sim->registers[ADXL345_SIM_REG_DEVID] = ADXL345_SIM_DEVID;
+	sim->registers[ADXL345_SIM_REG_BW_RATE] = 0x0Au;
+	if (int1_pin >= 0) {
+		hal_gpio_set_input(int1_pin);
+	}
+	adxl345_sim_update(sim);
+}
+
+void adxl345_sim_attach (adxl345_sim* sim, hal_spi_device spi) {
+	hal_linux_set_spi_responder(spi, adxl345_sim_respond, sim);
+}
+
+void adxl345_sim_raise_events (adxl345_sim* sim, uint8_t events) {
+	sim->registers[ADXL345_SIM_REG_INT_SOURCE] |=
+		events & (uint8_t)~ADXL345_SIM_INT_FIFO_BITS;
+	adxl345_sim_update(sim);
+}
+
+int64_t adxl345_sim_period_ns (const adxl345_sim* sim) {
+	const uint8_t rate =
+		sim->registers[ADXL345_SIM_REG_BW_RATE] & ADXL345_SIM_BW_RATE_RATE_MASK;
+	return (int64_t)ADXL345_SIM_3200HZ_PERIOD_NS << (ADXL345_SIM_RATE_3200HZ - rate);
+}
+
+int64_t adxl345_sim_sample_time_ns (const adxl345_sim* sim, uint64_t index) {
+	return sim->next_sample_ns -
+		(int64_t)(sim->num_samples - index) * adxl345_sim_period_ns(sim);
+}
+
+void adxl345_sim_counter_sample (void* user_data, uint64_t index, int16_t* accs) {
+	(void)user_data;
+	accs[0] = (int16_t)(uint16_t)index;
+	accs[1] = (int16_t)(uint16_t)(index >> 16);
+	accs[2] = (int16_t)(uint16_t)~index;
+}
+
+uint32_t adxl345_sim_counter_index (const int16_t* accs) {
+	return (uint32_t)(uint16_t)accs[0] | ((uint32_t)(uint16_t)accs[1] << 16);
+}
@@ -0,0 +1,205 @@
+#ifndef _ADXL345_SIM_H
+#define _ADXL345_SIM_H
+
+/**
+ * @file adxl345_sim.h
+ *
+ * Simulated ADXL345 on the Linux HAL, modeled at the level of registers.
+ *
+ * Takes samples at the output data rate of BW_RATE while POWER_CTL has
+ * the measure bit, and keeps them in a FIFO as the mode of FIFO_CTL says.
+ * Reading DATAX0 to DATAZ1 pops the oldest sample after the transaction.
+ * INT_SOURCE shows the data ready, watermark and overrun conditions, and
+ * INT1 goes HIGH while an enabled interrupt mapped to it is set.
+ * Activity, taps and free fall are not detected from samples; a test raises
+ * them with `::adxl345_sim_raise_events` instead.
+ *
+ * By default the `n`-th sample is `{ n & 0xFFFF, n >> 16, ~n & 0xFFFF }`,
+ * so that a test can tell dropped and reordered samples.
+ * The trigger mode of the FIFO behaves like the stream mode.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Number of registers. */
+#define ADXL345_SIM_NUM_REGISTERS  0x40u
+
+/** @brief Number of samples the FIFO holds. */
+#define ADXL345_SIM_FIFO_SIZE  32u
+
+/** @brief Value of DEVID. */
+#define ADXL345_SIM_DEVID  0xE5u
+
+/**
+ * @brief Generates a sample.
+ *
+ * @param[in] user_data
+ *
+ *   `sample_user_data` of the simulated ADXL345.
+ *
+ * @param[in] index
+ *
+ *   Index of the sample from `0`.
+ *
+ * @param[out] accs
+ *
+ *   Receives acceleration of x, y and z.
+ */
+typedef void (*adxl345_sim_sample_fn)(
+		void* user_data,
+		uint64_t index,
+		int16_t* accs);
+
+/**
+ * @brief Simulated ADXL345.
+ *
+ * Initialize with `::adxl345_sim_init`.
+ */
+typedef struct adxl345_sim_t {
+	/** @brief GPIO# for INT1. */
+	int int1_pin;
+	/** @brief Registers. */
+	uint8_t registers[ADXL345_SIM_NUM_REGISTERS];
+	/** @brief Samples in the FIFO; the oldest at `fifo_head`. */
+	int16_t fifo[ADXL345_SIM_FIFO_SIZE][3];
+	/** @brief Index of the oldest sample in `fifo`. */
+	size_t fifo_head;
+	/** @brief Number of samples in `fifo`. */
+	size_t num_entries;
+	/** @brief Generates samples. `NULL` generates counters. */
+	adxl345_sim_sample_fn sample_fn;
+	/** @brief Passed to `sample_fn`. */
+	void* sample_user_data;
+	/** @brief Whether a sample is scheduled. */
+	int sampling;
+	/**
+	 * @brief Time of the next sample in nanoseconds.
+	 *
+	 * Counted from the previous one, so that samples keep the output data
+	 * rate even if the clock runs past them during a transaction.
+	 */
+	int64_t next_sample_ns;
+	/** @brief Number of samples taken. */
+	uint64_t num_samples;
+	/** @brief Number of samples popped from the FIFO. */
+	uint64_t num_popped;
+	/** @brief Number of samples lost as the FIFO was full. */
+	uint64_t num_overrun_samples;
+	/** @brief Largest number of samples the FIFO has held. */
+	size_t max_entries;
+	/** @brief Number of register writes. */
+	size_t num_writes;
+	/** @brief Number of transactions. */
+	size_t num_transactions;
+} adxl345_sim;
+
+/**
+ * @brief Initializes a simulated ADXL345.
+ *
+ * Registers are reset as the datasheet says, and INT1 is driven LOW.
+ * Attach it to a device with `::adxl345_sim_attach`.
+ *
+ * @param[out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] int1_pin
+ *
+ *   GPIO# for INT1. Negative if INT1 is not connected.
+ */
+void adxl345_sim_init (adxl345_sim* sim, int int1_pin);
+
+/**
+ * @brief Makes a simulated ADXL345 answer an SPI device.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] spi
+ *
+ *   SPI device of the ADXL345.
+ */
+void adxl345_sim_attach (adxl345_sim* sim, hal_spi_device spi);
+
+/**
+ * @brief Raises events in INT_SOURCE.
+ *
+ * Events are set whether or not they are enabled, and INT1 follows
+ * INT_ENABLE and INT_MAP. Reading INT_SOURCE clears them.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] events
+ *
+ *   Bits of INT_SOURCE; e.g., `0x10` for activity.
+ *   Data ready, watermark and overrun follow the FIFO, and are ignored.
+ */
+void adxl345_sim_raise_events (adxl345_sim* sim, uint8_t events);
+
+/**
+ * @brief Sampling period of the current output data rate.
+ *
+ * @param[in] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @return
+ *
+ *   Period in nanoseconds; `1 / (3200Hz / 2^(15 - rate))`.
+ */
+int64_t adxl345_sim_period_ns (const adxl345_sim* sim);
+
+/**
+ * @brief Time when a sample was taken.
+ *
+ * Valid for samples since the measure bit was last set.
+ *
+ * @param[in] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] index
+ *
+ *   Index of the sample from `0`.
+ *
+ * @return
+ *
+ *   Time in nanoseconds.
+ */
+int64_t adxl345_sim_sample_time_ns (const adxl345_sim* sim, uint64_t index);
+
+/**
+ * @brief Generates the default `n`-th sample.
+ *
+ * See `::adxl345_sim_sample_fn`.
+ */
+void adxl345_sim_counter_sample (void* user_data, uint64_t index, int16_t* accs);
+
+/**
+ * @brief Recovers the index of a sample by `::adxl345_sim_counter_sample`.
+ *
+ * @param[in] accs
+ *
+ *   Acceleration of the sample.
+ *
+ * @return
+ *
+ *   Index of the sample modulo `2^32`.
+ */
+uint32_t adxl345_sim_counter_index (const int16_t* accs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file epd_sim.c
+ *
+ * Simulated SSD168x controller on the Linux HAL.
+ */
+
+#include "epd_sim.h"
+
+#include <assert.h>
+
+#include "hal_linux.h"
+
+/** @brief Software Reset command. */
+#define EPD_SIM_COMMAND_SW_RESET  0x12u
+/** @brief Master Activation command. */
+#define EPD_SIM_COMMAND_MASTER_ACTIVATION  0x20u
+/** @brief Display Update Control 2 command. */
+#define EPD_SIM_COMMAND_DISPLAY_UPDATE_CONTROL_2  0x22u
+
+/**
+ * @brief Drives BUSY LOW when an operation finishes.
+ *
+ * @param[in] arg
+ *
+ *   (`::epd_sim*`) Simulated controller.
+ */
+static void epd_sim_release_busy (void* arg) {
+	epd_sim* sim = (epd_sim*)arg;
+	sim->busy_total_ns += hal_linux_get_time_ns() - sim->busy_start_ns;
+	hal_linux_set_input_level(sim->busy_pin, 0);
+}
+
+/**
+ * @brief Drives BUSY HIGH for a given time.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated controller.
+ *
+ * @param[in] ns
+ *
+ *   Time to stay HIGH in nanoseconds.
+ */
+static void epd_sim_hold_busy (epd_sim* sim, int64_t ns) {
+	int ret;
+	sim->busy_start_ns = hal_linux_get_time_ns();
+	hal_linux_set_input_level(sim->busy_pin, 1);
+	ret = hal_linux_schedule(
+		sim->busy_start_ns + ns,
+		epd_sim_release_busy,
+		sim);
+	assert(ret == 0);
+	(void)ret;
+}
+
+/**
+ * @brief Answers a transaction to a simulated controller.
+ *
+ * See `::hal_linux_spi_responder`.
+ */
+static void epd_sim_respond (
+		void* user_data,
+		const hal_spi_transaction* trans,
+		const uint8_t* tx,
+		uint8_t* rx,
+		size_t num_bytes)
+{
+	epd_sim* sim = (epd_sim*)user_data;
+	size_t i;
+	(void)trans;
+	(void)rx;
+	if (tx == NULL) {
+		return;
+	}
+	if (hal_gpio_get_level(sim->dc_pin) == 0) {
+		// a command is a single byte
+		for (i = 0; i < num_bytes; ++i) {
+			epd_sim_flush(sim);
+			sim->has_command = 1;
+			sim->command = tx[i];
+			++sim->num_commands;
+			if (tx[i] == EPD_SIM_COMMAND_SW_RESET) {
+				epd_sim_hold_busy(sim, sim->reset_ns);
+			} else if (tx[i] == EPD_SIM_COMMAND_MASTER_ACTIVATION) {
+				++sim->num_activations;
+				epd_sim_hold_busy(sim, sim->refresh_ns);
+			}
+		}
+		return;
+	}
+	for (i = 0; i < num_bytes; ++i) {
+		if (sim->num_data_bytes < EPD_SIM_MAX_TRACED_BYTES) {
+			sim->data[sim->num_data_bytes] = tx[i];
+		}
+		if ((sim->num_data_bytes == 0u) &&
+			(sim->command == EPD_SIM_COMMAND_DISPLAY_UPDATE_CONTROL_2))
+		{
+			sim->sequence = tx[i];
+		}
+		++sim->num_data_bytes;
+		sim->data_sum += tx[i];
+	}
+	sim->num_data_total += num_bytes;
+}
+
+void epd_sim_init (epd_sim* sim, int dc_pin, int busy_pin, FILE* trace) {
+	sim->dc_pin = dc_pin;
+	sim->busy_pin = busy_pin;
+	sim->reset_ns = EPD_SIM_DEFAULT_RESET_NS;
+	sim->refresh_ns = EPD_SIM_DEFAULT_REFRESH_NS;
+	sim->trace = trace;
+	sim->has_command = 0;
+	sim->command = 0u;
+	sim->num_data_bytes = 0u;
+	sim->data_sum = 0u;
+	sim->num_commands = 0u;
+	sim->num_data_total = 0u;
+	sim->num_activations = 0u;
+	sim->sequence = 0u;
+	sim->busy_start_ns = 0;
+	sim->busy_total_ns = 0;
+	hal_gpio_set_input(busy_pin);
+	hal_linux_set_input_level(busy_pin, 0);
+}
+
+void epd_sim_attach (epd_sim* sim, hal_spi_device spi) {
+	hal_linux_set_spi_responder(spi, epd_sim_respond, sim);
+}
+
+void epd_sim_flush (epd_sim* sim) {
+	size_t i;
+	if (!sim->has_command) {
+		return;
+	}
+	if (sim->trace != NULL) {
+		fprintf(sim->trace, "%02X", (unsigned)sim->command);
+		if (sim->num_data_bytes <= EPD_SIM_MAX_TRACED_BYTES) {
+			for (i = 0; i < sim->num_data_bytes; ++i) {
+				fprintf(sim->trace, " %02X", (unsigned)sim->data[i]);
+			}
+		} else {
+			fprintf(
+				sim->trace,
+				" [%u bytes, sum 0x%08X]",
+				(unsigned)sim->num_data_bytes,
+				(unsigned)sim->data_sum);
+		}
+		fprintf(sim->trace, "\n");
+	}
+	sim->has_command = 0;
+	sim->num_data_bytes = 0u;
+	sim->data_sum = 0u;
+}
@@ -0,0 +1,131 @@
+#ifndef _EPD_SIM_H
+#define _EPD_SIM_H
+
+/**
+ * @file epd_sim.h
+ *
+ * Simulated SSD168x controller on the Linux HAL.
+ *
+ * Tells commands from data by the level of the DC pin, and drives the BUSY
+ * pin after a software reset and a master activation as the controller does.
+ * Every command is written to a trace with its data, so that a test can
+ * compare what a driver sent with a golden trace.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Number of data bytes of a command written to a trace as they are. */
+#define EPD_SIM_MAX_TRACED_BYTES  8u
+
+/** @brief Time BUSY stays HIGH after a software reset (ns). */
+#define EPD_SIM_DEFAULT_RESET_NS  10000000
+
+/** @brief Time BUSY stays HIGH after a master activation (ns). */
+#define EPD_SIM_DEFAULT_REFRESH_NS  2000000000
+
+/**
+ * @brief Simulated SSD168x controller.
+ *
+ * Initialize with `::epd_sim_init`.
+ */
+typedef struct epd_sim_t {
+	/** @brief GPIO# for DC. */
+	int dc_pin;
+	/** @brief GPIO# for BUSY. */
+	int busy_pin;
+	/** @brief Time BUSY stays HIGH after a software reset (ns). */
+	int64_t reset_ns;
+	/** @brief Time BUSY stays HIGH after a master activation (ns). */
+	int64_t refresh_ns;
+	/**
+	 * @brief Trace of commands. `NULL` writes no trace.
+	 *
+	 * A line per command; e.g., `22 F7` or
+	 * `24 [5000 bytes, sum 0x0004C4B4]` for long data.
+	 */
+	FILE* trace;
+	/** @brief Whether a command has been received. */
+	int has_command;
+	/** @brief Last command. */
+	uint8_t command;
+	/** @brief Number of data bytes of the last command. */
+	size_t num_data_bytes;
+	/** @brief First data bytes of the last command. */
+	uint8_t data[EPD_SIM_MAX_TRACED_BYTES];
+	/** @brief Sum of the data bytes of the last command. */
+	uint32_t data_sum;
+	/** @brief Number of commands received. */
+	size_t num_commands;
+	/** @brief Number of data bytes received. */
+	size_t num_data_total;
+	/** @brief Number of master activations. */
+	size_t num_activations;
+	/** @brief Data of the last Display Update Control 2 command. */
+	uint8_t sequence;
+	/** @brief Time when BUSY went HIGH last time (ns). */
+	int64_t busy_start_ns;
+	/** @brief Total time BUSY was HIGH (ns). */
+	int64_t busy_total_ns;
+} epd_sim;
+
+/**
+ * @brief Initializes a simulated controller.
+ *
+ * Drives BUSY LOW. Attach it to a device with `::epd_sim_attach`.
+ *
+ * @param[out] sim
+ *
+ *   Simulated controller.
+ *
+ * @param[in] dc_pin
+ *
+ *   GPIO# for DC.
+ *
+ * @param[in] busy_pin
+ *
+ *   GPIO# for BUSY.
+ *
+ * @param[in] trace
+ *
+ *   Trace of commands. `NULL` writes no trace.
+ */
+void epd_sim_init (epd_sim* sim, int dc_pin, int busy_pin, FILE* trace);
+
+/**
+ * @brief Makes a simulated controller answer an SPI device.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated controller.
+ *
+ * @param[in] spi
+ *
+ *   SPI device of the EPD.
+ */
+void epd_sim_attach (epd_sim* sim, hal_spi_device spi);
+
+/**
+ * @brief Writes the last command to the trace.
+ *
+ * Commands are written when the next one comes, so call this function
+ * before the trace is read.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated controller.
+ */
+void epd_sim_flush (epd_sim* sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Writes golden results of dithering by ``make_binary_image.py``.
+
+``test_dither`` dithers the same grayscale images with ``dither.h``, and
+compares the rows bit by bit.
+
+The file is laid out as follows. All integers are little-endian.
+
+- ``b'DITH'``: magic.
+- ``uint32_t``: number of images.
+- for each image,
+    - ``uint16_t`` width and ``uint16_t`` height.
+    - 8-bit grayscale pixels, ``width * height`` bytes.
+    - packed rows thresholded at ``127``, ordered dithered and
+      Floyd-Steinberg dithered, ``height * ((width + 7) // 8)`` bytes each.
+"""
+
+import argparse
+import importlib
+import struct
+import sys
+import numpy as np
+
+
+def synthetic_images():
+    """Generates grayscale images that stress edge cases.
+
+    :return: list of 2D arrays of 8-bit grayscale pixels.
+    :rtype: list
+    """
+    rng = np.random.default_rng(9)
+    gradient = np.tile(np.arange(200, dtype=np.uint8), (64, 1))
+    noise = rng.integers(0, 256, (50, 123), dtype=np.uint8)
+    # the largest errors are diffused over the widest row
+    extremes = rng.choice(np.array([0, 127, 128, 255], dtype=np.uint8),
+                          (16, 800))
+    return [gradient, noise, extremes]
+
+
+def main():
+    """Writes the golden file."""
+    arg_parser = argparse.ArgumentParser(
+        description='Write golden results of dithering')
+    arg_parser.add_argument(
+        'script_dir', metavar='SCRIPT_DIR', type=str,
+        help='directory of make_binary_image.py')
+    arg_parser.add_argument(
+        'output', metavar='OUTPUT', type=str,
+        help='path to the golden file')
+    arg_parser.add_argument(
+        'image_paths', metavar='IMAGE', type=str, nargs='*',
+        help='images to be dithered in addition to synthetic ones')
+    args = arg_parser.parse_args()
+    sys.path.insert(0, args.script_dir)
+    make_binary_image = importlib.import_module('make_binary_image')
+    images = synthetic_images()
+    for image_path in make_binary_image.collect_image_paths(args.image_paths):
+        images.append(make_binary_image.to_gray(
+            make_binary_image.load_channel(image_path)))
+    with open(args.output, 'wb') as out:
+        out.write(b'DITH')
+        out.write(struct.pack('<I', len(images)))
+        for gray in images:
+            height, width = gray.shape
+            out.write(struct.pack('<HH', width, height))
+            out.write(np.ascontiguousarray(gray, dtype=np.uint8).tobytes())
+            out.write(np.packbits(gray > 127, axis=1).tobytes())
+            out.write(make_binary_image.ordered_dither(gray).tobytes())
+            out.write(
+                make_binary_image.floyd_steinberg_dither(gray).tobytes())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Writes golden results of the stages in ``dsp.h`` by ``dsp_reference.py``.
+
+``test_dsp`` processes the same input with ``dsp.c``, and compares the
+outputs value by value.
+
+The file is laid out as follows. All integers are little-endian.
+
+- ``b'DSPG'``: magic.
+- ``uint32_t``: number of input values, then ``int16_t`` input values.
+- ``uint32_t``: number of cases.
+- for each case, ``uint8_t`` kind followed by
+    - ``0`` (CIC): ``uint8_t`` order and ``uint8_t`` log2 of the decimation
+      factor.
+    - ``1`` (biquad cascade): ``uint8_t`` number of stages, then ``double``
+      b0, b1, b2, a1 and a2 of each stage before conversion into Q2.14.
+    - ``2`` (window): ``uint32_t`` length.
+
+  then ``uint32_t`` number of outputs, and the outputs; ``int16_t`` values
+  for CIC and biquad cases, and ``int16_t`` mean, ``uint16_t`` RMS and
+  ``uint16_t`` peak for window cases.
+"""
+
+import argparse
+import importlib
+import math
+import random
+import struct
+import sys
+
+
+SEGMENT_SIZE = 8192
+"""Number of values of a segment of the input."""
+
+CIC_CASES = [(1, 1), (3, 4), (4, 4), (2, 8), (1, 15)]
+"""``(order, log2_factor)`` of CIC cases; ``(3, 4)`` is the firmware's."""
+
+WINDOW_CASES = [1, 200, 4096, 65536]
+"""Lengths of window cases; ``200`` is the firmware's."""
+
+
+def biquad_cases(dsp_reference):
+    """Lists biquad cascades to test.
+
+    :param dsp_reference: ``dsp_reference`` module.
+    :type dsp_reference: module
+
+    :return: list of lists of ``(b0, b1, b2, a1, a2)`` real numbers.
+    :rtype: list
+    """
+    largest = 32767.0 / 16384.0
+    return [
+        dsp_reference.FIRMWARE_BIQUADS[:1],
+        dsp_reference.FIRMWARE_BIQUADS,
+        # halves; rounding ties of negative values
+        [(0.5, 0.0, 0.0, 0.0, 0.0)],
+        # resonates at a quarter of the rate, and saturates
+        [(0.5, 0.0, -0.5, 0.0, 0.98)],
+        # coefficients at both ends; grows until it saturates
+        [(-2.0, largest, -2.0, -2.0, largest)],
+    ]
+
+
+def make_input():
+    """Generates input values that stress edge cases.
+
+    :return: ``int16_t`` values.
+    :rtype: list
+    """
+    rng = random.Random(15)
+    xs = []
+    for i in range(SEGMENT_SIZE):
+        # gravity at full resolution, a 5Hz vibration at 3200Hz and noise
+        xs.append(256 + int(8000 * math.sin(2 * math.pi * 5 * i / 3200)) +
+                  rng.randint(-500, 500))
+    xs.extend(rng.randint(-0x8000, 0x7FFF) for _ in range(SEGMENT_SIZE))
+    xs.extend(0x7FFF if (i // 37) % 2 else -0x8000
+              for i in range(SEGMENT_SIZE))
+    xs.extend([0] * SEGMENT_SIZE)
+    # a chirp up to half of the rate
+    xs.extend(int(30000 * math.sin(math.pi * i * i / (2 * SEGMENT_SIZE)))
+              for i in range(SEGMENT_SIZE))
+    xs.extend([-0x8000] * SEGMENT_SIZE)
+    xs.extend([0x7FFF] * SEGMENT_SIZE)
+    xs.extend(rng.choice([-0x8000, 0x7FFF]) if i % 97 == 0 else 0
+              for i in range(SEGMENT_SIZE))
+    xs.extend(rng.randint(-3, 3) for _ in range(SEGMENT_SIZE // 2))
+    return xs
+
+
+def main():
+    """Writes the golden file."""
+    arg_parser = argparse.ArgumentParser(
+        description='Write golden results of the stages in dsp.h')
+    arg_parser.add_argument(
+        'script_dir', metavar='SCRIPT_DIR', type=str,
+        help='directory of dsp_reference.py')
+    arg_parser.add_argument(
+        'output', metavar='OUTPUT', type=str,
+        help='path to the golden file')
+    args = arg_parser.parse_args()
+    sys.path.insert(0, args.script_dir)
+    dsp_reference = importlib.import_module('dsp_reference')
+    xs = make_input()
+    cases = []
+    for order, log2_factor in CIC_CASES:
+        ys = dsp_reference.cic(order, log2_factor, xs)
+        cases.append(struct.pack('<BBB', 0, order, log2_factor) +
+                     struct.pack('<I%dh' % len(ys), len(ys), *ys))
+    for stages in biquad_cases(dsp_reference):
+        ys = dsp_reference.biquad_cascade(
+            [tuple(map(dsp_reference.q14, c)) for c in stages], xs)
+        header = struct.pack('<BB', 1, len(stages))
+        for coefficients in stages:
+            header += struct.pack('<5d', *coefficients)
+        cases.append(header + struct.pack('<I%dh' % len(ys), len(ys), *ys))
+    for length in WINDOW_CASES:
+        features = dsp_reference.window(length, xs)
+        case = struct.pack('<BII', 2, length, len(features))
+        for mean, rms, peak in features:
+            case += struct.pack('<hHH', mean, rms, peak)
+        cases.append(case)
+    with open(args.output, 'wb') as out:
+        out.write(b'DSPG')
+        out.write(struct.pack('<I%dh' % len(xs), len(xs), *xs))
+        out.write(struct.pack('<I', len(cases)))
+        for case in cases:
+            out.write(case)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,165 @@
+/**
+ * @file test_adxl345_config.c
+ *
+ * Applies every `adxl345_config` to a simulated ADXL345, and checks the
+ * registers it ends up with and the SPI clock chosen for it.
+ */
+
+#include "adxl345.h"
+#include "hal_linux.h"
+
+#include "adxl345_sim.h"
+#include "test_util.h"
+
+/** @brief Watermark of the FIFO. Same as `spi_adxl345_main.c`. */
+#define TEST_WATERMARK  16u
+
+/**
+ * @brief Adds an SPI device for a given configuration.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ *
+ * @return
+ *
+ *   SPI device.
+ */
+static hal_spi_device test_add_device (const adxl345_config* config) {
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		adxl345_spi_clock_hz(config, TEST_WATERMARK),
+		8,
+		0u);
+	hal_spi_device spi;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	TEST_CHECK(spi != NULL);
+	return spi;
+}
+
+/**
+ * @brief Checks the SPI clock chosen for a given configuration.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ *
+ * @param[in] watermark
+ *
+ *   Watermark of the FIFO. `0` if the FIFO is not used.
+ */
+static void test_check_clock (const adxl345_config* config, uint32_t watermark) {
+	const int clock_hz = adxl345_spi_clock_hz(config, watermark);
+	const uint64_t bits = adxl345_bus_bits_per_second(config, watermark);
+	TEST_CHECK(clock_hz <= ADXL345_MAX_SPI_CLOCK_HZ);
+	if (config->rate >= ADXL345_RATE_1600HZ) {
+		TEST_CHECK(clock_hz >= ADXL345_MIN_FAST_SPI_CLOCK_HZ);
+	}
+	TEST_CHECK(bits * 100u <= (uint64_t)clock_hz * ADXL345_MAX_BUS_UTILIZATION);
+	// the slowest clock that is enough
+	if ((clock_hz > 1000000) &&
+		((config->rate < ADXL345_RATE_1600HZ) || (clock_hz > 2000000)))
+	{
+		TEST_CHECK(bits * 100u > (uint64_t)(clock_hz / 2) * ADXL345_MAX_BUS_UTILIZATION);
+	}
+}
+
+/**
+ * @brief Applies a configuration, and checks the registers.
+ *
+ * @param[in] config
+ *
+ *   Configuration of the ADXL345.
+ */
+static void test_configure (const adxl345_config* config) {
+	const hal_spi_device spi = test_add_device(config);
+	const uint8_t bw_rate = (uint8_t)config->rate |
+		(config->low_power ? ADXL345_BW_RATE_LOW_POWER : 0u);
+	const uint8_t data_format = (uint8_t)config->range |
+		(config->full_resolution ? ADXL345_DATA_FORMAT_FULL_RES : 0u);
+	adxl345_sim sim;
+	const hal_linux_event* events;
+	size_t num_events;
+	adxl345_sim_init(&sim, -1);
+	adxl345_sim_attach(&sim, spi);
+	TEST_CHECK_EQUAL(adxl345_configure(spi, config), HAL_OK);
+	TEST_CHECK_EQUAL(sim.registers[ADXL345_REG_BW_RATE], bw_rate);
+	TEST_CHECK_EQUAL(sim.registers[ADXL345_REG_DATA_FORMAT], data_format);
+	// writes BW_RATE and DATA_FORMAT, then reads them back; nothing else
+	events = hal_linux_get_events(&num_events);
+	TEST_CHECK_EQUAL(num_events, 4u);
+	TEST_CHECK_EQUAL(sim.num_writes, 2u);
+	if (num_events == 4u) {
+		TEST_CHECK_EQUAL(events[0].command_or_pin, ADXL345_REG_BW_RATE);
+		TEST_CHECK_EQUAL(events[1].command_or_pin, ADXL345_REG_DATA_FORMAT);
+		TEST_CHECK_EQUAL(
+			events[2].command_or_pin,
+			ADXL345_REG_READ_FLAG | ADXL345_REG_BW_RATE);
+		TEST_CHECK_EQUAL(
+			events[3].command_or_pin,
+			ADXL345_REG_READ_FLAG | ADXL345_REG_DATA_FORMAT);
+	}
+	// the simulated ADXL345 samples at the rate the driver assumes,
+	// which is truncated to mHz below 1Hz
+	TEST_CHECK_EQUAL(
+		(int64_t)1000000000000 / adxl345_sim_period_ns(&sim),
+		adxl345_odr_millihz(config));
+	test_check_clock(config, 0u);
+	test_check_clock(config, TEST_WATERMARK);
+}
+
+/** @brief Every configuration is written and read back. */
+static void test_configure_all (void) {
+	adxl345_config config;
+	int rate;
+	int range;
+	int full_resolution;
+	int low_power;
+	size_t num_configs = 0u;
+	for (rate = ADXL345_RATE_0_10HZ; rate <= ADXL345_RATE_3200HZ; ++rate) {
+		for (range = ADXL345_RANGE_2G; range <= ADXL345_RANGE_16G; ++range) {
+			for (full_resolution = 0; full_resolution <= 1; ++full_resolution) {
+				for (low_power = 0; low_power <= 1; ++low_power) {
+					if (low_power &&
+						((rate < ADXL345_RATE_12_5HZ) || (rate > ADXL345_RATE_400HZ)))
+					{
+						continue;
+					}
+					config.rate = (adxl345_rate)rate;
+					config.range = (adxl345_range)range;
+					config.full_resolution = full_resolution;
+					config.low_power = low_power;
+					test_configure(&config);
+					++num_configs;
+				}
+			}
+		}
+	}
+	TEST_CHECK_EQUAL(num_configs, (16u + 6u) * 4u * 2u);
+}
+
+/** @brief A device that does not hold the values is reported. */
+static void test_configure_no_device (void) {
+	const adxl345_config config =
+		adxl345_config_initializer(ADXL345_RATE_3200HZ, ADXL345_RANGE_16G, 1, 0);
+	// nothing answers; every register reads 0
+	const hal_spi_device spi = test_add_device(&config);
+	TEST_CHECK_EQUAL(adxl345_configure(spi, &config), HAL_ERR_INVALID_RESPONSE);
+}
+
+/** @brief Configurations of `spi_adxl345_main.c` get the clocks in the README. */
+static void test_default_clocks (void) {
+	const adxl345_config polling =
+		adxl345_config_initializer(ADXL345_RATE_100HZ, ADXL345_RANGE_16G, 1, 0);
+	const adxl345_config fifo =
+		adxl345_config_initializer(ADXL345_RATE_3200HZ, ADXL345_RANGE_16G, 1, 0);
+	TEST_CHECK_EQUAL(adxl345_spi_clock_hz(&polling, 0u), 1000000);
+	TEST_CHECK_EQUAL(adxl345_spi_clock_hz(&fifo, TEST_WATERMARK), 2000000);
+}
+
+int main (void) {
+	test_configure_all();
+	test_configure_no_device();
+	test_default_clocks();
+	return test_result();
+}
@@ -0,0 +1,419 @@
+/**
+ * @file test_adxl345_fifo.c
+ *
+ * Streams samples from a simulated ADXL345 through the FIFO, as the FIFO
+ * task of `spi_adxl345_main.c` does, and checks that no sample is dropped
+ * or reordered.
+ *
+ * The simulated ADXL345 numbers its samples, so a sample pushed into the
+ * ring tells which one it was, and when it was taken. Timestamps are
+ * compared with that time.
+ */
+
+#include <string.h>
+
+#include "adxl345.h"
+#include "hal_linux.h"
+#include "interval_stats.h"
+#include "sample_ring.h"
+
+#include "adxl345_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for INT1. */
+#define TEST_PIN_INT1  33
+
+/** @brief Watermark of the FIFO. Same as `spi_adxl345_main.c`. */
+#define TEST_WATERMARK  16u
+
+/** @brief Time to wait for the watermark interrupt (ms). */
+#define TEST_FIFO_TIMEOUT_MS  100u
+
+/** @brief Capacity of the ring. */
+#define TEST_RING_SIZE  1024u
+
+/** @brief Time to stream (ms). */
+#define TEST_DURATION_MS  2000u
+
+/** @brief Time of the last rising edge of INT1 in microseconds. */
+static int64_t test_int1_timestamp = 0;
+
+/** @brief Records of the ring. */
+static sample_record test_records[TEST_RING_SIZE];
+
+/** @brief Result of streaming. */
+typedef struct {
+	/** @brief Number of samples popped from the ring. */
+	uint32_t num_samples;
+	/** @brief Number of samples missing between popped ones. */
+	uint32_t num_missing;
+	/** @brief Number of samples that came before an earlier one. */
+	uint32_t num_reordered;
+	/** @brief Number of timestamps not after the previous one. */
+	uint32_t num_non_monotonic;
+	/** @brief Number of drains that saw the overrun. */
+	uint32_t num_overruns;
+	/** @brief Number of samples dropped by the ring. */
+	uint32_t num_ring_drops;
+	/** @brief Number of samples the ADXL345 lost after starting. */
+	uint64_t num_overrun_samples;
+	/**
+	 * @brief Largest difference of a timestamp from the sampling time (us).
+	 *
+	 * Samples stamped before the first edge of INT1 are not counted.
+	 */
+	int64_t max_timestamp_error;
+	/** @brief Intervals between timestamps. */
+	interval_stats intervals;
+} test_stream_result;
+
+/** @brief State of `::test_random`. */
+static uint32_t test_random_state = 0x6A09E667u;
+
+/**
+ * @brief Handles a rising edge of INT1.
+ *
+ * @param[in] arg
+ *
+ *   (`hal_task`) Task to notify.
+ */
+static void test_int1_isr (void* arg) {
+	test_int1_timestamp = hal_get_time_us();
+	hal_task_notify_from_isr((hal_task)arg);
+}
+
+/**
+ * @brief Time of the last rising edge of INT1.
+ *
+ * @return
+ *
+ *   Time in microseconds.
+ */
+static int64_t test_get_int1_timestamp (void) {
+	return test_int1_timestamp;
+}
+
+/**
+ * @brief Starts a simulated ADXL345 streaming through the FIFO.
+ *
+ * @param[out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] config
+ *
+ *   Configuration.
+ *
+ * @return
+ *
+ *   SPI device of the ADXL345.
+ */
+static hal_spi_device test_setup (adxl345_sim* sim, const adxl345_config* config) {
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		adxl345_spi_clock_hz(config, TEST_WATERMARK),
+		8,
+		0u);
+	hal_spi_device spi;
+	hal_err_t ret;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	TEST_CHECK(spi != NULL);
+	adxl345_sim_init(sim, TEST_PIN_INT1);
+	adxl345_sim_attach(sim, spi);
+	ret = hal_gpio_set_isr(
+		TEST_PIN_INT1,
+		HAL_GPIO_RISING_EDGE,
+		test_int1_isr,
+		hal_task_current());
+	TEST_CHECK_EQUAL(ret, HAL_OK);
+	TEST_CHECK_EQUAL(adxl345_configure(spi, config), HAL_OK);
+	adxl345_configure_fifo(spi, TEST_WATERMARK);
+	adxl345_start(spi);
+	return spi;
+}
+
+/**
+ * @brief Pops every sample from a ring, and checks the order and timestamps.
+ *
+ * @param[in] sim
+ *
+ *   Simulated ADXL345 that took the samples.
+ *
+ * @param[in] anchored
+ *
+ *   Whether the samples, and those consumed before them, were stamped
+ *   from an edge of INT1. Samples stamped from the end of
+ *   `::adxl345_discard_fifo` are not compared with the sampling time,
+ *   nor are their intervals counted.
+ *
+ * @param[in,out] ring
+ *
+ *   Ring.
+ *
+ * @param[in,out] next_index
+ *
+ *   Index of the sample expected next. `UINT64_MAX` accepts any.
+ *
+ * @param[in,out] last_timestamp
+ *
+ *   Timestamp of the last sample.
+ *
+ * @param[in,out] result
+ *
+ *   Result to update.
+ */
+static void test_consume (
+		const adxl345_sim* sim,
+		int anchored,
+		sample_ring* ring,
+		uint64_t* next_index,
+		int64_t* last_timestamp,
+		test_stream_result* result)
+{
+	sample_record sample;
+	while (sample_ring_pop(ring, &sample, 1u) == 1u) {
+		const uint32_t index = adxl345_sim_counter_index(sample.accs);
+		int64_t error =
+			sample.timestamp - adxl345_sim_sample_time_ns(sim, index) / 1000;
+		if (error < 0) {
+			error = -error;
+		}
+		if (anchored && (error > result->max_timestamp_error)) {
+			result->max_timestamp_error = error;
+		}
+		if (*next_index != UINT64_MAX) {
+			if (anchored) {
+				interval_stats_add(
+					&result->intervals,
+					sample.timestamp - *last_timestamp);
+			}
+			if (index > *next_index) {
+				result->num_missing += (uint32_t)(index - *next_index);
+			} else if (index < *next_index) {
+				++result->num_reordered;
+			}
+			if (sample.timestamp <= *last_timestamp) {
+				++result->num_non_monotonic;
+			}
+		}
+		*next_index = (uint64_t)index + 1u;
+		*last_timestamp = sample.timestamp;
+		++result->num_samples;
+	}
+}
+
+/**
+ * @brief Streams samples as the FIFO task does.
+ *
+ * @param[in,out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @param[in] rate
+ *
+ *   Output data rate.
+ *
+ * @param[in] stall_ms
+ *
+ *   Time the task is kept from draining once in the middle.
+ *   `0` not to stall.
+ *
+ * @param[in] max_latency_us
+ *
+ *   Longest time the task takes to wake up after INT1 rises.
+ *   Each wake-up takes a random time up to this.
+ *
+ * @param[out] result
+ *
+ *   Receives the result.
+ */
+static void test_stream (
+		adxl345_sim* sim,
+		adxl345_rate rate,
+		uint32_t stall_ms,
+		uint32_t max_latency_us,
+		test_stream_result* result)
+{
+	const adxl345_config config =
+		adxl345_config_initializer(rate, ADXL345_RANGE_16G, 1, 0);
+	sample_ring ring = sample_ring_initializer(test_records, TEST_RING_SIZE);
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	adxl345_fifo_clock clock = {
+		.odr_millihz = adxl345_odr_millihz(&config),
+		.next_index = 0u,
+		.anchor_index = 0u,
+		.anchor_timestamp = 0,
+		.drain_end_timestamp = 0
+	};
+	const hal_spi_device spi = test_setup(sim, &config);
+	uint64_t next_index = UINT64_MAX;
+	uint64_t start_index;
+	int anchored;
+	int was_anchored = 0;
+	int64_t last_timestamp = 0;
+	int64_t end_ns;
+	int64_t stall_ns;
+	size_t num_samples;
+	uint8_t int_source;
+	memset(result, 0, sizeof(test_stream_result));
+	interval_stats_reset(&result->intervals);
+	adxl345_discard_fifo(spi, &clock, adxl345_odr_millihz(&config));
+	start_index = clock.anchor_index;
+	// the FIFO filled up and overran while starting
+	sim->max_entries = sim->num_entries;
+	result->num_overrun_samples = sim->num_overrun_samples;
+	end_ns = hal_linux_get_time_ns() + (int64_t)TEST_DURATION_MS * 1000000;
+	stall_ns = hal_linux_get_time_ns() + (int64_t)TEST_DURATION_MS * 500000;
+	while (hal_linux_get_time_ns() < end_ns) {
+		do {
+			num_samples = adxl345_drain_fifo(
+				spi,
+				&clock,
+				TEST_WATERMARK,
+				test_get_int1_timestamp,
+				samples,
+				&int_source);
+			if ((int_source & ADXL345_INT_OVERRUN) != 0u) {
+				++result->num_overruns;
+			}
+			result->num_ring_drops += (uint32_t)(
+				num_samples - sample_ring_push(&ring, samples, num_samples));
+		} while (num_samples >= TEST_WATERMARK);
+		anchored = (clock.anchor_index != start_index);
+		test_consume(
+			sim,
+			anchored && was_anchored,
+			&ring,
+			&next_index,
+			&last_timestamp,
+			result);
+		was_anchored = anchored;
+		if ((stall_ms > 0u) && (hal_linux_get_time_ns() >= stall_ns)) {
+			hal_delay_ms(stall_ms);
+			stall_ms = 0u;
+		}
+		hal_task_wait_notification(TEST_FIFO_TIMEOUT_MS);
+		if (max_latency_us > 0u) {
+			hal_linux_advance_time_ns(
+				(int64_t)(test_random(&test_random_state) % max_latency_us) * 1000);
+		}
+	}
+	result->num_overrun_samples =
+		sim->num_overrun_samples - result->num_overrun_samples;
+}
+
+/** @brief Every sample arrives in order at 800Hz to 3200Hz. */
+static void test_no_drops (void) {
+	static const adxl345_rate RATES[] = {
+		ADXL345_RATE_800HZ,
+		ADXL345_RATE_1600HZ,
+		ADXL345_RATE_3200HZ
+	};
+	adxl345_sim sim;
+	test_stream_result result;
+	size_t i;
+	for (i = 0; i < sizeof(RATES) / sizeof(RATES[0]); ++i) {
+		uint32_t expected;
+		test_stream(&sim, RATES[i], 0u, 0u, &result);
+		expected = (uint32_t)(
+			((int64_t)TEST_DURATION_MS * 1000000) / adxl345_sim_period_ns(&sim));
+		printf(
+			"%4lldHz: %u samples, %u missing, %u reordered, "
+			"peak FIFO fill %u of %u\n",
+			(long long)(1000000000 / adxl345_sim_period_ns(&sim)),
+			(unsigned)result.num_samples,
+			(unsigned)result.num_missing,
+			(unsigned)result.num_reordered,
+			(unsigned)sim.max_entries,
+			(unsigned)ADXL345_SIM_FIFO_SIZE);
+		TEST_CHECK_EQUAL(result.num_missing, 0);
+		TEST_CHECK_EQUAL(result.num_reordered, 0);
+		TEST_CHECK_EQUAL(result.num_non_monotonic, 0);
+		TEST_CHECK_EQUAL(result.num_overruns, 0);
+		TEST_CHECK_EQUAL(result.num_ring_drops, 0);
+		TEST_CHECK_EQUAL(result.num_overrun_samples, 0);
+		// only samples after the last drain stay in the FIFO
+		TEST_CHECK(result.num_samples + TEST_WATERMARK >= expected);
+		TEST_CHECK_EQUAL(
+			sim.num_popped + sim.num_overrun_samples + sim.num_entries,
+			sim.num_samples);
+		TEST_CHECK(sim.max_entries < ADXL345_SIM_FIFO_SIZE);
+	}
+}
+
+/** @brief A stalled task loses samples, which both the ADXL345 and the ring show. */
+static void test_stall_drops (void) {
+	adxl345_sim sim;
+	test_stream_result result;
+	// 64 samples at 3200Hz overflow the FIFO of 32
+	test_stream(&sim, ADXL345_RATE_3200HZ, 20u, 0u, &result);
+	TEST_CHECK(result.num_overruns > 0u);
+	TEST_CHECK_EQUAL(result.num_reordered, 0);
+	// every sample the ADXL345 lost went missing, and nothing else; some
+	// may be lost while the full FIFO is drained
+	TEST_CHECK_EQUAL(result.num_missing, result.num_overrun_samples);
+	TEST_CHECK(result.num_missing >= 64u - ADXL345_SIM_FIFO_SIZE);
+	TEST_CHECK(result.num_missing <= 64u - ADXL345_SIM_FIFO_SIZE + 2u);
+}
+
+/**
+ * @brief Timestamps follow the sampling time whenever the task drains.
+ *
+ * The task wakes up to 4ms late, which still leaves the FIFO room at
+ * 3200Hz. Timestamps are counted at the output data rate from edges of
+ * INT1, so they are off by at most the microsecond truncated from the
+ * edge, and their intervals stay within 2us of 312.5us.
+ */
+static void test_timestamps (void) {
+	adxl345_sim sim;
+	test_stream_result result;
+	test_stream(&sim, ADXL345_RATE_3200HZ, 0u, 4000u, &result);
+	printf(
+		"3200Hz, 0-4ms late: %u samples, timestamp error max %lld us, "
+		"interval (us) min %lld, max %lld, mean %.3f, stddev %.3f\n",
+		(unsigned)result.num_samples,
+		(long long)result.max_timestamp_error,
+		(long long)result.intervals.min,
+		(long long)result.intervals.max,
+		interval_stats_mean(&result.intervals),
+		interval_stats_stddev(&result.intervals));
+	TEST_CHECK_EQUAL(result.num_missing, 0);
+	TEST_CHECK_EQUAL(result.num_overruns, 0);
+	TEST_CHECK_EQUAL(result.num_non_monotonic, 0);
+	// only the samples of the first drain are stamped from the discard
+	TEST_CHECK(result.intervals.count + 2u * TEST_WATERMARK > result.num_samples);
+	TEST_CHECK(result.max_timestamp_error <= 1);
+	TEST_CHECK(result.intervals.min >= 311);
+	TEST_CHECK(result.intervals.max <= 314);
+	TEST_CHECK(interval_stats_mean(&result.intervals) > 312.49);
+	TEST_CHECK(interval_stats_mean(&result.intervals) < 312.51);
+}
+
+/** @brief Registers are written as the driver configures the FIFO. */
+static void test_registers (void) {
+	const adxl345_config config =
+		adxl345_config_initializer(ADXL345_RATE_3200HZ, ADXL345_RANGE_16G, 1, 0);
+	adxl345_sim sim;
+	const hal_spi_device spi = test_setup(&sim, &config);
+	uint8_t devid = 0u;
+	TEST_CHECK_EQUAL(adxl345_read(spi, ADXL345_REG_DEVID, &devid), HAL_OK);
+	TEST_CHECK_EQUAL(devid, ADXL345_SIM_DEVID);
+	TEST_CHECK_EQUAL(sim.registers[ADXL345_REG_BW_RATE], ADXL345_RATE_3200HZ);
+	TEST_CHECK_EQUAL(
+		sim.registers[ADXL345_REG_DATA_FORMAT],
+		ADXL345_DATA_FORMAT_FULL_RES | ADXL345_RANGE_16G);
+	TEST_CHECK_EQUAL(
+		sim.registers[ADXL345_REG_FIFO_CTL],
+		ADXL345_FIFO_CTL_STREAM | TEST_WATERMARK);
+	TEST_CHECK_EQUAL(sim.registers[ADXL345_REG_INT_MAP], 0x00u);
+	TEST_CHECK_EQUAL(sim.registers[ADXL345_REG_INT_ENABLE], ADXL345_INT_WATERMARK);
+	TEST_CHECK_EQUAL(sim.registers[ADXL345_REG_POWER_CTL], ADXL345_POWER_CTL_MEASURE);
+}
+
+int main (void) {
+	test_registers();
+	test_no_drops();
+	test_stall_drops();
+	test_timestamps();
+	return test_result();
+}
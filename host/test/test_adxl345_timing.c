@@ -0,0 +1,232 @@
+/**
+ * @file test_adxl345_timing.c
+ *
+ * Runs the polling loop of `spi_adxl345_main.c` on the simulated clock,
+ * and checks that its period does not drift.
+ *
+ * Every iteration reads a sample from a simulated ADXL345 at 100Hz, then
+ * takes a random time of up to 4ms as if it printed the sample. Waking up
+ * with `::hal_delay_until` keeps polls on a 10ms grid, so that every poll
+ * reads the next sample at the same age. Sleeping 10ms with
+ * `::hal_delay_ms` instead drifts by the time of every iteration, and
+ * skips samples.
+ */
+
+#include <string.h>
+
+#include "adxl345.h"
+#include "hal_linux.h"
+#include "interval_stats.h"
+
+#include "adxl345_sim.h"
+#include "test_util.h"
+
+/** @brief Period of polling (ms). Same as `spi_adxl345_main.c`. */
+#define TEST_POLLING_PERIOD_MS  10u
+
+/** @brief Number of polls. */
+#define TEST_NUM_POLLS  1000u
+
+/** @brief Longest time an iteration takes after reading a sample (us). */
+#define TEST_MAX_WORK_US  4000u
+
+/** @brief Result of polling. */
+typedef struct {
+	/** @brief Intervals between timestamps. */
+	interval_stats intervals;
+	/** @brief Time from the first poll to the end of the last wait (us). */
+	int64_t elapsed_us;
+	/** @brief Number of polls that read the same sample as the previous one. */
+	uint32_t num_duplicates;
+	/** @brief Number of samples skipped between polls. */
+	uint32_t num_skipped;
+	/** @brief Shortest time from a sample to the poll that read it (ns). */
+	int64_t min_age_ns;
+	/** @brief Longest time from a sample to the poll that read it (ns). */
+	int64_t max_age_ns;
+} test_poll_result;
+
+/** @brief State of `::test_random`. */
+static uint32_t test_random_state = 0x2545F491u;
+
+/**
+ * @brief Starts a simulated ADXL345 in the polling mode.
+ *
+ * @param[out] sim
+ *
+ *   Simulated ADXL345.
+ *
+ * @return
+ *
+ *   SPI device of the ADXL345.
+ */
+static hal_spi_device test_setup (adxl345_sim* sim) {
+	const adxl345_config config =
+		adxl345_config_initializer(ADXL345_RATE_100HZ, ADXL345_RANGE_16G, 1, 0);
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		adxl345_spi_clock_hz(&config, 0u),
+		8,
+		0u);
+	hal_spi_device spi;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	TEST_CHECK(spi != NULL);
+	adxl345_sim_init(sim, -1);
+	adxl345_sim_attach(sim, spi);
+	TEST_CHECK_EQUAL(adxl345_configure(spi, &config), HAL_OK);
+	adxl345_start(spi);
+	return spi;
+}
+
+/**
+ * @brief Polls samples as the polling task does.
+ *
+ * @param[in] until
+ *
+ *   Whether to wait with `::hal_delay_until`. `0` sleeps a period with
+ *   `::hal_delay_ms` after every iteration.
+ *
+ * @param[in] stall_at
+ *
+ *   Iteration that takes 25ms longer than a period.
+ *   `TEST_NUM_POLLS` not to stall.
+ *
+ * @param[out] result
+ *
+ *   Receives the result.
+ */
+static void test_poll (int until, uint32_t stall_at, test_poll_result* result) {
+	adxl345_sim sim;
+	const hal_spi_device spi = test_setup(&sim);
+	int64_t wake_time;
+	int64_t start;
+	int64_t last_timestamp = 0;
+	uint32_t last_index = 0u;
+	uint32_t i;
+	memset(result, 0, sizeof(test_poll_result));
+	interval_stats_reset(&result->intervals);
+	result->min_age_ns = INT64_MAX;
+	result->max_age_ns = INT64_MIN;
+	start = hal_get_time_us();
+	wake_time = start;
+	for (i = 0u; i < TEST_NUM_POLLS; ++i) {
+		int16_t accs[3];
+		const int64_t timestamp = hal_get_time_us();
+		uint32_t index;
+		int64_t age_ns;
+		TEST_CHECK_EQUAL(adxl345_read_acceleration(spi, accs), HAL_OK);
+		index = adxl345_sim_counter_index(accs);
+		age_ns = hal_linux_get_time_ns() - adxl345_sim_sample_time_ns(&sim, index);
+		if (age_ns < result->min_age_ns) {
+			result->min_age_ns = age_ns;
+		}
+		if (age_ns > result->max_age_ns) {
+			result->max_age_ns = age_ns;
+		}
+		if (i > 0u) {
+			interval_stats_add(&result->intervals, timestamp - last_timestamp);
+			if (index == last_index) {
+				++result->num_duplicates;
+			} else {
+				result->num_skipped += index - last_index - 1u;
+			}
+		}
+		last_timestamp = timestamp;
+		last_index = index;
+		// prints the sample
+		hal_linux_advance_time_ns(
+			(int64_t)(test_random(&test_random_state) % TEST_MAX_WORK_US) * 1000);
+		if (i == stall_at) {
+			hal_linux_advance_time_ns(
+				((int64_t)TEST_POLLING_PERIOD_MS + 25) * 1000000);
+		}
+		if (until) {
+			hal_delay_until(&wake_time, TEST_POLLING_PERIOD_MS);
+		} else {
+			hal_delay_ms(TEST_POLLING_PERIOD_MS);
+		}
+	}
+	result->elapsed_us = hal_get_time_us() - start;
+}
+
+/**
+ * @brief Prints a result.
+ *
+ * @param[in] name
+ *
+ *   Name of the loop.
+ *
+ * @param[in] result
+ *
+ *   Result.
+ */
+static void test_print (const char* name, const test_poll_result* result) {
+	printf(
+		"%-12s: %u polls in %lld us, interval (us) min %lld, max %lld, "
+		"mean %.1f, stddev %.1f, %u duplicated, %u skipped, "
+		"sample age %lld to %lld us\n",
+		name,
+		(unsigned)TEST_NUM_POLLS,
+		(long long)result->elapsed_us,
+		(long long)result->intervals.min,
+		(long long)result->intervals.max,
+		interval_stats_mean(&result->intervals),
+		interval_stats_stddev(&result->intervals),
+		(unsigned)result->num_duplicates,
+		(unsigned)result->num_skipped,
+		(long long)(result->min_age_ns / 1000),
+		(long long)(result->max_age_ns / 1000));
+}
+
+/** @brief Polls stay on the grid whatever each iteration takes. */
+static void test_delay_until (void) {
+	const int64_t period_us = (int64_t)TEST_POLLING_PERIOD_MS * 1000;
+	test_poll_result result;
+	test_poll(1, TEST_NUM_POLLS, &result);
+	test_print("delay until", &result);
+	TEST_CHECK_EQUAL(result.elapsed_us, (int64_t)TEST_NUM_POLLS * period_us);
+	TEST_CHECK_EQUAL(result.intervals.count, TEST_NUM_POLLS - 1u);
+	TEST_CHECK_EQUAL(result.intervals.min, period_us);
+	TEST_CHECK_EQUAL(result.intervals.max, period_us);
+	TEST_CHECK(interval_stats_stddev(&result.intervals) == 0.0);
+	// every poll reads the next sample at the same phase of the output data rate
+	TEST_CHECK_EQUAL(result.num_duplicates, 0);
+	TEST_CHECK_EQUAL(result.num_skipped, 0);
+	TEST_CHECK_EQUAL(result.max_age_ns, result.min_age_ns);
+}
+
+/** @brief Sleeping a period after every iteration drifts and skips samples. */
+static void test_delay_drifts (void) {
+	const int64_t period_us = (int64_t)TEST_POLLING_PERIOD_MS * 1000;
+	test_poll_result result;
+	test_poll(0, TEST_NUM_POLLS, &result);
+	test_print("delay", &result);
+	// half of the work on average
+	TEST_CHECK(
+		result.elapsed_us >
+			(int64_t)TEST_NUM_POLLS * (period_us + TEST_MAX_WORK_US / 4));
+	TEST_CHECK(result.intervals.min > period_us);
+	TEST_CHECK(interval_stats_stddev(&result.intervals) > 100.0);
+	TEST_CHECK(result.num_skipped > 0u);
+}
+
+/** @brief A late iteration is caught up, and polls return to the grid. */
+static void test_delay_until_catches_up (void) {
+	const int64_t period_us = (int64_t)TEST_POLLING_PERIOD_MS * 1000;
+	test_poll_result result;
+	test_poll(1, TEST_NUM_POLLS / 2u, &result);
+	test_print("late once", &result);
+	TEST_CHECK_EQUAL(result.elapsed_us, (int64_t)TEST_NUM_POLLS * period_us);
+	TEST_CHECK(result.intervals.max > 3 * period_us);
+	// polls due during the stall run back to back
+	TEST_CHECK(result.intervals.min < period_us);
+	// no sample is lost for good but those during the stall
+	TEST_CHECK(result.num_skipped <= 3u);
+}
+
+int main (void) {
+	test_delay_until();
+	test_delay_drifts();
+	test_delay_until_catches_up();
+	return test_result();
+}
@@ -0,0 +1,393 @@
+/**
+ * @file test_capture_history.c
+ *
+ * Checks which samples `capture_history.h` freezes around triggers, at the
+ * boundaries of the pre- and post-trigger windows, of the buffer, and of
+ * indices; and reports the memory footprint of histories.
+ */
+
+#include <stdio.h>
+
+#include "capture_history.h"
+
+#include "test_util.h"
+
+/** @brief Depth of histories in tests. */
+#define TEST_CAPACITY  64u
+
+/** @brief Samples before a trigger in tests. */
+#define TEST_PRE_TRIGGER  20u
+
+/** @brief Samples from a trigger in tests. */
+#define TEST_POST_TRIGGER  12u
+
+/** @brief Threshold in tests. */
+#define TEST_THRESHOLD  1000u
+
+/** @brief Memory block of histories in tests. */
+static sample_record test_records[TEST_CAPACITY];
+
+/**
+ * @brief Adds samples of consecutive indices below the threshold.
+ *
+ * @param[in,out] history
+ *
+ *   History.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples to add.
+ *
+ * @return
+ *
+ *   Number of samples that completed a capture.
+ */
+static uint32_t test_add (capture_history* history, uint32_t num_samples) {
+	sample_record sample;
+	uint32_t num_completed = 0u;
+	uint32_t i;
+	for (i = 0u; i < num_samples; ++i) {
+		test_make_sample(history->next, &sample);
+		num_completed += (uint32_t)capture_history_add(history, &sample);
+	}
+	return num_completed;
+}
+
+/**
+ * @brief Adds a sample that reaches the threshold.
+ *
+ * @param[in,out] history
+ *
+ *   History.
+ *
+ * @return
+ *
+ *   Result of `::capture_history_add`.
+ */
+static int test_add_spike (capture_history* history) {
+	sample_record sample;
+	test_make_sample(history->next, &sample);
+	sample.accs[0] = (int16_t)TEST_THRESHOLD;
+	sample.accs[1] = 0;
+	sample.accs[2] = 0;
+	return capture_history_add(history, &sample);
+}
+
+/**
+ * @brief Checks that a range of a history holds consecutive samples.
+ *
+ * Walks the range with `::capture_history_peek`, which may wrap around.
+ * Samples by `::test_add_spike` are identified by their timestamps.
+ *
+ * @param[in] history
+ *
+ *   History.
+ *
+ * @param[in] begin
+ *
+ *   Index of the first sample.
+ *
+ * @param[in] end
+ *
+ *   Index next to the last sample.
+ *
+ * @return
+ *
+ *   Number of calls to `::capture_history_peek`.
+ */
+static int test_check_range (
+		const capture_history* history,
+		uint32_t begin,
+		uint32_t end)
+{
+	const sample_record* samples;
+	uint32_t index = begin;
+	int num_peeks = 0;
+	while (index != end) {
+		const size_t num_samples = capture_history_peek(history, index, end, &samples);
+		size_t i;
+		TEST_CHECK(num_samples > 0u);
+		if (num_samples == 0u) {
+			break;
+		}
+		for (i = 0u; i < num_samples; ++i) {
+			TEST_CHECK_EQUAL((uint32_t)samples[i].timestamp, index);
+			++index;
+		}
+		++num_peeks;
+	}
+	return num_peeks;
+}
+
+/** @brief A sample at the threshold triggers, one below does not. */
+static void test_threshold_boundary (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		5u);
+	// magnitudes of 4.7 and 5
+	const sample_record below = { .timestamp = 0, .accs = { 3, 3, -2 } };
+	const sample_record exact = { .timestamp = 1, .accs = { -3, 0, 4 } };
+	TEST_CHECK_EQUAL(capture_history_add(&history, &below), 0);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_ARMED);
+	TEST_CHECK_EQUAL(capture_history_add(&history, &exact), 0);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_TRIGGERED);
+	TEST_CHECK_EQUAL(history.capture.trigger, 1u);
+	TEST_CHECK_EQUAL(history.capture.start, 0u);
+	// the largest magnitude does not overflow the square
+	{
+		capture_history loud = capture_history_initializer(
+			test_records,
+			TEST_CAPACITY,
+			TEST_PRE_TRIGGER,
+			TEST_POST_TRIGGER,
+			56755u);
+		const sample_record corner = {
+			.timestamp = 0,
+			.accs = { INT16_MIN, INT16_MIN, INT16_MIN }
+		};
+		const sample_record almost = {
+			.timestamp = 0,
+			.accs = { INT16_MIN, INT16_MIN, INT16_MAX }
+		};
+		// sqrt(3) * 32768 = 56755.8, sqrt(2 * 32768^2 + 32767^2) = 56755.2
+		TEST_CHECK_EQUAL(capture_history_add(&loud, &almost), 0);
+		TEST_CHECK_EQUAL(loud.state, CAPTURE_TRIGGERED);
+		loud = (capture_history)capture_history_initializer(
+			test_records,
+			TEST_CAPACITY,
+			TEST_PRE_TRIGGER,
+			TEST_POST_TRIGGER,
+			56756u);
+		TEST_CHECK_EQUAL(capture_history_add(&loud, &almost), 0);
+		TEST_CHECK_EQUAL(loud.state, CAPTURE_ARMED);
+		TEST_CHECK_EQUAL(capture_history_add(&loud, &corner), 0);
+		TEST_CHECK_EQUAL(loud.state, CAPTURE_ARMED);
+	}
+}
+
+/**
+ * @brief A trigger freezes exactly the pre- and post-trigger windows, and
+ * completes on the last post-trigger sample.
+ */
+static void test_trigger_windows (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	uint32_t trigger;
+	// wraps the buffer before the trigger
+	TEST_CHECK_EQUAL(test_add(&history, 140u), 0u);
+	trigger = history.next;
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(history.capture.start, trigger - TEST_PRE_TRIGGER);
+	TEST_CHECK_EQUAL(history.capture.trigger, trigger);
+	TEST_CHECK_EQUAL(history.capture.end, trigger + TEST_POST_TRIGGER);
+	// spikes after a trigger do not move it
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(history.capture.trigger, trigger);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER - 3u), 0u);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_TRIGGERED);
+	TEST_CHECK_EQUAL(test_add(&history, 1u), 1u);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_FROZEN);
+	TEST_CHECK_EQUAL(history.next, history.capture.end);
+	// the capture starts at 120 % 64 and wraps once
+	TEST_CHECK_EQUAL(
+		test_check_range(&history, history.capture.start, history.capture.end),
+		2);
+	TEST_CHECK_EQUAL(history.num_dropped, 0u);
+}
+
+/** @brief A trigger early in the history takes every sample before it. */
+static void test_short_pre_trigger (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	// the very first sample
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(history.capture.start, 0u);
+	TEST_CHECK_EQUAL(history.capture.trigger, 0u);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER - 1u), 1u);
+	capture_history_release(&history);
+	// one sample short of the pre-trigger window
+	history = (capture_history)capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_PRE_TRIGGER - 1u), 0u);
+	TEST_CHECK_EQUAL(capture_history_trigger(&history), 1);
+	TEST_CHECK_EQUAL(history.capture.start, 0u);
+	TEST_CHECK_EQUAL(history.capture.trigger, TEST_PRE_TRIGGER - 1u);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER), 1u);
+	test_check_range(&history, history.capture.start, history.capture.end);
+}
+
+/** @brief An external trigger makes the next sample the trigger sample. */
+static void test_external_trigger (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		0u);
+	// magnitude is ignored with the threshold of 0
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(test_add(&history, 40u), 0u);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_ARMED);
+	TEST_CHECK_EQUAL(capture_history_trigger(&history), 1);
+	TEST_CHECK_EQUAL(capture_history_trigger(&history), 0);
+	TEST_CHECK_EQUAL(history.capture.trigger, 41u);
+	TEST_CHECK_EQUAL(history.capture.start, 41u - TEST_PRE_TRIGGER);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER), 1u);
+	TEST_CHECK_EQUAL(capture_history_trigger(&history), 0);
+	test_check_range(&history, history.capture.start, history.capture.end);
+}
+
+/**
+ * @brief New samples fill only the rest of the buffer while a capture is
+ * frozen, and the history resumes after a release.
+ */
+static void test_frozen_capture (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	const uint32_t room = TEST_CAPACITY - TEST_PRE_TRIGGER - TEST_POST_TRIGGER;
+	capture_record capture;
+	TEST_CHECK_EQUAL(test_add(&history, 30u), 0u);
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER - 1u), 1u);
+	capture = history.capture;
+	// spikes are not triggers while frozen
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(test_add(&history, room - 1u), 0u);
+	TEST_CHECK_EQUAL(history.num_dropped, 0u);
+	TEST_CHECK_EQUAL(history.next, capture.start + TEST_CAPACITY);
+	// the next one would overwrite the first pre-trigger sample
+	TEST_CHECK_EQUAL(test_add(&history, 5u), 0u);
+	TEST_CHECK_EQUAL(history.num_dropped, 5u);
+	TEST_CHECK_EQUAL(history.next, capture.start + TEST_CAPACITY);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_FROZEN);
+	TEST_CHECK_EQUAL(history.capture.start, capture.start);
+	test_check_range(&history, capture.start, capture.end);
+	// samples after the capture are kept too
+	test_check_range(&history, capture.end, history.next);
+	capture_history_release(&history);
+	TEST_CHECK_EQUAL(history.state, CAPTURE_ARMED);
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(history.capture.trigger, capture.start + TEST_CAPACITY);
+	TEST_CHECK_EQUAL(
+		history.capture.start,
+		history.capture.trigger - TEST_PRE_TRIGGER);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER - 1u), 1u);
+	TEST_CHECK_EQUAL(history.next - history.oldest, TEST_CAPACITY);
+}
+
+/** @brief A capture of the whole buffer leaves no room while frozen. */
+static void test_full_capacity (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_CAPACITY - TEST_POST_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	TEST_CHECK_EQUAL(test_add(&history, 3u * TEST_CAPACITY + 7u), 0u);
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER - 1u), 1u);
+	TEST_CHECK_EQUAL(
+		history.capture.end - history.capture.start,
+		TEST_CAPACITY);
+	TEST_CHECK_EQUAL(test_add(&history, 1u), 0u);
+	TEST_CHECK_EQUAL(history.num_dropped, 1u);
+	test_check_range(&history, history.capture.start, history.capture.end);
+}
+
+/** @brief Indices wrap around at `2^32` in the middle of a capture. */
+static void test_index_wraparound (void) {
+	capture_history history = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	// as if 2^32 - 40 samples had been added
+	history.oldest = 0u - 40u - TEST_CAPACITY;
+	history.next = 0u - 40u;
+	TEST_CHECK_EQUAL(test_add(&history, 35u), 0u);
+	TEST_CHECK_EQUAL(test_add_spike(&history), 0);
+	TEST_CHECK_EQUAL(history.capture.trigger, 0u - 5u);
+	TEST_CHECK_EQUAL(history.capture.end, TEST_POST_TRIGGER - 5u);
+	TEST_CHECK_EQUAL(test_add(&history, TEST_POST_TRIGGER - 1u), 1u);
+	TEST_CHECK_EQUAL(history.next, TEST_POST_TRIGGER - 5u);
+	test_check_range(&history, history.capture.start, history.capture.end);
+}
+
+/** @brief Footprints are the descriptor and the buffer, and are reported. */
+static void test_footprint (void) {
+	// the consumer of `spi_adxl345_main.c`
+	static sample_record firmware_records[4096];
+	// 1s before and 0.5s from a trigger at 3200Hz
+	static sample_record second_records[8192];
+	const capture_history firmware = capture_history_initializer(
+		firmware_records,
+		4096u,
+		2048u,
+		1024u,
+		750u);
+	const capture_history second = capture_history_initializer(
+		second_records,
+		8192u,
+		3200u,
+		1600u,
+		750u);
+	const capture_history small = capture_history_initializer(
+		test_records,
+		TEST_CAPACITY,
+		TEST_PRE_TRIGGER,
+		TEST_POST_TRIGGER,
+		TEST_THRESHOLD);
+	printf("sample_record: %u bytes\n", (unsigned)sizeof(sample_record));
+	printf(
+		"history of 4096 (firmware): %u bytes\n",
+		(unsigned)capture_history_footprint(&firmware));
+	printf(
+		"history of 8192 (1s pre-trigger at 3200Hz): %u bytes\n",
+		(unsigned)capture_history_footprint(&second));
+	TEST_CHECK_EQUAL(
+		capture_history_footprint(&small),
+		sizeof(capture_history) + sizeof(test_records));
+	TEST_CHECK_EQUAL(
+		capture_history_footprint(&firmware),
+		sizeof(capture_history) + sizeof(firmware_records));
+	TEST_CHECK_EQUAL(
+		capture_history_footprint(&second),
+		sizeof(capture_history) + sizeof(second_records));
+	// the descriptor does not grow with the depth
+	TEST_CHECK_EQUAL(
+		capture_history_footprint(&second) - capture_history_footprint(&firmware),
+		4096u * sizeof(sample_record));
+	TEST_CHECK_EQUAL(capture_history_capacity(&second), 8192u);
+}
+
+int main (void) {
+	test_threshold_boundary();
+	test_trigger_windows();
+	test_short_pre_trigger();
+	test_external_trigger();
+	test_frozen_capture();
+	test_full_capacity();
+	test_index_wraparound();
+	test_footprint();
+	return test_result();
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Decodes the stream written by ``test_sample_log`` with
+``decode_samples.py``, and compares it with the expected results.
+
+Exits with ``1`` if anything differs.
+"""
+
+import argparse
+import importlib
+import io
+import logging
+import os
+import sys
+
+
+class RecordingHandler(logging.Handler):
+    """Keeps warnings logged by ``decode_samples.py``."""
+
+    def __init__(self):
+        super().__init__(logging.WARNING)
+        self.messages = []
+
+    def emit(self, record):
+        self.messages.append(record.getMessage())
+
+
+def read_frames(path):
+    """Reads the expected headers of frames.
+
+    :param path: path to ``sample-log-frames.csv``.
+    :type path: str
+
+    :return: list of dicts of ``sequence``, ``num_dropped`` and
+             ``num_overruns``.
+    :rtype: list
+    """
+    with open(path) as f:
+        lines = f.read().splitlines()
+    keys = lines[0].split(',')
+    return [dict(zip(keys, map(int, line.split(',')))) for line in lines[1:]]
+
+
+def main():
+    """Runs the test.
+
+    :return: exit status.
+    :rtype: int
+    """
+    arg_parser = argparse.ArgumentParser(
+        description='Round-trip frames of sample_log.h through'
+                    ' decode_samples.py')
+    arg_parser.add_argument(
+        'script_dir', metavar='SCRIPT_DIR', type=str,
+        help='directory of decode_samples.py')
+    arg_parser.add_argument(
+        'blob_dir', metavar='BLOB_DIR', type=str,
+        help='directory where test_sample_log wrote the stream')
+    args = arg_parser.parse_args()
+    sys.path.insert(0, args.script_dir)
+    decode_samples = importlib.import_module('decode_samples')
+    handler = RecordingHandler()
+    decode_samples.LOGGER.addHandler(handler)
+    with open(os.path.join(args.blob_dir, 'sample-log.bin'), 'rb') as f:
+        data = f.read()
+    with open(os.path.join(args.blob_dir, 'sample-log.csv')) as f:
+        expected_csv = f.read()
+    expected_frames = read_frames(
+        os.path.join(args.blob_dir, 'sample-log-frames.csv'))
+    frames = decode_samples.decode_frames(data)
+    decode_samples.check_frames(frames)
+    out = io.StringIO()
+    decode_samples.write_csv(
+        out, decode_samples.concatenate_samples(frames))
+    failures = []
+    headers = [header for header, _ in frames]
+    if headers != expected_frames:
+        failures.append('headers differ: %s != %s' % (
+            headers, expected_frames))
+    if out.getvalue() != expected_csv:
+        actual_lines = out.getvalue().splitlines()
+        expected_lines = expected_csv.splitlines()
+        for i, (actual, expected) in enumerate(
+                zip(actual_lines, expected_lines)):
+            if actual != expected:
+                failures.append('line %d: %s != %s' % (i, actual, expected))
+                break
+        if len(actual_lines) != len(expected_lines):
+            failures.append('%d lines != %d lines' % (
+                len(actual_lines), len(expected_lines)))
+    # the corrupted frame is reported as lost, as is nothing else
+    lost = [m for m in handler.messages if m.startswith('lost')]
+    if len(lost) != 1:
+        failures.append('lost frames reported: %s' % lost)
+    print('%d frame(s), %d sample(s) decoded' % (
+        len(frames), len(out.getvalue().splitlines()) - 1))
+    for failure in failures:
+        print(failure, file=sys.stderr)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,159 @@
+/**
+ * @file test_dither.c
+ *
+ * Compares dithering of `dither.h` with `make_binary_image.py` bit by bit.
+ *
+ * The build writes the results of the script on synthetic images and the
+ * images in `epd/imgs` to `TEST_BLOB_DIR/dither-golden.bin` with
+ * `make_dither_golden.py`, which also describes the layout of the file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dither.h"
+#include "image_buffer.h"
+
+#include "test_util.h"
+
+#ifndef TEST_BLOB_DIR
+#error "define TEST_BLOB_DIR"
+#endif
+
+/** @brief Methods in the order of the golden rows. */
+static const dither_method TEST_METHODS[] = {
+	DITHER_THRESHOLD,
+	DITHER_ORDERED,
+	DITHER_FLOYD_STEINBERG
+};
+
+/** @brief Names of `TEST_METHODS`. */
+static const char* const TEST_METHOD_NAMES[] = {
+	"threshold",
+	"ordered",
+	"floyd-steinberg"
+};
+
+/** @brief Number of `TEST_METHODS`. */
+#define TEST_NUM_METHODS \
+	(int)(sizeof(TEST_METHODS) / sizeof(TEST_METHODS[0]))
+
+/** @brief Error buffer of Floyd-Steinberg dithering. */
+static int16_t test_errors[DITHER_ERROR_BUFFER_SIZE(DITHER_MAX_WIDTH)];
+
+/**
+ * @brief Dithers an image and compares it with golden rows.
+ *
+ * Also draws the rows with `::dither_draw_row` at an unaligned position,
+ * and checks the drawn bits.
+ *
+ * @param[in] method
+ *
+ *   Index of the method in `TEST_METHODS`.
+ *
+ * @param[in] gray
+ *
+ *   Grayscale pixels.
+ *
+ * @param[in] golden
+ *
+ *   Packed rows by `make_binary_image.py`.
+ *
+ * @param[in] width
+ *
+ *   Width of the image.
+ *
+ * @param[in] height
+ *
+ *   Height of the image.
+ *
+ * @return
+ *
+ *   Number of rows that differ.
+ */
+static int test_compare (
+		int method,
+		const uint8_t* gray,
+		const uint8_t* golden,
+		uint16_t width,
+		uint16_t height)
+{
+	const size_t row_size = (width + 7u) / 8u;
+	const uint32_t buffer_width = ((width + 3u + 7u) / 8u) * 8u;
+	uint8_t row[DITHER_MAX_WIDTH / 8u];
+	uint8_t* buffer_memory = (uint8_t*)malloc(buffer_width / 8u);
+	image_buffer buffer = image_buffer_initializer(buffer_memory, buffer_width, 1u);
+	dither converted = dither_initializer(TEST_METHODS[method], width, test_errors);
+	dither drawn = dither_initializer(TEST_METHODS[method], width, test_errors);
+	int num_mismatches = 0;
+	uint16_t x;
+	uint16_t y;
+	for (y = 0u; y < height; ++y) {
+		dither_convert_row(&converted, gray + (y * width), row);
+		if (memcmp(row, golden + (y * row_size), row_size) != 0) {
+			++num_mismatches;
+		}
+	}
+	// `drawn` starts at the first row, and clears the errors again
+	// draws at x = 3, on a single row buffer reused for every row
+	for (y = 0u; y < height; ++y) {
+		image_buffer_clear_all(&buffer);
+		dither_draw_row(&drawn, &buffer, gray + (y * width), 3, 0);
+		for (x = 0u; x < width; ++x) {
+			const int expected = (golden[y * row_size + x / 8u] >> (7 - x % 8u)) & 1;
+			const int actual = (buffer_memory[(x + 3u) / 8u] >> (7 - (x + 3u) % 8u)) & 1;
+			if (expected != actual) {
+				++num_mismatches;
+				break;
+			}
+		}
+	}
+	free(buffer_memory);
+	return num_mismatches;
+}
+
+int main (void) {
+	const char* path = TEST_BLOB_DIR "/dither-golden.bin";
+	size_t size;
+	uint8_t* data = test_load_file(path, &size);
+	const uint8_t* next;
+	uint32_t num_images;
+	uint32_t i;
+	int method;
+	if ((data == NULL) || (size < 8u) || (memcmp(data, "DITH", 4u) != 0)) {
+		fprintf(stderr, "%s is not a golden file\n", path);
+		return 1;
+	}
+	num_images = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+	TEST_CHECK(num_images > 0u);
+	next = data + 8;
+	for (i = 0u; i < num_images; ++i) {
+		const uint16_t width = (uint16_t)(next[0] | (next[1] << 8));
+		const uint16_t height = (uint16_t)(next[2] | (next[3] << 8));
+		const uint8_t* gray = next + 4;
+		const size_t golden_size = height * ((width + 7u) / 8u);
+		const uint8_t* golden = gray + (width * height);
+		TEST_CHECK(width <= DITHER_MAX_WIDTH);
+		if (width > DITHER_MAX_WIDTH) {
+			break;
+		}
+		for (method = 0; method < TEST_NUM_METHODS; ++method) {
+			const int num_mismatches =
+				test_compare(method, gray, golden, width, height);
+			printf(
+				"#%u %3ux%-3u %-15s: %d row(s) differ\n",
+				(unsigned)i,
+				(unsigned)width,
+				(unsigned)height,
+				TEST_METHOD_NAMES[method],
+				num_mismatches);
+			TEST_CHECK_EQUAL(num_mismatches, 0);
+			golden += golden_size;
+		}
+		next = golden;
+	}
+	TEST_CHECK(next == data + size);
+	free(data);
+	return test_result();
+}
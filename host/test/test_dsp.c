@@ -0,0 +1,330 @@
+/**
+ * @file test_dsp.c
+ *
+ * Compares the stages of `dsp.h` with `dsp_reference.py` value by value.
+ *
+ * The build writes the outputs of the reference for CIC decimators, biquad
+ * cascades and windows on a synthetic input to
+ * `TEST_BLOB_DIR/dsp-golden.bin` with `make_dsp_golden.py`, which also
+ * describes the layout of the file. Biquad coefficients are stored as real
+ * numbers, so that `DSP_BIQUAD_Q14` is checked as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp.h"
+
+#include "test_util.h"
+
+#ifndef TEST_BLOB_DIR
+#error "define TEST_BLOB_DIR"
+#endif
+
+/** @brief Maximum number of stages of a biquad cascade. */
+#define TEST_MAX_BIQUADS  4u
+
+/** @brief Kind of a case in the golden file. */
+typedef enum {
+	/** @brief `::dsp_cic`. */
+	TEST_CASE_CIC = 0,
+	/** @brief `::dsp_biquad_cascade_process`. */
+	TEST_CASE_BIQUAD,
+	/** @brief `::dsp_window`. */
+	TEST_CASE_WINDOW
+} test_case_kind;
+
+/** @brief Reader of the golden file. */
+typedef struct {
+	/** @brief Next byte. */
+	const uint8_t* next;
+	/** @brief End of the file. */
+	const uint8_t* end;
+	/** @brief Whether the reader has run past the end. */
+	int overrun;
+} test_reader;
+
+/**
+ * @brief Reads a little-endian integer.
+ *
+ * @param[in,out] reader
+ *
+ *   Reader.
+ *
+ * @param[in] size
+ *
+ *   Number of bytes.
+ *
+ * @return
+ *
+ *   Integer. `0` if the file ends.
+ */
+static uint64_t test_read (test_reader* reader, size_t size) {
+	const uint8_t* bytes = reader->next;
+	uint64_t value = 0u;
+	if ((size_t)(reader->end - bytes) < size) {
+		reader->overrun = 1;
+		reader->next = reader->end;
+		return 0u;
+	}
+	reader->next += size;
+	while (size > 0u) {
+		--size;
+		value = (value << 8) | bytes[size];
+	}
+	return value;
+}
+
+/**
+ * @brief Reads a little-endian `int16_t`.
+ *
+ * @param[in,out] reader
+ *
+ *   Reader.
+ *
+ * @return
+ *
+ *   Value.
+ */
+static int16_t test_read_int16 (test_reader* reader) {
+	return (int16_t)(uint16_t)test_read(reader, 2u);
+}
+
+/**
+ * @brief Reads a little-endian `double`.
+ *
+ * @param[in,out] reader
+ *
+ *   Reader.
+ *
+ * @return
+ *
+ *   Value.
+ */
+static double test_read_double (test_reader* reader) {
+	const uint64_t bits = test_read(reader, 8u);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/**
+ * @brief Decimates the input, and compares with the golden outputs.
+ *
+ * @param[in,out] reader
+ *
+ *   Reader at the parameters of the case.
+ *
+ * @param[in] xs
+ *
+ *   Input values.
+ *
+ * @param[in] num_inputs
+ *
+ *   Number of input values.
+ *
+ * @return
+ *
+ *   Number of outputs that differ or are missing.
+ */
+static uint32_t test_cic (test_reader* reader, const int16_t* xs, uint32_t num_inputs) {
+	const uint8_t order = (uint8_t)test_read(reader, 1u);
+	const uint8_t log2_factor = (uint8_t)test_read(reader, 1u);
+	const uint32_t num_outputs = (uint32_t)test_read(reader, 4u);
+	dsp_cic cic = dsp_cic_initializer(order, log2_factor);
+	uint32_t num_mismatches = 0u;
+	uint32_t j = 0u;
+	uint32_t i;
+	int16_t y;
+	for (i = 0u; i < num_inputs; ++i) {
+		if (dsp_cic_process(&cic, xs[i], &y)) {
+			if ((j >= num_outputs) || (y != test_read_int16(reader))) {
+				++num_mismatches;
+			}
+			++j;
+		}
+	}
+	printf(
+		"cic order %u, factor %-5u: %u output(s), %u differ\n",
+		(unsigned)order,
+		1u << log2_factor,
+		(unsigned)j,
+		(unsigned)num_mismatches);
+	if (j != num_outputs) {
+		num_mismatches += (j > num_outputs) ? 0u : num_outputs - j;
+		reader->overrun = 1;
+	}
+	return num_mismatches;
+}
+
+/**
+ * @brief Filters the input, and compares with the golden outputs.
+ *
+ * @param[in,out] reader
+ *
+ *   Reader at the parameters of the case.
+ *
+ * @param[in] xs
+ *
+ *   Input values.
+ *
+ * @param[in] num_inputs
+ *
+ *   Number of input values.
+ *
+ * @return
+ *
+ *   Number of outputs that differ.
+ */
+static uint32_t test_biquad (test_reader* reader, const int16_t* xs, uint32_t num_inputs) {
+	const uint8_t num_stages = (uint8_t)test_read(reader, 1u);
+	dsp_biquad_coefficients coefficients[TEST_MAX_BIQUADS];
+	dsp_biquad stages[TEST_MAX_BIQUADS];
+	uint32_t num_outputs;
+	uint32_t num_mismatches = 0u;
+	uint32_t i;
+	TEST_CHECK(num_stages <= TEST_MAX_BIQUADS);
+	if (num_stages > TEST_MAX_BIQUADS) {
+		reader->overrun = 1;
+		return 0u;
+	}
+	for (i = 0u; i < num_stages; ++i) {
+		double c[5];
+		int k;
+		for (k = 0; k < 5; ++k) {
+			c[k] = test_read_double(reader);
+		}
+		coefficients[i].b0 = DSP_BIQUAD_Q14(c[0]);
+		coefficients[i].b1 = DSP_BIQUAD_Q14(c[1]);
+		coefficients[i].b2 = DSP_BIQUAD_Q14(c[2]);
+		coefficients[i].a1 = DSP_BIQUAD_Q14(c[3]);
+		coefficients[i].a2 = DSP_BIQUAD_Q14(c[4]);
+		stages[i].coefficients = &coefficients[i];
+		stages[i].x1 = stages[i].x2 = 0;
+		stages[i].y1 = stages[i].y2 = 0;
+	}
+	num_outputs = (uint32_t)test_read(reader, 4u);
+	TEST_CHECK_EQUAL(num_outputs, num_inputs);
+	for (i = 0u; (i < num_inputs) && (i < num_outputs); ++i) {
+		const int16_t y = dsp_biquad_cascade_process(stages, num_stages, xs[i]);
+		if (y != test_read_int16(reader)) {
+			++num_mismatches;
+		}
+	}
+	printf(
+		"biquad x%u (b0 %+7.4f)  : %u output(s), %u differ\n",
+		(unsigned)num_stages,
+		coefficients[0].b0 / (double)(1 << DSP_BIQUAD_SHIFT),
+		(unsigned)i,
+		(unsigned)num_mismatches);
+	return num_mismatches;
+}
+
+/**
+ * @brief Accumulates windows of the input, and compares with the golden
+ * features.
+ *
+ * @param[in,out] reader
+ *
+ *   Reader at the parameters of the case.
+ *
+ * @param[in] xs
+ *
+ *   Input values.
+ *
+ * @param[in] num_inputs
+ *
+ *   Number of input values.
+ *
+ * @return
+ *
+ *   Number of windows whose features differ or are missing.
+ */
+static uint32_t test_window (test_reader* reader, const int16_t* xs, uint32_t num_inputs) {
+	const uint32_t length = (uint32_t)test_read(reader, 4u);
+	const uint32_t num_outputs = (uint32_t)test_read(reader, 4u);
+	dsp_window window = dsp_window_initializer(length);
+	dsp_features features;
+	uint32_t num_mismatches = 0u;
+	uint32_t j = 0u;
+	uint32_t i;
+	for (i = 0u; i < num_inputs; ++i) {
+		if (dsp_window_add(&window, xs[i], &features)) {
+			if (j >= num_outputs) {
+				++num_mismatches;
+			} else {
+				const int16_t mean = test_read_int16(reader);
+				const uint16_t rms = (uint16_t)test_read(reader, 2u);
+				const uint16_t peak = (uint16_t)test_read(reader, 2u);
+				if ((features.mean != mean) ||
+					(features.rms != rms) ||
+					(features.peak != peak))
+				{
+					++num_mismatches;
+				}
+			}
+			++j;
+		}
+	}
+	printf(
+		"window %-16u: %u output(s), %u differ\n",
+		(unsigned)length,
+		(unsigned)j,
+		(unsigned)num_mismatches);
+	if (j != num_outputs) {
+		num_mismatches += (j > num_outputs) ? 0u : num_outputs - j;
+		reader->overrun = 1;
+	}
+	return num_mismatches;
+}
+
+int main (void) {
+	const char* path = TEST_BLOB_DIR "/dsp-golden.bin";
+	size_t size;
+	uint8_t* data = test_load_file(path, &size);
+	test_reader reader;
+	int16_t* xs;
+	uint32_t num_inputs;
+	uint32_t num_cases;
+	uint32_t i;
+	if ((data == NULL) || (size < 8u) || (memcmp(data, "DSPG", 4u) != 0)) {
+		fprintf(stderr, "%s is not a golden file\n", path);
+		return 1;
+	}
+	reader.next = data + 4;
+	reader.end = data + size;
+	reader.overrun = 0;
+	num_inputs = (uint32_t)test_read(&reader, 4u);
+	xs = (int16_t*)malloc(num_inputs * sizeof(int16_t));
+	for (i = 0u; i < num_inputs; ++i) {
+		xs[i] = test_read_int16(&reader);
+	}
+	num_cases = (uint32_t)test_read(&reader, 4u);
+	TEST_CHECK(num_cases > 0u);
+	for (i = 0u; (i < num_cases) && !reader.overrun; ++i) {
+		uint32_t num_mismatches;
+		switch ((test_case_kind)test_read(&reader, 1u)) {
+		case TEST_CASE_CIC:
+			num_mismatches = test_cic(&reader, xs, num_inputs);
+			break;
+		case TEST_CASE_BIQUAD:
+			num_mismatches = test_biquad(&reader, xs, num_inputs);
+			break;
+		case TEST_CASE_WINDOW:
+			num_mismatches = test_window(&reader, xs, num_inputs);
+			break;
+		default:
+			fprintf(stderr, "unknown case #%u\n", (unsigned)i);
+			reader.overrun = 1;
+			num_mismatches = 0u;
+			break;
+		}
+		TEST_CHECK_EQUAL(num_mismatches, 0u);
+	}
+	TEST_CHECK(!reader.overrun);
+	TEST_CHECK(reader.next == reader.end);
+	free(xs);
+	free(data);
+	return test_result();
+}
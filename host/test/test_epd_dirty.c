@@ -0,0 +1,409 @@
+/**
+ * @file test_epd_dirty.c
+ *
+ * Tests dirty rectangles of `image_buffer` and their upload by
+ * `epd_draw_image_buffer_dirty` and `epd_draw_image_buffer_changed`.
+ *
+ * `image_buffer_mark_dirty` aligns a rectangle to bytes and clips it to the
+ * buffer, merges it with a rectangle when the union costs no extra bytes,
+ * and merges it with the rectangle that grows least when the list is full.
+ * Every dirty rectangle is then uploaded as a window, whose rows are packed
+ * into blocks, so the EPD receives exactly the bytes of the rectangles.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+#include "image_buffer.h"
+
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for DC. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. */
+#define TEST_PIN_BUSY  26
+
+/** @brief Width of the frame; that of the 1.54" panel. */
+#define TEST_WIDTH  EPD_PANEL_1IN54_V2_RAM_WIDTH
+/** @brief Height of the frame; that of the 1.54" panel. */
+#define TEST_HEIGHT  EPD_PANEL_1IN54_V2_HEIGHT
+
+/**
+ * @brief Data bytes to set a window besides its rows.
+ *
+ * The X range (2 bytes) and address (1 byte), and the Y range (4 bytes) and
+ * address (2 bytes).
+ */
+#define TEST_WINDOW_SETUP_BYTES  9u
+
+/**
+ * @brief Transactions to set a window and start writing the RAM.
+ *
+ * A command and its data for each of the X range, X address, Y range and
+ * Y address, and the Write RAM command.
+ */
+#define TEST_WINDOW_SETUP_TRANSACTIONS  9u
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t test_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Black square of 64x64 pixels. */
+static const uint8_t TEST_BLACK_SQUARE[64u * 64u / 8u];
+
+/**
+ * @brief Whether an image buffer has a given dirty rectangle.
+ *
+ * @param[in] buffer
+ *
+ *   Image buffer.
+ *
+ * @param[in] left
+ *
+ *   Left position of the rectangle.
+ *
+ * @param[in] top
+ *
+ *   Top position of the rectangle.
+ *
+ * @param[in] right
+ *
+ *   Right position of the rectangle (exclusive).
+ *
+ * @param[in] bottom
+ *
+ *   Bottom position of the rectangle (exclusive).
+ */
+static int test_has_dirty_rect (
+		const image_buffer* buffer,
+		int left,
+		int top,
+		int right,
+		int bottom)
+{
+	const image_buffer_rect* rect;
+	int i;
+	for (i = 0; i < image_buffer_num_dirty_rects(buffer); ++i) {
+		rect = image_buffer_dirty_rect(buffer, i);
+		if ((rect->left == left) &&
+			(rect->top == top) &&
+			(rect->right == right) &&
+			(rect->bottom == bottom))
+		{
+			return 1;
+		}
+	}
+	fprintf(
+		stderr,
+		"no dirty rect [%d, %d) x [%d, %d) in %d rect(s)\n",
+		left,
+		right,
+		top,
+		bottom,
+		image_buffer_num_dirty_rects(buffer));
+	return 0;
+}
+
+/** @brief Rectangles are merged when the union costs no extra bytes. */
+static void test_union (void) {
+	image_buffer buffer = image_buffer_initializer(
+		test_frame_memory,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	// side by side
+	image_buffer_mark_dirty(&buffer, 0, 0, 16, 8);
+	image_buffer_mark_dirty(&buffer, 16, 0, 16, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 1);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 0, 32, 8));
+	// inside
+	image_buffer_mark_dirty(&buffer, 2, 2, 4, 4);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 1);
+	// apart
+	image_buffer_mark_dirty(&buffer, 64, 64, 8, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 2);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 64, 64, 72, 72));
+	// bridges two rectangles; the union with one of them makes it
+	// mergeable with the other one
+	image_buffer_clear_dirty(&buffer);
+	image_buffer_mark_dirty(&buffer, 0, 0, 8, 8);
+	image_buffer_mark_dirty(&buffer, 16, 0, 8, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 2);
+	image_buffer_mark_dirty(&buffer, 8, 0, 8, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 1);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 0, 24, 8));
+}
+
+/** @brief Rectangles are aligned to bytes and clipped to the buffer. */
+static void test_clip (void) {
+	image_buffer buffer = image_buffer_initializer(
+		test_frame_memory,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	// top-left corner
+	image_buffer_mark_dirty(&buffer, -5, -3, 20, 10);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 1);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 0, 16, 7));
+	// unaligned edges widen to bytes
+	image_buffer_clear_dirty(&buffer);
+	image_buffer_mark_dirty(&buffer, 3, 50, 10, 4);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 50, 16, 54));
+	// bottom-right corner
+	image_buffer_clear_dirty(&buffer);
+	image_buffer_mark_dirty(&buffer, TEST_WIDTH - 4, TEST_HEIGHT - 2, 20, 10);
+	TEST_CHECK(test_has_dirty_rect(
+		&buffer,
+		TEST_WIDTH - 8,
+		TEST_HEIGHT - 2,
+		TEST_WIDTH,
+		TEST_HEIGHT));
+	// outside or empty
+	image_buffer_clear_dirty(&buffer);
+	image_buffer_mark_dirty(&buffer, TEST_WIDTH + 50, 10, 8, 8);
+	image_buffer_mark_dirty(&buffer, 10, -20, 8, 8);
+	image_buffer_mark_dirty(&buffer, 10, 10, 0, 5);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 0);
+}
+
+/** @brief A full list merges the rectangle that grows least. */
+static void test_list_full (void) {
+	image_buffer buffer = image_buffer_initializer(
+		test_frame_memory,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	image_buffer_mark_dirty(&buffer, 0, 0, 8, 8);
+	image_buffer_mark_dirty(&buffer, 96, 0, 8, 8);
+	image_buffer_mark_dirty(&buffer, 0, 96, 8, 8);
+	image_buffer_mark_dirty(&buffer, 96, 96, 8, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), IMAGE_BUFFER_MAX_DIRTY_RECTS);
+	// next to the last one
+	image_buffer_mark_dirty(&buffer, 112, 104, 8, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), IMAGE_BUFFER_MAX_DIRTY_RECTS);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 0, 8, 8));
+	TEST_CHECK(test_has_dirty_rect(&buffer, 96, 0, 104, 8));
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 96, 8, 104));
+	TEST_CHECK(test_has_dirty_rect(&buffer, 96, 96, 120, 112));
+	// next to the first one
+	image_buffer_mark_dirty(&buffer, 8, 8, 8, 8);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), IMAGE_BUFFER_MAX_DIRTY_RECTS);
+	TEST_CHECK(test_has_dirty_rect(&buffer, 0, 0, 16, 16));
+}
+
+/**
+ * @brief Uploads the dirty rectangles of a frame, and checks what is sent.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] sim
+ *
+ *   Simulated controller of `epd`.
+ *
+ * @param[in,out] frame
+ *
+ *   Frame to upload.
+ */
+static void test_upload_frame (
+		epd_device* epd,
+		const epd_sim* sim,
+		image_buffer* frame)
+{
+	const size_t stride = TEST_WIDTH / 8u;
+	const image_buffer_rect* rect;
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	size_t expected_bytes = 0u;
+	size_t expected_transactions = 0u;
+	size_t rows_per_block;
+	size_t num_rows;
+	size_t row_size;
+	size_t num_data;
+	int num_rects;
+	int i;
+	num_rects = image_buffer_num_dirty_rects(frame);
+	for (i = 0; i < num_rects; ++i) {
+		rect = image_buffer_dirty_rect(frame, i);
+		row_size = (rect->right - rect->left) / 8u;
+		num_rows = rect->bottom - rect->top;
+		expected_bytes += TEST_WINDOW_SETUP_BYTES + (row_size * num_rows);
+		expected_transactions += TEST_WINDOW_SETUP_TRANSACTIONS;
+		if (row_size == stride) {
+			// straight from the frame in chunks
+			expected_transactions +=
+				(row_size * num_rows + EPD_MAX_TRANSFER_SIZE - 1u) /
+				EPD_MAX_TRANSFER_SIZE;
+		} else {
+			rows_per_block = EPD_STREAM_BLOCK_SIZE / row_size;
+			expected_transactions +=
+				(num_rows + rows_per_block - 1u) / rows_per_block;
+		}
+	}
+	num_data = sim->num_data_total;
+	hal_linux_get_stats(&start);
+	epd_draw_image_buffer_dirty(epd, frame);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	TEST_CHECK_EQUAL(sim->num_data_total - num_data, expected_bytes);
+	TEST_CHECK_EQUAL(stats.num_transactions, expected_transactions);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(frame), 0);
+	TEST_CHECK(memcmp(
+		test_panel_memory,
+		test_frame_memory,
+		epd_panel_frame_size(epd->panel)) == 0);
+	printf(
+		"%d window(s): %5u bytes, %2u transactions, %.3f ms\n",
+		num_rects,
+		(unsigned)(sim->num_data_total - num_data),
+		(unsigned)stats.num_transactions,
+		stats.elapsed_ns * 1e-6);
+}
+
+/**
+ * @brief Initializes and clears a simulated 1.54" EPD.
+ *
+ * @param[out] epd
+ *
+ *   EPD to initialize.
+ *
+ * @param[out] sim
+ *
+ *   Simulated controller attached to `epd`.
+ */
+static void test_init_epd (epd_device* epd, epd_sim* sim) {
+	const epd_panel* panel = &EPD_PANELS[EPD_PANEL_1IN54_V2];
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	hal_spi_device spi;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(sim, TEST_PIN_DC, TEST_PIN_BUSY, NULL);
+	epd_sim_attach(sim, spi);
+	epd_device_init(
+		epd,
+		panel,
+		spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	epd_configure_gpios(epd);
+	epd_initialize(epd);
+	epd_clear_all(epd);
+}
+
+/** @brief Windows are uploaded with their bytes and nothing else. */
+static void test_upload (void) {
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	epd_device epd;
+	epd_sim sim;
+	int i;
+	test_init_epd(&epd, &sim);
+	// the whole frame in a window of full width
+	image_buffer_clear_all(&frame);
+	test_upload_frame(&epd, &sim, &frame);
+	// two sprites, one clipped by the right edge
+	image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 8, 8, 64, 64);
+	image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 170, 120, 64, 64);
+	TEST_CHECK(test_has_dirty_rect(&frame, 8, 8, 72, 72));
+	TEST_CHECK(test_has_dirty_rect(&frame, 168, 120, 200, 184));
+	test_upload_frame(&epd, &sim, &frame);
+	// more sprites than rectangles
+	for (i = 0; i < 6; ++i) {
+		image_buffer_clear_range(&frame, 16 + 24 * i, 80 + 4 * i, 16, 16);
+	}
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&frame), IMAGE_BUFFER_MAX_DIRTY_RECTS);
+	test_upload_frame(&epd, &sim, &frame);
+}
+
+/**
+ * @brief Draws a frame with `epd_draw_image_buffer_changed`, and checks the
+ * number of bytes sent.
+ *
+ * @param[in,out] epd
+ *
+ *   EPD.
+ *
+ * @param[in] sim
+ *
+ *   Simulated controller of `epd`.
+ *
+ * @param[in,out] frame
+ *
+ *   Frame to draw.
+ *
+ * @param[in] expected_bytes
+ *
+ *   Number of data bytes expected to be sent.
+ */
+static void test_draw_changed (
+		epd_device* epd,
+		const epd_sim* sim,
+		image_buffer* frame,
+		size_t expected_bytes)
+{
+	const size_t num_data = sim->num_data_total;
+	epd_draw_image_buffer_changed(epd, frame);
+	TEST_CHECK_EQUAL(sim->num_data_total - num_data, expected_bytes);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(frame), 0);
+	TEST_CHECK(memcmp(
+		test_panel_memory,
+		test_frame_memory,
+		epd_panel_frame_size(epd->panel)) == 0);
+}
+
+/**
+ * @brief `epd_draw_image_buffer_changed` takes windows or runs of rows,
+ * whichever are fewer bytes.
+ */
+static void test_choose (void) {
+	const size_t stride = TEST_WIDTH / 8u;
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	epd_device epd;
+	epd_sim sim;
+	test_init_epd(&epd, &sim);
+	image_buffer_clear_all(&frame);
+	image_buffer_clear_dirty(&frame);
+	// a sprite narrower than the rows goes in a window
+	image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 8, 8, 64, 64);
+	test_draw_changed(
+		&epd,
+		&sim,
+		&frame,
+		TEST_WINDOW_SETUP_BYTES + (64u / 8u) * 64u);
+	// a sprite drawn where it was is dirty but unchanged
+	image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 8, 8, 64, 64);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&frame), 1);
+	test_draw_changed(&epd, &sim, &frame, 0u);
+	// a dirty rectangle far larger than the change goes in a run of rows
+	image_buffer_mark_dirty(&frame, 0, 0, TEST_WIDTH - 8, TEST_HEIGHT);
+	test_frame_memory[100u * stride] = 0x00u;
+	test_draw_changed(&epd, &sim, &frame, TEST_WINDOW_SETUP_BYTES + stride);
+	// a change written without dirty rectangles goes in a run of rows
+	test_frame_memory[150u * stride + 3u] = 0x00u;
+	test_draw_changed(&epd, &sim, &frame, TEST_WINDOW_SETUP_BYTES + stride);
+}
+
+int main (void) {
+	test_union();
+	test_clip();
+	test_list_full();
+	test_upload();
+	test_choose();
+	return test_result();
+}
@@ -0,0 +1,221 @@
+/**
+ * @file test_epd_driver.c
+ *
+ * Tests of the EPD driver against a simulated controller.
+ */
+
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for DC. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. */
+#define TEST_PIN_BUSY  26
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t test_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Black square of 64x64 pixels. */
+static const uint8_t TEST_BLACK_SQUARE[64u * 64u / 8u];
+
+/** @brief Time for a notified task to run again (ns); a context switch. */
+#define TEST_TASK_WAKEUP_NS  20000
+
+/** @brief Period of polling BUSY before the interrupt (ms). */
+#define TEST_POLLING_PERIOD_MS  100u
+
+/** @brief Time when BUSY went LOW (ns). */
+static int64_t test_busy_fell_ns;
+
+/**
+ * @brief Drives BUSY LOW, which notifies the waiting task from the ISR.
+ *
+ * @param[in] arg
+ *
+ *   Unused.
+ */
+static void test_busy_falls (void* arg) {
+	(void)arg;
+	test_busy_fell_ns = hal_linux_get_time_ns();
+	hal_linux_set_input_level(TEST_PIN_BUSY, 0);
+}
+
+/**
+ * @brief Waits for BUSY like the driver did before the interrupt.
+ *
+ * @param[in] busy_pin
+ *
+ *   GPIO# for BUSY.
+ */
+static void test_wait_busy_polling (int busy_pin) {
+	while (hal_gpio_get_level(busy_pin) == 1u) {
+		hal_delay_ms(TEST_POLLING_PERIOD_MS);
+	}
+}
+
+/**
+ * @brief Attaches a simulated EPD of a given panel, and initializes it.
+ *
+ * @param[out] epd
+ *
+ *   EPD.
+ *
+ * @param[out] sim
+ *
+ *   Simulated controller.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ */
+static void test_setup (epd_device* epd, epd_sim* sim, const epd_panel* panel) {
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	hal_spi_device spi;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	TEST_CHECK(spi != NULL);
+	epd_sim_init(sim, TEST_PIN_DC, TEST_PIN_BUSY, NULL);
+	epd_sim_attach(sim, spi);
+	epd_device_init(
+		epd,
+		panel,
+		spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	epd_configure_gpios(epd);
+}
+
+/** @brief Initialization waits for the software reset. */
+static void test_initialize (void) {
+	epd_device epd;
+	epd_sim sim;
+	test_setup(&epd, &sim, &EPD_PANELS[EPD_PANEL_1IN54_V2]);
+	epd_initialize(&epd);
+	epd_sim_flush(&sim);
+	TEST_CHECK_EQUAL(hal_gpio_get_level(TEST_PIN_BUSY), 0);
+	TEST_CHECK_EQUAL(sim.busy_total_ns, sim.reset_ns);
+	// RST pulse (410ms) and the software reset
+	TEST_CHECK(hal_linux_get_time_ns() >= 410000000 + sim.reset_ns);
+	TEST_CHECK(sim.num_commands >= 8u);
+	TEST_CHECK_EQUAL(sim.num_activations, 0);
+}
+
+/** @brief A refresh blocks until BUSY goes LOW. */
+static void test_refresh_waits_for_busy (void) {
+	const epd_panel* panel = &EPD_PANELS[EPD_PANEL_1IN54_V2];
+	epd_device epd;
+	epd_sim sim;
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		panel->ram_width,
+		panel->height);
+	int64_t start_ns;
+	test_setup(&epd, &sim, panel);
+	epd_initialize(&epd);
+	epd_enable_display_mode_1(&epd);
+	epd_clear_all(&epd);
+	image_buffer_clear_all(&frame);
+	image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 8, 8, 64, 64);
+	epd_draw_image_buffer_diff(&epd, &frame);
+	TEST_CHECK(memcmp(test_panel_memory, test_frame_memory, epd_panel_frame_size(panel)) == 0);
+	start_ns = hal_linux_get_time_ns();
+	epd_refresh_display_mode_1(&epd);
+	TEST_CHECK_EQUAL(sim.num_activations, 2);
+	TEST_CHECK_EQUAL(sim.sequence, panel->sequences.display_1);
+	TEST_CHECK(hal_linux_get_time_ns() - start_ns >= sim.refresh_ns);
+	TEST_CHECK_EQUAL(hal_gpio_get_level(TEST_PIN_BUSY), 0);
+}
+
+/** @brief Waiting for a stuck BUSY times out. */
+static void test_wait_busy_times_out (void) {
+	epd_device epd;
+	epd_sim sim;
+	hal_err_t ret;
+	int64_t start_ns;
+	test_setup(&epd, &sim, &EPD_PANELS[EPD_PANEL_2IN9_V2]);
+	epd_initialize(&epd);
+	sim.refresh_ns = 10000000000;
+	epd_start_refresh_display_mode_1(&epd);
+	start_ns = hal_linux_get_time_ns();
+	ret = epd_wait_busy_timeout(&epd, 100u);
+	TEST_CHECK_EQUAL(ret, HAL_ERR_TIMEOUT);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns() - start_ns, 100000000);
+	ret = epd_wait_busy_timeout(&epd, HAL_WAIT_FOREVER);
+	TEST_CHECK_EQUAL(ret, HAL_OK);
+}
+
+/**
+ * @brief The waiting task runs a context switch after BUSY goes LOW,
+ * instead of at the next poll.
+ */
+static void test_wait_busy_latency (void) {
+	epd_device epd;
+	epd_sim sim;
+	hal_err_t ret;
+	test_setup(&epd, &sim, &EPD_PANELS[EPD_PANEL_1IN54_V2]);
+	hal_linux_set_task_wakeup_ns(TEST_TASK_WAKEUP_NS);
+	// falls between two polls
+	hal_linux_set_input_level(TEST_PIN_BUSY, 1);
+	hal_linux_schedule(hal_linux_get_time_ns() + 250000000, test_busy_falls, NULL);
+	ret = epd_wait_busy_timeout(&epd, 1000u);
+	TEST_CHECK_EQUAL(ret, HAL_OK);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns() - test_busy_fell_ns, TEST_TASK_WAKEUP_NS);
+	// the same edge found by polling
+	hal_linux_set_input_level(TEST_PIN_BUSY, 1);
+	hal_linux_schedule(hal_linux_get_time_ns() + 250000000, test_busy_falls, NULL);
+	test_wait_busy_polling(TEST_PIN_BUSY);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns() - test_busy_fell_ns, 50000000);
+}
+
+/** @brief A label drawn directly is not transferred again by a diff. */
+static void test_rle_image_updates_panel_image (void) {
+	// 16x2 black pixels; each row repeats 0x00 twice
+	static const uint8_t data[] = { 0xFFu, 0x00u, 0xFFu, 0x00u };
+	const rle_image label = rle_image_initializer(data, sizeof(data), 16u, 2u, 0u);
+	const epd_panel* panel = &EPD_PANELS[EPD_PANEL_1IN54_V2];
+	epd_device epd;
+	epd_sim sim;
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		panel->ram_width,
+		panel->height);
+	hal_linux_stats start;
+	hal_linux_stats stats;
+	test_setup(&epd, &sim, panel);
+	epd_initialize(&epd);
+	epd_clear_all(&epd);
+	TEST_CHECK_EQUAL(epd_draw_rle_image(&epd, &label, 8u, 2u), 0);
+	image_buffer_clear_all(&frame);
+	TEST_CHECK_EQUAL(rle_image_draw(&frame, &label, 8, 2), 0);
+	TEST_CHECK(memcmp(test_panel_memory, test_frame_memory, epd_panel_frame_size(panel)) == 0);
+	hal_linux_get_stats(&start);
+	epd_draw_image_buffer_diff(&epd, &frame);
+	hal_linux_get_stats(&stats);
+	hal_linux_stats_diff(&stats, &start, &stats);
+	TEST_CHECK_EQUAL(stats.num_transactions, 0);
+}
+
+int main (void) {
+	test_initialize();
+	test_refresh_waits_for_busy();
+	test_wait_busy_times_out();
+	test_wait_busy_latency();
+	test_rle_image_updates_panel_image();
+	return test_result();
+}
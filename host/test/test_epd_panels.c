@@ -0,0 +1,410 @@
+/**
+ * @file test_epd_panels.c
+ *
+ * Tests the commands sent to every panel in `EPD_PANELS` against golden
+ * traces.
+ *
+ * `epd_initialize` and a frame of a 64x64 square in the display mode 1 are
+ * recorded by a simulated controller on the Linux HAL. Geometry shows up in
+ * the Driver Output Control (`0x01`), the X and Y ranges (`0x44`, `0x45`)
+ * and the sizes of RAM writes (`0x24`), so a change to a descriptor or to
+ * the driver that alters any of them fails here. The events recorded by
+ * the HAL, hashed with their times, catch changes that keep the commands but
+ * split or merge their transfers, toggle pins differently or move them in
+ * time. A mismatch of the hash prints the events.
+ *
+ * Update a golden trace only after checking the new one on the panel.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for DC. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. */
+#define TEST_PIN_BUSY  26
+
+/** @brief Maximum number of characters in a line of a trace. */
+#define TEST_MAX_LINE  64
+
+/** @brief Number of lines of a golden trace. */
+#define TEST_NUM_LINES(trace)  (int)(sizeof(trace) / sizeof(trace[0]))
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t test_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Black square of 64x64 pixels. */
+static const uint8_t TEST_BLACK_SQUARE[64u * 64u / 8u];
+
+/** @brief Golden trace of the 1.54" V2 panel. */
+static const char* const TEST_GOLDEN_1IN54_V2[] = {
+	// epd_initialize
+	"12",
+	"01 C7 00 00",
+	"11 03",
+	"44 00 18",
+	"4E 00",
+	"45 00 00 C7 00",
+	"4F 00 00",
+	"3C 00",
+	"18 80",
+	// epd_enable_display_mode_1
+	"22 B1",
+	"20",
+	// epd_clear_all
+	"44 00 18",
+	"4E 00",
+	"45 00 00 C7 00",
+	"4F 00 00",
+	"24 [5000 bytes, sum 0x00137478]",
+	// epd_draw_image_buffer_diff of a 64x64 square at (8, 8)
+	"44 00 18",
+	"4E 00",
+	"45 08 00 47 00",
+	"4F 08 00",
+	"24 [1600 bytes, sum 0x00043BC0]",
+	// epd_refresh_display_mode_1
+	"22 C7",
+	"20"
+};
+
+/** @brief Golden trace of the 2.13" V4 panel. */
+static const char* const TEST_GOLDEN_2IN13_V4[] = {
+	// epd_initialize
+	"12",
+	"01 F9 00 00",
+	"11 03",
+	"44 00 0F",
+	"4E 00",
+	"45 00 00 F9 00",
+	"4F 00 00",
+	"3C 00",
+	"18 80",
+	// epd_enable_display_mode_1
+	"22 B1",
+	"20",
+	// epd_clear_all
+	"44 00 0F",
+	"4E 00",
+	"45 00 00 F9 00",
+	"4F 00 00",
+	"24 [4000 bytes, sum 0x000F9060]",
+	// epd_draw_image_buffer_diff of a 64x64 square at (8, 8)
+	"44 00 0F",
+	"4E 00",
+	"45 08 00 47 00",
+	"4F 08 00",
+	"24 [1024 bytes, sum 0x0001FE00]",
+	// epd_refresh_display_mode_1
+	"22 C7",
+	"20"
+};
+
+/** @brief Golden trace of the 2.9" V2 panel. */
+static const char* const TEST_GOLDEN_2IN9_V2[] = {
+	// epd_initialize
+	"12",
+	"01 27 01 00",
+	"11 03",
+	"44 00 0F",
+	"4E 00",
+	"45 00 00 27 01",
+	"4F 00 00",
+	"3C 00",
+	"18 80",
+	// epd_enable_display_mode_1
+	"22 B1",
+	"20",
+	// epd_clear_all
+	"44 00 0F",
+	"4E 00",
+	"45 00 00 27 01",
+	"4F 00 00",
+	"24 [4736 bytes, sum 0x00126D80]",
+	// epd_draw_image_buffer_diff of a 64x64 square at (8, 8)
+	"44 00 0F",
+	"4E 00",
+	"45 08 00 47 00",
+	"4F 08 00",
+	"24 [1024 bytes, sum 0x0001FE00]",
+	// epd_refresh_display_mode_1
+	"22 C7",
+	"20"
+};
+
+/** @brief Golden trace of the 4.2" V2 panel. */
+static const char* const TEST_GOLDEN_4IN2_V2[] = {
+	// epd_initialize
+	"12",
+	"01 2B 01 00",
+	"11 03",
+	"44 00 31",
+	"4E 00",
+	"45 00 00 2B 01",
+	"4F 00 00",
+	"3C 00",
+	"18 80",
+	// epd_enable_display_mode_1
+	"22 B1",
+	"20",
+	// epd_clear_all
+	"44 00 31",
+	"4E 00",
+	"45 00 00 2B 01",
+	"4F 00 00",
+	"24 [15000 bytes, sum 0x003A5D68]",
+	// epd_draw_image_buffer_diff of a 64x64 square at (8, 8)
+	"44 00 31",
+	"4E 00",
+	"45 08 00 47 00",
+	"4F 08 00",
+	"24 [3200 bytes, sum 0x000A7580]",
+	// epd_refresh_display_mode_1
+	"22 C7",
+	"20"
+};
+
+/** @brief Golden trace of a panel. */
+typedef struct {
+	/** @brief Panel. */
+	epd_panel_id panel_id;
+	/** @brief Lines of the trace. */
+	const char* const* lines;
+	/** @brief Number of `lines`. */
+	int num_lines;
+	/** @brief Number of events recorded by the HAL. */
+	uint32_t num_events;
+	/** @brief Hash of the events; see `::test_hash_events`. */
+	uint32_t events_hash;
+} test_golden;
+
+/** @brief Golden traces of the panels. */
+static const test_golden TEST_GOLDENS[EPD_NUM_PANELS] = {
+	{
+		EPD_PANEL_1IN54_V2,
+		TEST_GOLDEN_1IN54_V2,
+		TEST_NUM_LINES(TEST_GOLDEN_1IN54_V2),
+		97u,
+		0x0FD57ACEu
+	},
+	{
+		EPD_PANEL_2IN13_V4,
+		TEST_GOLDEN_2IN13_V4,
+		TEST_NUM_LINES(TEST_GOLDEN_2IN13_V4),
+		95u,
+		0x8902CF51u
+	},
+	{
+		EPD_PANEL_2IN9_V2,
+		TEST_GOLDEN_2IN9_V2,
+		TEST_NUM_LINES(TEST_GOLDEN_2IN9_V2),
+		97u,
+		0x72C6A283u
+	},
+	{
+		EPD_PANEL_4IN2_V2,
+		TEST_GOLDEN_4IN2_V2,
+		TEST_NUM_LINES(TEST_GOLDEN_4IN2_V2),
+		117u,
+		0xCBD41D2Au
+	}
+};
+
+/**
+ * @brief Mixes a value into an FNV-1a hash.
+ *
+ * @param[in] hash
+ *
+ *   Hash so far.
+ *
+ * @param[in] value
+ *
+ *   Value to mix, a byte at a time from the LSB.
+ *
+ * @return
+ *
+ *   New hash.
+ */
+static uint32_t test_hash_value (uint32_t hash, uint64_t value) {
+	int i;
+	for (i = 0; i < 8; ++i) {
+		hash ^= (uint32_t)(value & 0xFFu);
+		hash *= 16777619u;
+		value >>= 8;
+	}
+	return hash;
+}
+
+/**
+ * @brief Hashes events recorded by the HAL.
+ *
+ * Every field of every event, including times, is mixed in order,
+ * except the device, whose address changes from run to run.
+ *
+ * @param[in] events
+ *
+ *   Events.
+ *
+ * @param[in] num_events
+ *
+ *   Number of `events`.
+ *
+ * @return
+ *
+ *   FNV-1a hash.
+ */
+static uint32_t test_hash_events (
+		const hal_linux_event* events,
+		size_t num_events)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+	for (i = 0u; i < num_events; ++i) {
+		hash = test_hash_value(hash, (uint64_t)events[i].kind);
+		hash = test_hash_value(hash, (uint64_t)events[i].start_ns);
+		hash = test_hash_value(hash, (uint64_t)events[i].end_ns);
+		hash = test_hash_value(hash, (uint64_t)events[i].wire_ns);
+		hash = test_hash_value(hash, events[i].command_or_pin);
+		hash = test_hash_value(hash, events[i].length_or_level);
+	}
+	return hash;
+}
+
+/**
+ * @brief Prints events recorded by the HAL.
+ *
+ * @param[in] events
+ *
+ *   Events.
+ *
+ * @param[in] num_events
+ *
+ *   Number of `events`.
+ */
+static void test_print_events (
+		const hal_linux_event* events,
+		size_t num_events)
+{
+	size_t i;
+	for (i = 0u; i < num_events; ++i) {
+		fprintf(
+			stderr,
+			"  %12lld..%12lld %s %u %u\n",
+			(long long)events[i].start_ns,
+			(long long)events[i].end_ns,
+			(events[i].kind == HAL_LINUX_EVENT_SPI) ? "SPI " : "GPIO",
+			(unsigned)events[i].command_or_pin,
+			(unsigned)events[i].length_or_level);
+	}
+}
+
+/**
+ * @brief Compares the trace of a panel with its golden one.
+ *
+ * @param[in] golden
+ *
+ *   Golden trace.
+ */
+static void test_panel (const test_golden* golden) {
+	const epd_panel* panel = &EPD_PANELS[golden->panel_id];
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		panel->ram_width,
+		panel->height);
+	char line[TEST_MAX_LINE];
+	const hal_linux_event* events;
+	size_t num_events;
+	uint32_t events_hash;
+	hal_spi_device spi;
+	epd_device epd;
+	epd_sim sim;
+	FILE* trace;
+	size_t len;
+	int num_lines = 0;
+	trace = tmpfile();
+	TEST_CHECK(trace != NULL);
+	if (trace == NULL) {
+		return;
+	}
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(&sim, TEST_PIN_DC, TEST_PIN_BUSY, trace);
+	epd_sim_attach(&sim, spi);
+	epd_device_init(
+		&epd,
+		panel,
+		spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	epd_configure_gpios(&epd);
+	epd_initialize(&epd);
+	epd_enable_display_mode_1(&epd);
+	epd_clear_all(&epd);
+	image_buffer_clear_all(&frame);
+	image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 8, 8, 64, 64);
+	epd_draw_image_buffer_diff(&epd, &frame);
+	epd_refresh_display_mode_1(&epd);
+	epd_sim_flush(&sim);
+	events = hal_linux_get_events(&num_events);
+	events_hash = test_hash_events(events, num_events);
+	rewind(trace);
+	while (fgets(line, sizeof(line), trace) != NULL) {
+		len = strlen(line);
+		if ((len > 0u) && (line[len - 1u] == '\n')) {
+			line[len - 1u] = '\0';
+		}
+		if ((num_lines >= golden->num_lines) ||
+			(strcmp(line, golden->lines[num_lines]) != 0))
+		{
+			fprintf(
+				stderr,
+				"%s: line %d: \"%s\" != \"%s\"\n",
+				panel->name,
+				num_lines + 1,
+				line,
+				(num_lines < golden->num_lines) ? golden->lines[num_lines] : "");
+			++test_num_failures;
+		}
+		++num_lines;
+	}
+	TEST_CHECK_EQUAL(num_lines, golden->num_lines);
+	TEST_CHECK_EQUAL(num_events, golden->num_events);
+	TEST_CHECK_EQUAL(events_hash, golden->events_hash);
+	if ((num_events != golden->num_events) ||
+		(events_hash != golden->events_hash))
+	{
+		fprintf(
+			stderr,
+			"%s: events (hash 0x%08X):\n",
+			panel->name,
+			(unsigned)events_hash);
+		test_print_events(events, num_events);
+	}
+	fclose(trace);
+}
+
+int main (void) {
+	int i;
+	for (i = 0; i < EPD_NUM_PANELS; ++i) {
+		test_panel(&TEST_GOLDENS[i]);
+	}
+	return test_result();
+}
@@ -0,0 +1,293 @@
+/**
+ * @file test_epd_partial.c
+ *
+ * Tests the commands of partial refreshes against a trace recorded by a
+ * simulated controller.
+ *
+ * Drives the EPD as `epd_worker_task` does in `EPD_DISPLAY_MODE_PARTIAL`:
+ * enables partial refreshes, then draws frames of a moving square with
+ * `epd_draw_image_buffer_partial` and `epd_start_refresh_partial_mode`.
+ * Every frame has to write the red RAM (`0x26`) before the black and white
+ * RAM (`0x24`), and refresh with `0xFC`, except that every
+ * `epd_device::max_partial_refreshes + 1`th frame is forced to a full
+ * refresh (`0xF7`). Runs with the default of the panel and with a limit of
+ * its own.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for DC. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. */
+#define TEST_PIN_BUSY  26
+
+/** @brief Number of partial refreshes before a full refresh, not the default. */
+#define TEST_MAX_PARTIAL_REFRESHES  3
+
+/** @brief Maximum number of characters in a line of a trace. */
+#define TEST_MAX_LINE  64
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to draw. */
+static uint8_t test_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Black square of 64x64 pixels. */
+static const uint8_t TEST_BLACK_SQUARE[64u * 64u / 8u];
+
+/**
+ * @brief Golden trace of enabling partial refreshes and the first two frames
+ * on the 1.54" panel.
+ *
+ * The first frame draws the square at the top; the second one moves it
+ * 8 rows down, so the red RAM gets the rows of the first square back, and
+ * only the rows above and below the overlap are sent to the black and white
+ * RAM.
+ */
+static const char* const TEST_GOLDEN_TRACE[] = {
+	// epd_enable_partial_refresh
+	"44 00 18",
+	"4E 00",
+	"45 00 00 C7 00",
+	"4F 00 00",
+	"26 [5000 bytes, sum 0x00137478]",
+	"44 00 18",
+	"4E 00",
+	"45 00 00 C7 00",
+	"4F 00 00",
+	"24 [5000 bytes, sum 0x00137478]",
+	"22 F7",
+	"20",
+	// frame 1: no previous frame to write to the red RAM
+	"44 00 18",
+	"4E 00",
+	"45 00 00 3F 00",
+	"4F 00 00",
+	"24 [1600 bytes, sum 0x00043BC0]",
+	"22 FC",
+	"20",
+	// frame 2: the first square to the red RAM, then two runs of rows
+	"44 00 18",
+	"4E 00",
+	"45 00 00 3F 00",
+	"4F 00 00",
+	"26 [1600 bytes, sum 0x00043BC0]",
+	"44 00 18",
+	"4E 00",
+	"45 00 00 07 00",
+	"4F 00 00",
+	"24 [200 bytes, sum 0x0000C738]",
+	"44 00 18",
+	"4E 00",
+	"45 40 00 47 00",
+	"4F 40 00",
+	"24 [200 bytes, sum 0x00008778]",
+	"22 FC",
+	"20"
+};
+
+/** @brief Number of lines of `TEST_GOLDEN_TRACE`. */
+#define TEST_NUM_GOLDEN_LINES \
+	(int)(sizeof(TEST_GOLDEN_TRACE) / sizeof(TEST_GOLDEN_TRACE[0]))
+
+/**
+ * @brief Reads the next line of a trace.
+ *
+ * @param[in,out] trace
+ *
+ *   Trace.
+ *
+ * @param[out] line
+ *
+ *   Line without the line break. `TEST_MAX_LINE` characters.
+ *
+ * @return
+ *
+ *   `1` if a line is read, `0` at the end of the trace.
+ */
+static int test_read_line (FILE* trace, char* line) {
+	size_t len;
+	if (fgets(line, TEST_MAX_LINE, trace) == NULL) {
+		return 0;
+	}
+	len = strlen(line);
+	if ((len > 0u) && (line[len - 1u] == '\n')) {
+		line[len - 1u] = '\0';
+	}
+	return 1;
+}
+
+/**
+ * @brief Whether a line of a trace is a given command.
+ *
+ * @param[in] line
+ *
+ *   Line of a trace.
+ *
+ * @param[in] command
+ *
+ *   Command in two hexadecimal digits; e.g., `"24"`.
+ */
+static int test_is_command (const char* line, const char* command) {
+	return (strncmp(line, command, 2u) == 0) &&
+		((line[2] == '\0') || (line[2] == ' '));
+}
+
+/**
+ * @brief Draws two cycles of partial refreshes, and checks the trace.
+ *
+ * @param[in] max_partial_refreshes
+ *
+ *   `epd_device::max_partial_refreshes`. `-1` keeps the default of
+ *   the panel. At least `2` for `TEST_GOLDEN_TRACE`.
+ */
+static void test_partial_mode (int max_partial_refreshes) {
+	const epd_panel* panel = &EPD_PANELS[EPD_PANEL_1IN54_V2];
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		panel->ram_width,
+		panel->height);
+	char line[TEST_MAX_LINE];
+	char expected_refresh[TEST_MAX_LINE];
+	hal_spi_device spi;
+	epd_device epd;
+	epd_sim sim;
+	FILE* trace;
+	long start;
+	int num_golden = 0;
+	int num_frames = 0;
+	int num_red = 0;
+	int num_bw = 0;
+	int red_after_bw = 0;
+	int num_cycle_frames;
+	int num_test_frames;
+	int i;
+	trace = tmpfile();
+	TEST_CHECK(trace != NULL);
+	if (trace == NULL) {
+		return;
+	}
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(&sim, TEST_PIN_DC, TEST_PIN_BUSY, trace);
+	epd_sim_attach(&sim, spi);
+	epd_device_init(
+		&epd,
+		panel,
+		spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	TEST_CHECK_EQUAL(epd.max_partial_refreshes, panel->max_partial_refreshes);
+	if (max_partial_refreshes >= 0) {
+		epd.max_partial_refreshes = max_partial_refreshes;
+	}
+	num_cycle_frames = epd.max_partial_refreshes + 1;
+	// two cycles of partial refreshes
+	num_test_frames = 2 * num_cycle_frames;
+	epd_configure_gpios(&epd);
+	epd_initialize(&epd);
+	epd_sim_flush(&sim);
+	start = ftell(trace);
+	epd_enable_partial_refresh(&epd);
+	for (i = 0; i < num_test_frames; ++i) {
+		image_buffer_clear_all(&frame);
+		image_buffer_draw_image(&frame, TEST_BLACK_SQUARE, 0, 8 * i, 64, 64);
+		epd_wait_busy(&epd);
+		epd_draw_image_buffer_partial(&epd, &frame);
+		epd_start_refresh_partial_mode(&epd);
+	}
+	epd_wait_busy(&epd);
+	epd_sim_flush(&sim);
+	TEST_CHECK_EQUAL(sim.num_activations, 1 + num_test_frames);
+	TEST_CHECK_EQUAL(epd.num_partial_refreshes, 0);
+	fseek(trace, start, SEEK_SET);
+	// the start of the trace as it is
+	while ((num_golden < TEST_NUM_GOLDEN_LINES) && test_read_line(trace, line)) {
+		if (strcmp(line, TEST_GOLDEN_TRACE[num_golden]) != 0) {
+			fprintf(
+				stderr,
+				"line %d: \"%s\" != \"%s\"\n",
+				num_golden + 1,
+				line,
+				TEST_GOLDEN_TRACE[num_golden]);
+		}
+		TEST_CHECK(strcmp(line, TEST_GOLDEN_TRACE[num_golden]) == 0);
+		++num_golden;
+	}
+	TEST_CHECK_EQUAL(num_golden, TEST_NUM_GOLDEN_LINES);
+	// the order of RAM writes and the refresh of every frame
+	fseek(trace, start, SEEK_SET);
+	while (test_read_line(trace, line)) {
+		if (test_is_command(line, "26")) {
+			if (num_bw > 0) {
+				red_after_bw = 1;
+			}
+			++num_red;
+		} else if (test_is_command(line, "24")) {
+			++num_bw;
+		} else if (test_is_command(line, "22")) {
+			TEST_CHECK(!red_after_bw);
+			TEST_CHECK(num_bw > 0);
+			if (num_frames > 1) {
+				// the previous square is written back to the red RAM
+				TEST_CHECK(num_red > 0);
+			}
+			if ((num_frames == 0) ||
+				((num_frames % num_cycle_frames) == 0))
+			{
+				snprintf(
+					expected_refresh,
+					sizeof(expected_refresh),
+					"22 %02X",
+					(unsigned)panel->sequences.full);
+			} else {
+				snprintf(
+					expected_refresh,
+					sizeof(expected_refresh),
+					"22 %02X",
+					(unsigned)panel->sequences.partial);
+			}
+			if (strcmp(line, expected_refresh) != 0) {
+				fprintf(stderr, "refresh %d: \"%s\"\n", num_frames, line);
+			}
+			TEST_CHECK(strcmp(line, expected_refresh) == 0);
+			++num_frames;
+			num_red = 0;
+			num_bw = 0;
+			red_after_bw = 0;
+		}
+	}
+	// enabling and the frames
+	TEST_CHECK_EQUAL(num_frames, 1 + num_test_frames);
+	TEST_CHECK_EQUAL(panel->sequences.partial, 0xFC);
+	TEST_CHECK_EQUAL(panel->sequences.full, 0xF7);
+	printf(
+		"%d partial refreshes before a full one: %d frames, %u activations\n",
+		epd.max_partial_refreshes,
+		num_test_frames,
+		(unsigned)sim.num_activations);
+	fclose(trace);
+}
+
+int main (void) {
+	test_partial_mode(-1);
+	test_partial_mode(TEST_MAX_PARTIAL_REFRESHES);
+	return test_result();
+}
@@ -0,0 +1,313 @@
+/**
+ * @file test_epd_pipeline.c
+ *
+ * Compares frames per second of the two-buffer pipeline of the sample
+ * project with a serial loop, on simulated time.
+ *
+ * The serial loop renders a frame, transfers it, and waits for its refresh.
+ * The pipeline renders the next frame into the other image buffer while
+ * the EPD is refreshing, like `epd_worker_task` and `produce_frames`.
+ * So a frame of the pipeline takes the longer of rendering and
+ * transfer plus refresh, instead of their sum.
+ */
+
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for DC. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. */
+#define TEST_PIN_BUSY  26
+
+/** @brief Number of image buffers of the pipeline. */
+#define TEST_NUM_IMAGE_BUFFERS  2
+
+/** @brief Number of frames to display. */
+#define TEST_NUM_FRAMES  10
+
+/** @brief Time of a refresh in the display mode 1 in nanoseconds. */
+#define TEST_REFRESH_NS  700000000
+
+/** @brief Tolerance of a predicted time in nanoseconds. */
+#define TEST_TOLERANCE_NS  1000000
+
+/** @brief Times to render a frame in nanoseconds. */
+static const int64_t TEST_RENDER_NS[] = {
+	50000000,
+	200000000,
+	600000000,
+	1500000000
+};
+
+/** @brief Number of `TEST_RENDER_NS`. */
+#define TEST_NUM_RENDER_TIMES \
+	(int)(sizeof(TEST_RENDER_NS) / sizeof(TEST_RENDER_NS[0]))
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Memory of the image buffers. */
+static uint8_t test_image_memory[TEST_NUM_IMAGE_BUFFERS][EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Black square of 64x64 pixels. */
+static const uint8_t TEST_BLACK_SQUARE[64u * 64u / 8u];
+
+/** @brief Times of a run. */
+typedef struct {
+	/** @brief Time to display all of the frames in nanoseconds. */
+	int64_t elapsed_ns;
+	/** @brief Time to transfer all of the frames in nanoseconds. */
+	int64_t transfer_ns;
+} test_run;
+
+/**
+ * @brief Attaches a simulated EPD, and clears it in the display mode 1.
+ *
+ * @param[out] epd
+ *
+ *   EPD.
+ *
+ * @param[out] sim
+ *
+ *   Simulated controller.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ */
+static void test_setup (epd_device* epd, epd_sim* sim, const epd_panel* panel) {
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	hal_spi_device spi;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	TEST_CHECK(spi != NULL);
+	epd_sim_init(sim, TEST_PIN_DC, TEST_PIN_BUSY, NULL);
+	sim->refresh_ns = TEST_REFRESH_NS;
+	epd_sim_attach(sim, spi);
+	epd_device_init(
+		epd,
+		panel,
+		spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	epd_configure_gpios(epd);
+	epd_initialize(epd);
+	epd_enable_display_mode_1(epd);
+	epd_clear_all(epd);
+	epd_refresh_display_mode_1(epd);
+}
+
+/**
+ * @brief Renders a given frame.
+ *
+ * Moves a black square so that every frame changes some rows.
+ * Takes no simulated time; callers advance the clock.
+ *
+ * @param[out] buffer
+ *
+ *   Image buffer to render the frame in.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @param[in] frame
+ *
+ *   Index of the frame.
+ */
+static void test_render (
+		image_buffer* buffer,
+		const epd_panel* panel,
+		int frame)
+{
+	const int x = (frame * 37) % ((int)panel->width - 64);
+	const int y = (frame * 53) % ((int)panel->height - 64);
+	image_buffer_clear_all(buffer);
+	image_buffer_draw_image(buffer, TEST_BLACK_SQUARE, x, y, 64, 64);
+}
+
+/**
+ * @brief Transfers a frame, and measures the time.
+ *
+ * @param[in] epd
+ *
+ *   EPD.
+ *
+ * @param[in] buffer
+ *
+ *   Frame.
+ *
+ * @return
+ *
+ *   Time to transfer the frame in nanoseconds.
+ */
+static int64_t test_transfer (epd_device* epd, image_buffer* buffer) {
+	const int64_t start_ns = hal_linux_get_time_ns();
+	epd_draw_image_buffer_diff(epd, buffer);
+	return hal_linux_get_time_ns() - start_ns;
+}
+
+/**
+ * @brief Renders, transfers and refreshes frames one after another.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @param[in] render_ns
+ *
+ *   Time to render a frame in nanoseconds.
+ *
+ * @return
+ *
+ *   Times of the run.
+ */
+static test_run test_serial (const epd_panel* panel, int64_t render_ns) {
+	image_buffer buffer = image_buffer_initializer(
+		test_image_memory[0],
+		panel->ram_width,
+		panel->height);
+	test_run run = { 0, 0 };
+	epd_device epd;
+	epd_sim sim;
+	int64_t start_ns;
+	int i;
+	test_setup(&epd, &sim, panel);
+	start_ns = hal_linux_get_time_ns();
+	for (i = 0; i < TEST_NUM_FRAMES; ++i) {
+		test_render(&buffer, panel, i);
+		hal_linux_advance_time_ns(render_ns);
+		run.transfer_ns += test_transfer(&epd, &buffer);
+		epd_refresh_display_mode_1(&epd);
+	}
+	run.elapsed_ns = hal_linux_get_time_ns() - start_ns;
+	return run;
+}
+
+/**
+ * @brief Renders frames in two image buffers while the EPD is refreshing.
+ *
+ * The producer renders frames in order, and starts a frame once it has
+ * finished the previous frame and the worker has released the image
+ * buffer of the frame. Its times are derived from the times the worker
+ * released buffers, so the producer needs no task of its own.
+ *
+ * The worker takes each frame once it is rendered, waits for the previous
+ * refresh, transfers the frame, releases its image buffer, and starts
+ * the refresh without waiting for it.
+ *
+ * @param[in] panel
+ *
+ *   Panel.
+ *
+ * @param[in] render_ns
+ *
+ *   Time to render a frame in nanoseconds.
+ *
+ * @return
+ *
+ *   Times of the run.
+ */
+static test_run test_pipeline (const epd_panel* panel, int64_t render_ns) {
+	image_buffer buffers[TEST_NUM_IMAGE_BUFFERS];
+	int64_t released_ns[TEST_NUM_IMAGE_BUFFERS];
+	int64_t rendered_ns;
+	test_run run = { 0, 0 };
+	epd_device epd;
+	epd_sim sim;
+	int64_t start_ns;
+	int i;
+	test_setup(&epd, &sim, panel);
+	start_ns = hal_linux_get_time_ns();
+	for (i = 0; i < TEST_NUM_IMAGE_BUFFERS; ++i) {
+		image_buffer initial = image_buffer_initializer(
+			test_image_memory[i],
+			panel->ram_width,
+			panel->height);
+		buffers[i] = initial;
+		released_ns[i] = start_ns;
+	}
+	rendered_ns = start_ns;
+	for (i = 0; i < TEST_NUM_FRAMES; ++i) {
+		image_buffer* buffer = &buffers[i % TEST_NUM_IMAGE_BUFFERS];
+		int64_t render_start_ns = released_ns[i % TEST_NUM_IMAGE_BUFFERS];
+		if (render_start_ns < rendered_ns) {
+			render_start_ns = rendered_ns;
+		}
+		rendered_ns = render_start_ns + render_ns;
+		test_render(buffer, panel, i);
+		// waits for the frame
+		if (hal_linux_get_time_ns() < rendered_ns) {
+			hal_linux_advance_time_ns(rendered_ns - hal_linux_get_time_ns());
+		}
+		epd_wait_busy(&epd);
+		run.transfer_ns += test_transfer(&epd, buffer);
+		released_ns[i % TEST_NUM_IMAGE_BUFFERS] = hal_linux_get_time_ns();
+		epd_start_refresh_display_mode_1(&epd);
+	}
+	epd_wait_busy(&epd);
+	run.elapsed_ns = hal_linux_get_time_ns() - start_ns;
+	TEST_CHECK_EQUAL(sim.num_activations, 2 + TEST_NUM_FRAMES);
+	return run;
+}
+
+/**
+ * @brief Compares both ways on a given panel.
+ *
+ * @param[in] panel_id
+ *
+ *   Panel.
+ */
+static void test_panel (epd_panel_id panel_id) {
+	const epd_panel* panel = &EPD_PANELS[panel_id];
+	int i;
+	for (i = 0; i < TEST_NUM_RENDER_TIMES; ++i) {
+		const int64_t render_ns = TEST_RENDER_NS[i];
+		const test_run serial = test_serial(panel, render_ns);
+		const test_run pipeline = test_pipeline(panel, render_ns);
+		const int64_t transfer_ns = serial.transfer_ns / TEST_NUM_FRAMES;
+		const int64_t refresh_ns = transfer_ns + TEST_REFRESH_NS;
+		int64_t expected_ns;
+		printf(
+			"%-10s render %4d ms, transfer %5.2f ms: "
+			"serial %.3f fps, pipeline %.3f fps (x%.2f)\n",
+			panel->name,
+			(int)(render_ns / 1000000),
+			transfer_ns / 1e6,
+			TEST_NUM_FRAMES * 1e9 / serial.elapsed_ns,
+			TEST_NUM_FRAMES * 1e9 / pipeline.elapsed_ns,
+			(double)serial.elapsed_ns / pipeline.elapsed_ns);
+		// both transfer the same rows
+		TEST_CHECK_EQUAL(pipeline.transfer_ns, serial.transfer_ns);
+		TEST_CHECK(pipeline.elapsed_ns < serial.elapsed_ns);
+		// the first frame is rendered before anything else can happen,
+		// and then the slower of the producer and the EPD sets the pace
+		expected_ns = render_ns;
+		if (render_ns <= refresh_ns) {
+			expected_ns += TEST_NUM_FRAMES * refresh_ns;
+		} else {
+			expected_ns += (TEST_NUM_FRAMES - 1) * render_ns + refresh_ns;
+		}
+		TEST_CHECK(pipeline.elapsed_ns > expected_ns - TEST_TOLERANCE_NS);
+		TEST_CHECK(pipeline.elapsed_ns < expected_ns + TEST_TOLERANCE_NS);
+	}
+}
+
+int main (void) {
+	test_panel(EPD_PANEL_1IN54_V2);
+	test_panel(EPD_PANEL_4IN2_V2);
+	return test_result();
+}
@@ -0,0 +1,145 @@
+/**
+ * @file test_epd_transactions.c
+ *
+ * Counts SPI transactions to upload a frame.
+ *
+ * A frame used to be sent a byte per transaction, with the DC pin set before
+ * every byte. The bulk path sets DC once per RAM write and queues chunks up to
+ * `EPD_MAX_TRANSFER_SIZE` bytes, so thousands of transactions become
+ * a handful.
+ */
+
+#include <string.h>
+
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for DC. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. */
+#define TEST_PIN_BUSY  26
+
+/**
+ * @brief Maximum number of transactions to upload a frame in bulk.
+ *
+ * Commands and addresses take 9 transactions, and the data of the largest
+ * frame takes 4 chunks.
+ */
+#define TEST_MAX_BULK_TRANSACTIONS  16u
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to upload. */
+static uint8_t test_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/**
+ * @brief Sends a frame a byte per transaction, like the driver used to.
+ *
+ * @param[in] spi
+ *
+ *   SPI device of the EPD.
+ *
+ * @param[in] data
+ *
+ *   Frame.
+ *
+ * @param[in] size
+ *
+ *   Size of the frame in bytes.
+ */
+static void test_send_bytewise (
+		hal_spi_device spi,
+		const uint8_t* data,
+		size_t size)
+{
+	hal_spi_transaction trans;
+	size_t i;
+	for (i = 0; i < size; ++i) {
+		memset(&trans, 0, sizeof(trans));
+		trans.length = 8u;
+		trans.tx_buffer = &data[i];
+		hal_gpio_set_level(TEST_PIN_DC, 1u);
+		hal_spi_transmit(spi, &trans);
+	}
+}
+
+/**
+ * @brief Compares the transactions of both ways on a given panel.
+ *
+ * @param[in] panel_id
+ *
+ *   Panel.
+ */
+static void test_panel (epd_panel_id panel_id) {
+	const epd_panel* panel = &EPD_PANELS[panel_id];
+	const size_t frame_size = epd_panel_frame_size(panel);
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		panel->max_clock_hz,
+		0,
+		EPD_MAX_TRANSFER_SIZE);
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		panel->ram_width,
+		panel->height);
+	hal_linux_stats start;
+	hal_linux_stats bytewise;
+	hal_linux_stats bulk;
+	hal_spi_device spi;
+	epd_device epd;
+	epd_sim sim;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	epd_sim_init(&sim, TEST_PIN_DC, TEST_PIN_BUSY, NULL);
+	epd_sim_attach(&sim, spi);
+	epd_device_init(
+		&epd,
+		panel,
+		spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	epd_configure_gpios(&epd);
+	epd_initialize(&epd);
+	epd_clear_all(&epd);
+	// every row differs from the white RAM
+	memset(test_frame_memory, 0x00, frame_size);
+	hal_linux_get_stats(&start);
+	test_send_bytewise(spi, test_frame_memory, frame_size);
+	hal_linux_get_stats(&bytewise);
+	hal_linux_stats_diff(&bytewise, &start, &bytewise);
+	hal_linux_get_stats(&start);
+	epd_draw_image_buffer(&epd, &frame);
+	hal_linux_get_stats(&bulk);
+	hal_linux_stats_diff(&bulk, &start, &bulk);
+	printf(
+		"%-10s %5u bytes: %5u -> %2u transactions, %6.2f -> %5.2f ms\n",
+		panel->name,
+		(unsigned)frame_size,
+		(unsigned)bytewise.num_transactions,
+		(unsigned)bulk.num_transactions,
+		bytewise.elapsed_ns / 1e6,
+		bulk.elapsed_ns / 1e6);
+	TEST_CHECK_EQUAL(bytewise.num_transactions, frame_size);
+	TEST_CHECK_EQUAL(bytewise.num_gpio_writes, frame_size);
+	TEST_CHECK(bulk.num_transactions <= TEST_MAX_BULK_TRANSACTIONS);
+	// DC once per command, and once for the data
+	TEST_CHECK(bulk.num_gpio_writes <= bulk.num_transactions);
+	TEST_CHECK(bulk.elapsed_ns * 5 < bytewise.elapsed_ns);
+	TEST_CHECK(memcmp(test_panel_memory, test_frame_memory, frame_size) == 0);
+}
+
+int main (void) {
+	int i;
+	for (i = 0; i < EPD_NUM_PANELS; ++i) {
+		test_panel((epd_panel_id)i);
+	}
+	return test_result();
+}
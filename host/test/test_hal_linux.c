@@ -0,0 +1,149 @@
+/**
+ * @file test_hal_linux.c
+ *
+ * Tests of the simulated clock, tasks and notifications of the Linux HAL.
+ */
+
+#include "hal.h"
+#include "hal_linux.h"
+
+#include "test_util.h"
+
+/** @brief GPIO# of the simulated interrupt line. */
+#define TEST_PIN_INT  4
+
+/** @brief Task notified by `::test_isr_handler`. */
+static hal_task test_notified_task;
+
+/** @brief Number of calls of `::test_isr_handler`. */
+static int test_num_interrupts;
+
+/** @brief Notifies `test_notified_task`. */
+static void test_isr_handler (void* arg) {
+	(void)arg;
+	++test_num_interrupts;
+	hal_task_notify_from_isr(test_notified_task);
+}
+
+/** @brief Raises the interrupt line. */
+static void test_raise_interrupt (void* arg) {
+	(void)arg;
+	hal_linux_set_input_level(TEST_PIN_INT, 1);
+}
+
+/** @brief Lowers the interrupt line. */
+static void test_lower_interrupt (void* arg) {
+	(void)arg;
+	hal_linux_set_input_level(TEST_PIN_INT, 0);
+}
+
+/** @brief Prepares the interrupt line and the notified task. */
+static void test_setup (void) {
+	hal_err_t ret;
+	hal_linux_reset();
+	test_notified_task = hal_task_current();
+	test_num_interrupts = 0;
+	ret = hal_gpio_set_input(TEST_PIN_INT);
+	TEST_CHECK_EQUAL(ret, HAL_OK);
+	ret = hal_gpio_set_isr(
+		TEST_PIN_INT,
+		HAL_GPIO_RISING_EDGE,
+		test_isr_handler,
+		NULL);
+	TEST_CHECK_EQUAL(ret, HAL_OK);
+}
+
+/** @brief An interrupt from a scheduled task wakes up a waiting task. */
+static void test_wait_wakes_on_interrupt (void) {
+	test_setup();
+	hal_linux_schedule(3000000, test_raise_interrupt, NULL);
+	TEST_CHECK_EQUAL(hal_task_wait_notification(HAL_WAIT_FOREVER), 1);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns(), 3000000);
+	TEST_CHECK_EQUAL(test_num_interrupts, 1);
+}
+
+/** @brief A falling edge does not fire a handler of rising edges. */
+static void test_wait_ignores_other_edge (void) {
+	test_setup();
+	hal_linux_set_input_level(TEST_PIN_INT, 1);
+	TEST_CHECK_EQUAL(hal_task_wait_notification(0u), 1);
+	hal_linux_schedule(1000000, test_lower_interrupt, NULL);
+	TEST_CHECK_EQUAL(hal_task_wait_notification(5u), 0);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns(), 5000000);
+	TEST_CHECK_EQUAL(test_num_interrupts, 1);
+}
+
+/** @brief A wait times out at its deadline, before later tasks. */
+static void test_wait_times_out (void) {
+	test_setup();
+	hal_linux_schedule(20000000, test_raise_interrupt, NULL);
+	TEST_CHECK_EQUAL(hal_task_wait_notification(10u), 0);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns(), 10000000);
+	TEST_CHECK_EQUAL(test_num_interrupts, 0);
+	// the task is still pending
+	TEST_CHECK_EQUAL(hal_task_wait_notification(10u), 1);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns(), 20000000);
+}
+
+/** @brief Notifications are counted and cleared by a wait. */
+static void test_notifications_accumulate (void) {
+	test_setup();
+	hal_task_notify_from_isr(test_notified_task);
+	hal_task_notify_from_isr(test_notified_task);
+	TEST_CHECK_EQUAL(hal_task_wait_notification(0u), 2);
+	TEST_CHECK_EQUAL(hal_task_wait_notification(0u), 0);
+	TEST_CHECK_EQUAL(hal_linux_get_time_ns(), 0);
+}
+
+/** @brief A delay runs tasks due in it, and counts as delay. */
+static void test_delay_runs_tasks (void) {
+	hal_linux_stats stats;
+	test_setup();
+	hal_linux_schedule(1000000, test_raise_interrupt, NULL);
+	hal_delay_ms(2u);
+	TEST_CHECK_EQUAL(test_num_interrupts, 1);
+	TEST_CHECK_EQUAL(hal_get_time_us(), 2000);
+	hal_linux_get_stats(&stats);
+	TEST_CHECK_EQUAL(stats.delay_ns, 2000000);
+	TEST_CHECK_EQUAL(stats.wire_ns, 0);
+}
+
+/** @brief A polling transaction costs its bits on the wire plus overhead. */
+static void test_transaction_timing (void) {
+	const hal_linux_spi_timing timing =
+		hal_linux_spi_timing_initializer(1000000, 8, 0u);
+	hal_linux_stats stats;
+	hal_spi_device spi;
+	uint8_t data[2] = { 0x12u, 0x34u };
+	hal_spi_transaction trans = {
+		.cmd = 0x80u,
+		.length = 16u,
+		.tx_buffer = data
+	};
+	hal_err_t ret;
+	test_setup();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	TEST_CHECK(spi != NULL);
+	ret = hal_spi_transmit(spi, &trans);
+	TEST_CHECK_EQUAL(ret, HAL_OK);
+	hal_linux_get_stats(&stats);
+	TEST_CHECK_EQUAL(stats.num_transactions, 1);
+	TEST_CHECK_EQUAL(stats.num_bits, 24);
+	// 24 bits at 1MHz
+	TEST_CHECK_EQUAL(stats.wire_ns, 24000);
+	// setup, CS setup and CS hold
+	TEST_CHECK_EQUAL(
+		stats.overhead_ns,
+		HAL_LINUX_DEFAULT_POLLING_SETUP_NS + 2000);
+	TEST_CHECK_EQUAL(stats.elapsed_ns, stats.wire_ns + stats.overhead_ns);
+}
+
+int main (void) {
+	test_wait_wakes_on_interrupt();
+	test_wait_ignores_other_edge();
+	test_wait_times_out();
+	test_notifications_accumulate();
+	test_delay_runs_tasks();
+	test_transaction_timing();
+	return test_result();
+}
@@ -0,0 +1,302 @@
+/**
+ * @file test_image_blit.c
+ *
+ * Tests blits of `image_buffer` against a naive per-pixel reference.
+ *
+ * Random images are blitted at random positions, with every raster
+ * operation, with and without a mask, clipped by every edge.
+ */
+
+#include <string.h>
+
+#include "image_buffer.h"
+
+#include "test_util.h"
+
+/** @brief Width of the buffer. */
+#define TEST_WIDTH  200
+/** @brief Height of the buffer. */
+#define TEST_HEIGHT  96
+/** @brief Size of the buffer in bytes. */
+#define TEST_FRAME_SIZE  (TEST_WIDTH * TEST_HEIGHT / 8)
+
+/** @brief Largest width and height of an image. */
+#define TEST_MAX_IMAGE_SIZE  80
+/** @brief Size of the largest image in bytes. */
+#define TEST_MAX_IMAGE_BYTES \
+	(TEST_MAX_IMAGE_SIZE * ((TEST_MAX_IMAGE_SIZE + 7) / 8))
+
+/** @brief Number of random blits. */
+#define TEST_NUM_BLITS  20000
+
+/** @brief Buffer blitted by `image_buffer`. */
+static uint8_t test_actual[TEST_FRAME_SIZE];
+
+/** @brief Buffer blitted by the reference. */
+static uint8_t test_expected[TEST_FRAME_SIZE];
+
+/** @brief Image to blit. */
+static uint8_t test_image[TEST_MAX_IMAGE_BYTES];
+
+/** @brief Mask of the image. */
+static uint8_t test_mask[TEST_MAX_IMAGE_BYTES];
+
+/** @brief State of `::test_random`. */
+static uint32_t test_rng = 0x12345678u;
+
+/**
+ * @brief Obtains a pixel of an image.
+ *
+ * @param[in] data
+ *
+ *   Image.
+ *
+ * @param[in] scan_size
+ *
+ *   Bytes in a row.
+ *
+ * @param[in] x
+ *
+ *   X position.
+ *
+ * @param[in] y
+ *
+ *   Y position.
+ *
+ * @return
+ *
+ *   Pixel; `0` or `1`.
+ */
+static int test_get_pixel (const uint8_t* data, int scan_size, int x, int y) {
+	return (data[y * scan_size + x / 8] >> (7 - x % 8)) & 1;
+}
+
+/**
+ * @brief Sets a pixel of an image.
+ *
+ * @param[in,out] data
+ *
+ *   Image.
+ *
+ * @param[in] scan_size
+ *
+ *   Bytes in a row.
+ *
+ * @param[in] x
+ *
+ *   X position.
+ *
+ * @param[in] y
+ *
+ *   Y position.
+ *
+ * @param[in] pixel
+ *
+ *   Pixel; `0` or `1`.
+ */
+static void test_set_pixel (
+		uint8_t* data,
+		int scan_size,
+		int x,
+		int y,
+		int pixel)
+{
+	uint8_t* byte = &data[y * scan_size + x / 8];
+	const uint8_t bit = (uint8_t)(0x80u >> (x % 8));
+	*byte = pixel ? (uint8_t)(*byte | bit) : (uint8_t)(*byte & ~bit);
+}
+
+/**
+ * @brief Blits an image into `test_expected` a pixel at a time.
+ *
+ * Takes the same arguments as `::image_buffer_blit`.
+ */
+static void test_reference_blit (
+		const uint8_t* data,
+		const uint8_t* mask,
+		int left,
+		int top,
+		int width,
+		int height,
+		image_buffer_rop rop)
+{
+	const int src_scan_size = (width + 7) / 8;
+	const int dest_scan_size = TEST_WIDTH / 8;
+	int x;
+	int y;
+	for (y = 0; y < height; ++y) {
+		for (x = 0; x < width; ++x) {
+			const int dest_x = left + x;
+			const int dest_y = top + y;
+			int src;
+			int dest;
+			if ((dest_x < 0) || (dest_x >= TEST_WIDTH) ||
+				(dest_y < 0) || (dest_y >= TEST_HEIGHT))
+			{
+				continue;
+			}
+			if ((mask != NULL) && !test_get_pixel(mask, src_scan_size, x, y)) {
+				continue;
+			}
+			src = test_get_pixel(data, src_scan_size, x, y);
+			dest = test_get_pixel(test_expected, dest_scan_size, dest_x, dest_y);
+			switch (rop) {
+			case IMAGE_BUFFER_ROP_AND:
+				dest &= src;
+				break;
+			case IMAGE_BUFFER_ROP_OR:
+				dest |= src;
+				break;
+			case IMAGE_BUFFER_ROP_XOR:
+				dest ^= src;
+				break;
+			case IMAGE_BUFFER_ROP_NOT_SRC:
+				dest = !src;
+				break;
+			case IMAGE_BUFFER_ROP_COPY:
+			default:
+				dest = src;
+				break;
+			}
+			test_set_pixel(test_expected, dest_scan_size, dest_x, dest_y, dest);
+		}
+	}
+}
+
+/**
+ * @brief Clears a range of `test_expected` a pixel at a time.
+ *
+ * Takes the same arguments as `::image_buffer_clear_range`.
+ */
+static void test_reference_clear_range (
+		int left,
+		int top,
+		int width,
+		int height)
+{
+	int x;
+	int y;
+	for (y = top; y < top + height; ++y) {
+		for (x = left; x < left + width; ++x) {
+			if ((x >= 0) && (x < TEST_WIDTH) && (y >= 0) && (y < TEST_HEIGHT)) {
+				test_set_pixel(test_expected, TEST_WIDTH / 8, x, y, 1);
+			}
+		}
+	}
+}
+
+/** @brief Random blits match the reference. */
+static void test_random_blits (void) {
+	image_buffer buffer = image_buffer_initializer(
+		test_actual,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	int num_mismatches = 0;
+	int i;
+	test_fill_random(&test_rng, test_actual, sizeof(test_actual));
+	memcpy(test_expected, test_actual, sizeof(test_actual));
+	for (i = 0; i < TEST_NUM_BLITS; ++i) {
+		const int width = test_random_range(&test_rng, 0, TEST_MAX_IMAGE_SIZE);
+		const int height = test_random_range(&test_rng, 0, TEST_MAX_IMAGE_SIZE);
+		const int left = test_random_range(&test_rng, -width - 4, TEST_WIDTH + 4);
+		const int top = test_random_range(&test_rng, -height - 4, TEST_HEIGHT + 4);
+		const image_buffer_rop rop =
+			(image_buffer_rop)test_random_range(
+				&test_rng,
+				0,
+				IMAGE_BUFFER_NUM_ROPS - 1);
+		const uint8_t* mask = (test_random(&test_rng) & 1u) ? test_mask : NULL;
+		const size_t image_size = (size_t)(height * ((width + 7) / 8));
+		test_fill_random(&test_rng, test_image, image_size);
+		test_fill_random(&test_rng, test_mask, image_size);
+		image_buffer_clear_dirty(&buffer);
+		image_buffer_blit(&buffer, test_image, mask, left, top, width, height, rop);
+		test_reference_blit(test_image, mask, left, top, width, height, rop);
+		if (memcmp(test_actual, test_expected, sizeof(test_actual)) != 0) {
+			++num_mismatches;
+			// keeps checking the following blits from the same state
+			memcpy(test_actual, test_expected, sizeof(test_actual));
+		}
+	}
+	TEST_CHECK_EQUAL(num_mismatches, 0);
+}
+
+/** @brief Random clears match the reference. */
+static void test_random_clears (void) {
+	image_buffer buffer = image_buffer_initializer(
+		test_actual,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	int num_mismatches = 0;
+	int i;
+	for (i = 0; i < TEST_NUM_BLITS / 4; ++i) {
+		const int width = test_random_range(&test_rng, 0, TEST_MAX_IMAGE_SIZE);
+		const int height = test_random_range(&test_rng, 0, TEST_MAX_IMAGE_SIZE);
+		const int left = test_random_range(&test_rng, -width - 4, TEST_WIDTH + 4);
+		const int top = test_random_range(&test_rng, -height - 4, TEST_HEIGHT + 4);
+		test_fill_random(&test_rng, test_actual, sizeof(test_actual));
+		memcpy(test_expected, test_actual, sizeof(test_actual));
+		image_buffer_clear_dirty(&buffer);
+		image_buffer_clear_range(&buffer, left, top, width, height);
+		test_reference_clear_range(left, top, width, height);
+		if (memcmp(test_actual, test_expected, sizeof(test_actual)) != 0) {
+			++num_mismatches;
+		}
+	}
+	TEST_CHECK_EQUAL(num_mismatches, 0);
+}
+
+/** @brief Copies of whole rows, which are copied at once, match the reference. */
+static void test_full_width_blits (void) {
+	// as many rows as fit in `test_image`
+	static const int height = TEST_MAX_IMAGE_BYTES / (TEST_WIDTH / 8);
+	static const int tops[] = { -8, 0, 30, TEST_HEIGHT - 8 };
+	image_buffer buffer = image_buffer_initializer(
+		test_actual,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	size_t i;
+	for (i = 0u; i < sizeof(tops) / sizeof(tops[0]); ++i) {
+		test_fill_random(&test_rng, test_actual, sizeof(test_actual));
+		memcpy(test_expected, test_actual, sizeof(test_actual));
+		test_fill_random(
+			&test_rng,
+			test_image,
+			(size_t)(height * (TEST_WIDTH / 8)));
+		image_buffer_draw_image(&buffer, test_image, 0, tops[i], TEST_WIDTH, height);
+		test_reference_blit(
+			test_image,
+			NULL,
+			0,
+			tops[i],
+			TEST_WIDTH,
+			height,
+			IMAGE_BUFFER_ROP_COPY);
+		TEST_CHECK(memcmp(test_actual, test_expected, sizeof(test_actual)) == 0);
+	}
+}
+
+/** @brief A masked blit leaves bits outside the mask alone. */
+static void test_mask_preserves (void) {
+	static const uint8_t black[2] = { 0x00u, 0x00u };
+	static const uint8_t mask[2] = { 0x0Fu, 0xF0u };
+	image_buffer buffer = image_buffer_initializer(
+		test_actual,
+		TEST_WIDTH,
+		TEST_HEIGHT);
+	image_buffer_clear_all(&buffer);
+	image_buffer_blit(&buffer, black, mask, 3, 0, 16, 1, IMAGE_BUFFER_ROP_COPY);
+	// bits 7-14 of the row are black
+	TEST_CHECK_EQUAL(test_actual[0], 0xFEu);
+	TEST_CHECK_EQUAL(test_actual[1], 0x01u);
+	TEST_CHECK_EQUAL(test_actual[2], 0xFFu);
+	TEST_CHECK_EQUAL(image_buffer_num_dirty_rects(&buffer), 1);
+}
+
+int main (void) {
+	test_random_blits();
+	test_random_clears();
+	test_full_width_blits();
+	test_mask_preserves();
+	return test_result();
+}
@@ -0,0 +1,480 @@
+/**
+ * @file test_motion_capture.c
+ *
+ * Runs the event task of `spi_adxl345_main.c` on the simulated clock, and
+ * drives `motion_detector.h` with events raised on a simulated ADXL345.
+ *
+ * Each scenario schedules events at given times, and checks the captures
+ * that follow: the events that started them, the pre-trigger window read
+ * from the FIFO at the idle rate, the post-trigger window at the capture
+ * rate, and that no sample is lost or reordered across the switch.
+ */
+
+#include "adxl345.h"
+#include "hal_linux.h"
+#include "motion_detector.h"
+
+#include "adxl345_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for INT1. */
+#define TEST_PIN_INT1  33
+
+/** @brief Watermark of the FIFO. Same as `spi_adxl345_main.c`. */
+#define TEST_WATERMARK  16u
+
+/** @brief Samples after the last event. Same as `spi_adxl345_main.c`. */
+#define TEST_POST_TRIGGER_SAMPLES  3200u
+
+/** @brief Maximum samples in a capture. Same as `spi_adxl345_main.c`. */
+#define TEST_MAX_CAPTURE_SAMPLES  32000u
+
+/** @brief Time to wait for the watermark interrupt (ms). */
+#define TEST_FIFO_TIMEOUT_MS  100u
+
+/** @brief Time to wait for an event before checking the clock (ms). */
+#define TEST_IDLE_TIMEOUT_MS  1000u
+
+/** @brief Maximum number of samples captured in a scenario. */
+#define TEST_MAX_SAMPLES  80000u
+
+/** @brief Maximum number of captures in a scenario. */
+#define TEST_MAX_CAPTURES  8u
+
+/** @brief Period of the idle rate (us). */
+#define TEST_IDLE_PERIOD_US  10000
+
+/** @brief Configuration of captures. Same as `spi_adxl345_main.c`. */
+static const adxl345_config TEST_CONFIG = adxl345_config_initializer(
+	ADXL345_RATE_3200HZ,
+	ADXL345_RANGE_16G,
+	1,
+	0);
+
+/** @brief Configuration while waiting for events. Same as `spi_adxl345_main.c`. */
+static const adxl345_config TEST_IDLE_CONFIG = adxl345_config_initializer(
+	ADXL345_RATE_100HZ,
+	ADXL345_RANGE_16G,
+	1,
+	1);
+
+/** @brief Event raised at a given time. */
+typedef struct {
+	/** @brief Time in milliseconds. */
+	int64_t at_ms;
+	/** @brief Bits of INT_SOURCE. */
+	uint8_t events;
+} test_event;
+
+/** @brief Events raised periodically. */
+typedef struct {
+	/** @brief Time of the first events in milliseconds. */
+	int64_t start_ms;
+	/** @brief Period in milliseconds. */
+	int64_t period_ms;
+	/** @brief Time to stop in milliseconds. */
+	int64_t end_ms;
+	/** @brief Bits of INT_SOURCE. */
+	uint8_t events;
+} test_repeat;
+
+/** @brief Capture. */
+typedef struct {
+	/** @brief Index of the first sample in `::test_samples`. */
+	size_t first;
+	/** @brief Number of samples in the pre-trigger window. */
+	size_t num_pre_trigger;
+	/** @brief Number of samples including the pre-trigger window. */
+	size_t num_samples;
+	/** @brief Events that started the capture. */
+	uint8_t trigger_events;
+	/** @brief Time of the edge of INT1 that reported the events (us). */
+	int64_t trigger_us;
+} test_capture;
+
+/** @brief Simulated ADXL345. */
+static adxl345_sim test_sim;
+
+/** @brief Samples of every capture. */
+static sample_record test_samples[TEST_MAX_SAMPLES];
+
+/** @brief Number of `::test_samples`. */
+static size_t test_num_samples;
+
+/** @brief Captures. */
+static test_capture test_captures[TEST_MAX_CAPTURES];
+
+/** @brief Number of `::test_captures`. */
+static size_t test_num_captures;
+
+/** @brief Number of drains that saw an overrun. */
+static uint32_t test_num_overruns;
+
+/** @brief Time of the last rising edge of INT1 (us). */
+static int64_t test_int1_timestamp;
+
+/**
+ * @brief Handles a rising edge of INT1.
+ *
+ * @param[in] arg
+ *
+ *   (`hal_task`) Task to notify.
+ */
+static void test_int1_isr (void* arg) {
+	test_int1_timestamp = hal_get_time_us();
+	hal_task_notify_from_isr((hal_task)arg);
+}
+
+/**
+ * @brief Time of the last rising edge of INT1.
+ *
+ * @return
+ *
+ *   Time in microseconds.
+ */
+static int64_t test_get_int1_timestamp (void) {
+	return test_int1_timestamp;
+}
+
+/**
+ * @brief Raises events on the simulated ADXL345.
+ *
+ * @param[in] arg
+ *
+ *   (`const test_event*`) Events to raise.
+ */
+static void test_raise (void* arg) {
+	adxl345_sim_raise_events(&test_sim, ((const test_event*)arg)->events);
+}
+
+/**
+ * @brief Raises events, and schedules itself again until the end.
+ *
+ * @param[in] arg
+ *
+ *   (`const test_repeat*`) Events to raise.
+ */
+static void test_raise_repeatedly (void* arg) {
+	const test_repeat* repeat = (const test_repeat*)arg;
+	const int64_t now_ns = hal_linux_get_time_ns();
+	adxl345_sim_raise_events(&test_sim, repeat->events);
+	if (now_ns + repeat->period_ms * 1000000 < repeat->end_ms * 1000000) {
+		TEST_CHECK_EQUAL(
+			hal_linux_schedule(
+				now_ns + repeat->period_ms * 1000000,
+				test_raise_repeatedly,
+				arg),
+			0);
+	}
+}
+
+/**
+ * @brief Keeps samples of the current capture.
+ *
+ * @param[in] samples
+ *
+ *   Samples.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples.
+ */
+static void test_push (const sample_record* samples, size_t num_samples) {
+	size_t i;
+	for (i = 0u; (i < num_samples) && (test_num_samples < TEST_MAX_SAMPLES); ++i) {
+		test_samples[test_num_samples++] = samples[i];
+	}
+}
+
+/**
+ * @brief Runs the event task for a given time.
+ *
+ * @param[in] events
+ *
+ *   Events to raise in the order of time.
+ *
+ * @param[in] num_events
+ *
+ *   Number of events.
+ *
+ * @param[in] repeat
+ *
+ *   Events raised periodically. `NULL` if none.
+ *
+ * @param[in] duration_ms
+ *
+ *   Time to run. A capture in progress is completed.
+ *
+ * @param[out] detector
+ *
+ *   Receives the state machine at the end.
+ */
+static void test_run (
+		const test_event* events,
+		size_t num_events,
+		const test_repeat* repeat,
+		int64_t duration_ms,
+		motion_detector* detector)
+{
+	const hal_linux_spi_timing timing = hal_linux_spi_timing_initializer(
+		adxl345_spi_clock_hz(&TEST_CONFIG, TEST_WATERMARK),
+		8,
+		0u);
+	const motion_detector initial = motion_detector_initializer(
+		TEST_POST_TRIGGER_SAMPLES,
+		TEST_MAX_CAPTURE_SAMPLES);
+	adxl345_fifo_clock clock = {
+		.odr_millihz = adxl345_odr_millihz(&TEST_IDLE_CONFIG),
+		.next_index = 0u,
+		.anchor_index = 0u,
+		.anchor_timestamp = 0,
+		.drain_end_timestamp = 0
+	};
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	hal_spi_device spi;
+	size_t num_samples;
+	uint8_t int_source;
+	size_t i;
+	*detector = initial;
+	test_num_samples = 0u;
+	test_num_captures = 0u;
+	test_num_overruns = 0u;
+	hal_linux_reset();
+	spi = hal_linux_add_spi_device(&timing, NULL, NULL);
+	adxl345_sim_init(&test_sim, TEST_PIN_INT1);
+	adxl345_sim_attach(&test_sim, spi);
+	hal_gpio_set_isr(
+		TEST_PIN_INT1,
+		HAL_GPIO_RISING_EDGE,
+		test_int1_isr,
+		hal_task_current());
+	// as `app_main` does
+	TEST_CHECK_EQUAL(adxl345_configure(spi, &TEST_CONFIG), HAL_OK);
+	adxl345_configure_fifo(spi, TEST_WATERMARK);
+	adxl345_configure_events(spi);
+	adxl345_start(spi);
+	for (i = 0u; i < num_events; ++i) {
+		TEST_CHECK_EQUAL(
+			hal_linux_schedule(events[i].at_ms * 1000000, test_raise, (void*)&events[i]),
+			0);
+	}
+	if (repeat != NULL) {
+		TEST_CHECK_EQUAL(
+			hal_linux_schedule(
+				repeat->start_ms * 1000000,
+				test_raise_repeatedly,
+				(void*)repeat),
+			0);
+	}
+	// as `adxl345_event_task` does
+	adxl345_arm_events(spi, &TEST_IDLE_CONFIG, &clock);
+	while (hal_get_time_us() < duration_ms * 1000) {
+		test_capture* capture;
+		if (hal_task_wait_notification(TEST_IDLE_TIMEOUT_MS) == 0u) {
+			continue;
+		}
+		TEST_CHECK_EQUAL(
+			adxl345_read(spi, ADXL345_REG_INT_SOURCE, &int_source),
+			HAL_OK);
+		if (motion_detector_handle_interrupt(detector, int_source) !=
+			MOTION_ACTION_START_CAPTURE)
+		{
+			continue;
+		}
+		TEST_CHECK(test_num_captures < TEST_MAX_CAPTURES);
+		if (test_num_captures >= TEST_MAX_CAPTURES) {
+			break;
+		}
+		capture = &test_captures[test_num_captures++];
+		capture->first = test_num_samples;
+		capture->trigger_events = detector->trigger_events;
+		capture->trigger_us = test_int1_timestamp;
+		num_samples = adxl345_start_capture(
+			spi,
+			&TEST_CONFIG,
+			&clock,
+			test_get_int1_timestamp,
+			samples);
+		capture->num_pre_trigger = num_samples;
+		test_push(samples, num_samples);
+		do {
+			num_samples = adxl345_drain_fifo(
+				spi,
+				&clock,
+				TEST_WATERMARK,
+				test_get_int1_timestamp,
+				samples,
+				&int_source);
+			if ((int_source & ADXL345_INT_OVERRUN) != 0u) {
+				++test_num_overruns;
+			}
+			test_push(samples, num_samples);
+			motion_detector_handle_interrupt(detector, int_source);
+			motion_detector_handle_samples(detector, (uint32_t)num_samples);
+			if ((num_samples < TEST_WATERMARK) &&
+				(detector->state == MOTION_CAPTURING))
+			{
+				hal_task_wait_notification(TEST_FIFO_TIMEOUT_MS);
+			}
+		} while (detector->state == MOTION_CAPTURING);
+		capture->num_samples = test_num_samples - capture->first;
+		adxl345_arm_events(spi, &TEST_IDLE_CONFIG, &clock);
+	}
+}
+
+/**
+ * @brief Checks a capture.
+ *
+ * @param[in] capture
+ *
+ *   Capture.
+ *
+ * @param[in] trigger_events
+ *
+ *   Events expected to start the capture.
+ *
+ * @param[in] min_post_trigger
+ *
+ *   Minimum number of samples after the pre-trigger window.
+ *
+ * @param[in] max_post_trigger
+ *
+ *   Maximum number of samples after the pre-trigger window.
+ */
+static void test_check_capture (
+		const test_capture* capture,
+		uint8_t trigger_events,
+		size_t min_post_trigger,
+		size_t max_post_trigger)
+{
+	const sample_record* samples = test_samples + capture->first;
+	const size_t num_post_trigger = capture->num_samples - capture->num_pre_trigger;
+	size_t i;
+	printf(
+		"capture at %lld us by 0x%02X: %u pre-trigger + %u samples\n",
+		(long long)capture->trigger_us,
+		(unsigned)capture->trigger_events,
+		(unsigned)capture->num_pre_trigger,
+		(unsigned)num_post_trigger);
+	TEST_CHECK_EQUAL(capture->trigger_events, trigger_events);
+	// the FIFO is full at the idle rate, and may take a sample while read
+	TEST_CHECK(capture->num_pre_trigger >= ADXL345_SIM_FIFO_SIZE);
+	TEST_CHECK(capture->num_pre_trigger <= ADXL345_MAX_FIFO_ENTRIES);
+	TEST_CHECK(num_post_trigger >= min_post_trigger);
+	TEST_CHECK(num_post_trigger <= max_post_trigger);
+	// the newest sample of the pre-trigger window is stamped at the edge
+	TEST_CHECK(
+		samples[capture->num_pre_trigger - 1u].timestamp <= capture->trigger_us);
+	for (i = 1u; i < capture->num_samples; ++i) {
+		const int64_t interval = samples[i].timestamp - samples[i - 1u].timestamp;
+		// no sample is lost or reordered across the switch of rates
+		TEST_CHECK_EQUAL(
+			adxl345_sim_counter_index(samples[i].accs),
+			adxl345_sim_counter_index(samples[i - 1u].accs) + 1u);
+		if (i < capture->num_pre_trigger) {
+			TEST_CHECK_EQUAL(interval, TEST_IDLE_PERIOD_US);
+		} else if (i > capture->num_pre_trigger + 1u) {
+			TEST_CHECK((interval >= 312) && (interval <= 313));
+		} else {
+			// the driver stamps the first sample at the capture rate at the
+			// switch, whereas the simulator takes it one idle period after
+			// the last one
+			TEST_CHECK(interval >= 0);
+			TEST_CHECK(interval <= TEST_IDLE_PERIOD_US);
+		}
+	}
+}
+
+/** @brief An event starts a capture, which ends after the post-trigger window. */
+static void test_single_event (void) {
+	static const test_event EVENTS[] = {
+		{ 1000, MOTION_EVENT_ACTIVITY }
+	};
+	motion_detector detector;
+	test_run(EVENTS, 1u, NULL, 3000, &detector);
+	TEST_CHECK_EQUAL(test_num_captures, 1u);
+	TEST_CHECK_EQUAL(detector.num_captures, 1u);
+	TEST_CHECK_EQUAL(detector.state, MOTION_IDLE);
+	TEST_CHECK_EQUAL(test_num_overruns, 0u);
+	if (test_num_captures == 1u) {
+		TEST_CHECK(test_captures[0].trigger_us >= 1000000);
+		TEST_CHECK(test_captures[0].trigger_us < 1000000 + 1000);
+		test_check_capture(
+			&test_captures[0],
+			MOTION_EVENT_ACTIVITY,
+			TEST_POST_TRIGGER_SAMPLES,
+			TEST_POST_TRIGGER_SAMPLES + ADXL345_MAX_FIFO_ENTRIES);
+	}
+	// back to the idle rate, waiting for events on INT1
+	TEST_CHECK_EQUAL(
+		test_sim.registers[ADXL345_REG_BW_RATE],
+		ADXL345_RATE_100HZ | ADXL345_BW_RATE_LOW_POWER);
+	TEST_CHECK_EQUAL(test_sim.registers[ADXL345_REG_INT_MAP], 0u);
+	TEST_CHECK_EQUAL(test_sim.registers[ADXL345_REG_INT_ENABLE], MOTION_EVENT_MASK);
+}
+
+/** @brief Events during a capture extend it instead of starting another. */
+static void test_retrigger (void) {
+	static const test_event EVENTS[] = {
+		{ 1000, MOTION_EVENT_SINGLE_TAP },
+		{ 1500, MOTION_EVENT_FREE_FALL },
+		{ 2200, MOTION_EVENT_ACTIVITY }
+	};
+	// the last event comes 1.2s after the first at 3200Hz
+	const size_t extended = TEST_POST_TRIGGER_SAMPLES + 1200u * 3200u / 1000u;
+	motion_detector detector;
+	test_run(EVENTS, 3u, NULL, 5000, &detector);
+	TEST_CHECK_EQUAL(test_num_captures, 1u);
+	TEST_CHECK_EQUAL(test_num_overruns, 0u);
+	if (test_num_captures == 1u) {
+		// a drain counts samples taken before the event it reports
+		test_check_capture(
+			&test_captures[0],
+			MOTION_EVENT_SINGLE_TAP,
+			extended - 2u * ADXL345_MAX_FIFO_ENTRIES,
+			extended + ADXL345_MAX_FIFO_ENTRIES);
+	}
+}
+
+/** @brief Endless events are cut into captures of the maximum length. */
+static void test_max_capture (void) {
+	// every 100ms from 1s until 12.5s
+	static const test_repeat REPEAT = { 1000, 100, 12500, MOTION_EVENT_ACTIVITY };
+	motion_detector detector;
+	test_run(NULL, 0u, &REPEAT, 12500, &detector);
+	TEST_CHECK_EQUAL(test_num_captures, 2u);
+	TEST_CHECK_EQUAL(test_num_overruns, 0u);
+	if (test_num_captures == 2u) {
+		test_check_capture(
+			&test_captures[0],
+			MOTION_EVENT_ACTIVITY,
+			TEST_MAX_CAPTURE_SAMPLES,
+			TEST_MAX_CAPTURE_SAMPLES + ADXL345_MAX_FIFO_ENTRIES);
+		// the next event after re-arming starts another
+		TEST_CHECK(test_captures[1].trigger_us > test_captures[0].trigger_us + 10000000);
+		TEST_CHECK(
+			test_captures[1].trigger_us < test_captures[0].trigger_us + 10000000 + 200000);
+	}
+}
+
+/** @brief Events that are not enabled never start a capture. */
+static void test_ignored_events (void) {
+	// inactivity; FIFO bits are ignored by the simulator too
+	static const test_event EVENTS[] = {
+		{ 500, 0x08u },
+		{ 800, ADXL345_INT_WATERMARK | ADXL345_INT_OVERRUN }
+	};
+	motion_detector detector;
+	test_run(EVENTS, 2u, NULL, 2000, &detector);
+	TEST_CHECK_EQUAL(test_num_captures, 0u);
+	TEST_CHECK_EQUAL(detector.num_captures, 0u);
+	TEST_CHECK_EQUAL(detector.state, MOTION_IDLE);
+}
+
+int main (void) {
+	test_single_event();
+	test_retrigger();
+	test_max_capture();
+	test_ignored_events();
+	return test_result();
+}
@@ -0,0 +1,350 @@
+/**
+ * @file test_rle_image.c
+ *
+ * Decodes images compressed by `make_binary_image.py` and compares them
+ * with the same images exported raw.
+ *
+ * The build exports the images in `epd/imgs` as binary blobs
+ * (`<dither>-<format>.bin`) in `TEST_BLOB_DIR`; see `host/CMakeLists.txt`.
+ * So the encoder in Python and the decoder in C are checked against each
+ * other on every build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_asset.h"
+#include "image_buffer.h"
+#include "rle_image.h"
+
+#include "test_util.h"
+
+#ifndef TEST_BLOB_DIR
+#error "define TEST_BLOB_DIR"
+#endif
+
+/** @brief Size of the magic and the number of images of a blob. */
+#define TEST_BLOB_HEADER_SIZE  8u
+
+/** @brief Size of an entry of the index table of a blob. */
+#define TEST_BLOB_ENTRY_SIZE  16u
+
+/** @brief Dithering methods the images are exported with. */
+static const char* const TEST_DITHER_METHODS[] = {
+	"none",
+	"floyd-steinberg"
+};
+
+/** @brief Number of `TEST_DITHER_METHODS`. */
+#define TEST_NUM_DITHER_METHODS \
+	(int)(sizeof(TEST_DITHER_METHODS) / sizeof(TEST_DITHER_METHODS[0]))
+
+/** @brief Binary blob loaded from a file. */
+typedef struct {
+	/** @brief Contents of the file. */
+	uint8_t* data;
+	/** @brief Number of images. */
+	uint32_t num_images;
+	/** @brief Index table. */
+	image_asset* assets;
+	/** @brief Encoded images after the index table. */
+	const uint8_t* images;
+} test_blob;
+
+/**
+ * @brief Reads a little-endian integer.
+ *
+ * @param[in] data
+ *
+ *   Bytes of the integer.
+ *
+ * @param[in] size
+ *
+ *   Number of bytes.
+ *
+ * @return
+ *
+ *   Integer.
+ */
+static uint32_t test_read_le (const uint8_t* data, size_t size) {
+	uint32_t value = 0u;
+	while (size > 0u) {
+		--size;
+		value = (value << 8) | data[size];
+	}
+	return value;
+}
+
+/**
+ * @brief Loads a blob exported by `make_binary_image.py`.
+ *
+ * @param[out] blob
+ *
+ *   Receives the blob. Free with `::test_free_blob`.
+ *
+ * @param[in] dither
+ *
+ *   Dithering method.
+ *
+ * @param[in] format
+ *
+ *   Format; `raw`, `rle` or `rle-delta`.
+ *
+ * @return
+ *
+ *   `0` if loaded, `-1` otherwise.
+ */
+static int test_load_blob (test_blob* blob, const char* dither, const char* format) {
+	char path[512];
+	FILE* file;
+	long size;
+	uint32_t i;
+	memset(blob, 0, sizeof(test_blob));
+	snprintf(path, sizeof(path), "%s/%s-%s.bin", TEST_BLOB_DIR, dither, format);
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	blob->data = (uint8_t*)malloc((size_t)size);
+	if (fread(blob->data, 1u, (size_t)size, file) != (size_t)size) {
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	if ((size < (long)TEST_BLOB_HEADER_SIZE) ||
+		(memcmp(blob->data, "EPDA", 4u) != 0))
+	{
+		fprintf(stderr, "%s is not a blob\n", path);
+		return -1;
+	}
+	blob->num_images = test_read_le(blob->data + 4, 4u);
+	blob->assets = (image_asset*)calloc(blob->num_images, sizeof(image_asset));
+	for (i = 0u; i < blob->num_images; ++i) {
+		const uint8_t* entry =
+			blob->data + TEST_BLOB_HEADER_SIZE + (i * TEST_BLOB_ENTRY_SIZE);
+		blob->assets[i].offset = test_read_le(entry, 4u);
+		blob->assets[i].size = test_read_le(entry + 4, 4u);
+		blob->assets[i].width = (uint16_t)test_read_le(entry + 8, 2u);
+		blob->assets[i].height = (uint16_t)test_read_le(entry + 10, 2u);
+		blob->assets[i].flags = entry[12];
+	}
+	blob->images = blob->data +
+		TEST_BLOB_HEADER_SIZE +
+		(blob->num_images * TEST_BLOB_ENTRY_SIZE);
+	return 0;
+}
+
+/**
+ * @brief Frees a blob loaded by `::test_load_blob`.
+ *
+ * @param[in,out] blob
+ *
+ *   Blob to free.
+ */
+static void test_free_blob (test_blob* blob) {
+	free(blob->assets);
+	free(blob->data);
+}
+
+/**
+ * @brief Decodes a compressed image row by row, and compares it with
+ * the raw image.
+ *
+ * @param[in] compressed
+ *
+ *   Blob of compressed images.
+ *
+ * @param[in] raw
+ *
+ *   Blob of raw images.
+ *
+ * @param[in] index
+ *
+ *   Index of the image.
+ *
+ * @return
+ *
+ *   Number of rows that differ.
+ */
+static int test_decode_rows (
+		const test_blob* compressed,
+		const test_blob* raw,
+		uint32_t index)
+{
+	const image_asset* asset = &compressed->assets[index];
+	const rle_image image = rle_image_initializer(
+		compressed->images + asset->offset,
+		asset->size,
+		asset->width,
+		asset->height,
+		asset->flags & RLE_IMAGE_FLAG_ROW_DELTA);
+	const size_t row_size = rle_image_row_size(&image);
+	const uint8_t* expected = raw->images + raw->assets[index].offset;
+	uint8_t row[RLE_IMAGE_MAX_ROW_SIZE];
+	rle_decoder decoder;
+	int num_mismatches = 0;
+	uint32_t y;
+	rle_decoder_init(&decoder, &image);
+	memset(row, 0, sizeof(row));
+	for (y = 0u; y < asset->height; ++y) {
+		if (rle_decoder_read_row(&decoder, row, row_size) != 0) {
+			return (int)(asset->height - y);
+		}
+		if (memcmp(row, expected + (y * row_size), row_size) != 0) {
+			++num_mismatches;
+		}
+	}
+	// the whole stream is consumed
+	TEST_CHECK(decoder.next == decoder.end);
+	return num_mismatches;
+}
+
+/**
+ * @brief Draws an image of both blobs with `::image_asset_draw`, and
+ * compares the buffers.
+ *
+ * @param[in] compressed
+ *
+ *   Blob of compressed images.
+ *
+ * @param[in] raw
+ *
+ *   Blob of raw images.
+ *
+ * @param[in] index
+ *
+ *   Index of the image.
+ */
+static void test_draw_asset (
+		const test_blob* compressed,
+		const test_blob* raw,
+		uint32_t index)
+{
+	const image_asset* asset = &compressed->assets[index];
+	// leaves a margin, and draws at an unaligned position
+	const uint32_t width = ((asset->width + 16u + 7u) / 8u) * 8u;
+	const uint32_t height = asset->height + 8u;
+	const size_t size = height * (width / 8u);
+	uint8_t* actual_memory = (uint8_t*)malloc(size);
+	uint8_t* expected_memory = (uint8_t*)malloc(size);
+	image_buffer actual = image_buffer_initializer(actual_memory, width, height);
+	image_buffer expected = image_buffer_initializer(expected_memory, width, height);
+	image_buffer_clear_all(&actual);
+	image_buffer_clear_all(&expected);
+	TEST_CHECK_EQUAL(
+		image_asset_draw(&actual, compressed->images, asset, 5, 3),
+		0);
+	TEST_CHECK_EQUAL(
+		image_asset_draw(&expected, raw->images, &raw->assets[index], 5, 3),
+		0);
+	TEST_CHECK(memcmp(actual_memory, expected_memory, size) == 0);
+	free(actual_memory);
+	free(expected_memory);
+}
+
+/**
+ * @brief Cuts the last byte of an image, and checks that decoding fails.
+ *
+ * @param[in] compressed
+ *
+ *   Blob of compressed images.
+ *
+ * @param[in] index
+ *
+ *   Index of the image.
+ */
+static void test_truncated (const test_blob* compressed, uint32_t index) {
+	const image_asset* asset = &compressed->assets[index];
+	const rle_image image = rle_image_initializer(
+		compressed->images + asset->offset,
+		asset->size - 1u,
+		asset->width,
+		asset->height,
+		asset->flags & RLE_IMAGE_FLAG_ROW_DELTA);
+	const size_t row_size = rle_image_row_size(&image);
+	uint8_t row[RLE_IMAGE_MAX_ROW_SIZE];
+	rle_decoder decoder;
+	int result = 0;
+	uint32_t y;
+	rle_decoder_init(&decoder, &image);
+	memset(row, 0, sizeof(row));
+	for (y = 0u; (y < asset->height) && (result == 0); ++y) {
+		result = rle_decoder_read_row(&decoder, row, row_size);
+	}
+	TEST_CHECK_EQUAL(result, -1);
+}
+
+/**
+ * @brief Round-trips the images exported with a given dithering method
+ * and format.
+ *
+ * @param[in] dither
+ *
+ *   Dithering method.
+ *
+ * @param[in] format
+ *
+ *   Compressed format; `rle` or `rle-delta`.
+ *
+ * @param[in] flags
+ *
+ *   Flags expected of the compressed images.
+ */
+static void test_round_trip (
+		const char* dither,
+		const char* format,
+		uint8_t flags)
+{
+	test_blob raw;
+	test_blob compressed;
+	uint32_t i;
+	if ((test_load_blob(&raw, dither, "raw") != 0) ||
+		(test_load_blob(&compressed, dither, format) != 0))
+	{
+		TEST_CHECK(!"blobs are loaded");
+		return;
+	}
+	TEST_CHECK(compressed.num_images > 0u);
+	TEST_CHECK_EQUAL(compressed.num_images, raw.num_images);
+	for (i = 0u; i < compressed.num_images; ++i) {
+		const image_asset* asset = &compressed.assets[i];
+		int num_mismatches;
+		TEST_CHECK_EQUAL(asset->flags, flags);
+		TEST_CHECK_EQUAL(raw.assets[i].flags, 0u);
+		TEST_CHECK_EQUAL(asset->width, raw.assets[i].width);
+		TEST_CHECK_EQUAL(asset->height, raw.assets[i].height);
+		num_mismatches = test_decode_rows(&compressed, &raw, i);
+		printf(
+			"%-15s %-9s #%u %3ux%-3u: %6u -> %6u bytes, %d row(s) differ\n",
+			dither,
+			format,
+			(unsigned)i,
+			(unsigned)asset->width,
+			(unsigned)asset->height,
+			(unsigned)raw.assets[i].size,
+			(unsigned)asset->size,
+			num_mismatches);
+		TEST_CHECK_EQUAL(num_mismatches, 0);
+		test_draw_asset(&compressed, &raw, i);
+		test_truncated(&compressed, i);
+	}
+	test_free_blob(&raw);
+	test_free_blob(&compressed);
+}
+
+int main (void) {
+	int i;
+	for (i = 0; i < TEST_NUM_DITHER_METHODS; ++i) {
+		test_round_trip(TEST_DITHER_METHODS[i], "rle", IMAGE_ASSET_FLAG_RLE);
+		test_round_trip(
+			TEST_DITHER_METHODS[i],
+			"rle-delta",
+			IMAGE_ASSET_FLAG_RLE | RLE_IMAGE_FLAG_ROW_DELTA);
+	}
+	return test_result();
+}
@@ -0,0 +1,276 @@
+/**
+ * @file test_sample_log.c
+ *
+ * Encodes sample batches with `sample_log.h`, and writes a stream for
+ * `decode_samples.py` to decode.
+ *
+ * Checks the sizes and headers of frames here, then writes to
+ * `TEST_BLOB_DIR`
+ * - `sample-log.bin`: frames mixed with noise and a corrupted frame,
+ *   as captured from a serial link.
+ * - `sample-log.csv`: samples of the valid frames in the CSV that
+ *   `decode_samples.py` writes.
+ * - `sample-log-frames.csv`: sequence number, total dropped samples and
+ *   total overruns of each valid frame.
+ *
+ * `test_decode_samples.py` decodes the stream and compares it with the
+ * CSV files; see `host/CMakeLists.txt`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample_log.h"
+
+#include "test_util.h"
+
+#ifndef TEST_BLOB_DIR
+#error "define TEST_BLOB_DIR"
+#endif
+
+/** @brief Sampling period of the batches (us); 3200Hz rounded up. */
+#define TEST_PERIOD_US  313
+
+/** @brief Kind of a batch. */
+typedef enum {
+	/** @brief Small steps; every difference takes a byte. */
+	TEST_BATCH_SMOOTH = 0,
+	/** @brief Random values; differences take up to 3 bytes. */
+	TEST_BATCH_RANDOM,
+	/** @brief Steps of `2^15`, which take 3 bytes and wrap around `2^16`. */
+	TEST_BATCH_EXTREMES,
+	/** @brief Number of kinds. */
+	TEST_NUM_BATCH_KINDS
+} test_batch_kind;
+
+/** @brief Samples of a batch. */
+static sample_record test_samples[SAMPLE_LOG_MAX_SAMPLES];
+
+/** @brief Frame. */
+static uint8_t test_frame[SAMPLE_LOG_MAX_FRAME_SIZE];
+
+/** @brief State of `::test_random`. */
+static uint32_t test_random_state = 0x12345678u;
+
+/**
+ * @brief Reads a little-endian integer.
+ *
+ * @param[in] data
+ *
+ *   Bytes of the integer.
+ *
+ * @param[in] size
+ *
+ *   Number of bytes.
+ *
+ * @return
+ *
+ *   Integer.
+ */
+static uint64_t test_read_le (const uint8_t* data, size_t size) {
+	uint64_t value = 0u;
+	while (size > 0u) {
+		--size;
+		value = (value << 8) | data[size];
+	}
+	return value;
+}
+
+/**
+ * @brief Fills a batch of evenly spaced samples.
+ *
+ * @param[in] kind
+ *
+ *   Kind of the batch.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples.
+ *
+ * @param[in] timestamp
+ *
+ *   Timestamp of the first sample.
+ */
+static void test_fill (test_batch_kind kind, size_t num_samples, int64_t timestamp) {
+	size_t i;
+	int axis;
+	for (i = 0; i < num_samples; ++i) {
+		test_samples[i].timestamp = timestamp + (int64_t)i * TEST_PERIOD_US;
+		for (axis = 0; axis < 3; ++axis) {
+			int16_t* acc = &test_samples[i].accs[axis];
+			switch (kind) {
+			case TEST_BATCH_SMOOTH:
+				*acc = (i == 0u) ?
+					(int16_t)(axis * 100 - 256) :
+					(int16_t)(test_samples[i - 1].accs[axis] +
+						(int)(test_random(&test_random_state) % 128u) - 64);
+				break;
+			case TEST_BATCH_RANDOM:
+				*acc = (int16_t)test_random(&test_random_state);
+				break;
+			default:
+				*acc = ((i + (size_t)axis) % 2u == 0u) ? INT16_MIN : 0;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Writes the samples of a batch in CSV.
+ *
+ * @param[out] csv
+ *
+ *   Stream to write.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of samples.
+ */
+static void test_write_csv (FILE* csv, size_t num_samples) {
+	size_t i;
+	for (i = 0; i < num_samples; ++i) {
+		fprintf(
+			csv,
+			"%lld,%d,%d,%d\n",
+			(long long)test_samples[i].timestamp,
+			test_samples[i].accs[0],
+			test_samples[i].accs[1],
+			test_samples[i].accs[2]);
+	}
+}
+
+/**
+ * @brief Checks the header of a frame.
+ *
+ * @param[in] size
+ *
+ *   Size of the frame.
+ *
+ * @param[in] num_samples
+ *
+ *   Number of encoded samples.
+ *
+ * @param[in] encoder
+ *
+ *   Encoder before encoding the frame.
+ */
+static void test_check_header (
+		size_t size,
+		size_t num_samples,
+		const sample_log_encoder* encoder)
+{
+	const size_t payload_size =
+		size - SAMPLE_LOG_HEADER_SIZE - SAMPLE_LOG_CRC_SIZE;
+	TEST_CHECK(size <= SAMPLE_LOG_MAX_FRAME_SIZE);
+	TEST_CHECK_EQUAL(test_frame[0], SAMPLE_LOG_SYNC_0);
+	TEST_CHECK_EQUAL(test_frame[1], SAMPLE_LOG_SYNC_1);
+	TEST_CHECK_EQUAL(test_frame[2], SAMPLE_LOG_VERSION);
+	TEST_CHECK_EQUAL(test_read_le(test_frame + 4, 2u), num_samples);
+	TEST_CHECK_EQUAL(test_read_le(test_frame + 6, 2u), payload_size);
+	TEST_CHECK_EQUAL(test_read_le(test_frame + 8, 4u), encoder->sequence);
+	TEST_CHECK_EQUAL(
+		(int64_t)test_read_le(test_frame + 12, 8u),
+		test_samples[0].timestamp);
+	TEST_CHECK_EQUAL(
+		test_read_le(test_frame + 20, 4u),
+		(num_samples - 1u) * TEST_PERIOD_US);
+	TEST_CHECK_EQUAL(test_read_le(test_frame + 24, 4u), encoder->num_dropped);
+	TEST_CHECK_EQUAL(test_read_le(test_frame + 28, 4u), encoder->num_overruns);
+}
+
+/** @brief Sizes of frames follow the varint lengths. */
+static void test_frame_sizes (void) {
+	sample_log_encoder encoder = sample_log_encoder_initializer();
+	size_t size;
+	test_fill(TEST_BATCH_SMOOTH, 1u, 0);
+	size = sample_log_encode(&encoder, test_samples, 1u, test_frame);
+	TEST_CHECK_EQUAL(size, SAMPLE_LOG_HEADER_SIZE + 6u + SAMPLE_LOG_CRC_SIZE);
+	// a byte per difference within [-64, 63]
+	test_fill(TEST_BATCH_SMOOTH, SAMPLE_LOG_MAX_SAMPLES, 0);
+	size = sample_log_encode(&encoder, test_samples, SAMPLE_LOG_MAX_SAMPLES, test_frame);
+	TEST_CHECK_EQUAL(
+		size,
+		SAMPLE_LOG_HEADER_SIZE + 6u +
+			(SAMPLE_LOG_MAX_SAMPLES - 1u) * 3u + SAMPLE_LOG_CRC_SIZE);
+	// the worst case
+	test_fill(TEST_BATCH_EXTREMES, SAMPLE_LOG_MAX_SAMPLES, 0);
+	size = sample_log_encode(&encoder, test_samples, SAMPLE_LOG_MAX_SAMPLES, test_frame);
+	TEST_CHECK_EQUAL(size, SAMPLE_LOG_MAX_FRAME_SIZE);
+	TEST_CHECK_EQUAL(encoder.sequence, 3u);
+}
+
+/**
+ * @brief Writes the stream and the expected results.
+ *
+ * The sequence numbers wrap around `2^32`. Counters of dropped samples
+ * and overruns grow on the way. One frame is corrupted after it is
+ * encoded, so its sequence number is missing from the expected frames.
+ */
+static void test_write_stream (void) {
+	static const size_t BATCH_SIZES[] = {
+		1u, 2u, 17u, 64u, SAMPLE_LOG_MAX_SAMPLES, 5u, 128u, 3u, 200u, 1u
+	};
+	const size_t num_batches = sizeof(BATCH_SIZES) / sizeof(BATCH_SIZES[0]);
+	sample_log_encoder encoder = sample_log_encoder_initializer();
+	FILE* stream = fopen(TEST_BLOB_DIR "/sample-log.bin", "wb");
+	FILE* csv = fopen(TEST_BLOB_DIR "/sample-log.csv", "w");
+	FILE* frames = fopen(TEST_BLOB_DIR "/sample-log-frames.csv", "w");
+	int64_t timestamp = 1000000;
+	size_t i;
+	if ((stream == NULL) || (csv == NULL) || (frames == NULL)) {
+		TEST_CHECK(!"files are opened");
+		return;
+	}
+	fprintf(csv, "timestamp_us,ax,ay,az\n");
+	fprintf(frames, "sequence,num_dropped,num_overruns\n");
+	// a boot message before frames, including a sync pattern
+	fputs("boot: \xA5\x5A rst:0x1\n", stream);
+	encoder.sequence = 0xFFFFFFFCu;
+	for (i = 0; i < num_batches * 3u; ++i) {
+		const size_t num_samples = BATCH_SIZES[i % num_batches];
+		const sample_log_encoder before = encoder;
+		size_t size;
+		test_fill((test_batch_kind)(i % TEST_NUM_BATCH_KINDS), num_samples, timestamp);
+		size = sample_log_encode(&encoder, test_samples, num_samples, test_frame);
+		test_check_header(size, num_samples, &before);
+		TEST_CHECK_EQUAL(encoder.sequence, before.sequence + 1u);
+		if (i == 7u) {
+			// flips a bit of the payload; the CRC rejects the frame
+			test_frame[SAMPLE_LOG_HEADER_SIZE + 3u] ^= 0x10u;
+		} else {
+			test_write_csv(csv, num_samples);
+			fprintf(
+				frames,
+				"%u,%u,%u\n",
+				(unsigned)before.sequence,
+				(unsigned)before.num_dropped,
+				(unsigned)before.num_overruns);
+		}
+		fwrite(test_frame, 1u, size, stream);
+		if (i % 4u == 1u) {
+			// noise between frames
+			fputs("\xA5\x5A\x01", stream);
+		}
+		timestamp += (int64_t)num_samples * TEST_PERIOD_US;
+		encoder.num_dropped += (uint32_t)(i % 3u);
+		encoder.num_overruns += (uint32_t)(i % 5u == 4u);
+	}
+	// a frame cut off by the end of the capture
+	test_fill(TEST_BATCH_RANDOM, 10u, timestamp);
+	fwrite(
+		test_frame,
+		1u,
+		sample_log_encode(&encoder, test_samples, 10u, test_frame) - 5u,
+		stream);
+	fclose(stream);
+	fclose(csv);
+	fclose(frames);
+}
+
+int main (void) {
+	test_frame_sizes();
+	test_write_stream();
+	return test_result();
+}
@@ -0,0 +1,178 @@
+/**
+ * @file test_sample_ring.c
+ *
+ * Stress test of `sample_ring` with a producer and a consumer thread.
+ *
+ * The producer pushes numbered records in batches of random sizes, and
+ * the consumer pops them in batches of other random sizes. Every record
+ * has to arrive once, in order and intact. The ring is small, and its
+ * indices start just before `2^32`, so both the records and the indices
+ * wrap around many times.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "sample_ring.h"
+
+#include "test_util.h"
+
+/** @brief Capacity of the ring. */
+#define TEST_RING_SIZE  64u
+
+/** @brief Number of records to pass. */
+#define TEST_NUM_RECORDS  4000000u
+
+/** @brief Largest batch pushed or popped at once. */
+#define TEST_MAX_BATCH  (TEST_RING_SIZE + 8u)
+
+/**
+ * @brief Initial indices of the ring.
+ *
+ * Wrap around `2^32` after 251 records. Not a multiple of the capacity,
+ * so that batches wrap around the end of the records even if the ring is
+ * filled up and emptied in turn.
+ */
+#define TEST_INITIAL_INDEX  0xFFFFFF05u
+
+/** @brief Records of the ring. */
+static sample_record test_records[TEST_RING_SIZE];
+
+/** @brief Ring shared by the threads. */
+static sample_ring test_ring = sample_ring_initializer(test_records, TEST_RING_SIZE);
+
+/** @brief State of a thread. */
+typedef struct {
+	/** @brief State of `::test_random`. */
+	uint32_t random_state;
+	/** @brief Number of records that were not as expected. */
+	uint32_t num_mismatches;
+	/** @brief Number of calls that moved no record. */
+	uint32_t num_empty_calls;
+	/** @brief Largest count seen by the thread. */
+	size_t max_count;
+} test_thread;
+
+/**
+ * @brief Pushes every record.
+ *
+ * @param[in,out] arg
+ *
+ *   (`test_thread*`) State of the producer.
+ *
+ * @return
+ *
+ *   `NULL`.
+ */
+static void* test_produce (void* arg) {
+	test_thread* thread = (test_thread*)arg;
+	sample_record batch[TEST_MAX_BATCH];
+	uint32_t number = 0u;
+	while (number < TEST_NUM_RECORDS) {
+		uint32_t size = 1u + test_random(&thread->random_state) % TEST_MAX_BATCH;
+		size_t num_pushed = 0u;
+		size_t count;
+		uint32_t i;
+		if (size > TEST_NUM_RECORDS - number) {
+			size = TEST_NUM_RECORDS - number;
+		}
+		for (i = 0u; i < size; ++i) {
+			test_make_sample(number + i, &batch[i]);
+		}
+		while (num_pushed < size) {
+			const size_t pushed = sample_ring_push(
+				&test_ring,
+				batch + num_pushed,
+				size - num_pushed);
+			if (pushed == 0u) {
+				++thread->num_empty_calls;
+				sched_yield();
+			}
+			num_pushed += pushed;
+		}
+		count = sample_ring_count(&test_ring);
+		if (count > thread->max_count) {
+			thread->max_count = count;
+		}
+		number += size;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Pops every record, and checks it.
+ *
+ * @param[in,out] arg
+ *
+ *   (`test_thread*`) State of the consumer.
+ *
+ * @return
+ *
+ *   `NULL`.
+ */
+static void* test_consume (void* arg) {
+	test_thread* thread = (test_thread*)arg;
+	sample_record batch[TEST_MAX_BATCH];
+	sample_record expected;
+	uint32_t number = 0u;
+	while (number < TEST_NUM_RECORDS) {
+		const uint32_t size = 1u + test_random(&thread->random_state) % TEST_MAX_BATCH;
+		const size_t num_popped = sample_ring_pop(&test_ring, batch, size);
+		size_t count;
+		size_t i;
+		if (num_popped == 0u) {
+			++thread->num_empty_calls;
+			sched_yield();
+			continue;
+		}
+		for (i = 0u; i < num_popped; ++i, ++number) {
+			test_make_sample(number, &expected);
+			if ((batch[i].timestamp != expected.timestamp) ||
+				(batch[i].accs[0] != expected.accs[0]) ||
+				(batch[i].accs[1] != expected.accs[1]) ||
+				(batch[i].accs[2] != expected.accs[2]))
+			{
+				++thread->num_mismatches;
+			}
+		}
+		count = sample_ring_count(&test_ring);
+		if (count > thread->max_count) {
+			thread->max_count = count;
+		}
+	}
+	return NULL;
+}
+
+int main (void) {
+	test_thread producer = { 0x12345678u, 0u, 0u, 0u };
+	test_thread consumer = { 0x9ABCDEF0u, 0u, 0u, 0u };
+	pthread_t producer_thread;
+	pthread_t consumer_thread;
+	test_ring.head = TEST_INITIAL_INDEX;
+	test_ring.tail = TEST_INITIAL_INDEX;
+	TEST_CHECK_EQUAL(
+		pthread_create(&consumer_thread, NULL, test_consume, &consumer),
+		0);
+	TEST_CHECK_EQUAL(
+		pthread_create(&producer_thread, NULL, test_produce, &producer),
+		0);
+	pthread_join(producer_thread, NULL);
+	pthread_join(consumer_thread, NULL);
+	printf(
+		"%u records through %u slots: %u mismatches, "
+		"%u full pushes, %u empty pops\n",
+		(unsigned)TEST_NUM_RECORDS,
+		(unsigned)TEST_RING_SIZE,
+		(unsigned)consumer.num_mismatches,
+		(unsigned)producer.num_empty_calls,
+		(unsigned)consumer.num_empty_calls);
+	TEST_CHECK_EQUAL(consumer.num_mismatches, 0);
+	TEST_CHECK(producer.max_count <= TEST_RING_SIZE);
+	TEST_CHECK(consumer.max_count <= TEST_RING_SIZE);
+	TEST_CHECK_EQUAL(sample_ring_count(&test_ring), 0);
+	TEST_CHECK_EQUAL(test_ring.head, (uint32_t)(TEST_INITIAL_INDEX + TEST_NUM_RECORDS));
+	return test_result();
+}
@@ -0,0 +1,375 @@
+/**
+ * @file test_shared_bus.c
+ *
+ * Puts the E-Paper display and the ADXL345 on one VSPI bus, as a product
+ * combining both projects would, and checks that the FIFO of the ADXL345
+ * survives back-to-back frames.
+ *
+ * Both devices are registered with one `::spi_bus_manager` with the pins
+ * and ranks of `spi_epd_main.c` and `spi_adxl345_main.c`. The ADXL345
+ * samples at 3200Hz with the watermark of 16, and is drained by a scheduled
+ * function that stands for the event task of higher priority. The main task
+ * uploads whole frames meanwhile, in chunks of `EPD_MAX_TRANSFER_SIZE`
+ * bytes. With the ADXL345 first, a drain waits at most for a chunk, so the
+ * FIFO never fills up; with the EPD registered first, a drain that meets
+ * a queued chunk waits for it too.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "adxl345.h"
+#include "epd_driver.h"
+#include "epd_panel.h"
+#include "hal_linux.h"
+#include "spi_bus_manager.h"
+
+#include "adxl345_sim.h"
+#include "epd_sim.h"
+#include "test_util.h"
+
+/** @brief GPIO# for MISO. Same as both projects. */
+#define TEST_PIN_MISO  19
+/** @brief GPIO# for MOSI. Same as both projects. */
+#define TEST_PIN_MOSI  23
+/** @brief GPIO# for SCLK. Same as both projects. */
+#define TEST_PIN_CLK  18
+/** @brief GPIO# for CS of the EPD. Same as `spi_epd_main.c`. */
+#define TEST_PIN_EPD_CS  5
+/** @brief GPIO# for CS of the ADXL345. Same as `spi_adxl345_main.c`. */
+#define TEST_PIN_ADXL345_CS  21
+/** @brief GPIO# for DC. Same as `spi_epd_main.c`. */
+#define TEST_PIN_DC  27
+/** @brief GPIO# for RST. Same as `spi_epd_main.c`. */
+#define TEST_PIN_RST  25
+/** @brief GPIO# for BUSY. Same as `spi_epd_main.c`. */
+#define TEST_PIN_BUSY  26
+/** @brief GPIO# for INT1. Same as `spi_adxl345_main.c`. */
+#define TEST_PIN_INT1  33
+
+/** @brief SPI host. Has no meaning on Linux. */
+#define TEST_HOST  3
+/** @brief DMA channel. Same as `spi_epd_main.c`. */
+#define TEST_DMA_CHAN  2
+
+/** @brief Rank of the ADXL345. Same as `spi_adxl345_main.c`. */
+#define TEST_ADXL345_RANK  1
+/** @brief Rank of the EPD. Same as `spi_epd_main.c`. */
+#define TEST_EPD_RANK  0
+
+/** @brief Queue size of the EPD. Same as `spi_epd_main.c`. */
+#define TEST_EPD_QUEUE_SIZE  4
+
+/** @brief Watermark of the FIFO. Same as `spi_adxl345_main.c`. */
+#define TEST_WATERMARK  16u
+
+/** @brief Panel of the EPD. Same as `spi_epd_main.c`. */
+#define TEST_PANEL  EPD_PANEL_1IN54_V2
+
+/** @brief Number of frames uploaded back to back. */
+#define TEST_NUM_FRAMES  500
+
+/** @brief Configuration of the ADXL345. Same as `spi_adxl345_main.c`. */
+static const adxl345_config TEST_CONFIG = adxl345_config_initializer(
+	ADXL345_RATE_3200HZ,
+	ADXL345_RANGE_16G,
+	1,
+	0);
+
+/** @brief Copy of the RAM of the EPD. */
+static uint8_t test_panel_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Frame to upload. */
+static uint8_t test_frame_memory[EPD_PANEL_MAX_FRAME_SIZE];
+
+/** @brief Simulated ADXL345. */
+static adxl345_sim test_adxl345_sim;
+
+/** @brief Handle of the ADXL345. */
+static hal_spi_device test_adxl345;
+
+/** @brief Clock of samples of the ADXL345. */
+static adxl345_fifo_clock test_clock;
+
+/** @brief Time of the last rising edge of INT1 (us). */
+static int64_t test_int1_timestamp;
+
+/** @brief Whether INT1 has risen since the last drain started. */
+static int test_pending;
+
+/** @brief Whether a drain is in progress. */
+static int test_draining;
+
+/** @brief Number of samples drained. */
+static uint64_t test_num_drained;
+
+/** @brief Index of the sample next to the last drained one. */
+static uint32_t test_next_index;
+
+/** @brief Number of samples out of order. */
+static uint32_t test_num_out_of_order;
+
+/** @brief Number of drains that saw an overrun. */
+static uint32_t test_num_overruns;
+
+/** @brief Statistics of the ADXL345 with the ranks of the projects. */
+static spi_bus_device_stats test_first_stats;
+
+/**
+ * @brief Time of the last rising edge of INT1.
+ *
+ * @return
+ *
+ *   Time in microseconds.
+ */
+static int64_t test_get_int1_timestamp (void) {
+	return test_int1_timestamp;
+}
+
+/**
+ * @brief Drains the FIFO until it is below the watermark.
+ *
+ * Drains again if INT1 rises during a drain, as a task notified from
+ * the ISR would.
+ *
+ * @param[in] arg
+ *
+ *   Not used.
+ */
+static void test_drain (void* arg) {
+	sample_record samples[ADXL345_MAX_FIFO_ENTRIES];
+	uint8_t int_source;
+	size_t num_samples;
+	size_t i;
+	(void)arg;
+	// a drain that talks to the bus runs scheduled functions
+	if (test_draining) {
+		return;
+	}
+	test_draining = 1;
+	while (test_pending) {
+		test_pending = 0;
+		do {
+			num_samples = adxl345_drain_fifo(
+				test_adxl345,
+				&test_clock,
+				TEST_WATERMARK,
+				test_get_int1_timestamp,
+				samples,
+				&int_source);
+			if ((int_source & ADXL345_INT_OVERRUN) != 0u) {
+				++test_num_overruns;
+			}
+			for (i = 0u; i < num_samples; ++i) {
+				if ((test_num_drained + i > 0u) &&
+					(adxl345_sim_counter_index(samples[i].accs) != test_next_index))
+				{
+					++test_num_out_of_order;
+				}
+				test_next_index = adxl345_sim_counter_index(samples[i].accs) + 1u;
+			}
+			test_num_drained += num_samples;
+		} while (num_samples >= TEST_WATERMARK);
+	}
+	test_draining = 0;
+}
+
+/**
+ * @brief Handles a rising edge of INT1.
+ *
+ * @param[in] arg
+ *
+ *   Not used.
+ */
+static void test_int1_isr (void* arg) {
+	(void)arg;
+	test_int1_timestamp = hal_get_time_us();
+	test_pending = 1;
+	if (!test_draining) {
+		TEST_CHECK_EQUAL(
+			hal_linux_schedule(hal_linux_get_time_ns(), test_drain, NULL),
+			0);
+	}
+}
+
+/**
+ * @brief Uploads frames while the ADXL345 streams, on a bus shared by both.
+ *
+ * @param[in] adxl345_rank
+ *
+ *   Rank of the ADXL345 on the bus.
+ *
+ * @param[in] epd_rank
+ *
+ *   Rank of the EPD on the bus.
+ *   The device of the higher rank is registered first.
+ *
+ * @param[out] adxl345_stats
+ *
+ *   Receives the statistics of the ADXL345 on the bus.
+ */
+static void test_run (
+		int adxl345_rank,
+		int epd_rank,
+		spi_bus_device_stats* adxl345_stats)
+{
+	const epd_panel* panel = &EPD_PANELS[TEST_PANEL];
+	const hal_spi_device_config epd_config = {
+		.cs_pin = TEST_PIN_EPD_CS,
+		.clock_speed_hz = panel->max_clock_hz,
+		.mode = 0,
+		.queue_size = TEST_EPD_QUEUE_SIZE
+	};
+	const hal_spi_device_config adxl345_config = {
+		.cs_pin = TEST_PIN_ADXL345_CS,
+		.clock_speed_hz = adxl345_spi_clock_hz(&TEST_CONFIG, TEST_WATERMARK),
+		.mode = 3,
+		.command_bits = 8,
+		.queue_size = ADXL345_MAX_FIFO_ENTRIES
+	};
+	// transactions as long as chunks of a frame
+	spi_bus_manager bus = spi_bus_manager_initializer(
+		TEST_HOST,
+		TEST_PIN_MOSI,
+		TEST_PIN_MISO,
+		TEST_PIN_CLK,
+		EPD_MAX_TRANSFER_SIZE,
+		TEST_DMA_CHAN);
+	const adxl345_fifo_clock initial_clock = {
+		.odr_millihz = adxl345_odr_millihz(&TEST_CONFIG),
+		.next_index = 0u,
+		.anchor_index = 0u,
+		.anchor_timestamp = 0,
+		.drain_end_timestamp = 0
+	};
+	image_buffer frame = image_buffer_initializer(
+		test_frame_memory,
+		panel->ram_width,
+		panel->height);
+	hal_spi_device epd_spi;
+	epd_device epd;
+	epd_sim sim;
+	int i;
+	hal_linux_reset();
+	test_clock = initial_clock;
+	test_pending = 0;
+	test_draining = 0;
+	test_num_drained = 0u;
+	test_num_out_of_order = 0u;
+	test_num_overruns = 0u;
+	// in descending order of rank
+	if (epd_rank > adxl345_rank) {
+		TEST_CHECK_EQUAL(
+			spi_bus_manager_add_device(&bus, &epd_config, epd_rank, &epd_spi),
+			HAL_OK);
+	}
+	TEST_CHECK_EQUAL(
+		spi_bus_manager_add_device(
+			&bus,
+			&adxl345_config,
+			adxl345_rank,
+			&test_adxl345),
+		HAL_OK);
+	if (epd_rank <= adxl345_rank) {
+		TEST_CHECK_EQUAL(
+			spi_bus_manager_add_device(&bus, &epd_config, epd_rank, &epd_spi),
+			HAL_OK);
+	}
+	TEST_CHECK_EQUAL(spi_bus_manager_start(&bus), HAL_OK);
+	epd_sim_init(&sim, TEST_PIN_DC, TEST_PIN_BUSY, NULL);
+	epd_sim_attach(&sim, epd_spi);
+	adxl345_sim_init(&test_adxl345_sim, TEST_PIN_INT1);
+	adxl345_sim_attach(&test_adxl345_sim, test_adxl345);
+	epd_device_init(
+		&epd,
+		panel,
+		epd_spi,
+		TEST_PIN_DC,
+		TEST_PIN_RST,
+		TEST_PIN_BUSY,
+		test_panel_memory);
+	epd_configure_gpios(&epd);
+	epd_initialize(&epd);
+	epd_clear_all(&epd);
+	// as `app_main` and the event task of `spi_adxl345_main.c` do;
+	// edges until the FIFO is discarded are kept for the first drain
+	test_draining = 1;
+	hal_gpio_set_isr(TEST_PIN_INT1, HAL_GPIO_RISING_EDGE, test_int1_isr, NULL);
+	TEST_CHECK_EQUAL(adxl345_configure(test_adxl345, &TEST_CONFIG), HAL_OK);
+	adxl345_configure_fifo(test_adxl345, TEST_WATERMARK);
+	adxl345_start(test_adxl345);
+	adxl345_discard_fifo(
+		test_adxl345,
+		&test_clock,
+		adxl345_odr_millihz(&TEST_CONFIG));
+	// counts from the first drain
+	test_adxl345_sim.max_entries = 0u;
+	test_adxl345_sim.num_overrun_samples = 0u;
+	test_draining = 0;
+	test_drain(NULL);
+	// every row differs from the previous frame
+	for (i = 0; i < TEST_NUM_FRAMES; ++i) {
+		memset(test_frame_memory, (i & 1) ? 0xFF : 0x00, epd_panel_frame_size(panel));
+		epd_draw_image_buffer_diff(&epd, &frame);
+	}
+	TEST_CHECK_EQUAL(
+		spi_bus_manager_get_stats(&bus, test_adxl345, adxl345_stats),
+		HAL_OK);
+	printf(
+		"ADXL345 rank %d, EPD rank %d: %u frames in %.0f ms, "
+		"%llu samples, peak FIFO fill %u of %u, latency mean %lld us max %lld us, ",
+		adxl345_rank,
+		epd_rank,
+		(unsigned)TEST_NUM_FRAMES,
+		hal_linux_get_time_ns() * 1e-6,
+		(unsigned long long)test_num_drained,
+		(unsigned)test_adxl345_sim.max_entries,
+		(unsigned)ADXL345_SIM_FIFO_SIZE,
+		(long long)(adxl345_stats->total_latency_us /
+			(int64_t)adxl345_stats->num_transactions),
+		(long long)adxl345_stats->max_latency_us);
+	if (test_adxl345_sim.num_overrun_samples == 0u) {
+		printf("no overruns\n");
+	} else {
+		printf("%llu samples overrun\n",
+			(unsigned long long)test_adxl345_sim.num_overrun_samples);
+	}
+}
+
+/** @brief The ADXL345 keeps up with frames with the ranks of the projects. */
+static void test_adxl345_first (void) {
+	spi_bus_device_stats stats;
+	// a chunk of the EPD on the wire
+	const int64_t chunk_us = (int64_t)EPD_MAX_TRANSFER_SIZE * 8 * 1000000 /
+		EPD_PANELS[TEST_PANEL].max_clock_hz;
+	test_run(TEST_ADXL345_RANK, TEST_EPD_RANK, &stats);
+	TEST_CHECK_EQUAL(test_adxl345_sim.num_overrun_samples, 0u);
+	TEST_CHECK_EQUAL(test_num_overruns, 0u);
+	TEST_CHECK_EQUAL(test_num_out_of_order, 0u);
+	TEST_CHECK(test_adxl345_sim.max_entries < ADXL345_SIM_FIFO_SIZE);
+	// no more than a chunk and the overhead around it
+	TEST_CHECK(stats.max_latency_us <= chunk_us + 100);
+	test_first_stats = stats;
+}
+
+/**
+ * @brief Registering the EPD first makes the ADXL345 wait longer.
+ *
+ * Only on average; either way, a drain that arrives while the EPD waits
+ * for a result goes first.
+ */
+static void test_epd_first (void) {
+	const spi_bus_device_stats* first = &test_first_stats;
+	spi_bus_device_stats reversed;
+	test_run(TEST_EPD_RANK, TEST_ADXL345_RANK, &reversed);
+	TEST_CHECK_EQUAL(test_num_out_of_order, 0u);
+	TEST_CHECK(
+		reversed.total_latency_us / (int64_t)reversed.num_transactions >
+		first->total_latency_us / (int64_t)first->num_transactions);
+}
+
+int main (void) {
+	test_adxl345_first();
+	test_epd_first();
+	return test_result();
+}
@@ -0,0 +1,280 @@
+/**
+ * @file test_spectrum.c
+ *
+ * Compares `::spectrum_fft` with a naive DFT in double precision, and
+ * checks peaks that `::spectrum_find_peaks` interpolates from spectra of
+ * synthetic sine waves.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spectrum.h"
+
+#include "test_util.h"
+
+/** @brief Pi in double precision. */
+#define TEST_PI  3.14159265358979323846
+
+/** @brief Largest relative RMS error of an FFT against the DFT. */
+#define TEST_MAX_FFT_ERROR  1.5e-7
+
+/** @brief FFT size of spectra of sine waves. Same as `spi_adxl345_main.c`. */
+#define TEST_SPECTRUM_SIZE  1024u
+
+/** @brief Sampling rate of sine waves in mHz. */
+#define TEST_SAMPLE_RATE_MILLIHZ  3200000u
+
+/** @brief Width of a bin of `TEST_SPECTRUM_SIZE` in Hz. */
+#define TEST_BIN_WIDTH \
+	(TEST_SAMPLE_RATE_MILLIHZ / 1000.0 / TEST_SPECTRUM_SIZE)
+
+/** @brief Hann window. */
+static float test_window[SPECTRUM_WINDOW_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Twiddle factors. */
+static float test_twiddles[SPECTRUM_TWIDDLES_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Work buffer. */
+static float test_work[SPECTRUM_WORK_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief History. */
+static int16_t test_history[SPECTRUM_HISTORY_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Magnitudes. */
+static float test_magnitudes[SPECTRUM_MAGNITUDES_SIZE(SPECTRUM_MAX_SIZE)];
+
+/** @brief Input of the DFT. */
+static double test_inputs[2u * SPECTRUM_MAX_SIZE];
+
+/** @brief `exp(-2 pi i m / size)` of the DFT as (re, im) pairs. */
+static double test_exps[2u * SPECTRUM_MAX_SIZE];
+
+/** @brief State of `::test_random`. */
+static uint32_t test_random_state = 0x6D2B79F5u;
+
+/**
+ * @brief Initializes a `::spectrum` of a given size on the test buffers.
+ *
+ * @param[out] s
+ *
+ *   `::spectrum` to initialize.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ */
+static void test_init_spectrum (spectrum* s, uint32_t size) {
+	const spectrum initial = spectrum_initializer(
+		size,
+		TEST_SAMPLE_RATE_MILLIHZ,
+		test_history,
+		test_window,
+		test_twiddles,
+		test_work,
+		test_magnitudes);
+	*s = initial;
+	spectrum_init(s);
+}
+
+/**
+ * @brief Transforms random complex numbers of a given size, and compares
+ * with a DFT.
+ *
+ * @param[in] size
+ *
+ *   FFT size.
+ *
+ * @return
+ *
+ *   Relative RMS error of the FFT.
+ */
+static double test_fft_error (uint32_t size) {
+	spectrum s;
+	double error = 0.0;
+	double power = 0.0;
+	uint32_t i;
+	uint32_t k;
+	test_init_spectrum(&s, size);
+	for (i = 0u; i < 2u * size; ++i) {
+		// 16-bit samples
+		test_work[i] = (float)(int16_t)test_random(&test_random_state);
+		test_inputs[i] = test_work[i];
+	}
+	for (i = 0u; i < size; ++i) {
+		test_exps[2u * i] = cos(-2.0 * TEST_PI * i / size);
+		test_exps[2u * i + 1u] = sin(-2.0 * TEST_PI * i / size);
+	}
+	spectrum_fft(test_work, size, s.twiddles);
+	for (k = 0u; k < size; ++k) {
+		double re = 0.0;
+		double im = 0.0;
+		for (i = 0u; i < size; ++i) {
+			const uint32_t m = (uint32_t)(((uint64_t)i * k) % size);
+			const double xr = test_inputs[2u * i];
+			const double xi = test_inputs[2u * i + 1u];
+			re += xr * test_exps[2u * m] - xi * test_exps[2u * m + 1u];
+			im += xr * test_exps[2u * m + 1u] + xi * test_exps[2u * m];
+		}
+		error += (test_work[2u * k] - re) * (test_work[2u * k] - re) +
+			(test_work[2u * k + 1u] - im) * (test_work[2u * k + 1u] - im);
+		power += re * re + im * im;
+	}
+	return sqrt(error / power);
+}
+
+/** @brief FFTs of every size agree with the DFT. */
+static void test_fft_matches_dft (void) {
+	uint32_t size;
+	for (size = SPECTRUM_MIN_SIZE; size <= SPECTRUM_MAX_SIZE; size <<= 1) {
+		const double error = test_fft_error(size);
+		printf("FFT %4u: relative RMS error %.2e\n", (unsigned)size, error);
+		TEST_CHECK(error <= TEST_MAX_FFT_ERROR);
+	}
+}
+
+/**
+ * @brief Feeds sine waves until the first spectra.
+ *
+ * @param[in,out] s
+ *
+ *   `::spectrum` with an empty history.
+ *
+ * @param[in] frequencies
+ *
+ *   Frequencies of sine waves of axes in Hz. `0` for a constant.
+ *
+ * @param[in] amplitudes
+ *
+ *   Amplitudes of sine waves of axes in LSB.
+ *
+ * @param[in] offset
+ *
+ *   Added to every axis; e.g., gravity.
+ */
+static void test_feed (
+		spectrum* s,
+		const double* frequencies,
+		const double* amplitudes,
+		int16_t offset)
+{
+	const double rate = TEST_SAMPLE_RATE_MILLIHZ / 1000.0;
+	sample_record sample;
+	uint32_t i;
+	int updated = 0;
+	int axis;
+	for (i = 0u; i < s->size; ++i) {
+		sample.timestamp = (int64_t)i * 1000000 / (int64_t)rate;
+		for (axis = 0; axis < 3; ++axis) {
+			sample.accs[axis] = (int16_t)(offset + lround(
+				amplitudes[axis] * sin(2.0 * TEST_PI * frequencies[axis] * i / rate)));
+		}
+		TEST_CHECK(!updated);
+		updated = spectrum_add(s, &sample);
+	}
+	TEST_CHECK(updated);
+}
+
+/**
+ * @brief Finds the peak of a sine wave of a given frequency.
+ *
+ * @param[in] frequency
+ *
+ *   Frequency in Hz.
+ *
+ * @param[out] peak
+ *
+ *   Receives the highest peak of the x axis.
+ */
+static void test_find_sine_peak (double frequency, spectrum_peak* peak) {
+	const double frequencies[3] = { frequency, 0.0, 0.0 };
+	const double amplitudes[3] = { 1000.0, 0.0, 0.0 };
+	spectrum s;
+	test_init_spectrum(&s, TEST_SPECTRUM_SIZE);
+	test_feed(&s, frequencies, amplitudes, 256);
+	TEST_CHECK_EQUAL(spectrum_find_peaks(&s, 0, peak, 1u), 1u);
+}
+
+/** @brief A sine wave at a bin keeps its frequency and amplitude. */
+static void test_peak_at_bin (void) {
+	const double frequency = 100.0 * TEST_BIN_WIDTH;
+	spectrum_peak peak;
+	test_find_sine_peak(frequency, &peak);
+	printf(
+		"sine at %.3fHz: peak at %.4fHz, magnitude %.2f\n",
+		frequency,
+		peak.frequency,
+		peak.magnitude);
+	TEST_CHECK(fabs(peak.frequency - frequency) < 1e-3 * TEST_BIN_WIDTH);
+	TEST_CHECK(fabs(peak.magnitude - 1000.0) < 1.0);
+}
+
+/**
+ * @brief Sine waves between bins are located within a fraction of a bin.
+ *
+ * A parabola through linear magnitudes of a Hann window is off by up to
+ * about 0.06 bins, whereas the nearest bin is off by up to 0.5 bins.
+ */
+static void test_peak_between_bins (void) {
+	double max_error = 0.0;
+	int i;
+	for (i = 0; i <= 10; ++i) {
+		const double frequency = (200.0 + i / 10.0) * TEST_BIN_WIDTH;
+		spectrum_peak peak;
+		double error;
+		test_find_sine_peak(frequency, &peak);
+		error = fabs(peak.frequency - frequency) / TEST_BIN_WIDTH;
+		if (error > max_error) {
+			max_error = error;
+		}
+		// at least the scalloped amplitude of a Hann window
+		TEST_CHECK(peak.magnitude > 1000.0 * 0.84);
+		TEST_CHECK(peak.magnitude <= 1000.0 * 1.001);
+	}
+	printf("sine between bins: peaks off by up to %.3f bins\n", max_error);
+	TEST_CHECK(max_error < 0.1);
+}
+
+/** @brief Peaks are sorted, truncated, and absent from constants. */
+static void test_peak_order (void) {
+	const double rate = TEST_SAMPLE_RATE_MILLIHZ / 1000.0;
+	spectrum s;
+	spectrum_peak peaks[3];
+	uint32_t i;
+	test_init_spectrum(&s, TEST_SPECTRUM_SIZE);
+	// gravity on x, two tones on y, nothing on z
+	for (i = 0u; i < TEST_SPECTRUM_SIZE; ++i) {
+		const sample_record sample = {
+			.timestamp = 0,
+			.accs = {
+				-256,
+				(int16_t)lround(
+					2000.0 * sin(2.0 * TEST_PI * 123.4 * i / rate) +
+					500.0 * sin(2.0 * TEST_PI * 777.7 * i / rate)),
+				0
+			}
+		};
+		spectrum_add(&s, &sample);
+	}
+	// a constant has no peaks once the mean is removed
+	TEST_CHECK_EQUAL(spectrum_find_peaks(&s, 0, peaks, 3u), 0u);
+	TEST_CHECK_EQUAL(spectrum_find_peaks(&s, 2, peaks, 3u), 0u);
+	TEST_CHECK_EQUAL(spectrum_find_peaks(&s, 1, peaks, 0u), 0u);
+	TEST_CHECK(spectrum_find_peaks(&s, 1, peaks, 3u) >= 2u);
+	TEST_CHECK(fabs(peaks[0].frequency - 123.4) < 0.1 * TEST_BIN_WIDTH);
+	TEST_CHECK(fabs(peaks[1].frequency - 777.7) < 0.1 * TEST_BIN_WIDTH);
+	TEST_CHECK(peaks[0].magnitude > peaks[1].magnitude);
+	TEST_CHECK(peaks[1].magnitude >= peaks[2].magnitude);
+	// only the highest one fits
+	TEST_CHECK_EQUAL(spectrum_find_peaks(&s, 1, peaks, 1u), 1u);
+	TEST_CHECK(fabs(peaks[0].frequency - 123.4) < 0.1 * TEST_BIN_WIDTH);
+}
+
+int main (void) {
+	test_fft_matches_dft();
+	test_peak_at_bin();
+	test_peak_between_bins();
+	test_peak_order();
+	return test_result();
+}
@@ -0,0 +1,210 @@
+#ifndef _TEST_UTIL_H
+#define _TEST_UTIL_H
+
+/**
+ * @file test_util.h
+ *
+ * Checks and fixtures shared by the host tests.
+ *
+ * A test runs every check, reports failed ones on `stderr`,
+ * and returns `test_result()` from `main`.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** @brief Number of failed checks. */
+static int test_num_failures = 0;
+
+/**
+ * @brief Checks that a given condition holds.
+ *
+ * @param[in] cond
+ *
+ *   Condition.
+ */
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++test_num_failures; \
+		} \
+	} while (0)
+
+/**
+ * @brief Checks that two integers are equal.
+ *
+ * @param[in] actual
+ *
+ *   Actual value.
+ *
+ * @param[in] expected
+ *
+ *   Expected value.
+ */
+#define TEST_CHECK_EQUAL(actual, expected) \
+	do { \
+		const long long test_actual_ = (long long)(actual); \
+		const long long test_expected_ = (long long)(expected); \
+		if (test_actual_ != test_expected_) { \
+			fprintf( \
+				stderr, \
+				"%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+				__FILE__, \
+				__LINE__, \
+				#actual, \
+				#expected, \
+				test_actual_, \
+				test_expected_); \
+			++test_num_failures; \
+		} \
+	} while (0)
+
+/**
+ * @brief Exit status of a test.
+ *
+ * @return
+ *
+ *   `0` if every check passed, otherwise `1`.
+ */
+static inline int test_result (void) {
+	if (test_num_failures > 0) {
+		fprintf(stderr, "%d check(s) failed\n", test_num_failures);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Generates a pseudo-random number (xorshift32).
+ *
+ * @param[in,out] state
+ *
+ *   State of the generator. Must not be `0`.
+ *
+ * @return
+ *
+ *   Pseudo-random number.
+ */
+static inline uint32_t test_random (uint32_t* state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/**
+ * @brief Generates a pseudo-random integer in a given range.
+ *
+ * @param[in,out] state
+ *
+ *   State of the generator.
+ *
+ * @param[in] min
+ *
+ *   Minimum integer.
+ *
+ * @param[in] max
+ *
+ *   Maximum integer, inclusive.
+ *
+ * @return
+ *
+ *   Pseudo-random integer.
+ */
+static inline int test_random_range (uint32_t* state, int min, int max) {
+	return min + (int)(test_random(state) % (uint32_t)(max - min + 1));
+}
+
+/**
+ * @brief Fills a block with pseudo-random bytes.
+ *
+ * @param[in,out] state
+ *
+ *   State of the generator.
+ *
+ * @param[out] data
+ *
+ *   Block to fill.
+ *
+ * @param[in] size
+ *
+ *   Size of the block in bytes.
+ */
+static inline void test_fill_random (uint32_t* state, uint8_t* data, size_t size) {
+	size_t i;
+	for (i = 0; i < size; ++i) {
+		data[i] = (uint8_t)test_random(state);
+	}
+}
+
+/**
+ * @brief Loads a whole file; e.g., a golden file written by a Python
+ * script.
+ *
+ * @param[in] path
+ *
+ *   Path to the file.
+ *
+ * @param[out] size
+ *
+ *   Receives the size of the file in bytes.
+ *
+ * @return
+ *
+ *   Contents of the file. Free with `free`.
+ *   `NULL` if the file cannot be read.
+ */
+static inline uint8_t* test_load_file (const char* path, size_t* size) {
+	FILE* file = fopen(path, "rb");
+	uint8_t* data;
+	long length;
+	if (file == NULL) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data = (uint8_t*)malloc((size_t)length);
+	if (fread(data, 1u, (size_t)length, file) != (size_t)length) {
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	*size = (size_t)length;
+	return data;
+}
+
+#ifdef _SAMPLE_RING_H
+/**
+ * @brief Makes the sample of a given index.
+ *
+ * The timestamp is the index, every axis is derived from it, and
+ * the magnitude stays below 700 LSB.
+ * So a torn sample does not match its index, and samples stay below
+ * a threshold of capture above that.
+ *
+ * Available if `sample_ring.h` is included before this header.
+ *
+ * @param[in] index
+ *
+ *   Index of the sample.
+ *
+ * @param[out] sample
+ *
+ *   Receives the sample.
+ */
+static inline void test_make_sample (uint32_t index, sample_record* sample) {
+	sample->timestamp = (int64_t)index;
+	sample->accs[0] = (int16_t)(index % 500u);
+	sample->accs[1] = -(int16_t)(index % 300u);
+	sample->accs[2] = 256;
+}
+#endif
+
+#endif